@@ -0,0 +1,117 @@
+/**
+ * @file bench_builtins.cpp
+ * @brief Dispatch and run cost of the built-in commands
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nullsh/builtins.h"
+#include "nullsh/output_sink.h"
+#include "nullsh/parser.h"
+#include "nullsh/shell.h"
+
+using namespace nullsh;
+
+namespace
+{
+    void bm_builtin(benchmark::State& state, std::vector<std::string> args)
+    {
+        shell::NullShell sh {};
+        auto cmd = parser::make_command(args);
+        if (!cmd)
+        {
+            state.SkipWithError("no command");
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            auto res = builtins::execute(*cmd, sh);
+            benchmark::DoNotOptimize(res);
+        }
+    }
+
+    // the shell's own path: output goes through a sink straight to an fd, nothing is captured
+    void bm_builtin_to_fd(benchmark::State& state, std::vector<std::string> args)
+    {
+        shell::NullShell sh {};
+        auto cmd = parser::make_command(args);
+        int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (!cmd || fd < 0)
+        {
+            state.SkipWithError("no command");
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            io::OutputSink out {fd};
+            io::OutputSink err {fd};
+            auto res = builtins::run(*cmd, sh, out, err);
+            out.finish();
+            err.finish();
+            benchmark::DoNotOptimize(res);
+        }
+        close(fd);
+    }
+
+    auto many_words(std::size_t count) -> std::vector<std::string>
+    {
+        std::vector<std::string> args {"echo"};
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            args.push_back("word" + std::to_string(i));
+        }
+        return args;
+    }
+
+    void bm_is_builtin(benchmark::State& state, const std::string& name)
+    {
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(builtins::is_builtin(name));
+        }
+    }
+
+    // the hash map is_builtin used before the compile-time table, as a baseline
+    void bm_is_builtin_unordered_map(benchmark::State& state, const std::string& name)
+    {
+        static const std::unordered_map<std::string, int> table = {
+            {"cd", 0},   {"pwd", 1},  {"exit", 2}, {"echo", 3},   {"hash", 4}, {"jobs", 5},
+            {"wait", 6}, {"fg", 7},   {"limit", 8}, {"source", 9}, {".", 10},
+        };
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(table.contains(name));
+        }
+    }
+} // namespace
+
+BENCHMARK_CAPTURE(bm_builtin, echo, std::vector<std::string> {"echo", "hello", "void"});
+BENCHMARK_CAPTURE(bm_builtin, pwd, std::vector<std::string> {"pwd"});
+BENCHMARK_CAPTURE(bm_builtin, cd, std::vector<std::string> {"cd", "."});
+BENCHMARK_CAPTURE(bm_builtin, hash_warm, std::vector<std::string> {"hash", "ls", "cat"});
+BENCHMARK_CAPTURE(bm_builtin, echo_many, many_words(256));
+BENCHMARK_CAPTURE(bm_builtin, test, std::vector<std::string> {"[", "-f", "/etc/passwd", "]"});
+BENCHMARK_CAPTURE(bm_builtin,
+                  printf,
+                  std::vector<std::string> {"printf", "%s=%d\\n", "one", "1", "two", "2"});
+BENCHMARK_CAPTURE(bm_builtin, cat, std::vector<std::string> {"cat", "/etc/passwd"});
+BENCHMARK_CAPTURE(bm_builtin_to_fd, echo, std::vector<std::string> {"echo", "hello", "void"});
+BENCHMARK_CAPTURE(bm_builtin_to_fd, pwd, std::vector<std::string> {"pwd"});
+BENCHMARK_CAPTURE(bm_builtin_to_fd, echo_many, many_words(256));
+
+BENCHMARK_CAPTURE(bm_is_builtin, hit, std::string("echo"));
+BENCHMARK_CAPTURE(bm_is_builtin, miss, std::string("some-external-tool"));
+BENCHMARK_CAPTURE(bm_is_builtin, miss_same_length, std::string("grep"));
+BENCHMARK_CAPTURE(bm_is_builtin_unordered_map, hit, std::string("echo"));
+BENCHMARK_CAPTURE(bm_is_builtin_unordered_map, miss, std::string("some-external-tool"));
+BENCHMARK_CAPTURE(bm_is_builtin_unordered_map, miss_same_length, std::string("grep"));
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * @file bench_executor.cpp
+ * @brief exec_external latency and capture throughput from 1 KiB to 1 GiB of output
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+
+#include "nullsh/command.h"
+#include "nullsh/executor.h"
+
+using namespace nullsh;
+
+namespace
+{
+    command::Command external(std::string name, std::vector<std::string> args)
+    {
+        command::Command cmd {};
+        cmd.name = std::move(name);
+        cmd.args = std::move(args);
+        cmd.type = command::CommandType::External;
+        return cmd;
+    }
+
+    // fork/exec/wait round trip of a command printing nothing
+    void bm_exec_external(benchmark::State& state)
+    {
+        auto cmd = external("true", {});
+        cmd.ops = {command::Op::None};
+
+        for (auto _ : state)
+        {
+            auto res = executor::exec_external(cmd);
+            benchmark::DoNotOptimize(res);
+        }
+    }
+
+    // everything the child writes goes through the capturer, spilling past the threshold
+    void bm_capture(benchmark::State& state)
+    {
+        const int64_t bytes = state.range(0);
+        auto cmd = external("head", {"-c", std::to_string(bytes), "/dev/zero"});
+
+        for (auto _ : state)
+        {
+            auto res = executor::exec_external(cmd);
+            if (res.return_code != 0)
+            {
+                state.SkipWithError("head failed");
+                break;
+            }
+            benchmark::DoNotOptimize(res);
+        }
+        state.SetBytesProcessed(state.iterations() * bytes);
+    }
+
+    // the same output discarded by the default operator, i.e. routed to /dev/null
+    void bm_discard(benchmark::State& state)
+    {
+        const int64_t bytes = state.range(0);
+        auto cmd = external("head", {"-c", std::to_string(bytes), "/dev/zero"});
+        cmd.ops = {command::Op::None};
+
+        for (auto _ : state)
+        {
+            auto res = executor::exec_external(cmd);
+            benchmark::DoNotOptimize(res);
+        }
+        state.SetBytesProcessed(state.iterations() * bytes);
+    }
+} // namespace
+
+BENCHMARK(bm_exec_external)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(bm_capture)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 30)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(bm_discard)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 30)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
\ No newline at end of file
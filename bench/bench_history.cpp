@@ -0,0 +1,104 @@
+/**
+ * @file bench_history.cpp
+ * @brief Persistent history: prefix search over large logs, and appending lines
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+
+#include "nullsh/history.h"
+
+using namespace nullsh::history;
+
+namespace
+{
+    constexpr std::array<const char*, 8> VERBS = {
+        "git commit -m", "make -C", "cd", "ls -la", "grep -rn", "vim", "cargo build -p", "ssh"};
+
+    // a log of generated commands, without an index yet
+    std::string make_log(const std::string& name, int64_t lines)
+    {
+        auto path = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove(path.string() + ".idx");
+        std::ofstream out(path);
+        for (int64_t i = 0; i < lines; ++i)
+        {
+            auto verb = VERBS[static_cast<std::size_t>(i) % VERBS.size()];
+            out << std::format("{} src/module{}/file{}.cpp\n", verb, i % 977, i);
+        }
+        return path.string();
+    }
+
+    // opening the first time sorts the whole log into the index
+    void bm_history_open(benchmark::State& state)
+    {
+        auto path = make_log("nullsh_bench_history_open", state.range(0));
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::filesystem::remove(path + ".idx");
+            state.ResumeTiming();
+            auto hist = History::open(path);
+            benchmark::DoNotOptimize(hist);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".idx");
+    }
+
+    void bm_history_search(benchmark::State& state, const char* prefix)
+    {
+        auto path = make_log("nullsh_bench_history_search", state.range(0));
+        auto hist = History::open(path);
+        if (!hist)
+        {
+            state.SkipWithError(hist.error().c_str());
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            auto found = hist->search(prefix, 20);
+            benchmark::DoNotOptimize(found);
+        }
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".idx");
+    }
+
+    // fdatasync every 32 lines, as the shell does
+    void bm_history_append(benchmark::State& state)
+    {
+        auto path = std::filesystem::temp_directory_path() / "nullsh_bench_history_append";
+        std::filesystem::remove(path);
+        auto hist = History::open(path.string());
+        if (!hist)
+        {
+            state.SkipWithError(hist.error().c_str());
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            hist->append("make -j8 -C build/release all");
+        }
+        state.SetItemsProcessed(state.iterations());
+        std::filesystem::remove(path);
+    }
+} // namespace
+
+BENCHMARK(bm_history_open)->Arg(1 << 20)->Unit(benchmark::kMillisecond)->Iterations(3);
+// a rare and a common prefix, and the latest lines
+BENCHMARK_CAPTURE(bm_history_search, narrow, "ssh src/module97/")
+    ->Arg(1 << 20)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(bm_history_search, wide, "git")->Arg(1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(bm_history_search, latest, "")->Arg(1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_history_append);
\ No newline at end of file
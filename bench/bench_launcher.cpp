@@ -0,0 +1,68 @@
+/**
+ * @file bench_launcher.cpp
+ * @brief Launch latency of fork() vs clone(CLONE_VM | CLONE_VFORK) by parent heap size
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "nullsh/launcher.h"
+
+using namespace nullsh::launcher;
+
+namespace
+{
+    // resident ballast standing in for large captured results
+    std::vector<char> heap_ballast;
+
+    void grow_heap(std::size_t mib)
+    {
+        heap_ballast.assign(mib * 1024 * 1024, 1); // touched, so every page is mapped
+    }
+
+    void bm_launch(benchmark::State& state, LaunchFn launch)
+    {
+        grow_heap(static_cast<std::size_t>(state.range(0)));
+
+        std::array<const char*, 2> args {"/bin/true", nullptr};
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        LaunchSpec spec {.file = args[0], .argv = const_cast<char* const*>(args.data()),
+                         .envp = environ};
+
+        for (auto _ : state)
+        {
+            auto child = launch(spec);
+            if (child.error != 0)
+            {
+                state.SkipWithError("launch failed");
+                break;
+            }
+            waitpid(child.pid, nullptr, 0);
+        }
+
+        state.counters["heap_mib"] = static_cast<double>(state.range(0));
+        heap_ballast = {};
+    }
+} // namespace
+
+BENCHMARK_CAPTURE(bm_launch, fork, &launch_fork)
+    ->Arg(0)
+    ->Arg(64)
+    ->Arg(512)
+    ->Arg(2048)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_launch, vfork, &launch_vfork)
+    ->Arg(0)
+    ->Arg(64)
+    ->Arg(512)
+    ->Arg(2048)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
@@ -0,0 +1,303 @@
+/**
+ * @file bench_parser.cpp
+ * @brief Tokenizer and parser throughput over realistic and adversarial command lines
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/parser.h"
+#include "nullsh/tokenizer.h"
+#include "nullsh/util.h"
+#include "nullsh/variables.h"
+
+namespace
+{
+    // typical interactive and CI lines
+    const char* const SIMPLE = "ls -la /tmp";
+    const char* const QUOTED = R"(git commit -m "fix: handle 'quoted' args" --author='A B <a@b>' !)";
+    const char* const PIPELINE = "cat build.log | grep -i error | sort | uniq -c | sort -rn $?";
+    const char* const EXPANDED = R"(cp -r $SRC/include ${DST}/include "$HOME/.config" !)";
+
+    // one very long argument-heavy line
+    std::string many_args(int64_t count)
+    {
+        std::string line = "echo";
+        for (int64_t i = 0; i < count; ++i)
+        {
+            line += " arg" + std::to_string(i);
+        }
+        return line;
+    }
+
+    // a generated file list, arguments too long for the small string buffer
+    std::string many_paths(int64_t count)
+    {
+        std::string line = "cc";
+        for (int64_t i = 0; i < count; ++i)
+        {
+            line += " src/generated/module_" + std::to_string(i % 17) + "/file_" +
+                    std::to_string(i) + ".cpp";
+        }
+        return line;
+    }
+
+    // a command followed by count operators, all stripped by the parser
+    std::string many_ops(int64_t count)
+    {
+        std::string line = "make -j8";
+        const char* const ops[] = {" !", " ?", " $?", " $$?", " $%"}; // NOLINT
+        for (int64_t i = 0; i < count; ++i)
+        {
+            line += ops[i % 5];
+        }
+        return line;
+    }
+
+    // deeply alternating quotes, the worst case for the quote state machine
+    std::string nested_quotes(int64_t count)
+    {
+        std::string line = "echo ";
+        for (int64_t i = 0; i < count; ++i)
+        {
+            line += i % 2 == 0 ? R"("a'b")" : R"('c"d')";
+        }
+        return line;
+    }
+
+    void bm_tokenize(benchmark::State& state, const std::string& line)
+    {
+        for (auto _ : state)
+        {
+            auto tokens = nullsh::util::tokenize(line);
+            benchmark::DoNotOptimize(tokens);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    }
+
+    // the character at a time, copy every token tokenizer that tokenize_views replaced
+    auto legacy_tokenize(std::string_view line)
+        -> std::expected<std::vector<std::string>, std::string>
+    {
+        std::vector<std::string> tokens;
+        std::string cur;
+        bool in_single = false;
+        bool in_double = false;
+        for (size_t i = 0; i < line.size(); ++i)
+        {
+            char chr = line[i];
+            if (chr == '\\')
+            {
+                cur.push_back(i + 1 < line.size() ? line[++i] : '\\');
+            }
+            else if (chr == '\'' && !in_double)
+            {
+                in_single = !in_single;
+            }
+            else if (chr == '"' && !in_single)
+            {
+                in_double = !in_double;
+            }
+            else if (!in_single && !in_double &&
+                     (std::isspace(static_cast<unsigned char>(chr)) != 0 || chr == '|' ||
+                      chr == '&'))
+            {
+                if (!cur.empty())
+                {
+                    tokens.emplace_back(std::move(cur));
+                    cur.clear();
+                }
+                if (chr == '|' || chr == '&')
+                {
+                    tokens.emplace_back(1, chr);
+                }
+            }
+            else
+            {
+                cur.push_back(chr);
+            }
+        }
+        if (in_single || in_double)
+        {
+            return std::unexpected("Mismatched quotes in command line");
+        }
+        if (!cur.empty())
+        {
+            tokens.emplace_back(std::move(cur));
+        }
+        return tokens;
+    }
+
+    void bm_tokenize_legacy(benchmark::State& state, std::string (*make)(int64_t))
+    {
+        const std::string line = make(state.range(0));
+        for (auto _ : state)
+        {
+            auto tokens = legacy_tokenize(line);
+            benchmark::DoNotOptimize(tokens);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    }
+
+    // in place tokenizer with a fixed block scanner, what the shell runs uses the best one
+    void bm_tokenize_views(benchmark::State& state,
+                           std::string (*make)(int64_t),
+                           nullsh::util::ScanLevel level)
+    {
+        const std::string line = make(state.range(0));
+        for (auto _ : state)
+        {
+            auto tokens = nullsh::util::tokenize_views(line, level);
+            benchmark::DoNotOptimize(tokens);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    }
+
+    // $NAME expansion against a table holding the shell's environment
+    void bm_tokenize_expand(benchmark::State& state, const std::string& line)
+    {
+        nullsh::vars::VarTable vars {environ};
+        vars.set("SRC", "/usr/src/project");
+        vars.set("DST", "/tmp/out");
+        for (auto _ : state)
+        {
+            auto tokens = nullsh::util::tokenize_views(line, vars);
+            benchmark::DoNotOptimize(tokens);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    }
+
+    // the if-chain parse_operator was before the compile-time table, as a baseline
+    auto legacy_parse_operator(std::string_view token) -> nullsh::command::Op
+    {
+        using nullsh::command::Op;
+        if (token == "!")
+        {
+            return Op::ForceOutput;
+        }
+        if (token == "?")
+        {
+            return Op::DiscardOutput;
+        }
+        if (token == "$?")
+        {
+            return Op::PrintRC;
+        }
+        if (token == "$$?")
+        {
+            return Op::PrintRCHuman;
+        }
+        if (token == "$%")
+        {
+            return Op::PrintUsage;
+        }
+        return Op::None;
+    }
+
+    void bm_parse_operator(benchmark::State& state, const std::string& token)
+    {
+        for (auto _ : state)
+        {
+            // opaque each round, or the inlined lookup is hoisted out of the loop
+            std::string_view view = token;
+            benchmark::DoNotOptimize(view);
+            benchmark::DoNotOptimize(nullsh::parser::parse_operator(view));
+        }
+    }
+
+    void bm_parse_operator_legacy(benchmark::State& state, const std::string& token)
+    {
+        for (auto _ : state)
+        {
+            // opaque each round, or the inlined lookup is hoisted out of the loop
+            std::string_view view = token;
+            benchmark::DoNotOptimize(view);
+            benchmark::DoNotOptimize(legacy_parse_operator(view));
+        }
+    }
+
+    void bm_make_command(benchmark::State& state, const std::string& line)
+    {
+        auto tokens = nullsh::util::tokenize(line);
+        if (!tokens)
+        {
+            state.SkipWithError(tokens.error().c_str());
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            auto cmd = nullsh::parser::make_command(*tokens);
+            benchmark::DoNotOptimize(cmd);
+        }
+    }
+
+    // everything between reading a line and execve: tokens, command and argv
+    void bm_line_to_argv(benchmark::State& state, std::string (*make)(int64_t))
+    {
+        const std::string line = make(state.range(0));
+        for (auto _ : state)
+        {
+            auto tokens = nullsh::util::tokenize_views(line);
+            auto cmd = nullsh::parser::make_command(*tokens);
+            char* const* argv = cmd->args.argv(cmd->name.c_str());
+            benchmark::DoNotOptimize(argv);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void bm_tokenize_generated(benchmark::State& state, std::string (*make)(int64_t))
+    {
+        bm_tokenize(state, make(state.range(0)));
+    }
+
+    void bm_make_command_generated(benchmark::State& state, std::string (*make)(int64_t))
+    {
+        bm_make_command(state, make(state.range(0)));
+    }
+} // namespace
+
+BENCHMARK_CAPTURE(bm_tokenize, simple, std::string(SIMPLE));
+BENCHMARK_CAPTURE(bm_tokenize, quoted, std::string(QUOTED));
+BENCHMARK_CAPTURE(bm_tokenize, pipeline, std::string(PIPELINE));
+BENCHMARK_CAPTURE(bm_tokenize, expanded_unset, std::string(EXPANDED));
+BENCHMARK_CAPTURE(bm_tokenize_expand, expanded, std::string(EXPANDED));
+BENCHMARK_CAPTURE(bm_tokenize_generated, many_args, &many_args)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_tokenize_generated, many_ops, &many_ops)->Range(8, 1024);
+BENCHMARK_CAPTURE(bm_tokenize_generated, nested_quotes, &nested_quotes)->Range(8, 4096);
+
+// legacy against in place on long argument lists, with each block scanner
+using nullsh::util::ScanLevel;
+BENCHMARK_CAPTURE(bm_tokenize_legacy, many_args, &many_args)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_tokenize_views, many_args/scalar, &many_args, ScanLevel::Scalar)
+    ->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_tokenize_views, many_args/sse2, &many_args, ScanLevel::SSE2)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_tokenize_views, many_args/avx2, &many_args, ScanLevel::AVX2)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_tokenize_legacy, nested_quotes, &nested_quotes)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_tokenize_views, nested_quotes/avx2, &nested_quotes, ScanLevel::AVX2)
+    ->Range(8, 4096);
+
+BENCHMARK_CAPTURE(bm_make_command, simple, std::string(SIMPLE));
+BENCHMARK_CAPTURE(bm_make_command, quoted, std::string(QUOTED));
+BENCHMARK_CAPTURE(bm_make_command, pipeline, std::string(PIPELINE));
+BENCHMARK_CAPTURE(bm_make_command_generated, many_args, &many_args)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_make_command_generated, many_ops, &many_ops)->Range(8, 1024);
+BENCHMARK_CAPTURE(bm_make_command_generated, many_paths, &many_paths)->Range(8, 4096);
+
+BENCHMARK_CAPTURE(bm_line_to_argv, many_args, &many_args)->Range(8, 4096);
+BENCHMARK_CAPTURE(bm_line_to_argv, many_paths, &many_paths)->Range(8, 4096);
+
+// every argument is checked for being an operator, most are not
+BENCHMARK_CAPTURE(bm_parse_operator, hit, std::string("$%"));
+BENCHMARK_CAPTURE(bm_parse_operator, miss, std::string("-la"));
+BENCHMARK_CAPTURE(bm_parse_operator_legacy, hit, std::string("$%"));
+BENCHMARK_CAPTURE(bm_parse_operator_legacy, miss, std::string("-la"));
\ No newline at end of file
@@ -0,0 +1,84 @@
+/**
+ * @file bench_script.cpp
+ * @brief Script throughput in lines per second, for builtin-only and external-heavy scripts
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "nullsh/shell.h"
+
+using namespace nullsh::shell;
+
+namespace
+{
+    // writes a script repeating line, once per generated file
+    std::string make_script(const std::string& name, const std::string& line, int64_t lines)
+    {
+        auto path = std::filesystem::temp_directory_path() / name;
+        std::ofstream out(path);
+        out << "# generated by nullsh-bench\n";
+        for (int64_t i = 0; i < lines; ++i)
+        {
+            out << line << '\n';
+        }
+        return path.string();
+    }
+
+    void bm_script(benchmark::State& state, const char* line)
+    {
+        const int64_t lines = state.range(0);
+        auto path = make_script("nullsh_bench_script.nsh", line, lines);
+
+        NullShell shell {};
+        for (auto _ : state)
+        {
+            auto rc = shell.source(path);
+            if (!rc)
+            {
+                state.SkipWithError(rc.error().c_str());
+                break;
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * lines);
+        state.SetLabel("items = lines");
+        std::filesystem::remove(path);
+    }
+} // namespace
+
+BENCHMARK_CAPTURE(bm_script, builtin, "cd .")
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_script, builtin_ops, "echo hello void ?")
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_script, builtin_true, "true")
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_script, builtin_test, "[ -f /etc/passwd ]")
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_script, builtin_printf, "printf hello ?")
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+// the same commands as programs, with their fork and exec
+BENCHMARK_CAPTURE(bm_script, external, "/usr/bin/true")
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_script, external_captured, "/usr/bin/printf hello ?")
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
\ No newline at end of file
@@ -0,0 +1,97 @@
+/**
+ * @file bench_startup.cpp
+ * @brief Startup latency of `nullsh -c true` (and nullsh-static) against `dash -c true`
+ *
+ * Every repetition is one spawn-to-exit run, so the aggregates are the latency distribution:
+ * compare the p50/p99 rows of nullsh with dash to catch startup regressions.
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <benchmark/benchmark.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace
+{
+    constexpr int RUNS = 300;
+
+    double percentile(const std::vector<double>& samples, double pct)
+    {
+        if (samples.empty())
+        {
+            return 0.0;
+        }
+        std::vector<double> sorted = samples;
+        std::ranges::sort(sorted);
+        auto rank = static_cast<std::size_t>(pct / 100.0 * static_cast<double>(sorted.size() - 1));
+        return sorted[rank];
+    }
+
+    double p50(const std::vector<double>& samples)
+    {
+        return percentile(samples, 50.0);
+    }
+
+    double p99(const std::vector<double>& samples)
+    {
+        return percentile(samples, 99.0);
+    }
+
+    void bm_startup(benchmark::State& state, const char* shell)
+    {
+        std::array<const char*, 4> args {shell, "-c", "true", nullptr};
+
+        for (auto _ : state)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            pid_t pid = -1;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            auto* argv = const_cast<char* const*>(args.data());
+            if (posix_spawn(&pid, shell, nullptr, nullptr, argv, environ) != 0)
+            {
+                state.SkipWithError("posix_spawn failed");
+                break;
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            state.SetIterationTime(elapsed.count());
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                state.SkipWithError("shell did not exit with 0");
+                break;
+            }
+        }
+    }
+
+    // one run per repetition, only the distribution is reported
+    void startup_args(benchmark::internal::Benchmark* bench)
+    {
+        bench->Iterations(1)
+            ->Repetitions(RUNS)
+            ->ReportAggregatesOnly(true)
+            ->ComputeStatistics("p50", p50)
+            ->ComputeStatistics("p99", p99)
+            ->UseManualTime()
+            ->Unit(benchmark::kMicrosecond);
+    }
+} // namespace
+
+BENCHMARK_CAPTURE(bm_startup, nullsh, NULLSH_BINARY)->Apply(startup_args);
+#ifdef NULLSH_STATIC_BINARY
+BENCHMARK_CAPTURE(bm_startup, nullsh_static, NULLSH_STATIC_BINARY)->Apply(startup_args);
+#endif
+#ifdef NULLSH_DASH_BINARY
+BENCHMARK_CAPTURE(bm_startup, dash, NULLSH_DASH_BINARY)->Apply(startup_args);
+#endif
\ No newline at end of file
@@ -0,0 +1,225 @@
+/**
+ * @file arg_block.h
+ * @brief Command arguments stored as one block of NUL-terminated strings
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nullsh::command
+{
+    /**
+     * Arguments of a command, packed back to back with their NUL terminators in one byte
+     * block and located through an offset array. argv() hands the block to execve as it is,
+     * only the pointer array is filled in. Blocks made by the parser allocate from an arena
+     * shared by every stage of the line, so a line costs a few arena allocations whatever its
+     * number of arguments. Copies are standalone and use the default resource. A moved-from
+     * block may only be assigned to or destroyed.
+     */
+    class ArgBlock
+    {
+      public:
+        using Arena = std::shared_ptr<std::pmr::memory_resource>;
+
+        class const_iterator
+        {
+          public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using reference = std::string_view;
+            using pointer = void;
+
+            const_iterator() = default;
+            const_iterator(const ArgBlock* block, std::size_t idx) : block_(block), idx_(idx) {}
+
+            std::string_view operator*() const
+            {
+                return (*block_)[idx_];
+            }
+            std::string_view operator[](difference_type off) const
+            {
+                return (*block_)[idx_ + static_cast<std::size_t>(off)];
+            }
+
+            const_iterator& operator++()
+            {
+                ++idx_;
+                return *this;
+            }
+            const_iterator operator++(int)
+            {
+                auto old = *this;
+                ++idx_;
+                return old;
+            }
+            const_iterator& operator--()
+            {
+                --idx_;
+                return *this;
+            }
+            const_iterator operator--(int)
+            {
+                auto old = *this;
+                --idx_;
+                return old;
+            }
+            const_iterator& operator+=(difference_type off)
+            {
+                idx_ += static_cast<std::size_t>(off);
+                return *this;
+            }
+            const_iterator& operator-=(difference_type off)
+            {
+                idx_ -= static_cast<std::size_t>(off);
+                return *this;
+            }
+
+            friend const_iterator operator+(const_iterator it, difference_type off)
+            {
+                return it += off;
+            }
+            friend const_iterator operator+(difference_type off, const_iterator it)
+            {
+                return it += off;
+            }
+            friend const_iterator operator-(const_iterator it, difference_type off)
+            {
+                return it -= off;
+            }
+            friend difference_type operator-(const const_iterator& lhs, const const_iterator& rhs)
+            {
+                return static_cast<difference_type>(lhs.idx_) -
+                       static_cast<difference_type>(rhs.idx_);
+            }
+            friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
+            {
+                return lhs.idx_ == rhs.idx_;
+            }
+            friend auto operator<=>(const const_iterator& lhs, const const_iterator& rhs)
+            {
+                return lhs.idx_ <=> rhs.idx_;
+            }
+
+          private:
+            const ArgBlock* block_ {nullptr};
+            std::size_t idx_ {0};
+        };
+
+        using iterator = const_iterator;
+        using value_type = std::string_view;
+
+        ArgBlock() : ArgBlock(Arena {}) {}
+        explicit ArgBlock(Arena arena);
+        ArgBlock(std::initializer_list<std::string_view> args);
+        ArgBlock(const std::vector<std::string>& args); // NOLINT(google-explicit-constructor)
+        template <std::input_iterator Iter> ArgBlock(Iter first, Iter last) : ArgBlock()
+        {
+            assign(first, last);
+        }
+        ~ArgBlock() = default;
+        ArgBlock(const ArgBlock& other);
+        ArgBlock(ArgBlock&& other) noexcept = default;
+        ArgBlock& operator=(const ArgBlock& other);
+        ArgBlock& operator=(ArgBlock&& other) noexcept;
+        ArgBlock& operator=(std::initializer_list<std::string_view> args);
+
+        void reserve(std::size_t count, std::size_t bytes);
+        void push_back(std::string_view arg);
+        void pop_back();
+        void clear();
+
+        template <std::input_iterator Iter> void assign(Iter first, Iter last)
+        {
+            clear();
+            if constexpr (std::forward_iterator<Iter>)
+            {
+                // size the block once, then copy each argument straight into place
+                std::size_t count = 0;
+                std::size_t bytes = 0;
+                for (auto it = first; it != last; ++it, ++count)
+                {
+                    bytes += std::string_view(*it).size() + 1;
+                }
+                reserve(count, bytes);
+                char* out = grow(bytes);
+                for (; first != last; ++first)
+                {
+                    out = place(out, std::string_view(*first));
+                }
+            }
+            else
+            {
+                for (; first != last; ++first)
+                {
+                    push_back(std::string_view(*first));
+                }
+            }
+        }
+
+        std::size_t size() const
+        {
+            return offsets_.size();
+        }
+        bool empty() const
+        {
+            return offsets_.empty();
+        }
+        std::string_view operator[](std::size_t idx) const
+        {
+            const std::size_t end = idx + 1 < offsets_.size() ? offsets_[idx + 1] : bytes_.size();
+            return {bytes_.data() + offsets_[idx], end - offsets_[idx] - 1};
+        }
+        std::string_view front() const
+        {
+            return (*this)[0];
+        }
+        std::string_view back() const
+        {
+            return (*this)[size() - 1];
+        }
+        const_iterator begin() const
+        {
+            return {this, 0};
+        }
+        const_iterator end() const
+        {
+            return {this, size()};
+        }
+
+        // NULL-terminated argv with arg0 in front of the arguments, valid until the next change
+        auto argv(const char* arg0) const -> char* const*;
+
+        // every argument and its terminator, back to back
+        std::string_view bytes() const
+        {
+            return {bytes_.data(), bytes_.size()};
+        }
+
+        friend bool operator==(const ArgBlock& lhs, const ArgBlock& rhs);
+        friend bool operator==(const ArgBlock& lhs, const std::vector<std::string>& rhs);
+
+      private:
+        char* grow(std::size_t bytes);
+        char* place(char* out, std::string_view arg);
+
+        Arena arena_; // declared first, so it outlives the containers allocating from it
+        std::pmr::vector<char> bytes_;
+        std::pmr::vector<std::uint32_t> offsets_;
+        mutable std::pmr::vector<char*> argv_;
+    };
+
+    auto make_arena(std::size_t bytes) -> ArgBlock::Arena;
+} // namespace nullsh::command
\ No newline at end of file
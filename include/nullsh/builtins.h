@@ -7,14 +7,22 @@
 
 #pragma once
 
-#include <string>
+#include <string_view>
+#include <vector>
 
 #include "nullsh/command.h"
+#include "nullsh/output_sink.h"
 #include "nullsh/shell.h"
 
 namespace nullsh::builtins
 {
-    bool is_builtin(const std::string& name);
+    bool is_builtin(std::string_view name);
+    bool is_utility(std::string_view name);
+    auto names() -> std::vector<std::string_view>;
 
+    command::CommandResult run(command::Command& cmd,
+                               shell::NullShell& sh,
+                               io::OutputSink& out,
+                               io::OutputSink& err);
     command::CommandResult execute(command::Command& cmd, shell::NullShell& sh);
 } // namespace nullsh::builtins
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <expected>
 #include <optional>
 #include <span>
@@ -18,6 +19,13 @@ namespace nullsh::cli
     {
         std::optional<std::string> one_shot;
         std::optional<std::string> spawn_term;
+        std::optional<std::size_t> spill_threshold;
+        std::optional<std::string> script;
+        std::optional<std::string> server;  // socket to serve sessions on
+        std::optional<std::string> client;  // socket of the server running -c
+        std::optional<std::string> history; // log of the interactive lines
+        std::optional<std::size_t> memo_size;
+        std::optional<std::string> memo_dir; // store of the memo results kept across sessions
     };
 
     auto parse_cli(std::span<const char*> args) -> std::expected<CLI, std::string>;
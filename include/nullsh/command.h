@@ -7,9 +7,17 @@
 
 #pragma once
 
+#include <sys/resource.h>
+
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "nullsh/arg_block.h"
+#include "nullsh/spill_file.h"
+
 namespace nullsh::command
 {
     enum class Op
@@ -19,27 +27,60 @@ namespace nullsh::command
         DiscardOutput, // ? -> discard stdout + stderr
         PrintRC,       // $? -> print return code
         PrintRCHuman,  // $$? -> human-readable RC
+        PrintUsage,    // $% -> RC with wall time and resource usage
     };
 
     enum class CommandType
     {
         Builtin,
-        External
+        External,
+        Pipeline
     };
 
     struct Command
     {
         CommandType type;
         std::string name;
-        std::vector<std::string> args;
+        ArgBlock args;
         std::vector<Op> ops;
+        // Pipeline only: the commands connected by |, operators stay on the pipeline itself
+        std::vector<Command> stages {};
+        // started as a background job, with a trailing &
+        bool background {false};
+        // leading NAME=VALUE words, exported to this command only; alone they set variables
+        ArgBlock assignments {};
     };
 
+    // Resources used by a command; counters of every process it ran are summed
+    struct Usage
+    {
+        std::chrono::nanoseconds wall {0};
+        std::chrono::microseconds user {0};
+        std::chrono::microseconds system {0};
+        long max_rss_kib {0}; // largest of the processes
+        long minor_faults {0};
+        long major_faults {0};
+        long voluntary_switches {0};
+        long involuntary_switches {0};
+
+        Usage& operator+=(const Usage& other);
+    };
+
+    auto to_usage(const rusage& ru) -> Usage;
+
     struct CommandResult
     {
         int return_code;
-        std::string stdout_data;
-        std::string stderr_data;
+        std::string stdout_data {};
+        std::string stderr_data {};
+        // already shown live while being captured, operators must not print them again
+        bool stdout_relayed {false};
+        bool stderr_relayed {false};
+        // output past the capture threshold; the matching *_data is empty then
+        std::shared_ptr<io::SpillFile> stdout_spill {};
+        std::shared_ptr<io::SpillFile> stderr_spill {};
+        // set by whoever reaped the command's processes, wall time is added by the shell
+        std::optional<Usage> usage {};
     };
 
     void sanitize_result(CommandResult& res);
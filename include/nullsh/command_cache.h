@@ -0,0 +1,76 @@
+/**
+ * @file command_cache.h
+ * @brief Cache of command names resolved through PATH
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace nullsh::cache
+{
+    class CommandCache
+    {
+      public:
+        struct Entry
+        {
+            std::string path; // empty if the name is not in PATH
+            std::size_t hits {0};
+        };
+
+        auto lookup(std::string_view name) -> std::optional<std::string_view>;
+        void forget(std::string_view name);
+        void clear();
+        auto warm() -> std::size_t;
+
+        template <typename Fn>
+        void for_each(Fn&& visit) const
+        {
+            for (const auto& [name, entry] : entries)
+            {
+                if (!entry.path.empty())
+                {
+                    std::invoke(visit, name, entry);
+                }
+            }
+        }
+
+      private:
+        struct StringHash
+        {
+            using is_transparent = void;
+            std::size_t operator()(std::string_view str) const
+            {
+                return std::hash<std::string_view> {}(str);
+            }
+        };
+
+        struct Dir
+        {
+            std::string path;
+            timespec mtime {};
+        };
+
+        std::string path_env;
+        bool loaded {false}; // path_env and dirs hold a PATH
+        std::vector<Dir> dirs;
+        bool cacheable {true}; // false if PATH has relative entries
+        std::string scratch;   // reused to build candidate paths
+        std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> entries;
+
+        void validate();
+        void load_path(const char* path);
+        auto resolve(std::string_view name) -> std::string;
+    };
+
+    CommandCache& command_cache();
+} // namespace nullsh::cache
\ No newline at end of file
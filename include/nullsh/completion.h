@@ -0,0 +1,152 @@
+/**
+ * @file completion.h
+ * @brief Tab completion: a trie of command names built off the prompt's thread, and cached
+ * directory listings
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace nullsh::complete
+{
+    // Sorted set of words. Nodes are first-child/next-sibling links in one vector, siblings in
+    // byte order, and each node counts the words below it, so the longest common extension of
+    // a prefix and its first n words cost the length of the prefix plus what is returned.
+    class Trie
+    {
+      public:
+        Trie();
+
+        void insert(std::string_view word);
+        std::size_t count(std::string_view prefix) const;
+        auto extension(std::string_view prefix) const -> std::string;
+        void collect(std::string_view prefix,
+                     std::size_t limit,
+                     std::vector<std::string>& out) const;
+
+        std::size_t size() const
+        {
+            return nodes_.front().count;
+        }
+
+      private:
+        static constexpr std::uint32_t NONE = UINT32_MAX;
+
+        struct Node
+        {
+            std::uint32_t child {NONE};
+            std::uint32_t sibling {NONE};
+            std::uint32_t count {0}; // words ending here or below
+            char chr {0};
+            bool terminal {false};
+        };
+
+        std::vector<Node> nodes_;
+
+        auto find(std::string_view prefix) const -> std::uint32_t;
+        void walk(std::uint32_t node,
+                  std::string& word,
+                  std::size_t limit,
+                  std::vector<std::string>& out) const;
+    };
+
+    // Directory listings, reused until the directory's mtime (or the directory) changes
+    class DirCache
+    {
+      public:
+        struct Entry
+        {
+            std::string name;
+            bool is_dir {false};
+        };
+
+        static constexpr std::size_t MAX_DIRS = 64;
+
+        auto list(const std::string& dir) -> const std::vector<Entry>&;
+
+      private:
+        struct Listing
+        {
+            dev_t dev {0};
+            ino_t ino {0};
+            timespec mtime {};
+            std::vector<Entry> entries; // sorted by name
+        };
+
+        std::unordered_map<std::string, Listing> listings_;
+        std::vector<Entry> none_;
+    };
+
+    struct Completion
+    {
+        std::size_t start {0};               // the word being completed begins here
+        std::string insert;                  // text to add at the cursor, escaped
+        std::vector<std::string> candidates; // shown when the word stays ambiguous
+        std::size_t total {0};               // candidates there are, listed or not
+    };
+
+    /**
+     * Completes the word before the cursor: the first word of a line from the builtins and the
+     * executables in PATH, anything else (or a word with a '/') from the filesystem. The PATH
+     * trie is built on a helper thread, and until it is ready only the builtins complete; a
+     * keystroke never waits for it.
+     */
+    class Completer
+    {
+      public:
+        static constexpr std::size_t MAX_CANDIDATES = 100;
+
+        Completer();
+        ~Completer();
+        Completer(const Completer&) = delete;
+        Completer& operator=(const Completer&) = delete;
+        Completer(Completer&&) = delete;
+        Completer& operator=(Completer&&) = delete;
+
+        void refresh();
+        auto complete(std::string_view line, std::size_t cursor) -> Completion;
+        auto commands() const -> std::shared_ptr<const Trie>;
+        bool ready() const;
+
+        void set_home(std::optional<std::string_view> home)
+        {
+            home_ = home ? std::string(*home) : std::string {};
+        }
+
+      private:
+        struct Dir
+        {
+            std::string path;
+            timespec mtime {};
+        };
+
+        mutable std::mutex mutex_;
+        std::shared_ptr<const Trie> commands_; // builtins, then builtins and PATH
+        bool ready_ {false};
+        std::thread builder_;
+
+        std::string path_env_;
+        std::vector<Dir> dirs_;
+        DirCache dir_cache_;
+        std::string home_;
+
+        void rebuild();
+        void build(std::vector<std::string> dirs);
+        auto complete_command(std::string_view word) -> Completion;
+        auto complete_path(std::string_view word) -> Completion;
+    };
+} // namespace nullsh::complete
\ No newline at end of file
@@ -0,0 +1,79 @@
+/**
+ * @file event_loop.h
+ * @brief epoll loop the interactive shell waits on, with signals read from a signalfd
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <array>
+#include <csignal>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace nullsh::io
+{
+    // Where the last SIGINT came from
+    enum class Interrupt
+    {
+        None,
+        Terminal, // ^C: the terminal sent it to the shell's process group, children included
+        Other,    // kill(2) and the like: only the shell got it
+    };
+
+    /**
+     * One epoll set for everything a shell waits on: the terminal, child pidfds and capture
+     * pipes. A loop made with signals also blocks SIGINT, SIGCHLD and SIGWINCH in the calling
+     * thread (and in the threads it starts later) and reads them from a signalfd, so a ^C
+     * wakes the loop instead of killing the shell. Children are launched with child_mask(),
+     * the mask the shell had before. Signals only set flags, taken by whoever handles them.
+     */
+    class EventLoop
+    {
+      public:
+        static constexpr int MAX_EVENTS = 16;
+
+        explicit EventLoop(bool signals = false);
+        ~EventLoop();
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+        EventLoop(EventLoop&&) = delete;
+        EventLoop& operator=(EventLoop&&) = delete;
+
+        bool add(int fd, std::uint32_t events = EPOLLIN);
+        void remove(int fd);
+        auto wait(int timeout_ms) -> std::optional<std::span<const epoll_event>>;
+        void wait_exit(int pidfd, bool own_group);
+
+        auto take_interrupt() -> Interrupt;
+        bool take_child();
+        bool take_resize();
+
+        bool valid() const
+        {
+            return epoll_fd_ >= 0;
+        }
+
+        // mask children exec with, nullptr when the loop changed nothing
+        const sigset_t* child_mask() const
+        {
+            return signal_fd_ >= 0 ? &saved_mask_ : nullptr;
+        }
+
+      private:
+        int epoll_fd_ {-1};
+        int signal_fd_ {-1};
+        sigset_t saved_mask_ {};
+        std::array<epoll_event, MAX_EVENTS> events_ {};
+
+        Interrupt interrupt_ {Interrupt::None};
+        bool child_ {false};
+        bool resize_ {false};
+
+        void read_signals();
+    };
+} // namespace nullsh::io
\ No newline at end of file
@@ -7,11 +7,57 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <vector>
+
 #include "nullsh/command.h"
+#include "nullsh/event_loop.h"
+#include "nullsh/jobs.h"
+#include "nullsh/launcher.h"
+#include "nullsh/output_sink.h"
+#include "nullsh/result_capturer.h"
+#include "nullsh/variables.h"
 
 namespace nullsh::executor
 {
-    command::CommandResult exec_external(const command::Command& cmd);
+    struct ExecOptions
+    {
+        // keep output in the result even when operators would only print or drop it
+        bool retain_output {false};
+        // captured bytes per stream kept on the heap, the rest goes to a memfd
+        std::size_t spill_threshold {io::CommandResultCapturer::DEFAULT_SPILL_THRESHOLD};
+        // how the child process is started
+        launcher::LaunchFn launch {&launcher::launch_vfork};
+        // timeout and resource caps, set per command by the limit builtin
+        io::Limits limits {};
+        // stdin of foreground commands, -1 inherits the shell's
+        int stdin_fd {-1};
+        // variables whose exported ones make up the environment, nullptr passes on environ
+        const vars::VarTable* vars {nullptr};
+        // environment of the command, overrides vars
+        char* const* envp {nullptr};
+        // the interactive shell's loop, waits go through it so a ^C stops them; nullptr blocks
+        io::EventLoop* loop {nullptr};
+    };
+
+    // runs a builtin pipeline stage in the shell, printing through the given sinks
+    using StageFn =
+        std::function<command::CommandResult(command::Command&, io::OutputSink&, io::OutputSink&)>;
+
+    auto route_streams(const std::vector<command::Op>& ops, bool retain = false)
+        -> io::StreamRoute;
+    command::CommandResult exec_external(const command::Command& cmd, const ExecOptions& opts = {});
+    bool exec_in_place(const command::Command& cmd, const ExecOptions& opts = {});
+    auto exec_background(const command::Command& cmd, const ExecOptions& opts = {}) -> jobs::Job;
+    command::CommandResult exec_pipeline(command::Command& cmd,
+                                         const ExecOptions& opts,
+                                         const StageFn& run_builtin);
+    void apply_operator(command::Op op,
+                        command::CommandResult& res,
+                        io::OutputSink& out,
+                        io::OutputSink& err);
     void apply_operator(command::Op op, command::CommandResult& res);
+    void apply_operators(const std::vector<command::Op>& ops, command::CommandResult& res);
 
 } // namespace nullsh::executor
\ No newline at end of file
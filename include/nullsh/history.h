@@ -0,0 +1,85 @@
+/**
+ * @file history.h
+ * @brief Opt-in persistent history: an append-only log with a memory mapped prefix index
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/mapped_file.h"
+
+namespace nullsh::history
+{
+    struct Options
+    {
+        std::size_t sync_every {32};                    // lines written between two fdatasync
+        std::chrono::milliseconds sync_interval {1000}; // or time since the last one
+        std::size_t merge_after {4096};                 // unindexed lines that rewrite the index
+    };
+
+    // One line per entry in `path`, plus `path.idx`: the distinct lines sorted bytewise, each
+    // with the offset of its latest occurrence. Lines the index does not cover yet are searched
+    // linearly and folded into it the next time a session opens the log with enough of them.
+    class History
+    {
+      public:
+        ~History();
+        History(const History&) = delete;
+        History& operator=(const History&) = delete;
+        History(History&& other) noexcept;
+        History& operator=(History&& other) noexcept;
+
+        static auto open(const std::string& path, Options opts = {})
+            -> std::expected<History, std::string>;
+
+        bool append(std::string_view line);
+        bool sync();
+        auto search(std::string_view prefix, std::size_t limit) const
+            -> std::vector<std::string_view>;
+
+        // distinct lines in the index, and lines after it
+        std::size_t indexed() const
+        {
+            return count_;
+        }
+        std::size_t pending() const
+        {
+            return tail_.size();
+        }
+
+      private:
+        struct Entry
+        {
+            std::uint64_t offset;
+            std::uint64_t length;
+        };
+
+        History(int fd, Options opts) : fd_(fd), opts_(opts) {}
+
+        auto load_index(const std::string& path, std::uint64_t log_ino) -> io::MappedFile;
+        bool write_index(const std::string& path, std::uint64_t log_ino, std::uint64_t log_size);
+        Entry entry(std::size_t idx) const;
+        std::string_view text(const Entry& ent) const;
+
+        int fd_ {-1};
+        Options opts_;
+        io::MappedFile log_;
+        io::MappedFile index_;
+        std::uint64_t indexed_size_ {0}; // bytes of the log the index covers
+        std::size_t count_ {0};
+        std::vector<std::string_view> tail_; // oldest first, into log_ or appended_
+        std::deque<std::string> appended_;   // lines of this session, stable addresses
+        std::size_t unsynced_ {0};
+        std::chrono::steady_clock::time_point last_sync_ {};
+    };
+} // namespace nullsh::history
\ No newline at end of file
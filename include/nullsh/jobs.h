@@ -0,0 +1,83 @@
+/**
+ * @file jobs.h
+ * @brief Background jobs started with '&'
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "nullsh/command.h"
+#include "nullsh/event_loop.h"
+#include "nullsh/spill_file.h"
+
+namespace nullsh::jobs
+{
+    struct Job
+    {
+        int id {0};
+        pid_t pid {-1};
+        int pidfd {-1};   // readable once the child has exited
+        std::string text; // command line, as listed by `jobs`
+        std::vector<command::Op> ops;
+        std::chrono::steady_clock::time_point started {};
+        // outputs the child writes to, null for a stream going to /dev/null
+        std::shared_ptr<io::SpillFile> out {};
+        std::shared_ptr<io::SpillFile> err {};
+        // output up to this size is moved to the result's strings when the job finishes
+        std::size_t spill_threshold {0};
+        command::CommandResult result {}; // final once done
+        bool done {false};
+        bool notified {false}; // completion already reported at the prompt
+    };
+
+    auto state(const Job& job) -> std::string;
+
+    class JobTable
+    {
+      public:
+        JobTable() = default;
+        ~JobTable();
+        JobTable(const JobTable&) = delete;
+        JobTable& operator=(const JobTable&) = delete;
+        JobTable(JobTable&&) = delete;
+        JobTable& operator=(JobTable&&) = delete;
+
+        int add(Job job);
+        void refresh();
+        bool wait(int id, io::EventLoop* loop = nullptr);
+        auto collect(int id) -> std::optional<Job>;
+        auto find(int id) -> Job*;
+        int current() const;
+
+        bool empty() const
+        {
+            return jobs.empty();
+        }
+
+        template <typename Fn>
+        void for_each(Fn&& visit)
+        {
+            for (auto& [id, job] : jobs)
+            {
+                std::invoke(visit, job);
+            }
+        }
+
+      private:
+        std::map<int, Job> jobs; // by id, so listing follows start order
+
+        static void finish(Job& job);
+    };
+} // namespace nullsh::jobs
\ No newline at end of file
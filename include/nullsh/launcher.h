@@ -0,0 +1,49 @@
+/**
+ * @file launcher.h
+ * @brief Process launchers for external commands
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <array>
+#include <csignal>
+
+#include "nullsh/capturer.h"
+
+namespace nullsh::launcher
+{
+    // Everything the child needs, prepared by the parent before launching
+    struct LaunchSpec
+    {
+        const char* file {nullptr}; // looked up in PATH unless it contains a '/'
+        char* const* argv {nullptr};
+        char* const* envp {nullptr};
+        // fds installed as 0/1/2 in the child, -1 keeps the inherited one
+        std::array<int, 3> stdio {-1, -1, -1};
+        // prepare_child() runs in the child after stdio is installed, right before exec
+        io::IOCapturer* io {nullptr};
+        // signal mask the child execs with, nullptr keeps the shell's
+        const sigset_t* sigmask {nullptr};
+        // whether the child leads a process group of its own, out of reach of the terminal's ^C
+        bool new_group {false};
+    };
+
+    struct Launch
+    {
+        pid_t pid {-1};
+        int error {0}; // errno of fork/exec, 0 if the program is running
+    };
+
+    using LaunchFn = Launch (*)(const LaunchSpec&);
+
+    Launch launch_fork(const LaunchSpec& spec);
+    Launch launch_vfork(const LaunchSpec& spec);
+
+    int open_pidfd(pid_t pid);
+    bool signal_pidfd(int pidfd, int sig);
+    bool pidfd_exited(int pidfd);
+} // namespace nullsh::launcher
\ No newline at end of file
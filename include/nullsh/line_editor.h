@@ -0,0 +1,151 @@
+/**
+ * @file line_editor.h
+ * @brief Raw-mode line editor for the interactive prompt, with incremental redraws
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "nullsh/completion.h"
+#include "nullsh/event_loop.h"
+#include "nullsh/history.h"
+
+namespace nullsh::edit
+{
+    // keys past the byte range, decoded from escape sequences
+    enum Key : int
+    {
+        KEY_NONE = 0x100,
+        KEY_LEFT,
+        KEY_RIGHT,
+        KEY_UP,
+        KEY_DOWN,
+        KEY_HOME,
+        KEY_END,
+        KEY_DELETE,
+        // signals the loop caught while the line was edited
+        KEY_INTERRUPT,
+        KEY_RESIZE,
+        KEY_CHILD
+    };
+
+    // columns text takes on screen, a UTF-8 sequence counting as one
+    std::size_t columns(std::string_view text);
+
+    // The line being edited and its cursor (a byte offset, kept on UTF-8 boundaries)
+    class LineBuffer
+    {
+      public:
+        const std::string& text() const
+        {
+            return text_;
+        }
+        std::size_t cursor() const
+        {
+            return cursor_;
+        }
+
+        void insert(std::string_view text);
+        void assign(std::string_view text);
+        bool erase_before();
+        bool erase_at();
+        bool move_left();
+        bool move_right();
+        void home();
+        void end();
+        void kill_to_end();
+        void kill_to_start();
+        void erase_word();
+
+      private:
+        std::string text_;
+        std::size_t cursor_ {0};
+    };
+
+    /**
+     * Keeps track of what the terminal shows after the prompt and brings it to the state of a
+     * buffer: the cursor goes to the first byte that changed and only the rest of the line is
+     * written, so typing at the end of a line writes that one character. Lines longer than the
+     * terminal wrap; a width of 0 means they never do.
+     */
+    class Renderer
+    {
+      public:
+        void reset(std::string_view prompt, std::size_t width);
+        void render(const LineBuffer& buf, std::string& out);
+        void clear(std::string& out);
+
+      private:
+        std::size_t width_ {0};
+        std::size_t prompt_cols_ {0};
+        std::string shown_;
+        std::size_t cursor_col_ {0}; // counted from the start of the prompt
+
+        void move(std::size_t from, std::size_t to, std::string& out) const;
+    };
+
+    class LineEditor
+    {
+      public:
+        static constexpr std::size_t HISTORY_STEPS = 256; // lines Up walks back through
+        static constexpr int ESC_TIMEOUT_MS = 50;         // a lone ESC is not a sequence
+
+        LineEditor(int in_fd, int out_fd, complete::Completer* completer = nullptr)
+            : in_fd_(in_fd), out_fd_(out_fd), completer_(completer)
+        {
+        }
+
+        void set_history(history::History* hist)
+        {
+            history_ = hist;
+        }
+
+        // waits for keys on the shell's loop, which also reports ^C, resizes and child exits
+        void set_loop(io::EventLoop* loop)
+        {
+            loop_ = loop;
+        }
+
+        // text shown above the line when a child exits, e.g. finished background jobs
+        void set_notices(std::function<std::string()> notices)
+        {
+            notices_ = std::move(notices);
+        }
+
+        auto read_line(std::string_view prompt) -> std::optional<std::string>;
+
+      private:
+        int in_fd_;
+        int out_fd_;
+        complete::Completer* completer_;
+        history::History* history_ {nullptr};
+        io::EventLoop* loop_ {nullptr};
+        bool watched_ {false}; // the input is in loop_'s set
+        std::function<std::string()> notices_;
+
+        std::string pending_; // read but not decoded yet, e.g. the rest of a paste
+        Renderer renderer_;
+        std::string out_;
+
+        std::vector<std::string_view> matches_; // history lines starting with saved_
+        std::size_t step_ {0};                  // 0 while editing, else index into matches_ + 1
+        std::string saved_;
+
+        auto edit(std::string_view prompt) -> std::optional<std::string>;
+        auto next_key() -> std::optional<int>;
+        auto signal_key() -> std::optional<int>;
+        bool fill(int timeout_ms);
+        void redraw(std::string_view prompt, std::size_t width, std::string_view above);
+        void complete(LineBuffer& buf, std::string_view prompt, std::size_t width);
+        void recall(LineBuffer& buf, bool older);
+    };
+} // namespace nullsh::edit
\ No newline at end of file
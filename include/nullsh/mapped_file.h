@@ -0,0 +1,68 @@
+/**
+ * @file mapped_file.h
+ * @brief Read-only memory mapped file and a line reader over it
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace nullsh::io
+{
+    class MappedFile
+    {
+      public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        // scripts are read front to back, indexes are probed at random
+        enum class Access
+        {
+            Sequential,
+            Random
+        };
+
+        static auto open(const std::string& path, Access access = Access::Sequential)
+            -> std::expected<MappedFile, std::string>;
+
+        std::string_view view() const
+        {
+            return {static_cast<const char*>(addr_), size_};
+        }
+
+      private:
+        MappedFile(void* addr, std::size_t size) : addr_(addr), size_(size) {}
+
+        void* addr_ {nullptr};
+        std::size_t size_ {0};
+    };
+
+    // Splits a buffer into lines without copying them; the views live as long as the buffer
+    class LineReader
+    {
+      public:
+        explicit LineReader(std::string_view text) : rest_(text) {}
+
+        auto next() -> std::optional<std::string_view>;
+
+        // 1-based number of the line last returned by next()
+        std::size_t line_number() const
+        {
+            return line_;
+        }
+
+      private:
+        std::string_view rest_;
+        std::size_t line_ {0};
+    };
+} // namespace nullsh::io
\ No newline at end of file
@@ -0,0 +1,127 @@
+/**
+ * @file memo_cache.h
+ * @brief Results of deterministic commands kept by the memo builtin, in memory and on disk
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "nullsh/command.h"
+
+namespace nullsh::memo
+{
+    // Builds the key a result is stored under. Fields are length-prefixed, so no two field
+    // lists give the same key, and keys are compared whole: a hash only names the disk file.
+    class KeyBuilder
+    {
+      public:
+        void add(std::string_view field);
+        void add_var(std::string_view name, std::optional<std::string_view> value);
+        void add_stamp(const std::string& path);
+        auto add_digest(const std::string& path) -> std::expected<void, std::string>;
+
+        auto take() -> std::string
+        {
+            return std::move(key_);
+        }
+
+      private:
+        std::string key_;
+    };
+
+    auto digest(std::string_view data) -> std::uint64_t;
+
+    /**
+     * Exit code and output of memoized commands by key. The entries held in memory are bounded
+     * by the bytes of their keys and output, the least recently used go first. With a store
+     * directory every entry is also written there, one file per key laid out to be mapped and
+     * read in place, and entries not in memory are looked up there. The disk is not bounded.
+     */
+    class MemoCache
+    {
+      public:
+        static constexpr std::size_t DEFAULT_CAPACITY = 64UL * 1024 * 1024;
+
+        struct Stats
+        {
+            std::size_t entries {0};
+            std::size_t bytes {0};
+            std::size_t hits {0};
+            std::size_t misses {0};
+        };
+
+        explicit MemoCache(std::size_t capacity = DEFAULT_CAPACITY) : capacity_(capacity) {}
+
+        auto lookup(std::string_view key) -> std::optional<command::CommandResult>;
+        bool store(std::string key, const command::CommandResult& res);
+        void clear();
+        void set_capacity(std::size_t capacity);
+        auto open_store(const std::string& dir) -> std::expected<void, std::string>;
+
+        auto stats() const -> Stats
+        {
+            return {.entries = lru_.size(), .bytes = bytes_, .hits = hits_, .misses = misses_};
+        }
+
+        std::size_t capacity() const
+        {
+            return capacity_;
+        }
+
+        // empty when results stay in memory only
+        const std::string& store_dir() const
+        {
+            return dir_;
+        }
+
+      private:
+        struct Entry
+        {
+            std::string key;
+            int return_code;
+            std::string out;
+            std::string err;
+
+            std::size_t size() const
+            {
+                return key.size() + out.size() + err.size();
+            }
+        };
+
+        struct StringHash
+        {
+            using is_transparent = void;
+            std::size_t operator()(std::string_view str) const
+            {
+                return std::hash<std::string_view> {}(str);
+            }
+        };
+
+        using Lru = std::list<Entry>;
+
+        std::size_t capacity_;
+        std::size_t bytes_ {0};
+        std::size_t hits_ {0};
+        std::size_t misses_ {0};
+        std::string dir_;
+        Lru lru_; // most recently used first
+        std::unordered_map<std::string_view, Lru::iterator, StringHash, std::equal_to<>> index_;
+
+        void insert(Entry entry);
+        void evict();
+        auto file_of(std::string_view key) const -> std::string;
+        auto load(std::string_view key) const -> std::optional<Entry>;
+        bool save(const Entry& entry) const;
+    };
+} // namespace nullsh::memo
\ No newline at end of file
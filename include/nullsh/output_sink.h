@@ -0,0 +1,166 @@
+/**
+ * @file output_sink.h
+ * @brief Gathering writer for output produced inside the shell process
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace nullsh::io
+{
+    /**
+     * @brief Collects builtin and operator output and hands it on in as few syscalls as possible
+     *
+     * Short fragments are copied into an inline scratch buffer, longer ones are referenced in
+     * place and must stay alive until the next flush(). A flush sends everything queued to the
+     * fd with one writev() and appends it to the capture string in one go. A sink only gets a
+     * capture string when an operator still needs the data; one with neither discards.
+     */
+    class OutputSink
+    {
+      public:
+        static constexpr std::size_t MAX_FRAGMENTS = 16;
+        static constexpr std::size_t SCRATCH_SIZE = 4096; // PIPE_BUF, one atomic write
+        static constexpr std::size_t COPY_LIMIT = 128;    // longer fragments are not copied
+        static constexpr std::size_t READ_SIZE = 65536;   // chunk for copy_from() via read()
+
+        OutputSink() = default;
+        explicit OutputSink(int fd) : fd_(fd) {}
+        explicit OutputSink(std::string& capture) : capture_(&capture) {}
+        OutputSink(int fd, std::string& capture) : fd_(fd), capture_(&capture) {}
+        ~OutputSink();
+        OutputSink(const OutputSink&) = delete;
+        OutputSink& operator=(const OutputSink&) = delete;
+        OutputSink(OutputSink&&) = delete;
+        OutputSink& operator=(OutputSink&&) = delete;
+
+        /**
+         * @brief Adds data to the output
+         *
+         * Short data is copied, anything past COPY_LIMIT is only referenced until the next
+         * flush().
+         *
+         * @param data Bytes to write
+         */
+        void write(std::string_view data)
+        {
+            if (fits(data.size()))
+            {
+                std::memcpy(scratch_.data() + used_, data.data(), data.size());
+                used_ += data.size();
+                written_ += data.size();
+                last_ = data.empty() ? last_ : data.back();
+                return;
+            }
+            write_slow(data);
+        }
+
+        void put(char ch)
+        {
+            if (fits(1))
+            {
+                scratch_[used_++] = ch;
+                ++written_;
+                last_ = ch;
+                return;
+            }
+            write_slow(std::string_view(&ch, 1));
+        }
+
+        void copy(std::string_view data);
+        bool copy_from(int in_fd);
+        bool flush();
+        bool finish();
+
+        /**
+         * @brief Formats straight into the scratch buffer, no temporary string
+         *
+         * @param fmt Format string
+         * @param args Format arguments
+         */
+        template <typename... Args>
+        void print(std::format_string<const Args&...> fmt, const Args&... args)
+        {
+            if (discards())
+            {
+                return;
+            }
+            make_room(0);
+
+            auto room = SCRATCH_SIZE - used_;
+            auto res = std::format_to_n(scratch_.data() + used_, room, fmt, args...);
+            auto size = static_cast<std::size_t>(res.size);
+            if (size > room)
+            {
+                flush();
+                if (size > SCRATCH_SIZE)
+                {
+                    write_now(std::format(fmt, args...));
+                    return;
+                }
+                std::format_to(scratch_.data(), fmt, args...);
+            }
+            commit(size);
+        }
+
+        // whether nothing is kept or written
+        bool discards() const
+        {
+            return fd_ < 0 && capture_ == nullptr;
+        }
+        // whether the output goes to an fd as it is flushed
+        bool relays() const
+        {
+            return fd_ >= 0;
+        }
+        int fd() const
+        {
+            return fd_;
+        }
+        // bytes accepted so far
+        std::size_t written() const
+        {
+            return written_;
+        }
+        // whether a write to the fd failed, e.g. the reader went away
+        bool failed() const
+        {
+            return failed_;
+        }
+
+      private:
+        // whether size bytes can simply be copied behind the scratch run
+        bool fits(std::size_t size) const
+        {
+            return !discards() && size <= COPY_LIMIT && size <= SCRATCH_SIZE - used_;
+        }
+
+        void write_slow(std::string_view data);
+        void make_room(std::size_t size);
+        void commit(std::size_t size);
+        void queue_run();
+        void write_now(std::string_view data);
+
+        int fd_ {-1};
+        std::string* capture_ {nullptr};
+        std::size_t written_ {0};
+        char last_ {'\n'};
+        bool failed_ {false};
+        std::size_t count_ {0}; // queued fragments
+        std::size_t run_ {0};   // start of the scratch bytes not queued yet
+        std::size_t used_ {0};  // scratch bytes in use
+        // left uninitialized, only [0, count_) and [0, used_) are ever read
+        std::array<iovec, MAX_FRAGMENTS> iov_;   // NOLINT(*-member-init)
+        std::array<char, SCRATCH_SIZE> scratch_; // NOLINT(*-member-init)
+    };
+} // namespace nullsh::io
\ No newline at end of file
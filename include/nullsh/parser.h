@@ -8,12 +8,30 @@
 #pragma once
 
 #include <optional>
+#include <string_view>
 
 #include "nullsh/command.h"
+#include "nullsh/static_map.h"
+#include "nullsh/tokenizer.h"
 
 namespace nullsh::parser
 {
-    auto parse_operator(std::string_view token) -> command::Op;
+    // operator tokens, laid out at compile time
+    inline constexpr auto OPERATORS = util::make_static_map<command::Op>({
+        {"!", command::Op::ForceOutput},    //
+        {"?", command::Op::DiscardOutput},  //
+        {"$?", command::Op::PrintRC},       //
+        {"$$?", command::Op::PrintRCHuman}, //
+        {"$%", command::Op::PrintUsage},    //
+    });
+
+    constexpr auto parse_operator(std::string_view token) -> command::Op
+    {
+        const command::Op* op = OPERATORS.find(token);
+        return op != nullptr ? *op : command::Op::None;
+    }
+
     std::optional<command::Command> make_command(const std::vector<std::string>& args);
+    std::optional<command::Command> make_command(const util::TokenList& tokens);
 
 } // namespace nullsh::parser
\ No newline at end of file
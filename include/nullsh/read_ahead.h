@@ -0,0 +1,74 @@
+/**
+ * @file read_ahead.h
+ * @brief Block reader that tokenizes and parses non-interactive input ahead of execution
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "nullsh/command.h"
+
+namespace nullsh::io
+{
+    // A line of input, parsed before its turn comes
+    struct ParsedLine
+    {
+        std::size_t number {0};              // 1-based line number in the stream
+        std::optional<command::Command> cmd; // nullopt when the line parses to nothing
+        std::string error;                   // tokenizer error, cmd is empty then
+        std::string deferred {};             // line expanding variables, parsed in its turn
+    };
+
+    /**
+     * Reads an fd in large blocks on a helper thread and queues the parsed lines, so the next
+     * commands are ready while the current one runs. Blank lines and '#' comments are dropped.
+     * The helper stays at most depth lines ahead of the consumer. A read error ends the input
+     * like EOF, without the partial line before it, and status() tells them apart.
+     */
+    class ReadAhead
+    {
+      public:
+        static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+        static constexpr std::size_t DEFAULT_DEPTH = 64;
+
+        explicit ReadAhead(int fd, std::size_t depth = DEFAULT_DEPTH);
+        ~ReadAhead();
+        ReadAhead(const ReadAhead&) = delete;
+        ReadAhead& operator=(const ReadAhead&) = delete;
+        ReadAhead(ReadAhead&&) = delete;
+        ReadAhead& operator=(ReadAhead&&) = delete;
+
+        auto next() -> std::optional<ParsedLine>;
+        auto status() const -> std::expected<void, std::string>;
+
+      private:
+        int fd_;
+        int wake_fd_ {-1}; // eventfd interrupting a helper blocked on a read
+        std::size_t depth_;
+
+        std::mutex mutex_;
+        std::condition_variable ready_; // a line was queued or the input ended
+        std::condition_variable room_;  // the consumer took a line or is leaving
+        std::deque<ParsedLine> queue_;
+        bool eof_ {false};
+        bool stop_ {false};
+        int error_ {0}; // errno of the read that ended the input, set before eof_
+
+        std::thread helper_;
+
+        void produce();
+        bool wait_readable();
+        bool push(std::string_view line, std::size_t number);
+    };
+} // namespace nullsh::io
\ No newline at end of file
@@ -7,20 +7,70 @@
 
 #pragma once
 
+#include <sys/resource.h>
+
 #include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
 #include <string>
 
 #include "nullsh/capturer.h"
 #include "nullsh/command.h"
+#include "nullsh/event_loop.h"
+#include "nullsh/spill_file.h"
 
 namespace nullsh::io
 {
+    // Where a child's output stream is wired to
+    enum class StreamMode
+    {
+        Capture, // pipe into the CommandResult
+        Inherit, // child writes straight to the shell's own fd
+        Discard, // child writes to /dev/null
+        Tee,     // captured and relayed to the shell's own fd as it arrives
+    };
+
+    struct StreamRoute
+    {
+        StreamMode out {StreamMode::Capture};
+        StreamMode err {StreamMode::Capture};
+    };
+
+    // Execution limits for a child, zero means unlimited
+    struct Limits
+    {
+        std::chrono::milliseconds timeout {0}; // wall clock, then SIGTERM and later SIGKILL
+        rlim_t cpu_seconds {0};                // RLIMIT_CPU
+        rlim_t address_space {0};              // RLIMIT_AS, in bytes
+        rlim_t open_files {0};                 // RLIMIT_NOFILE
+        std::size_t max_output {0};            // captured bytes kept per stream
+    };
+
     class CommandResultCapturer final : public IOCapturer
     {
-        static constexpr int BUF_SIZE = 4096;
+        // one full pipe buffer per read
+        static constexpr int BUF_SIZE = 65536;
 
       public:
-        explicit CommandResultCapturer(command::CommandResult& res) : cmd_result(&res) {}
+        // captured bytes kept on the heap per stream before moving to a memfd
+        static constexpr std::size_t DEFAULT_SPILL_THRESHOLD = 16UL * 1024 * 1024;
+        // time a timed out child gets between SIGTERM and SIGKILL
+        static constexpr std::chrono::milliseconds KILL_GRACE {1000};
+
+        explicit CommandResultCapturer(command::CommandResult& res,
+                                       StreamRoute route = {},
+                                       std::size_t spill_threshold = DEFAULT_SPILL_THRESHOLD,
+                                       Limits limits = {},
+                                       EventLoop* loop = nullptr)
+            : cmd_result(&res),
+              route(route),
+              spill_threshold(spill_threshold),
+              limits(limits),
+              loop(loop)
+        {
+        }
+        ~CommandResultCapturer() override;
 
         void init_pipes();
         void prepare_child() override;
@@ -28,10 +78,32 @@ namespace nullsh::io
 
       private:
         command::CommandResult* cmd_result;
+        StreamRoute route;
+        std::size_t spill_threshold;
+        Limits limits;
+        EventLoop* loop; // the shell's, which sees its ^C; nullptr waits on a private one
+        int devnull {-1};
         std::array<int, 2> stdout_pipe {-1, -1};
         std::array<int, 2> stderr_pipe {-1, -1};
         std::array<char, BUF_SIZE> buffer {};
 
-        void read_pipe(int fd, std::string& out);
+        struct Relay
+        {
+            int fd {-1};
+            bool is_pipe {false};
+        };
+
+        struct Stream
+        {
+            std::string* data;
+            std::shared_ptr<SpillFile>* spill;
+            Relay relay;
+            bool truncated {false}; // output past limits.max_output was dropped
+        };
+
+        bool drain_pipes(int pidfd);
+        bool read_pipe(int fd, Stream& stream);
+        void store(Stream& stream, const char* data, size_t len);
+        auto room(const Stream& stream) const -> std::size_t;
     };
 } // namespace nullsh::io
\ No newline at end of file
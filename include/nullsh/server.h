@@ -0,0 +1,54 @@
+/**
+ * @file server.h
+ * @brief Persistent nullsh server over a Unix socket, and the client talking to it
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/shell.h"
+
+namespace nullsh::server
+{
+    // frames larger than this are treated as a broken peer
+    constexpr std::uint32_t MAX_FRAME = 1U << 30;
+
+    struct Request
+    {
+        std::string line;             // command line, as given to -c
+        std::string cwd;              // directory to run it in, empty keeps the session's
+        std::vector<std::string> env; // "NAME=value" sets a variable, "NAME" unsets it
+    };
+
+    struct Reply
+    {
+        int return_code {0};
+        std::string stdout_data; // what the command printed, after its operators
+        std::string stderr_data;
+    };
+
+    auto encode(const Request& req) -> std::string;
+    auto encode(const Reply& reply) -> std::string;
+    auto decode_request(std::string_view data) -> std::optional<Request>;
+    auto decode_reply(std::string_view data) -> std::optional<Reply>;
+
+    bool write_frame(int fd, std::string_view payload);
+    auto read_frame(int fd) -> std::optional<std::string>;
+
+    Reply handle(shell::NullShell& sh, const Request& req);
+    auto send_request(const std::string& path, const Request& req)
+        -> std::expected<Reply, std::string>;
+
+    int run_server(const std::string& path, shell::NullShell& sh);
+    int run_client(const std::string& path, const std::string& line);
+
+} // namespace nullsh::server
\ No newline at end of file
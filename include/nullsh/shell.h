@@ -7,34 +7,96 @@
 
 #pragma once
 
+#include <expected>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "nullsh/command.h"
+#include "nullsh/executor.h"
+#include "nullsh/history.h"
+#include "nullsh/jobs.h"
+#include "nullsh/memo_cache.h"
+#include "nullsh/tokenizer.h"
+#include "nullsh/variables.h"
 
 namespace nullsh::shell
 {
     // Conventional POSIX exit codes for shells
+    constexpr int EXIT_USAGE = 2;                // syntax or usage error
+    constexpr int EXIT_TIMEOUT = 124;            // stopped for running past its timeout
     constexpr int EXIT_CMD_NOT_EXECUTABLE = 126; // found but not executable
     constexpr int EXIT_CMD_NOT_FOUND = 127;      // command not found
     constexpr int EXIT_SIGNAL_BASE = 128;        // 128 + signal number
 
+    // scripts sourcing each other deeper than this are assumed to loop
+    constexpr int MAX_SOURCE_DEPTH = 64;
+
     class NullShell
     {
         bool running {false};
         bool has_exit {false};
 
       public:
-        NullShell() = default;
+        NullShell();
+        ~NullShell() = default;
+        // exec_opts points at the variables, the shell stays where it was made
+        NullShell(const NullShell&) = delete;
+        NullShell& operator=(const NullShell&) = delete;
+        NullShell(NullShell&&) = delete;
+        NullShell& operator=(NullShell&&) = delete;
 
         int run();
+        int run_stream(int fd, std::string_view name);
         int execute(const std::vector<std::string>& args);
+        int execute(const util::TokenList& tokens);
+        int execute(command::Command& cmd);
+        int execute_last(const util::TokenList& tokens);
+        int run_script(std::string_view text, std::string_view name);
+        auto source(const std::string& path) -> std::expected<int, std::string>;
+        auto enable_history(const std::string& path) -> std::expected<void, std::string>;
         void exit();
 
+        executor::ExecOptions& exec_options()
+        {
+            return exec_opts;
+        }
+
+        jobs::JobTable& jobs()
+        {
+            return job_table;
+        }
+
+        vars::VarTable& variables()
+        {
+            return var_table;
+        }
+
+        memo::MemoCache& memo()
+        {
+            return memo_cache;
+        }
+
+        // nullptr unless enabled with --history
+        history::History* history()
+        {
+            return history_ ? &*history_ : nullptr;
+        }
+
       private:
         std::string prompt {"nullsh>"};
         int last_status_ {0};
+        executor::ExecOptions exec_opts {};
+        jobs::JobTable job_table;
+        vars::VarTable var_table;
+        memo::MemoCache memo_cache;
+        std::optional<history::History> history_;
+        int source_depth {0};
 
         command::CommandResult execute_command(command::Command& cmd);
+        int start_job(command::Command& cmd);
+        void notify_jobs();
+        auto job_notices() -> std::string;
     };
 } // namespace nullsh::shell
\ No newline at end of file
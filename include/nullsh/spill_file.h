@@ -0,0 +1,48 @@
+/**
+ * @file spill_file.h
+ * @brief Anonymous in-memory file holding captured output past the heap threshold
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace nullsh::io
+{
+    class SpillFile
+    {
+      public:
+        explicit SpillFile(int fd) : fd_(fd) {}
+        ~SpillFile();
+        SpillFile(const SpillFile&) = delete;
+        SpillFile& operator=(const SpillFile&) = delete;
+        SpillFile(SpillFile&&) = delete;
+        SpillFile& operator=(SpillFile&&) = delete;
+
+        static auto create(const char* name) -> std::shared_ptr<SpillFile>;
+
+        bool append(const char* data, std::size_t len);
+        auto splice_from(int pipe_fd, std::size_t len) -> long;
+        bool send_to(int out_fd) const;
+        auto read_all() const -> std::string;
+        char back() const;
+        std::size_t sync_size();
+
+        int fd() const
+        {
+            return fd_;
+        }
+        std::size_t size() const
+        {
+            return size_;
+        }
+
+      private:
+        int fd_;
+        std::size_t size_ {0};
+    };
+} // namespace nullsh::io
\ No newline at end of file
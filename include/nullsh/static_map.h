@@ -0,0 +1,177 @@
+/**
+ * @file static_map.h
+ * @brief Compile-time perfect hash table keyed by short strings
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace nullsh::util
+{
+    /**
+     * Fixed set of string keys laid out at compile time. Keys are hashed whole with a seeded
+     * FNV-1a, and the seed is searched for when the map is built until every key lands in a
+     * slot of its own. A lookup hashes the key, probes one slot and compares the length and
+     * bytes stored there, so any set of distinct keys works. Lives in read-only data: no heap,
+     * no static initialisation.
+     */
+    template <typename Value, std::size_t N> class StaticMap
+    {
+      public:
+        using Entry = std::pair<std::string_view, Value>;
+
+        // at least twice as many slots as keys keeps the seed search short
+        static constexpr std::size_t SLOTS = std::bit_ceil(N * 2);
+        static constexpr int SHIFT = 32 - std::countr_zero(SLOTS);
+
+        consteval explicit StaticMap(const std::array<Entry, N>& entries)
+        {
+            for (const auto& entry : entries)
+            {
+                if (entry.first.size() > MAX_KEY)
+                {
+                    throw std::logic_error("key too long");
+                }
+                max_len_ = std::max(max_len_, entry.first.size());
+            }
+            for (std::size_t i = 0; i < N; ++i)
+            {
+                for (std::size_t j = i + 1; j < N; ++j)
+                {
+                    if (entries[i].first == entries[j].first)
+                    {
+                        throw std::logic_error("duplicate key");
+                    }
+                }
+            }
+
+            for (std::uint32_t seed = 1; seed < MAX_SEED; ++seed)
+            {
+                if (place(entries, seed))
+                {
+                    seed_ = seed;
+                    return;
+                }
+            }
+            throw std::logic_error("no seed places every key in a slot of its own");
+        }
+
+        constexpr const Value* find(std::string_view key) const
+        {
+            if (key.size() > max_len_)
+            {
+                return nullptr;
+            }
+            const Slot& slot = slots_[index(hash(key, seed_))];
+            if (slot.len != key.size() || std::string_view(slot.key, slot.len) != key)
+            {
+                return nullptr;
+            }
+            return &slot.value;
+        }
+
+        constexpr bool contains(std::string_view key) const
+        {
+            return find(key) != nullptr;
+        }
+
+        static constexpr std::size_t size()
+        {
+            return N;
+        }
+
+        // visits the keys in slot order, which is not their order in the list
+        template <typename Fn> constexpr void for_each_key(Fn&& visit) const
+        {
+            for (const Slot& slot : slots_)
+            {
+                if (slot.len != FREE)
+                {
+                    visit(std::string_view(slot.key, slot.len));
+                }
+            }
+        }
+
+      private:
+        static constexpr std::size_t MAX_KEY = 0xff;
+        static constexpr std::uint32_t MAX_SEED = 1U << 16;
+        static constexpr std::uint32_t FREE = 0xffffffffU; // longer than any key
+
+        struct Slot
+        {
+            std::uint32_t len {FREE};
+            Value value {};
+            const char* key {nullptr};
+        };
+
+        // FNV-1a over the whole key, the seed perturbs the offset basis
+        static constexpr std::uint32_t hash(std::string_view key, std::uint32_t seed)
+        {
+            std::uint32_t state = 0x811C9DC5U ^ (seed * 0x9E3779B1U);
+            for (char chr : key)
+            {
+                state ^= static_cast<unsigned char>(chr);
+                state *= 0x01000193U;
+            }
+            return state;
+        }
+
+        // the top bits, after a final multiply spreads FNV's weak high bits
+        static constexpr std::size_t index(std::uint32_t digest)
+        {
+            const std::uint32_t mixed = (digest ^ (digest >> 15U)) * 0x2C1B3C6DU;
+            if constexpr (SHIFT >= 32)
+            {
+                return 0;
+            }
+            else
+            {
+                return mixed >> SHIFT;
+            }
+        }
+
+        constexpr bool place(const std::array<Entry, N>& entries, std::uint32_t seed)
+        {
+            slots_ = {};
+            for (const auto& [key, value] : entries)
+            {
+                Slot& slot = slots_[index(hash(key, seed))];
+                if (slot.len != FREE)
+                {
+                    return false;
+                }
+                slot = {.len = static_cast<std::uint32_t>(key.size()),
+                        .value = value,
+                        .key = key.data()};
+            }
+            return true;
+        }
+
+        std::array<Slot, SLOTS> slots_ {};
+        std::uint32_t seed_ {0};
+        std::size_t max_len_ {0};
+    };
+
+    /**
+     * @brief Builds a StaticMap from a braced list, counting the entries
+     *
+     * @param entries Key and value pairs, keys must be distinct
+     * @return StaticMap<Value, N>
+     */
+    template <typename Value, std::size_t N>
+    consteval auto make_static_map(const std::pair<std::string_view, Value> (&entries)[N])
+        -> StaticMap<Value, N>
+    {
+        return StaticMap<Value, N>(std::to_array(entries));
+    }
+} // namespace nullsh::util
\ No newline at end of file
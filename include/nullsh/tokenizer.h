@@ -0,0 +1,123 @@
+/**
+ * @file tokenizer.h
+ * @brief Vectorized command line tokenizer returning views into the line
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/variables.h"
+
+namespace nullsh::util
+{
+    // what a token is to the parser; quoted or escaped '|' and '&' are words like any other
+    enum class TokenKind : std::uint8_t
+    {
+        Word,
+        Separator, // unquoted '|' or '&'
+    };
+
+    /**
+     * Tokens of a command line. A token spelled verbatim in the line, or as one quoted span
+     * with nothing else around it, is a view into the line; only tokens that had to be
+     * rewritten (escapes, quotes in the middle of a word) are materialised here. The views
+     * are valid while both the line and the list are alive.
+     */
+    class TokenList
+    {
+      public:
+        TokenList() = default;
+        ~TokenList() = default;
+        TokenList(const TokenList&) = delete;
+        TokenList& operator=(const TokenList&) = delete;
+        TokenList(TokenList&&) noexcept = default;
+        TokenList& operator=(TokenList&&) noexcept = default;
+
+        void push_view(std::string_view token, TokenKind kind = TokenKind::Word)
+        {
+            tokens_.push_back(token);
+            kinds_.push_back(kind);
+        }
+
+        void push_owned(std::string&& token)
+        {
+            tokens_.emplace_back(owned_.emplace_back(std::move(token)));
+            kinds_.push_back(TokenKind::Word);
+        }
+
+        std::span<const std::string_view> views() const
+        {
+            return tokens_;
+        }
+
+        // one per token, parallel to views()
+        std::span<const TokenKind> kinds() const
+        {
+            return kinds_;
+        }
+
+        std::size_t size() const
+        {
+            return tokens_.size();
+        }
+
+        bool empty() const
+        {
+            return tokens_.empty();
+        }
+
+        std::string_view operator[](std::size_t idx) const
+        {
+            return tokens_[idx];
+        }
+
+        auto begin() const
+        {
+            return tokens_.begin();
+        }
+
+        auto end() const
+        {
+            return tokens_.end();
+        }
+
+        // number of tokens that could not be views into the line
+        std::size_t owned_count() const
+        {
+            return owned_.size();
+        }
+
+        auto to_strings() const -> std::vector<std::string>;
+
+      private:
+        std::vector<std::string_view> tokens_;
+        std::vector<TokenKind> kinds_;
+        std::deque<std::string> owned_; // stable addresses, tokens_ points into them
+    };
+
+    // Byte scanner used to find separators, quotes and escapes, 64 bytes at a time
+    enum class ScanLevel : std::uint8_t
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    auto best_scan_level() -> ScanLevel;
+    auto tokenize_views(std::string_view line) -> std::expected<TokenList, std::string>;
+    auto tokenize_views(std::string_view line, ScanLevel level)
+        -> std::expected<TokenList, std::string>;
+    auto tokenize_views(std::string_view line, const vars::VarTable& vars)
+        -> std::expected<TokenList, std::string>;
+    bool has_expansions(std::string_view line);
+} // namespace nullsh::util
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <expected>
 #include <filesystem>
 #include <optional>
@@ -22,13 +23,18 @@ namespace nullsh::util
     void trim(std::string& str);
     void newline(std::string& str);
     auto tokenize(std::string_view line) -> std::expected<std::vector<std::string>, std::string>;
+    auto parse_size(std::string_view str) -> std::optional<std::size_t>;
 
     // Command helpers
     bool command_exists(const std::string& cmd);
 
     // Filesystem helpers
-    auto get_env_var(const std::string& name) -> std::optional<std::string>;
-    auto expand_user_path(const std::string& path) -> std::filesystem::path;
+    auto get_env_var(const char* name) -> std::optional<std::string_view>;
+    auto expand_user_path(std::string_view path, std::optional<std::string_view> home)
+        -> std::filesystem::path;
     std::error_code resolve_directory(const std::filesystem::path& path,
                                       std::filesystem::path& resolved_path);
+
+    // Output helpers, straight to the fd: no iostream on the one-shot path
+    bool write_all(int fd, std::string_view data);
 } // namespace nullsh::util
\ No newline at end of file
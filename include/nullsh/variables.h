@@ -0,0 +1,140 @@
+/**
+ * @file variables.h
+ * @brief Shell variables, with the environment of child processes kept ready to pass on
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nullsh::vars
+{
+    bool valid_name(std::string_view name);
+    auto split_assignment(std::string_view word)
+        -> std::optional<std::pair<std::string_view, std::string_view>>;
+
+    /**
+     * Every variable of the shell, exported or not. Exported ones are also slots of a
+     * NULL-terminated envp array that is patched in place on every change: a child gets
+     * envp() as is, nothing is rebuilt or scanned when it starts. Values are views into
+     * the table, valid until the variable changes.
+     */
+    class VarTable
+    {
+      public:
+        VarTable() = default;
+        explicit VarTable(char* const* env, bool sync_process = false);
+        ~VarTable() = default;
+        VarTable(const VarTable&) = delete;
+        VarTable& operator=(const VarTable&) = delete;
+        VarTable(VarTable&&) noexcept = default;
+        VarTable& operator=(VarTable&&) noexcept = default;
+
+        auto get(std::string_view name) const -> std::optional<std::string_view>;
+        bool exported(std::string_view name) const;
+
+        void set(std::string_view name, std::string_view value);
+        void export_var(std::string_view name, std::string_view value);
+        void export_var(std::string_view name);
+        bool unset(std::string_view name);
+
+        // NULL-terminated "NAME=VALUE" strings of the exported variables, valid until a change
+        char* const* envp() const
+        {
+            return envp_.data();
+        }
+
+        // number of exported variables
+        std::size_t exported_count() const
+        {
+            return envp_.size() - 1;
+        }
+
+        template <typename Fn>
+        void for_each(Fn&& visit) const
+        {
+            for (const auto& [name, var] : vars_)
+            {
+                std::invoke(visit, std::string_view(name), value_of(var), var.slot != NO_SLOT);
+            }
+        }
+
+        /**
+         * `NAME=VALUE cmd` assignments, exported for the duration of one command and undone
+         * afterwards. The process environment is never touched.
+         */
+        class Scope
+        {
+          public:
+            template <typename Words>
+            Scope(VarTable& table, const Words& assignments) : table_(&table)
+            {
+                for (std::string_view word : assignments)
+                {
+                    apply(word);
+                }
+            }
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+            Scope(Scope&&) = delete;
+            Scope& operator=(Scope&&) = delete;
+
+          private:
+            struct Saved
+            {
+                std::string name;
+                std::optional<std::string> value; // nullopt: the variable did not exist
+                bool exported {false};
+            };
+
+            void apply(std::string_view word);
+
+            VarTable* table_;
+            std::vector<Saved> saved_;
+        };
+
+      private:
+        static constexpr std::size_t NO_SLOT = static_cast<std::size_t>(-1);
+
+        struct Var
+        {
+            std::string entry;     // "NAME=VALUE", what envp points at
+            std::size_t value_pos; // start of VALUE in entry
+            std::size_t slot;      // index in envp_, NO_SLOT when not exported
+        };
+
+        struct StringHash
+        {
+            using is_transparent = void;
+            std::size_t operator()(std::string_view str) const
+            {
+                return std::hash<std::string_view> {}(str);
+            }
+        };
+
+        static std::string_view value_of(const Var& var)
+        {
+            return std::string_view(var.entry).substr(var.value_pos);
+        }
+
+        std::unordered_map<std::string, Var, StringHash, std::equal_to<>> vars_;
+        std::vector<char*> envp_ {nullptr};
+        std::vector<Var*> owners_; // owners_[slot] is the variable envp_[slot] belongs to
+        bool sync_process_ {false};
+
+        void put(std::string_view name, std::string_view value, bool exported, bool sync);
+        void remove(std::string_view name, bool sync);
+        void add_slot(Var& var);
+        void drop_slot(Var& var);
+    };
+} // namespace nullsh::vars
\ No newline at end of file
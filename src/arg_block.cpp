@@ -0,0 +1,185 @@
+/**
+ * @file arg_block.cpp
+ * @brief Command arguments stored as one block of NUL-terminated strings
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/arg_block.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace nullsh::command
+{
+    namespace
+    {
+        // typical command lines fit here, in the same allocation as the arena itself
+        constexpr std::size_t INLINE_ARENA = 512;
+
+        struct SmallArena
+        {
+            std::array<std::byte, INLINE_ARENA> buffer;
+            std::pmr::monotonic_buffer_resource resource {buffer.data(), buffer.size()};
+        };
+
+        std::pmr::memory_resource* resource_of(const ArgBlock::Arena& arena)
+        {
+            return arena ? arena.get() : std::pmr::get_default_resource();
+        }
+    } // namespace
+
+    ArgBlock::ArgBlock(Arena arena)
+        : arena_(std::move(arena)), bytes_(resource_of(arena_)), offsets_(resource_of(arena_)),
+          argv_(resource_of(arena_))
+    {
+    }
+
+    ArgBlock::ArgBlock(std::initializer_list<std::string_view> args) : ArgBlock()
+    {
+        assign(args.begin(), args.end());
+    }
+
+    ArgBlock::ArgBlock(const std::vector<std::string>& args) : ArgBlock()
+    {
+        assign(args.begin(), args.end());
+    }
+
+    ArgBlock::ArgBlock(const ArgBlock& other) : ArgBlock()
+    {
+        bytes_.assign(other.bytes_.begin(), other.bytes_.end());
+        offsets_.assign(other.offsets_.begin(), other.offsets_.end());
+    }
+
+    ArgBlock& ArgBlock::operator=(const ArgBlock& other)
+    {
+        if (this != &other)
+        {
+            ArgBlock copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    ArgBlock& ArgBlock::operator=(ArgBlock&& other) noexcept
+    {
+        // containers keep their resource on assignment, rebuild so ours comes along with theirs
+        if (this != &other)
+        {
+            std::destroy_at(this);
+            std::construct_at(this, std::move(other));
+        }
+        return *this;
+    }
+
+    ArgBlock& ArgBlock::operator=(std::initializer_list<std::string_view> args)
+    {
+        assign(args.begin(), args.end());
+        return *this;
+    }
+
+    /**
+     * @brief Makes room for more arguments, so adding them does not reallocate
+     *
+     * @param count Number of arguments about to be added
+     * @param bytes Their total length, terminators included
+     */
+    void ArgBlock::reserve(std::size_t count, std::size_t bytes)
+    {
+        bytes_.reserve(bytes_.size() + bytes);
+        argv_.reserve(offsets_.size() + count + 2);
+        offsets_.reserve(offsets_.size() + count);
+    }
+
+    void ArgBlock::push_back(std::string_view arg)
+    {
+        place(grow(arg.size() + 1), arg);
+    }
+
+    // appends room for bytes more bytes, returns where it starts
+    char* ArgBlock::grow(std::size_t bytes)
+    {
+        const std::size_t used = bytes_.size();
+        if (used + bytes >= std::numeric_limits<std::uint32_t>::max())
+        {
+            throw std::length_error("argument block over 4 GiB");
+        }
+        bytes_.resize(used + bytes);
+        return bytes_.data() + used;
+    }
+
+    // copies one argument and its terminator to out, inside room made by grow()
+    char* ArgBlock::place(char* out, std::string_view arg)
+    {
+        offsets_.push_back(static_cast<std::uint32_t>(out - bytes_.data()));
+        std::memcpy(out, arg.data(), arg.size());
+        out[arg.size()] = '\0';
+        return out + arg.size() + 1;
+    }
+
+    void ArgBlock::pop_back()
+    {
+        bytes_.resize(offsets_.back());
+        offsets_.pop_back();
+    }
+
+    void ArgBlock::clear()
+    {
+        bytes_.clear();
+        offsets_.clear();
+    }
+
+    /**
+     * @brief Builds the argv handed to execve, pointing into the block
+     *
+     * @param arg0 Program name placed in front of the arguments
+     * @return char* const* size() + 2 pointers, the last one NULL
+     */
+    auto ArgBlock::argv(const char* arg0) const -> char* const*
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-const-cast)
+        argv_.clear();
+        argv_.push_back(const_cast<char*>(arg0));
+        char* base = const_cast<char*>(bytes_.data());
+        for (auto off : offsets_)
+        {
+            argv_.push_back(base + off);
+        }
+        // NOLINTEND(cppcoreguidelines-pro-type-const-cast)
+        argv_.push_back(nullptr);
+        return argv_.data();
+    }
+
+    bool operator==(const ArgBlock& lhs, const ArgBlock& rhs)
+    {
+        return std::ranges::equal(lhs.offsets_, rhs.offsets_) &&
+               std::ranges::equal(lhs.bytes_, rhs.bytes_);
+    }
+
+    bool operator==(const ArgBlock& lhs, const std::vector<std::string>& rhs)
+    {
+        return std::ranges::equal(lhs, rhs, [](std::string_view arg, const std::string& str)
+                                  { return arg == str; });
+    }
+
+    /**
+     * @brief Creates the arena the blocks of one command line allocate from
+     *
+     * @param bytes Expected total size of the line's blocks
+     * @return ArgBlock::Arena Arena, freed with the last block using it
+     */
+    auto make_arena(std::size_t bytes) -> ArgBlock::Arena
+    {
+        if (bytes <= INLINE_ARENA)
+        {
+            auto arena = std::make_shared<SmallArena>();
+            return {arena, &arena->resource};
+        }
+        return std::make_shared<std::pmr::monotonic_buffer_resource>(bytes);
+    }
+} // namespace nullsh::command
\ No newline at end of file
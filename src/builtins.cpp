@@ -7,167 +7,2020 @@
 
 #include "nullsh/builtins.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cinttypes>
+#include <climits>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <filesystem>
 #include <format>
+#include <optional>
 #include <ranges>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
+#include "nullsh/command_cache.h"
+#include "nullsh/executor.h"
+#include "nullsh/jobs.h"
+#include "nullsh/memo_cache.h"
+#include "nullsh/output_sink.h"
 #include "nullsh/shell.h"
+#include "nullsh/static_map.h"
 #include "nullsh/util.h"
+#include "nullsh/variables.h"
 
 namespace nullsh::builtins
 {
-    using Handler = command::CommandResult (*)(command::Command&, shell::NullShell&);
+    using Handler = command::CommandResult (*)(command::Command&,
+                                               shell::NullShell&,
+                                               io::OutputSink&,
+                                               io::OutputSink&);
 
     namespace
     {
         namespace fs = std::filesystem;
 
         command::CommandResult builtin_cd(command::Command& cmd,
-                                          [[maybe_unused]] shell::NullShell& sh)
+                                          shell::NullShell& sh,
+                                          [[maybe_unused]] io::OutputSink& out,
+                                          io::OutputSink& err)
         {
             try
             {
                 fs::path new_path;
                 if (cmd.args.empty())
                 {
-                    auto home = util::get_env_var("HOME");
+                    auto home = sh.variables().get("HOME");
 
                     if (!home.has_value())
                     {
-                        return {
-                            .return_code = 1, .stdout_data = "", .stderr_data = "cd: HOME not set"};
+                        err.write("cd: HOME not set\n");
+                        return {.return_code = 1};
                     }
                     new_path = fs::path(*home);
                 }
                 else if (cmd.args.size() > 1)
                 {
-                    return {.return_code = 1,
-                            .stdout_data = "",
-                            .stderr_data = "cd: too many arguments"};
+                    err.write("cd: too many arguments\n");
+                    return {.return_code = 1};
                 }
                 else
                 {
-                    new_path = util::expand_user_path(cmd.args[0]);
+                    new_path = util::expand_user_path(cmd.args[0], sh.variables().get("HOME"));
                 }
 
                 fs::path resolved_path;
                 auto ec = util::resolve_directory(new_path, resolved_path);
                 if (ec)
                 {
-                    return {.return_code = ec.value(),
-                            .stdout_data = "",
-                            .stderr_data = "cd: " + new_path.string() + ": " + ec.message()};
+                    err.print("cd: {}: {}\n", new_path.native(), ec.message());
+                    return {.return_code = ec.value()};
                 }
 
                 // change directory
                 fs::current_path(resolved_path);
 
-                // set PWD environment variable
-                setenv("PWD", resolved_path.c_str(), 1);
+                sh.variables().export_var("PWD", resolved_path.native());
 
-                return {.return_code = 0, .stdout_data = "", .stderr_data = ""};
+                return {.return_code = 0};
             }
             catch (const fs::filesystem_error& e)
             {
-                return {.return_code = 1,
-                        .stdout_data = "",
-                        .stderr_data = "cd: " + std::string(e.what())};
+                err.print("cd: {}\n", e.what());
+                return {.return_code = 1};
             }
         }
 
         command::CommandResult builtin_pwd([[maybe_unused]] command::Command& cmd,
-                                           [[maybe_unused]] shell::NullShell& sh)
+                                           [[maybe_unused]] shell::NullShell& sh,
+                                           io::OutputSink& out,
+                                           io::OutputSink& err)
         {
-            // namespace fs = std::filesystem;
-            try
-            {
-                fs::path cwd = fs::current_path();
-                return {.return_code = 0, .stdout_data = cwd.string() + "\n", .stderr_data = ""};
-            }
-            catch (const fs::filesystem_error& e)
+            // a stack buffer rather than fs::current_path(), which allocates
+            std::array<char, PATH_MAX> cwd {};
+            if (getcwd(cwd.data(), cwd.size()) == nullptr)
             {
-                return {.return_code = errno, .stdout_data = "", .stderr_data = e.what()};
+                int error = errno;
+                err.print("pwd: {}\n", std::strerror(error));
+                return {.return_code = error};
             }
+            out.print("{}\n", cwd.data());
+            return {.return_code = 0};
         }
 
-        command::CommandResult builtin_exit(command::Command& cmd, shell::NullShell& sh)
+        command::CommandResult builtin_exit(command::Command& cmd,
+                                            shell::NullShell& sh,
+                                            [[maybe_unused]] io::OutputSink& out,
+                                            io::OutputSink& err)
         {
             int status = 0;
             if (!cmd.args.empty())
             {
                 try
                 {
-                    status = std::stoi(cmd.args[0]);
+                    status = std::stoi(std::string(cmd.args[0]));
                 }
                 catch (const std::invalid_argument& e)
                 {
-                    return {.return_code = 1,
-                            .stdout_data = "",
-                            .stderr_data = "exit: numeric argument required"};
+                    err.write("exit: numeric argument required\n");
+                    return {.return_code = 1};
                 }
                 catch (const std::out_of_range& e)
                 {
-                    return {.return_code = 1,
-                            .stdout_data = "",
-                            .stderr_data = "exit: numeric argument out of range"};
+                    err.write("exit: numeric argument out of range\n");
+                    return {.return_code = 1};
                 }
             }
             sh.exit();
-            return {.return_code = status, .stdout_data = "", .stderr_data = ""};
+            return {.return_code = status};
         }
 
         command::CommandResult builtin_echo(command::Command& cmd,
-                                            [[maybe_unused]] shell::NullShell& sh)
+                                            [[maybe_unused]] shell::NullShell& sh,
+                                            io::OutputSink& out,
+                                            [[maybe_unused]] io::OutputSink& err)
         {
-            auto joined = cmd.args | std::views::join_with(' ');
-            auto out = std::format("{}\n", std::string(joined.begin(), joined.end()));
-            return {.return_code = 0, .stdout_data = out, .stderr_data = ""};
+            // the arguments outlive the sink's flush, so long ones are written in place
+            bool first = true;
+            for (std::string_view arg : cmd.args)
+            {
+                if (!first)
+                {
+                    out.put(' ');
+                }
+                out.write(arg);
+                first = false;
+            }
+            out.put('\n');
+            return {.return_code = 0};
         }
-    } // namespace
 
-    // builtin dispatch table
-    static const std::unordered_map<std::string, Handler> BUILTINS_TABLE = {
-        {"cd", &builtin_cd},     //
-        {"pwd", &builtin_pwd},   //
-        {"exit", &builtin_exit}, //
-        {"echo", &builtin_echo}  //
-    };
+        command::CommandResult builtin_hash(command::Command& cmd,
+                                            [[maybe_unused]] shell::NullShell& sh,
+                                            io::OutputSink& out,
+                                            io::OutputSink& err)
+        {
+            auto& cache = cache::command_cache();
 
-    /**
-     * @brief Checks if a command is a built-in
-     *
-     * @param name Command name
-     * @return true if built-in, false otherwise
-     */
-    bool is_builtin(const std::string& name)
-    {
-        return BUILTINS_TABLE.contains(name);
-    }
+            if (cmd.args.empty())
+            {
+                bool listed = false;
+                cache.for_each(
+                    [&out, &listed](std::string_view, const cache::CommandCache::Entry& entry)
+                    {
+                        if (!listed)
+                        {
+                            out.write("hits\tcommand\n");
+                            listed = true;
+                        }
+                        out.print("{:4}\t{}\n", entry.hits, entry.path);
+                    });
 
-    /**
-     * @brief Executes a built-in command
-     *
-     * @param cmd Command to execute
-     * @param sh Shell context
-     * @return command::CommandResult Result of command execution
-     */
-    command::CommandResult execute(command::Command& cmd, shell::NullShell& sh)
-    {
-        auto entry = BUILTINS_TABLE.find(cmd.name);
-        if (entry != BUILTINS_TABLE.end())
+                if (!listed)
+                {
+                    out.write("hash: hash table empty\n");
+                }
+                return {.return_code = 0};
+            }
+
+            if (cmd.args.size() == 1 && cmd.args[0] == "-r")
+            {
+                cache.clear();
+                return {.return_code = 0};
+            }
+
+            // warm the cache with the given names
+            int status = 0;
+            for (const auto& name : cmd.args)
+            {
+                if (name.find('/') != std::string::npos || !cache.lookup(name))
+                {
+                    status = 1;
+                    err.print("hash: {}: not found\n", name);
+                }
+            }
+            return {.return_code = status};
+        }
+
+        // accepts a job id as "N" or "%N"
+        auto parse_job_id(std::string_view spec) -> std::optional<int>
+        {
+            if (spec.starts_with('%'))
+            {
+                spec.remove_prefix(1);
+            }
+
+            int id = 0;
+            auto [end, ec] = std::from_chars(spec.data(), spec.data() + spec.size(), id);
+            if (ec != std::errc {} || end != spec.data() + spec.size() || id <= 0)
+            {
+                return std::nullopt;
+            }
+            return id;
+        }
+
+        // waits for a job and applies its operators, as if it had run in the foreground
+        int collect_job(shell::NullShell& sh, int id, io::OutputSink& out, io::OutputSink& err)
+        {
+            // the job prints its own output, after whatever the builtin wrote so far
+            out.flush();
+            err.flush();
+
+            auto& table = sh.jobs();
+            table.wait(id, sh.exec_options().loop);
+            auto job = table.collect(id);
+            if (!job)
+            {
+                return shell::EXIT_CMD_NOT_FOUND;
+            }
+
+            executor::apply_operators(job->ops, job->result);
+            return job->result.return_code;
+        }
+
+        command::CommandResult builtin_jobs([[maybe_unused]] command::Command& cmd,
+                                            shell::NullShell& sh,
+                                            io::OutputSink& out,
+                                            [[maybe_unused]] io::OutputSink& err)
+        {
+            auto& table = sh.jobs();
+            table.refresh();
+
+            table.for_each(
+                [&out](jobs::Job& job)
+                {
+                    out.print("[{}]  {:<8}  {}\n", job.id, jobs::state(job), job.text);
+                    job.notified = job.done;
+                });
+
+            return {.return_code = 0};
+        }
+
+        command::CommandResult builtin_wait(command::Command& cmd,
+                                            shell::NullShell& sh,
+                                            io::OutputSink& out,
+                                            io::OutputSink& err)
+        {
+            int status = 0;
+
+            if (cmd.args.empty())
+            {
+                std::vector<int> ids;
+                sh.jobs().for_each([&ids](const jobs::Job& job) { ids.push_back(job.id); });
+                for (int id : ids)
+                {
+                    status = collect_job(sh, id, out, err);
+                }
+                return {.return_code = status};
+            }
+
+            for (const auto& arg : cmd.args)
+            {
+                auto id = parse_job_id(arg);
+                if (!id || sh.jobs().find(*id) == nullptr)
+                {
+                    status = shell::EXIT_CMD_NOT_FOUND;
+                    err.print("wait: {}: no such job\n", arg);
+                    continue;
+                }
+                status = collect_job(sh, *id, out, err);
+            }
+            return {.return_code = status};
+        }
+
+        command::CommandResult builtin_fg(command::Command& cmd,
+                                          shell::NullShell& sh,
+                                          io::OutputSink& out,
+                                          io::OutputSink& err)
+        {
+            if (cmd.args.size() > 1)
+            {
+                err.write("fg: too many arguments\n");
+                return {.return_code = 1};
+            }
+
+            std::string_view spec = cmd.args.empty() ? "current" : cmd.args[0];
+            auto id = cmd.args.empty() ? std::optional<int>(sh.jobs().current())
+                                       : parse_job_id(cmd.args[0]);
+            if (!id || sh.jobs().find(*id) == nullptr)
+            {
+                err.print("fg: {}: no such job\n", spec);
+                return {.return_code = 1};
+            }
+
+            return {.return_code = collect_job(sh, *id, out, err)};
+        }
+
+        // parses one `limit` option into limits, false if the value is malformed
+        bool parse_limit(std::string_view flag, std::string_view value, io::Limits& limits)
+        {
+            const char* first = value.data();
+            const char* last = value.data() + value.size();
+
+            if (flag == "-t")
+            {
+                double secs = 0;
+                auto [end, ec] = std::from_chars(first, last, secs);
+                if (ec != std::errc {} || end != last || secs <= 0)
+                {
+                    return false;
+                }
+                limits.timeout = std::max(
+                    std::chrono::milliseconds {1},
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::duration<double>(secs)));
+                return true;
+            }
+
+            if (flag == "-m" || flag == "-o")
+            {
+                auto size = util::parse_size(value);
+                if (!size || *size == 0)
+                {
+                    return false;
+                }
+                (flag == "-m" ? limits.address_space : limits.max_output) = *size;
+                return true;
+            }
+
+            if (flag == "-c" || flag == "-n")
+            {
+                rlim_t count = 0;
+                auto [end, ec] = std::from_chars(first, last, count);
+                if (ec != std::errc {} || end != last || count == 0)
+                {
+                    return false;
+                }
+                (flag == "-c" ? limits.cpu_seconds : limits.open_files) = count;
+                return true;
+            }
+
+            return false;
+        }
+
+        command::CommandResult builtin_limit(command::Command& cmd,
+                                             shell::NullShell& sh,
+                                             [[maybe_unused]] io::OutputSink& out,
+                                             io::OutputSink& err)
+        {
+            constexpr std::string_view USAGE =
+                "limit: usage: limit [-t secs] [-c secs] [-m size] [-n files] [-o size] "
+                "command [args...]\n";
+
+            io::Limits limits {};
+            std::size_t i = 0;
+            for (; i < cmd.args.size(); ++i)
+            {
+                std::string_view flag = cmd.args[i];
+                if (flag == "--")
+                {
+                    ++i;
+                    break;
+                }
+                if (flag.size() != 2 || flag[0] != '-')
+                {
+                    break;
+                }
+                if (std::string_view("tcmno").find(flag[1]) == std::string_view::npos)
+                {
+                    err.print("limit: {}: unknown option\n", flag);
+                    return {.return_code = shell::EXIT_USAGE};
+                }
+                if (i + 1 == cmd.args.size())
+                {
+                    err.print("limit: {}: missing value\n", flag);
+                    return {.return_code = shell::EXIT_USAGE};
+                }
+                if (!parse_limit(flag, cmd.args[i + 1], limits))
+                {
+                    err.print("limit: {}: invalid value '{}'\n", flag, cmd.args[i + 1]);
+                    return {.return_code = shell::EXIT_USAGE};
+                }
+                ++i;
+            }
+
+            if (i == cmd.args.size())
+            {
+                err.write(USAGE);
+                return {.return_code = shell::EXIT_USAGE};
+            }
+
+            // the limited command takes over the operators of the whole line
+            auto name = cmd.args.begin() + static_cast<std::ptrdiff_t>(i);
+            command::Command inner {.type = command::CommandType::External,
+                                    .name = std::string(*name),
+                                    .args = {name + 1, cmd.args.end()},
+                                    .ops = cmd.ops};
+            if (is_builtin(inner.name) && !is_utility(inner.name))
+            {
+                err.print("limit: {}: only external commands can be limited\n", inner.name);
+                return {.return_code = shell::EXIT_USAGE};
+            }
+
+            // the child routes its own output, the result carries whatever it captured
+            auto opts = sh.exec_options();
+            opts.limits = limits;
+            return executor::exec_external(inner, opts);
+        }
+
+        // results that depend on more than the key: launch failures, timeouts and signals
+        bool memoizable(const command::CommandResult& res)
+        {
+            return res.return_code < shell::EXIT_TIMEOUT;
+        }
+
+        command::CommandResult builtin_memo(command::Command& cmd,
+                                            shell::NullShell& sh,
+                                            io::OutputSink& out,
+                                            io::OutputSink& err)
+        {
+            constexpr std::string_view USAGE =
+                "memo: usage: memo [-d file] [-c file] [-e name] command [args...] | memo [-r]\n";
+
+            auto& cache = sh.memo();
+            if (cmd.args.empty())
+            {
+                auto stats = cache.stats();
+                out.print("memo: {} entries, {} of {} bytes, {} hits, {} misses\n",
+                          stats.entries,
+                          stats.bytes,
+                          cache.capacity(),
+                          stats.hits,
+                          stats.misses);
+                return {.return_code = 0};
+            }
+            if (cmd.args.size() == 1 && cmd.args[0] == "-r")
+            {
+                cache.clear();
+                return {.return_code = 0};
+            }
+
+            // the key holds what the output may depend on: cwd, then the chosen variables and
+            // files, then argv
+            std::array<char, PATH_MAX> cwd {};
+            if (getcwd(cwd.data(), cwd.size()) == nullptr)
+            {
+                err.print("memo: {}\n", std::strerror(errno));
+                return {.return_code = 1};
+            }
+            memo::KeyBuilder key;
+            key.add(cwd.data());
+
+            const auto& vars = sh.variables();
+            std::size_t i = 0;
+            for (; i < cmd.args.size(); ++i)
+            {
+                std::string_view flag = cmd.args[i];
+                if (flag == "--")
+                {
+                    ++i;
+                    break;
+                }
+                if (flag.size() != 2 || flag[0] != '-')
+                {
+                    break;
+                }
+                if (std::string_view("dce").find(flag[1]) == std::string_view::npos)
+                {
+                    err.print("memo: {}: unknown option\n", flag);
+                    return {.return_code = shell::EXIT_USAGE};
+                }
+                if (i + 1 == cmd.args.size())
+                {
+                    err.print("memo: {}: missing value\n", flag);
+                    return {.return_code = shell::EXIT_USAGE};
+                }
+
+                std::string value {cmd.args[++i]};
+                key.add(flag);
+                if (flag == "-e")
+                {
+                    // the command only sees exported variables
+                    key.add_var(value, vars.exported(value) ? vars.get(value) : std::nullopt);
+                }
+                else if (flag == "-d")
+                {
+                    key.add_stamp(value);
+                }
+                else if (auto hashed = key.add_digest(value); !hashed)
+                {
+                    err.print("memo: {}: {}\n", value, hashed.error());
+                    return {.return_code = 1};
+                }
+            }
+
+            if (i == cmd.args.size())
+            {
+                err.write(USAGE);
+                return {.return_code = shell::EXIT_USAGE};
+            }
+
+            auto name = cmd.args.begin() + static_cast<std::ptrdiff_t>(i);
+            command::Command inner {.type = command::CommandType::External,
+                                    .name = std::string(*name),
+                                    .args = {name + 1, cmd.args.end()},
+                                    .ops = cmd.ops};
+            if (is_builtin(inner.name) && !is_utility(inner.name))
+            {
+                err.print("memo: {}: only external commands can be memoized\n", inner.name);
+                return {.return_code = shell::EXIT_USAGE};
+            }
+            for (; name != cmd.args.end(); ++name)
+            {
+                key.add(*name);
+            }
+
+            // a hit is written like a builtin's output, where the operators route it
+            auto memo_key = key.take();
+            if (auto res = cache.lookup(memo_key))
+            {
+                out.write(res->stdout_data);
+                out.flush();
+                err.write(res->stderr_data);
+                err.flush();
+                return {.return_code = res->return_code};
+            }
+
+            // the whole output is kept, streams the operators print are still shown live
+            auto opts = sh.exec_options();
+            opts.retain_output = true;
+            auto res = executor::exec_external(inner, opts);
+            if (memoizable(res))
+            {
+                cache.store(std::move(memo_key), res);
+            }
+            return res;
+        }
+
+        command::CommandResult builtin_source(command::Command& cmd,
+                                              shell::NullShell& sh,
+                                              io::OutputSink& out,
+                                              io::OutputSink& err)
+        {
+            if (cmd.args.size() != 1)
+            {
+                err.write("source: usage: source file\n");
+                return {.return_code = shell::EXIT_USAGE};
+            }
+
+            // the script's commands print their own output
+            out.flush();
+            err.flush();
+
+            auto home = sh.variables().get("HOME");
+            auto rc = sh.source(util::expand_user_path(cmd.args[0], home).string());
+            if (!rc)
+            {
+                err.print("source: {}: {}\n", cmd.args[0], rc.error());
+                return {.return_code = 1};
+            }
+            return {.return_code = *rc};
+        }
+
+        // runs the program a builtin stands in for, for the options it leaves to it
+        command::CommandResult run_program(command::Command& cmd,
+                                           shell::NullShell& sh,
+                                           io::OutputSink& out,
+                                           io::OutputSink& err)
         {
-            return entry->second(cmd, sh);
+            out.flush();
+            err.flush();
+            return executor::exec_external(cmd, sh.exec_options());
         }
 
-        return {.return_code = shell::EXIT_CMD_NOT_FOUND,
-                .stdout_data = "",
-                .stderr_data = "not a builtin"};
+        command::CommandResult builtin_true([[maybe_unused]] command::Command& cmd,
+                                            [[maybe_unused]] shell::NullShell& sh,
+                                            [[maybe_unused]] io::OutputSink& out,
+                                            [[maybe_unused]] io::OutputSink& err)
+        {
+            return {.return_code = 0};
+        }
+
+        command::CommandResult builtin_false([[maybe_unused]] command::Command& cmd,
+                                             [[maybe_unused]] shell::NullShell& sh,
+                                             [[maybe_unused]] io::OutputSink& out,
+                                             [[maybe_unused]] io::OutputSink& err)
+        {
+            return {.return_code = 1};
+        }
+
+        // thrown while evaluating a `test` expression, which then exits with 2
+        struct TestError
+        {
+            std::string message;
+        };
+
+        /**
+         * @brief Evaluates a `test` or `[` expression the way coreutils does
+         *
+         * Up to four arguments follow the POSIX rules by argument count. Longer expressions
+         * are parsed with `!`, `-a`, `-o` and parentheses, `-a` binding tighter than `-o`.
+         * Arguments are NUL-terminated in the ArgBlock, so they are passed to stat() as is.
+         */
+        class TestExpr
+        {
+          public:
+            explicit TestExpr(const command::ArgBlock& args) : args_(args) {}
+
+            bool eval(std::size_t first, std::size_t last)
+            {
+                switch (last - first)
+                {
+                    case 0:
+                        return false;
+                    case 1:
+                        return !args_[first].empty();
+                    case 2:
+                        if (args_[first] == "!")
+                        {
+                            return args_[first + 1].empty();
+                        }
+                        if (is_flag(args_[first]))
+                        {
+                            return unary(args_[first], args_[first + 1]);
+                        }
+                        throw TestError {
+                            std::format("missing argument after '{}'", args_[last - 1])};
+                    case 3:
+                        if (is_binary(args_[first + 1]) || args_[first + 1] == "-a" ||
+                            args_[first + 1] == "-o")
+                        {
+                            return binary(args_[first], args_[first + 1], args_[first + 2]);
+                        }
+                        if (args_[first] == "!")
+                        {
+                            return !eval(first + 1, last);
+                        }
+                        if (args_[first] == "(" && args_[first + 2] == ")")
+                        {
+                            return !args_[first + 1].empty();
+                        }
+                        throw TestError {
+                            std::format("'{}': binary operator expected", args_[first + 1])};
+                    case 4:
+                        if (args_[first] == "!")
+                        {
+                            return !eval(first + 1, last);
+                        }
+                        if (args_[first] == "(" && args_[first + 3] == ")")
+                        {
+                            return eval(first + 1, last - 1);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+
+                pos_ = first;
+                end_ = last;
+                bool value = any();
+                if (pos_ != end_)
+                {
+                    throw TestError {std::format("extra argument '{}'", args_[pos_])};
+                }
+                return value;
+            }
+
+          private:
+            static bool is_flag(std::string_view arg)
+            {
+                return arg.size() == 2 && arg[0] == '-';
+            }
+
+            static bool is_unary(std::string_view arg)
+            {
+                return is_flag(arg) && std::string_view("bcdefgGhkLnOprsStuwxz").contains(arg[1]);
+            }
+
+            // binary operators other than -a and -o, which join expressions
+            static bool is_binary(std::string_view arg)
+            {
+                static constexpr std::array<std::string_view, 14> OPS = {
+                    "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt",
+                    "-le", "-gt", "-ge", "-nt", "-ot", "-ef"};
+                return std::ranges::find(OPS, arg) != OPS.end();
+            }
+
+            static auto integer(std::string_view text) -> std::intmax_t
+            {
+                constexpr std::string_view SPACE = " \t\n\v\f\r";
+                auto trimmed = text;
+                trimmed.remove_prefix(std::min(trimmed.find_first_not_of(SPACE), trimmed.size()));
+                trimmed.remove_suffix(trimmed.size() - (trimmed.find_last_not_of(SPACE) + 1));
+                if (trimmed.starts_with('+'))
+                {
+                    trimmed.remove_prefix(1);
+                }
+
+                std::intmax_t value = 0;
+                const char* last = trimmed.data() + trimmed.size();
+                auto [end, ec] = std::from_chars(trimmed.data(), last, value);
+                if (trimmed.empty() || ec != std::errc {} || end != last)
+                {
+                    throw TestError {std::format("invalid integer '{}'", text)};
+                }
+                return value;
+            }
+
+            static bool unary(std::string_view op, std::string_view operand)
+            {
+                const char* path = operand.data();
+                switch (op[1])
+                {
+                    case 'n':
+                        return !operand.empty();
+                    case 'z':
+                        return operand.empty();
+                    case 't':
+                        return isatty(static_cast<int>(integer(operand))) == 1;
+                    case 'r':
+                        return faccessat(AT_FDCWD, path, R_OK, AT_EACCESS) == 0;
+                    case 'w':
+                        return faccessat(AT_FDCWD, path, W_OK, AT_EACCESS) == 0;
+                    case 'x':
+                        return faccessat(AT_FDCWD, path, X_OK, AT_EACCESS) == 0;
+                    default:
+                        break;
+                }
+
+                struct stat st {};
+                bool link = op[1] == 'h' || op[1] == 'L';
+                if ((link ? lstat(path, &st) : stat(path, &st)) != 0)
+                {
+                    return false;
+                }
+                switch (op[1])
+                {
+                    case 'b':
+                        return S_ISBLK(st.st_mode);
+                    case 'c':
+                        return S_ISCHR(st.st_mode);
+                    case 'd':
+                        return S_ISDIR(st.st_mode);
+                    case 'e':
+                        return true;
+                    case 'f':
+                        return S_ISREG(st.st_mode);
+                    case 'g':
+                        return (st.st_mode & S_ISGID) != 0;
+                    case 'G':
+                        return st.st_gid == getegid();
+                    case 'h':
+                    case 'L':
+                        return S_ISLNK(st.st_mode);
+                    case 'k':
+                        return (st.st_mode & S_ISVTX) != 0;
+                    case 'O':
+                        return st.st_uid == geteuid();
+                    case 'p':
+                        return S_ISFIFO(st.st_mode);
+                    case 's':
+                        return st.st_size > 0;
+                    case 'S':
+                        return S_ISSOCK(st.st_mode);
+                    case 'u':
+                        return (st.st_mode & S_ISUID) != 0;
+                    default:
+                        throw TestError {std::format("'{}': unary operator expected", op)};
+                }
+            }
+
+            static bool binary(std::string_view lhs, std::string_view op, std::string_view rhs)
+            {
+                if (op == "=" || op == "==")
+                {
+                    return lhs == rhs;
+                }
+                if (op == "!=")
+                {
+                    return lhs != rhs;
+                }
+                if (op == "<" || op == ">")
+                {
+                    return op == "<" ? lhs < rhs : lhs > rhs;
+                }
+                if (op == "-a" || op == "-o")
+                {
+                    return op == "-a" ? !lhs.empty() && !rhs.empty()
+                                      : !lhs.empty() || !rhs.empty();
+                }
+                if (op == "-nt" || op == "-ot" || op == "-ef")
+                {
+                    return compare_files(lhs, op, rhs);
+                }
+
+                auto left = integer(lhs);
+                auto right = integer(rhs);
+                if (op == "-eq")
+                {
+                    return left == right;
+                }
+                if (op == "-ne")
+                {
+                    return left != right;
+                }
+                if (op == "-lt")
+                {
+                    return left < right;
+                }
+                if (op == "-le")
+                {
+                    return left <= right;
+                }
+                if (op == "-gt")
+                {
+                    return left > right;
+                }
+                return left >= right;
+            }
+
+            // -nt and -ot compare modification times, a missing file is older than any other
+            static bool compare_files(std::string_view lhs,
+                                      std::string_view op,
+                                      std::string_view rhs)
+            {
+                struct stat left {};
+                struct stat right {};
+                bool has_left = stat(lhs.data(), &left) == 0;
+                bool has_right = stat(rhs.data(), &right) == 0;
+                if (op == "-ef")
+                {
+                    return has_left && has_right && left.st_dev == right.st_dev &&
+                           left.st_ino == right.st_ino;
+                }
+
+                if (op == "-ot")
+                {
+                    std::swap(left, right);
+                    std::swap(has_left, has_right);
+                }
+                if (!has_left || !has_right)
+                {
+                    return has_left;
+                }
+                return std::tie(left.st_mtim.tv_sec, left.st_mtim.tv_nsec) >
+                       std::tie(right.st_mtim.tv_sec, right.st_mtim.tv_nsec);
+            }
+
+            // the argument that is missing, for the error message
+            [[noreturn]] void missing() const
+            {
+                throw TestError {std::format("missing argument after '{}'", args_[end_ - 1])};
+            }
+
+            // expr: and ("-o" and)*
+            bool any()
+            {
+                bool value = all();
+                while (pos_ < end_ && args_[pos_] == "-o")
+                {
+                    ++pos_;
+                    bool rhs = all();
+                    value = value || rhs;
+                }
+                return value;
+            }
+
+            // and: term ("-a" term)*
+            bool all()
+            {
+                bool value = term();
+                while (pos_ < end_ && args_[pos_] == "-a")
+                {
+                    ++pos_;
+                    bool rhs = term();
+                    value = value && rhs;
+                }
+                return value;
+            }
+
+            // term: "!" term | "(" expr ")" | arg binop arg | unop arg | arg
+            bool term()
+            {
+                if (pos_ >= end_)
+                {
+                    missing();
+                }
+
+                std::string_view arg = args_[pos_];
+                if (arg == "!")
+                {
+                    ++pos_;
+                    return !term();
+                }
+                if (arg == "(")
+                {
+                    ++pos_;
+                    if (pos_ >= end_)
+                    {
+                        missing();
+                    }
+                    bool value = any();
+                    if (pos_ >= end_)
+                    {
+                        throw TestError {"')' expected"};
+                    }
+                    if (args_[pos_] != ")")
+                    {
+                        throw TestError {std::format("')' expected, found '{}'", args_[pos_])};
+                    }
+                    ++pos_;
+                    return value;
+                }
+                if (pos_ + 2 < end_ && is_binary(args_[pos_ + 1]))
+                {
+                    pos_ += 3;
+                    return binary(arg, args_[pos_ - 2], args_[pos_ - 1]);
+                }
+                if (is_unary(arg))
+                {
+                    if (pos_ + 1 >= end_)
+                    {
+                        missing();
+                    }
+                    pos_ += 2;
+                    return unary(arg, args_[pos_ - 1]);
+                }
+                ++pos_;
+                return !arg.empty();
+            }
+
+            const command::ArgBlock& args_;
+            std::size_t pos_ {0};
+            std::size_t end_ {0};
+        };
+
+        command::CommandResult builtin_test(command::Command& cmd,
+                                            [[maybe_unused]] shell::NullShell& sh,
+                                            [[maybe_unused]] io::OutputSink& out,
+                                            io::OutputSink& err)
+        {
+            std::size_t last = cmd.args.size();
+            if (cmd.name == "[")
+            {
+                if (cmd.args.empty() || cmd.args.back() != "]")
+                {
+                    err.write("[: missing ']'\n");
+                    return {.return_code = 2};
+                }
+                --last;
+            }
+
+            try
+            {
+                return {.return_code = TestExpr(cmd.args).eval(0, last) ? 0 : 1};
+            }
+            catch (const TestError& e)
+            {
+                err.print("{}: {}\n", cmd.name, e.message);
+                return {.return_code = 2};
+            }
+        }
+
+        // a conversion of a `printf` format, e.g. "%-8.3s"
+        struct Conversion
+        {
+            std::size_t end {0};    // just past the conversion character
+            std::string_view flags; // any of "-+ #0"
+            std::string_view width; // digits or "*"
+            std::string_view precision;
+            bool has_precision {false};
+            char type {'\0'};
+        };
+
+        // parses the conversion starting at the '%' at pos, nullopt when it is malformed
+        auto parse_conversion(std::string_view fmt, std::size_t pos) -> std::optional<Conversion>
+        {
+            Conversion conv {};
+            auto span = [&fmt, &pos](std::string_view chars)
+            {
+                std::size_t start = pos;
+                while (pos < fmt.size() && chars.contains(fmt[pos]))
+                {
+                    ++pos;
+                }
+                return fmt.substr(start, pos - start);
+            };
+
+            ++pos;
+            conv.flags = span("-+ #0");
+            conv.width = pos < fmt.size() && fmt[pos] == '*' ? fmt.substr(pos++, 1)
+                                                             : span("0123456789");
+            if (pos < fmt.size() && fmt[pos] == '.')
+            {
+                ++pos;
+                conv.has_precision = true;
+                conv.precision = pos < fmt.size() && fmt[pos] == '*' ? fmt.substr(pos++, 1)
+                                                                     : span("0123456789");
+            }
+            span("hlLqjzt"); // length modifiers are accepted and ignored, like coreutils does
+
+            if (pos >= fmt.size() || !std::string_view("diouxXfFeEgGaAcsb").contains(fmt[pos]))
+            {
+                return std::nullopt;
+            }
+            conv.type = fmt[pos];
+            conv.end = pos + 1;
+            return conv;
+        }
+
+        // a decoded backslash escape
+        struct Escape
+        {
+            char value {'\\'};
+            std::size_t length {1}; // bytes of the escape, backslash included
+            bool stop {false};      // \c: no further output at all
+        };
+
+        // value of ch as a digit in base 8 or 16, -1 if it is not one
+        int digit_value(char ch, unsigned base)
+        {
+            if (ch >= '0' && ch <= '7')
+            {
+                return ch - '0';
+            }
+            if (base == 16)
+            {
+                if (ch >= '8' && ch <= '9')
+                {
+                    return ch - '0';
+                }
+                char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+                if (lower >= 'a' && lower <= 'f')
+                {
+                    return lower - 'a' + 10;
+                }
+            }
+            return -1;
+        }
+
+        // decodes the escape at text[0] == '\\', %b arguments spell octal escapes as \0NNN
+        auto decode_escape(std::string_view text, bool octal_zero) -> Escape
+        {
+            if (text.size() < 2)
+            {
+                return {};
+            }
+
+            auto digits = [&text](std::size_t start, std::size_t max, unsigned base) -> Escape
+            {
+                unsigned value = 0;
+                std::size_t end = start;
+                for (; end < text.size() && end < start + max; ++end)
+                {
+                    int digit = digit_value(text[end], base);
+                    if (digit < 0)
+                    {
+                        break;
+                    }
+                    value = value * base + static_cast<unsigned>(digit);
+                }
+                return {.value = static_cast<char>(value), .length = end, .stop = false};
+            };
+
+            switch (text[1])
+            {
+                case 'a':
+                    return {.value = '\a', .length = 2};
+                case 'b':
+                    return {.value = '\b', .length = 2};
+                case 'c':
+                    return {.value = '\0', .length = 2, .stop = true};
+                case 'e':
+                    return {.value = '\x1b', .length = 2};
+                case 'f':
+                    return {.value = '\f', .length = 2};
+                case 'n':
+                    return {.value = '\n', .length = 2};
+                case 'r':
+                    return {.value = '\r', .length = 2};
+                case 't':
+                    return {.value = '\t', .length = 2};
+                case 'v':
+                    return {.value = '\v', .length = 2};
+                case '\\':
+                    return {.value = '\\', .length = 2};
+                case '"':
+                    return {.value = '"', .length = 2};
+                case 'x':
+                    if (text.size() > 2 && digit_value(text[2], 16) >= 0)
+                    {
+                        return digits(2, 2, 16);
+                    }
+                    return {};
+                default:
+                    break;
+            }
+
+            if (octal_zero && text[1] == '0')
+            {
+                return digits(2, 3, 8);
+            }
+            if (text[1] >= '0' && text[1] <= '7')
+            {
+                return digits(1, 3, 8);
+            }
+            return {};
+        }
+
+        /**
+         * @brief One run of `printf`, the format is reused until the arguments run out
+         *
+         * Numbers go through snprintf() with the conversion rebuilt for intmax_t or long double.
+         * Strings are padded here, so they may hold NUL bytes.
+         */
+        class Printf
+        {
+          public:
+            Printf(const command::ArgBlock& args, io::OutputSink& out, io::OutputSink& err)
+                : args_(args), out_(out), err_(err)
+            {
+            }
+
+            // whether every conversion in fmt is one handled here
+            static bool supported(std::string_view fmt)
+            {
+                for (auto pos = fmt.find('%'); pos != std::string_view::npos;
+                     pos = fmt.find('%', pos))
+                {
+                    if (fmt.substr(pos, 2) == "%%")
+                    {
+                        pos += 2;
+                        continue;
+                    }
+                    auto conv = parse_conversion(fmt, pos);
+                    if (!conv)
+                    {
+                        return false;
+                    }
+                    pos = conv->end;
+                }
+                return true;
+            }
+
+            int run()
+            {
+                std::string_view fmt = args_[0];
+                next_ = 1;
+                while (true)
+                {
+                    std::size_t start = next_;
+                    if (!apply(fmt) || next_ == start || next_ >= args_.size())
+                    {
+                        break;
+                    }
+                }
+                return status_;
+            }
+
+          private:
+            // applies the format once, false once \c stopped all output
+            bool apply(std::string_view fmt)
+            {
+                std::size_t pos = 0;
+                while (pos < fmt.size())
+                {
+                    auto special = fmt.find_first_of("\\%", pos);
+                    // the format lives in the ArgBlock, literal text is written in place
+                    out_.write(fmt.substr(pos, special - pos));
+                    if (special == std::string_view::npos)
+                    {
+                        break;
+                    }
+
+                    pos = special;
+                    if (fmt[pos] == '\\')
+                    {
+                        auto esc = decode_escape(fmt.substr(pos), false);
+                        if (esc.stop)
+                        {
+                            return false;
+                        }
+                        out_.put(esc.value);
+                        pos += esc.length;
+                    }
+                    else if (fmt.substr(pos, 2) == "%%")
+                    {
+                        out_.put('%');
+                        pos += 2;
+                    }
+                    else
+                    {
+                        // checked by supported() before the first pass
+                        auto conv = parse_conversion(fmt, pos).value();
+                        if (!convert(conv))
+                        {
+                            return false;
+                        }
+                        pos = conv.end;
+                    }
+                }
+                return true;
+            }
+
+            // the next argument, empty once they ran out
+            auto next() -> std::string_view
+            {
+                return next_ < args_.size() ? args_[next_++] : std::string_view {};
+            }
+
+            // a count from the format, or from the next argument for "*"; nullopt and status 1
+            // when it does not fit an int
+            auto count(std::string_view spec, std::string_view what) -> std::optional<int>
+            {
+                std::intmax_t value = 0;
+                if (spec == "*")
+                {
+                    spec = next();
+                    value = number<std::intmax_t>(spec);
+                }
+                else
+                {
+                    auto [end, ec] = std::from_chars(spec.data(), spec.data() + spec.size(), value);
+                    if (ec != std::errc {})
+                    {
+                        value = INTMAX_MAX;
+                    }
+                }
+                if (value < INT_MIN || value > INT_MAX)
+                {
+                    fail(spec, what);
+                    return std::nullopt;
+                }
+                return static_cast<int>(value);
+            }
+
+            bool convert(const Conversion& conv)
+            {
+                auto width =
+                    conv.width.empty() ? std::nullopt : count(conv.width, "invalid field width");
+                auto precision =
+                    conv.has_precision ? count(conv.precision, "invalid precision") : std::nullopt;
+                if (precision && *precision < 0)
+                {
+                    precision.reset();
+                }
+
+                switch (conv.type)
+                {
+                    case 's':
+                        pad(next(), conv, width, precision);
+                        return true;
+                    case 'c':
+                    {
+                        auto arg = next();
+                        pad(arg.empty() ? std::string_view("", 1) : arg.substr(0, 1),
+                            conv,
+                            width,
+                            std::nullopt);
+                        return true;
+                    }
+                    case 'b':
+                    {
+                        std::string text;
+                        bool stopped = expand(next(), text);
+                        pad(text, conv, width, precision);
+                        return !stopped;
+                    }
+                    case 'd':
+                    case 'i':
+                        numeric(conv, width, precision, 'j', number<std::intmax_t>(next()));
+                        return true;
+                    case 'o':
+                    case 'u':
+                    case 'x':
+                    case 'X':
+                        numeric(conv, width, precision, 'j', number<std::uintmax_t>(next()));
+                        return true;
+                    default:
+                        numeric(conv, width, precision, 'L', number<long double>(next()));
+                        return true;
+                }
+            }
+
+            // %b: the argument with its escapes decoded, true if it ended with \c
+            static bool expand(std::string_view arg, std::string& text)
+            {
+                for (std::size_t pos = 0; pos < arg.size();)
+                {
+                    if (arg[pos] != '\\')
+                    {
+                        text += arg[pos++];
+                        continue;
+                    }
+                    auto esc = decode_escape(arg.substr(pos), true);
+                    if (esc.stop)
+                    {
+                        return true;
+                    }
+                    text += esc.value;
+                    pos += esc.length;
+                }
+                return false;
+            }
+
+            // writes text with the conversion's width and precision, "-" pads on the right
+            void pad(std::string_view text,
+                     const Conversion& conv,
+                     std::optional<int> width,
+                     std::optional<int> precision)
+            {
+                if (precision && static_cast<std::size_t>(*precision) < text.size())
+                {
+                    text = text.substr(0, static_cast<std::size_t>(*precision));
+                }
+
+                bool left = conv.flags.contains('-') || (width && *width < 0);
+                // negated as unsigned, -INT_MIN does not fit an int
+                std::size_t fill = 0;
+                if (width)
+                {
+                    auto magnitude = static_cast<unsigned>(*width);
+                    fill = *width < 0 ? 0U - magnitude : magnitude;
+                }
+                fill = fill > text.size() ? fill - text.size() : 0;
+                if (!left)
+                {
+                    spaces(fill);
+                }
+                out_.copy(text);
+                if (left)
+                {
+                    spaces(fill);
+                }
+            }
+
+            void spaces(std::size_t count)
+            {
+                constexpr std::string_view BLANKS = "                                ";
+                for (; count > 0; count -= std::min(count, BLANKS.size()))
+                {
+                    out_.write(BLANKS.substr(0, std::min(count, BLANKS.size())));
+                }
+            }
+
+            // formats one number with snprintf(), the conversion rebuilt for the value's type
+            template <typename T>
+            void numeric(const Conversion& conv,
+                         std::optional<int> width,
+                         std::optional<int> precision,
+                         char length,
+                         T value)
+            {
+                std::array<char, 48> spec {};
+                char* it = spec.data();
+                char* end = spec.data() + spec.size() - 3; // room for length, type and NUL
+                *it++ = '%';
+                // repeated flags mean nothing, a few are enough
+                it = std::ranges::copy(conv.flags.substr(0, 8), it).out;
+                if (width)
+                {
+                    it = std::to_chars(it, end, *width).ptr;
+                }
+                if (precision)
+                {
+                    *it++ = '.';
+                    it = std::to_chars(it, end, *precision).ptr;
+                }
+                *it++ = length;
+                *it++ = conv.type;
+                *it = '\0';
+
+                std::array<char, 128> buf {};
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+                int size = std::snprintf(buf.data(), buf.size(), spec.data(), value);
+                if (size < 0)
+                {
+                    return;
+                }
+                if (static_cast<std::size_t>(size) < buf.size())
+                {
+                    out_.copy(std::string_view(buf.data(), static_cast<std::size_t>(size)));
+                    return;
+                }
+
+                // wider than the stack buffer, e.g. a large width
+                std::string wide(static_cast<std::size_t>(size) + 1, '\0');
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+                std::snprintf(wide.data(), wide.size(), spec.data(), value);
+                wide.pop_back();
+                out_.copy(wide);
+            }
+
+            // a numeric argument: C syntax, or a leading quote for the next character's code
+            template <typename T> auto number(std::string_view arg) -> T
+            {
+                if (arg.empty())
+                {
+                    return 0;
+                }
+                if ((arg[0] == '\'' || arg[0] == '"') && arg.size() > 1)
+                {
+                    return static_cast<T>(static_cast<unsigned char>(arg[1]));
+                }
+
+                // arguments are NUL-terminated in the ArgBlock
+                const char* text = arg.data();
+                char* end = nullptr;
+                errno = 0;
+                T value {};
+                if constexpr (std::is_same_v<T, std::intmax_t>)
+                {
+                    value = std::strtoimax(text, &end, 0);
+                }
+                else if constexpr (std::is_same_v<T, std::uintmax_t>)
+                {
+                    value = std::strtoumax(text, &end, 0);
+                }
+                else
+                {
+                    value = std::strtold(text, &end);
+                }
+
+                if (end == text)
+                {
+                    fail(arg, "expected a numeric value");
+                }
+                else if (errno == ERANGE)
+                {
+                    fail(arg, std::strerror(ERANGE));
+                }
+                else if (end != text + arg.size())
+                {
+                    fail(arg, "value not completely converted");
+                }
+                return value;
+            }
+
+            void fail(std::string_view arg, std::string_view reason)
+            {
+                out_.flush();
+                err_.print("printf: '{}': {}\n", arg, reason);
+                status_ = 1;
+            }
+
+            const command::ArgBlock& args_;
+            io::OutputSink& out_;
+            io::OutputSink& err_;
+            std::size_t next_ {1};
+            int status_ {0};
+        };
+
+        command::CommandResult builtin_printf(command::Command& cmd,
+                                              shell::NullShell& sh,
+                                              io::OutputSink& out,
+                                              io::OutputSink& err)
+        {
+            if (cmd.args.empty())
+            {
+                err.write("printf: missing operand\n");
+                return {.return_code = 1};
+            }
+            // options such as --help, and conversions like %q, are the program's
+            if (cmd.args[0].starts_with("--") || !Printf::supported(cmd.args[0]))
+            {
+                return run_program(cmd, sh, out, err);
+            }
+
+            return {.return_code = Printf(cmd.args, out, err).run()};
+        }
+
+        // a `sleep` operand in seconds: a non-negative number with an optional s, m, h or d
+        auto parse_interval(std::string_view text) -> std::optional<double>
+        {
+            constexpr std::string_view SUFFIXES = "smhd";
+            constexpr std::array<double, 4> SCALES {1, 60, 3600, 86400};
+
+            double scale = 1;
+            auto suffix = text.empty() ? std::string_view::npos : SUFFIXES.find(text.back());
+            if (suffix != std::string_view::npos)
+            {
+                scale = SCALES.at(suffix);
+                text.remove_suffix(1);
+            }
+
+            double secs = 0;
+            const char* last = text.data() + text.size();
+            auto [end, ec] = std::from_chars(text.data(), last, secs);
+            if (text.empty() || ec != std::errc {} || end != last || !(secs >= 0))
+            {
+                return std::nullopt;
+            }
+            return secs * scale;
+        }
+
+        /**
+         * @brief Sleeps on the shell's loop, so a ^C ends the sleep instead of waiting behind it
+         *
+         * @param loop The interactive shell's loop
+         * @param deadline CLOCK_MONOTONIC time to wake up at
+         * @return bool false if interrupted; true once past the deadline, or if the loop failed
+         */
+        bool sleep_on(io::EventLoop& loop, const timespec& deadline)
+        {
+            while (true)
+            {
+                timespec now {};
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                auto left = std::chrono::seconds(deadline.tv_sec - now.tv_sec) +
+                            std::chrono::nanoseconds(deadline.tv_nsec - now.tv_nsec);
+                auto wait_ms = std::chrono::ceil<std::chrono::milliseconds>(left).count();
+                if (wait_ms <= 0)
+                {
+                    return true;
+                }
+
+                auto ready = loop.wait(static_cast<int>(std::min<long>(wait_ms, INT_MAX)));
+                if (loop.take_interrupt() != io::Interrupt::None)
+                {
+                    return false;
+                }
+                if (!ready)
+                {
+                    return true; // the caller sleeps the rest
+                }
+            }
+        }
+
+        command::CommandResult builtin_sleep(command::Command& cmd,
+                                             shell::NullShell& sh,
+                                             [[maybe_unused]] io::OutputSink& out,
+                                             io::OutputSink& err)
+        {
+            if (cmd.args.empty())
+            {
+                err.write("sleep: missing operand\n");
+                return {.return_code = 1};
+            }
+
+            double total = 0;
+            int status = 0;
+            for (std::string_view arg : cmd.args)
+            {
+                auto secs = parse_interval(arg);
+                if (!secs)
+                {
+                    err.print("sleep: invalid time interval '{}'\n", arg);
+                    status = 1;
+                    continue;
+                }
+                total += *secs;
+            }
+            if (status != 0)
+            {
+                return {.return_code = status};
+            }
+
+            // an absolute deadline, so signals interrupting the sleep do not stretch it
+            constexpr double MAX_SLEEP = 1e9; // about 31 years, what "inf" comes down to
+            total = std::min(total, MAX_SLEEP);
+            auto whole = static_cast<time_t>(total);
+            timespec deadline {};
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += whole;
+            deadline.tv_nsec += static_cast<long>((total - static_cast<double>(whole)) * 1e9);
+            if (deadline.tv_nsec >= 1'000'000'000)
+            {
+                ++deadline.tv_sec;
+                deadline.tv_nsec -= 1'000'000'000;
+            }
+            if (auto* loop = sh.exec_options().loop; loop != nullptr && !sleep_on(*loop, deadline))
+            {
+                return {.return_code = shell::EXIT_SIGNAL_BASE + SIGINT};
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+            {
+            }
+            return {.return_code = 0};
+        }
+
+        command::CommandResult builtin_cat(command::Command& cmd,
+                                           shell::NullShell& sh,
+                                           io::OutputSink& out,
+                                           io::OutputSink& err)
+        {
+            // plain concatenation only, -n, -A and friends are the program's
+            bool options = true;
+            for (std::string_view arg : cmd.args)
+            {
+                if (arg == "--")
+                {
+                    break;
+                }
+                if (arg.size() > 1 && arg[0] == '-' && arg != "-u")
+                {
+                    return run_program(cmd, sh, out, err);
+                }
+            }
+
+            int input = sh.exec_options().stdin_fd >= 0 ? sh.exec_options().stdin_fd : STDIN_FILENO;
+            if (sh.exec_options().loop != nullptr && isatty(input) != 0)
+            {
+                // the shell blocks ^C, a read from the terminal would only end with ^D
+                return run_program(cmd, sh, out, err);
+            }
+            int status = 0;
+            auto copy = [&out, &err, &status](std::string_view name, int fd)
+            {
+                if (!out.copy_from(fd))
+                {
+                    int error = errno;
+                    err.print("cat: {}: {}\n", name, std::strerror(error));
+                    status = 1;
+                }
+            };
+
+            bool named = false;
+            for (std::string_view arg : cmd.args)
+            {
+                if (options && (arg == "--" || arg == "-u"))
+                {
+                    options = arg != "--";
+                    continue;
+                }
+                named = true;
+                if (arg == "-")
+                {
+                    copy(arg, input);
+                    continue;
+                }
+
+                // arguments are NUL-terminated in the ArgBlock
+                int fd = open(arg.data(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                {
+                    int error = errno;
+                    err.print("cat: {}: {}\n", arg, std::strerror(error));
+                    status = 1;
+                    continue;
+                }
+                copy(arg, fd);
+                close(fd);
+            }
+            if (!named)
+            {
+                copy("-", input);
+            }
+            return {.return_code = status};
+        }
+
+        command::CommandResult builtin_env(command::Command& cmd,
+                                           shell::NullShell& sh,
+                                           io::OutputSink& out,
+                                           io::OutputSink& err)
+        {
+            std::size_t i = 0;
+            bool clear = false;
+            for (; i < cmd.args.size(); ++i)
+            {
+                std::string_view arg = cmd.args[i];
+                if (arg == "-i" || arg == "-")
+                {
+                    clear = true;
+                    continue;
+                }
+                if (arg == "--")
+                {
+                    ++i;
+                    break;
+                }
+                if (arg.starts_with('-'))
+                {
+                    // -u, -C, -S and the rest are left to the program
+                    return run_program(cmd, sh, out, err);
+                }
+                break;
+            }
+
+            std::size_t first_var = i;
+            while (i < cmd.args.size() && cmd.args[i].find('=') != std::string_view::npos &&
+                   !cmd.args[i].starts_with('='))
+            {
+                ++i;
+            }
+            auto assignments =
+                std::ranges::subrange(cmd.args.begin() + static_cast<std::ptrdiff_t>(first_var),
+                                      cmd.args.begin() + static_cast<std::ptrdiff_t>(i));
+
+            // -i starts from nothing, otherwise the assignments go on top of the shell's
+            // exported variables for as long as the command runs
+            vars::VarTable empty;
+            auto& table = clear ? empty : sh.variables();
+            std::optional<vars::VarTable::Scope> scope;
+            if (clear)
+            {
+                for (std::string_view assignment : assignments)
+                {
+                    auto eq = assignment.find('=');
+                    empty.export_var(assignment.substr(0, eq), assignment.substr(eq + 1));
+                }
+            }
+            else
+            {
+                scope.emplace(table, assignments);
+            }
+
+            if (i == cmd.args.size())
+            {
+                // the environment strings are written in place
+                for (char* const* var = table.envp(); *var != nullptr; ++var)
+                {
+                    out.write(*var);
+                    out.put('\n');
+                }
+                // the sink may still point into the table, which the scope is about to change
+                out.flush();
+                return {.return_code = 0};
+            }
+
+            auto name = cmd.args.begin() + static_cast<std::ptrdiff_t>(i);
+            command::Command program {.type = command::CommandType::External,
+                                      .name = std::string(*name),
+                                      .args = {name + 1, cmd.args.end()},
+                                      .ops = cmd.ops};
+            auto opts = sh.exec_options();
+            opts.envp = table.envp();
+            out.flush();
+            err.flush();
+            return executor::exec_external(program, opts);
+        }
+
+        command::CommandResult builtin_export(command::Command& cmd,
+                                              shell::NullShell& sh,
+                                              io::OutputSink& out,
+                                              io::OutputSink& err)
+        {
+            auto& vars = sh.variables();
+            if (cmd.args.empty() || (cmd.args.size() == 1 && cmd.args[0] == "-p"))
+            {
+                // sorted and quoted, so the listing can be sourced again
+                std::vector<std::pair<std::string_view, std::string_view>> exported;
+                exported.reserve(vars.exported_count());
+                vars.for_each(
+                    [&exported](std::string_view name, std::string_view value, bool is_exported)
+                    {
+                        if (is_exported)
+                        {
+                            exported.emplace_back(name, value);
+                        }
+                    });
+                std::ranges::sort(exported);
+
+                for (auto [name, value] : exported)
+                {
+                    out.print("export {}='", name);
+                    for (auto quote = value.find('\''); quote != std::string_view::npos;
+                         quote = value.find('\''))
+                    {
+                        out.copy(value.substr(0, quote));
+                        out.write("'\\''");
+                        value.remove_prefix(quote + 1);
+                    }
+                    out.copy(value);
+                    out.write("'\n");
+                }
+                return {.return_code = 0};
+            }
+
+            int status = 0;
+            for (std::string_view arg : cmd.args)
+            {
+                auto eq = arg.find('=');
+                auto name = arg.substr(0, eq);
+                if (!vars::valid_name(name))
+                {
+                    err.print("export: '{}': not a valid identifier\n", arg);
+                    status = 1;
+                }
+                else if (eq == std::string_view::npos)
+                {
+                    vars.export_var(name);
+                }
+                else
+                {
+                    vars.export_var(name, arg.substr(eq + 1));
+                }
+            }
+            return {.return_code = status};
+        }
+
+        command::CommandResult builtin_unset(command::Command& cmd,
+                                             shell::NullShell& sh,
+                                             [[maybe_unused]] io::OutputSink& out,
+                                             io::OutputSink& err)
+        {
+            int status = 0;
+            for (std::string_view arg : cmd.args)
+            {
+                if (arg == "-v")
+                {
+                    continue;
+                }
+                if (!vars::valid_name(arg))
+                {
+                    err.print("unset: '{}': not a valid identifier\n", arg);
+                    status = 1;
+                    continue;
+                }
+                sh.variables().unset(arg);
+            }
+            return {.return_code = status};
+        }
+
+        // lines `history` shows without -n
+        constexpr std::size_t HISTORY_LINES = 20;
+
+        command::CommandResult builtin_history(command::Command& cmd,
+                                               shell::NullShell& sh,
+                                               io::OutputSink& out,
+                                               io::OutputSink& err)
+        {
+            auto* hist = sh.history();
+            if (hist == nullptr)
+            {
+                err.write("history: not enabled, start nullsh with --history <file>\n");
+                return {.return_code = 1};
+            }
+
+            std::size_t count = HISTORY_LINES;
+            std::size_t pos = 0;
+            if (cmd.args.size() >= 2 && cmd.args[0] == "-n")
+            {
+                std::string_view num = cmd.args[1];
+                const char* last = num.data() + num.size();
+                auto [end, ec] = std::from_chars(num.data(), last, count);
+                if (ec != std::errc {} || end != last)
+                {
+                    err.print("history: {}: invalid count\n", num);
+                    return {.return_code = 1};
+                }
+                pos = 2;
+            }
+            if (cmd.args.size() > pos + 1)
+            {
+                err.write("history: too many arguments\n");
+                return {.return_code = 1};
+            }
+
+            std::string_view prefix = cmd.args.size() > pos ? cmd.args[pos] : std::string_view {};
+
+            // oldest first, so the latest line ends up next to the prompt; the lines live as
+            // long as the history
+            for (std::string_view line : hist->search(prefix, count) | std::views::reverse)
+            {
+                out.write(line);
+                out.put('\n');
+            }
+            return {.return_code = 0};
+        }
+
+        // builtin dispatch table, laid out at compile time
+        constexpr auto BUILTINS = util::make_static_map<Handler>({
+            {"cd", &builtin_cd},          //
+            {"pwd", &builtin_pwd},        //
+            {"exit", &builtin_exit},      //
+            {"echo", &builtin_echo},      //
+            {"hash", &builtin_hash},      //
+            {"jobs", &builtin_jobs},      //
+            {"wait", &builtin_wait},      //
+            {"fg", &builtin_fg},          //
+            {"limit", &builtin_limit},    //
+            {"memo", &builtin_memo},      //
+            {"source", &builtin_source},  //
+            {".", &builtin_source},       //
+            {"true", &builtin_true},      //
+            {"false", &builtin_false},    //
+            {"test", &builtin_test},      //
+            {"[", &builtin_test},         //
+            {"printf", &builtin_printf},  //
+            {"sleep", &builtin_sleep},    //
+            {"cat", &builtin_cat},        //
+            {"env", &builtin_env},        //
+            {"export", &builtin_export},  //
+            {"unset", &builtin_unset},    //
+            {"history", &builtin_history} //
+        });
+
+        // builtins standing in for a program of the same name, which runs where a builtin can't
+        constexpr auto UTILITIES = util::make_static_map<bool>({
+            {"true", true},   //
+            {"false", true},  //
+            {"test", true},   //
+            {"[", true},      //
+            {"printf", true}, //
+            {"sleep", true},  //
+            {"cat", true},    //
+            {"env", true}     //
+        });
+    } // namespace
+
+    /**
+     * @brief Checks if a command is a built-in
+     *
+     * @param name Command name
+     * @return true if built-in, false otherwise
+     */
+    bool is_builtin(std::string_view name)
+    {
+        return BUILTINS.contains(name);
+    }
+
+    /**
+     * @brief Lists the built-in names, sorted
+     *
+     * @return std::vector<std::string_view> Names, in read-only data
+     */
+    auto names() -> std::vector<std::string_view>
+    {
+        std::vector<std::string_view> all;
+        all.reserve(BUILTINS.size());
+        BUILTINS.for_each_key([&all](std::string_view name) { all.push_back(name); });
+        std::ranges::sort(all);
+        return all;
+    }
+
+    /**
+     * @brief Checks if a built-in only stands in for a program of the same name
+     *
+     * Such builtins are run as the program where a builtin can't be: in the background, under
+     * `limit` or `memo`, or reading the output of an earlier pipeline stage.
+     *
+     * @param name Command name
+     * @return true if the builtin has a program counterpart, false otherwise
+     */
+    bool is_utility(std::string_view name)
+    {
+        return UTILITIES.contains(name);
+    }
+
+    /**
+     * @brief Runs a built-in command, writing its output into the given sinks
+     *
+     * The returned result carries the exit status. Only `limit` and `memo`, which run a child,
+     * fill in output and usage there as well.
+     *
+     * @param cmd Command to execute
+     * @param sh Shell context
+     * @param out Sink for stdout
+     * @param err Sink for stderr
+     * @return command::CommandResult Result of command execution
+     */
+    command::CommandResult run(command::Command& cmd,
+                               shell::NullShell& sh,
+                               io::OutputSink& out,
+                               io::OutputSink& err)
+    {
+        if (const Handler* handler = BUILTINS.find(cmd.name))
+        {
+            return (*handler)(cmd, sh, out, err);
+        }
+
+        err.write("not a builtin\n");
+        return {.return_code = shell::EXIT_CMD_NOT_FOUND};
+    }
+
+    /**
+     * @brief Executes a built-in command, capturing its output in the result
+     *
+     * @param cmd Command to execute
+     * @param sh Shell context
+     * @return command::CommandResult Result of command execution
+     */
+    command::CommandResult execute(command::Command& cmd, shell::NullShell& sh)
+    {
+        std::string out_data;
+        std::string err_data;
+        io::OutputSink out {out_data};
+        io::OutputSink err {err_data};
+
+        auto res = run(cmd, sh, out, err);
+        out.flush();
+        err.flush();
+        if (!out_data.empty())
+        {
+            res.stdout_data = std::move(out_data);
+        }
+        if (!err_data.empty())
+        {
+            res.stderr_data = std::move(err_data);
+        }
+        return res;
     }
 
 } // namespace nullsh::builtins
\ No newline at end of file
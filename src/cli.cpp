@@ -7,10 +7,12 @@
 
 #include "nullsh/cli.h"
 
+#include <unistd.h>
+
+#include <array>
 #include <format>
-#include <iostream>
+#include <string>
 #include <string_view>
-#include <vector>
 
 #include "nullsh/util.h"
 #include "nullsh/version.h"
@@ -31,7 +33,7 @@ namespace nullsh::cli
 Embrace the void. Execute with purpose.
 
 Usage:
-  nullsh [OPTIONS]
+  nullsh [OPTIONS] [SCRIPT]
 
 Options:
   -h, --help        Show this help message and exit
@@ -39,27 +41,69 @@ Options:
       --build-info  Show build info (compiler, flags, etc.)
   -c, --command     Execute a single command and exit
   -s, --spawn       Launch nullsh in a new terminal window
+      --spill-threshold <bytes[K|M|G]>
+                    Captured output kept in memory per stream before
+                    spilling to an anonymous file (default 16M)
+      --server <socket>
+                    Serve one-shot commands on a Unix socket
+      --client <socket>
+                    Run the -c command on a nullsh server
+      --history <file>
+                    Keep the interactive lines in file, searchable
+                    across sessions with 'history'
+      --memo-size <bytes[K|M|G]>
+                    Results 'memo' keeps in memory (default 64M)
+      --memo-dir <dir>
+                    Also keep 'memo' results in dir, across sessions
 
 Operators:
   !       Force output: print stdout and stderr
   ?       Silent run: suppress all output, even on failure
   $?      Return code: print numeric exit code of last command
   $$?     Verbose return code: exit code with success/failure note
+  $%      Resource usage: exit code, wall/CPU time, max RSS, faults
+          (minor/major) and context switches (voluntary/involuntary)
 
 Built-in Commands:
   cd [dir]      Change current directory
   pwd           Print current working directory
   echo [args]   Print arguments (silent without '!')
   exit [code]   Exit the shell
+  hash [-r|cmd] Show, clear (-r) or warm the command lookup cache
+  source file   Run the commands in file (also '.')
+  jobs          List background jobs started with '&'
+  wait [id...]  Wait for background jobs and show their output
+  fg [id]       Wait for a background job and show its output
+  limit [opts] cmd
+                Run cmd with limits: -t timeout secs, -c CPU secs,
+                -m memory, -n open files, -o captured output
+  export [NAME[=VALUE]...]
+                Export variables to commands (list them without args)
+  unset NAME... Remove variables
+  history [-n count] [prefix]
+                Show the latest lines starting with prefix
+  memo [opts] cmd
+                Run cmd once and replay its output while the key holds:
+                argv, cwd, -e variables, -d file times, -c file hashes
+  memo [-r]     Show or clear (-r) the memoized results
+  true, false, test, [, printf, sleep, cat, env
+                Run in the shell without forking, like coreutils
 
 Examples:
   nullsh                  Start interactive session
   nullsh -c 'ls /tmp !'   Execute command and exit
+  nullsh build.nsh        Run a script file and exit
+  nullsh --server /tmp/nullsh.sock
+                          Keep a warm shell serving clients
+  nullsh --client /tmp/nullsh.sock -c 'make ?'
+                          Run a command on that server
   nullsh --spawn          Launch in a new terminal window
 
 Notes:
 - Commands succeed silently by default; errors are shown.
 - Operators modify behavior or display return codes.
+- Commands can be piped with '|'; operators apply to the last stage.
+- A trailing '&' runs an external command in the background.
 )";
 
     constexpr std::string_view LICENSE_SHORT =
@@ -70,16 +114,16 @@ Notes:
 
     namespace
     {
-        const std::vector<std::string> TERMS = {
+        constexpr std::array<std::string_view, 6> TERMS = {
             "gnome-terminal", "konsole", "xfce4-terminal", "lxterminal", "alacritty", "xterm"};
 
         inline void spawn_terminal(CLI& cli)
         {
             for (const auto& term : TERMS)
             {
-                if (nullsh::util::command_exists(term))
+                std::string cmd {term};
+                if (nullsh::util::command_exists(cmd))
                 {
-                    std::string cmd = term;
 
                     if (term == "gnome-terminal" || term == "xfce4-terminal" ||
                         term == "lxterminal")
@@ -121,14 +165,65 @@ Notes:
                 }
                 cli.one_shot = args[++i];
             }
+            else if (arg == "--spill-threshold"sv)
+            {
+                if (args.size() <= i + 1)
+                {
+                    return std::unexpected("Missing argument to --spill-threshold");
+                }
+                cli.spill_threshold = util::parse_size(args[++i]);
+                if (!cli.spill_threshold)
+                {
+                    return std::unexpected(
+                        std::format("Invalid size for --spill-threshold: {}", args[i]));
+                }
+            }
+            else if (arg == "--server"sv || arg == "--client"sv)
+            {
+                if (args.size() <= i + 1)
+                {
+                    return std::unexpected(std::format("Missing argument to {}", arg));
+                }
+                (arg == "--server"sv ? cli.server : cli.client) = args[++i];
+            }
+            else if (arg == "--history"sv)
+            {
+                if (args.size() <= i + 1)
+                {
+                    return std::unexpected("Missing argument to --history");
+                }
+                cli.history = args[++i];
+            }
+            else if (arg == "--memo-size"sv)
+            {
+                if (args.size() <= i + 1)
+                {
+                    return std::unexpected("Missing argument to --memo-size");
+                }
+                cli.memo_size = util::parse_size(args[++i]);
+                if (!cli.memo_size)
+                {
+                    return std::unexpected(
+                        std::format("Invalid size for --memo-size: {}", args[i]));
+                }
+            }
+            else if (arg == "--memo-dir"sv)
+            {
+                if (args.size() <= i + 1)
+                {
+                    return std::unexpected("Missing argument to --memo-dir");
+                }
+                cli.memo_dir = args[++i];
+            }
             else if (arg == "-h"sv || arg == "--help"sv)
             {
-                std::cout << NULLSH_LOGO << "\n"
-                          << "NullShell (nullsh) v" << VERSION_STR << "\n"
-                          << LICENSE_SHORT << "\n"
-                          << "\n"
-                          << HELP_BODY << "\n"
-                          << LICENSE_DETAILS << "\n";
+                util::write_all(STDOUT_FILENO,
+                                std::format("{}\nNullShell (nullsh) v{}\n{}\n\n{}\n{}\n",
+                                            NULLSH_LOGO,
+                                            VERSION_STR,
+                                            LICENSE_SHORT,
+                                            HELP_BODY,
+                                            LICENSE_DETAILS));
                 std::exit(0);
             }
             else if (arg == "-s"sv || arg == "--spawn"sv)
@@ -141,31 +236,64 @@ Notes:
             }
             else if (arg == "-v"sv || arg == "--version"sv)
             {
-                std::cout << "NullShell version " << VERSION_STR << " (commit " << GIT_COMMIT
-                          << ")\n"
-                          << LICENSE_SHORT << "\n"
-                          << "Build type: " << BUILD_TYPE << "\n"
-                          << "Compiler: " << COMPILER_ID << " " << COMPILER_VERSION << "\n";
+                util::write_all(STDOUT_FILENO,
+                                std::format("NullShell version {} (commit {})\n{}\n"
+                                            "Build type: {}\nCompiler: {} {}\n",
+                                            VERSION_STR,
+                                            GIT_COMMIT,
+                                            LICENSE_SHORT,
+                                            BUILD_TYPE,
+                                            COMPILER_ID,
+                                            COMPILER_VERSION));
                 std::exit(0);
             }
             else if (arg == "--build-info")
             {
-                std::cout << "NullShell version " << VERSION_STR << " (commit " << GIT_COMMIT
-                          << ", branch " << GIT_BRANCH << ", tag " << GIT_TAG << ")\n"
-                          << LICENSE_SHORT << "\n"
-                          << "Build type:     " << BUILD_TYPE << "\n"
-                          << "Compiler:       " << COMPILER_ID << " " << COMPILER_VERSION << "\n"
-                          << "System:         " << SYSTEM_NAME << " (" << SYSTEM_PROCESSOR << ")\n"
-                          << "CMake version:  " << CMAKE_VERSION << "\n"
-                          << "Build timestamp:" << BUILD_TIMESTAMP << "\n";
+                util::write_all(STDOUT_FILENO,
+                                std::format("NullShell version {} (commit {}, branch {}, tag {})\n"
+                                            "{}\n"
+                                            "Build type:     {}\n"
+                                            "Compiler:       {} {}\n"
+                                            "System:         {} ({})\n"
+                                            "CMake version:  {}\n"
+                                            "Build timestamp:{}\n",
+                                            VERSION_STR,
+                                            GIT_COMMIT,
+                                            GIT_BRANCH,
+                                            GIT_TAG,
+                                            LICENSE_SHORT,
+                                            BUILD_TYPE,
+                                            COMPILER_ID,
+                                            COMPILER_VERSION,
+                                            SYSTEM_NAME,
+                                            SYSTEM_PROCESSOR,
+                                            CMAKE_VERSION,
+                                            BUILD_TIMESTAMP));
                 std::exit(0);
             }
+            else if (!arg.starts_with('-') && !cli.script)
+            {
+                cli.script = args[i];
+            }
+            else if (!arg.starts_with('-'))
+            {
+                return std::unexpected(std::format("Unexpected argument: {}", arg));
+            }
             else
             {
                 return std::unexpected(std::format("Unknown option: {}", arg));
             }
         }
 
+        if (cli.client && !cli.one_shot)
+        {
+            return std::unexpected("--client requires -c");
+        }
+        if (cli.server && cli.client)
+        {
+            return std::unexpected("--server and --client are mutually exclusive");
+        }
+
         return cli;
     }
 } // namespace nullsh::cli
\ No newline at end of file
@@ -7,13 +7,59 @@
 
 #include "nullsh/command.h"
 
+#include <algorithm>
+
 #include "nullsh/util.h"
 
 namespace nullsh::command
 {
+    namespace
+    {
+        auto to_micros(const timeval& tv) -> std::chrono::microseconds
+        {
+            return std::chrono::seconds {tv.tv_sec} + std::chrono::microseconds {tv.tv_usec};
+        }
+    } // namespace
+
+    Usage& Usage::operator+=(const Usage& other)
+    {
+        wall = std::max(wall, other.wall);
+        user += other.user;
+        system += other.system;
+        max_rss_kib = std::max(max_rss_kib, other.max_rss_kib);
+        minor_faults += other.minor_faults;
+        major_faults += other.major_faults;
+        voluntary_switches += other.voluntary_switches;
+        involuntary_switches += other.involuntary_switches;
+        return *this;
+    }
+
+    /**
+     * @brief Converts what wait4()/getrusage() report into a Usage, without wall time
+     */
+    auto to_usage(const rusage& ru) -> Usage
+    {
+        return {.wall = {},
+                .user = to_micros(ru.ru_utime),
+                .system = to_micros(ru.ru_stime),
+                .max_rss_kib = ru.ru_maxrss,
+                .minor_faults = ru.ru_minflt,
+                .major_faults = ru.ru_majflt,
+                .voluntary_switches = ru.ru_nvcsw,
+                .involuntary_switches = ru.ru_nivcsw};
+    }
+
     void sanitize_result(CommandResult& res)
     {
         util::newline(res.stdout_data);
         util::newline(res.stderr_data);
+
+        for (const auto& spill : {res.stdout_spill, res.stderr_spill})
+        {
+            if (spill && spill->size() > 0 && spill->back() != '\n')
+            {
+                spill->append("\n", 1);
+            }
+        }
     }
 } // namespace nullsh::command
\ No newline at end of file
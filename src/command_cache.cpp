@@ -0,0 +1,253 @@
+/**
+ * @file command_cache.cpp
+ * @brief Cache of command names resolved through PATH
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/command_cache.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+namespace nullsh::cache
+{
+    namespace
+    {
+        bool same_time(const timespec& lhs, const timespec& rhs)
+        {
+            return lhs.tv_sec == rhs.tv_sec && lhs.tv_nsec == rhs.tv_nsec;
+        }
+
+        timespec dir_mtime(const std::string& path)
+        {
+            struct stat st {};
+            if (stat(path.c_str(), &st) < 0)
+            {
+                return {};
+            }
+            return st.st_mtim;
+        }
+
+        // the search path execvp() falls back to when PATH is unset
+        const std::string& default_path()
+        {
+            static const std::string PATH = []
+            {
+                std::string path(confstr(_CS_PATH, nullptr, 0), '\0');
+                if (path.empty())
+                {
+                    return std::string("/bin:/usr/bin");
+                }
+                confstr(_CS_PATH, path.data(), path.size());
+                path.pop_back(); // the terminating NUL
+                return path;
+            }();
+            return PATH;
+        }
+    } // namespace
+
+    /**
+     * @brief Resolves a command name through PATH, the way execvp() would
+     *
+     * Results, misses included, are remembered until PATH changes or one of its directories
+     * is modified. The returned view stays valid until the next call on the cache.
+     *
+     * @param name Command name, without any '/'
+     * @return std::optional<std::string_view> Full path of the executable, if found
+     */
+    auto CommandCache::lookup(std::string_view name) -> std::optional<std::string_view>
+    {
+        validate();
+
+        if (!cacheable)
+        {
+            scratch = resolve(name);
+            return scratch.empty() ? std::nullopt : std::optional<std::string_view> {scratch};
+        }
+
+        auto it = entries.find(name);
+        if (it == entries.end())
+        {
+            it = entries.emplace(std::string(name), Entry {.path = resolve(name), .hits = 0})
+                     .first;
+        }
+
+        if (it->second.path.empty())
+        {
+            return std::nullopt;
+        }
+
+        ++it->second.hits;
+        return it->second.path;
+    }
+
+    /**
+     * @brief Drops a single name, e.g. after its cached path failed to execute
+     */
+    void CommandCache::forget(std::string_view name)
+    {
+        if (auto it = entries.find(name); it != entries.end())
+        {
+            entries.erase(it);
+        }
+    }
+
+    void CommandCache::clear()
+    {
+        entries.clear();
+    }
+
+    /**
+     * @brief Resolves every name found in the PATH directories up front
+     *
+     * Each name is resolved through the whole PATH, so an executable shadowed by an earlier
+     * directory maps to the one execvp() would pick. Hit counts are left at zero.
+     *
+     * @return std::size_t Number of commands in the cache afterwards
+     */
+    auto CommandCache::warm() -> std::size_t
+    {
+        validate();
+        if (!cacheable)
+        {
+            return 0;
+        }
+
+        std::vector<std::string> names;
+        for (const auto& dir : dirs)
+        {
+            DIR* handle = opendir(dir.path.c_str());
+            if (handle == nullptr)
+            {
+                continue;
+            }
+            while (const dirent* entry = readdir(handle))
+            {
+                std::string_view name = entry->d_name;
+                if (!name.starts_with('.') && !entries.contains(name))
+                {
+                    names.emplace_back(name);
+                }
+            }
+            closedir(handle);
+        }
+
+        for (auto& name : names)
+        {
+            if (!entries.contains(name))
+            {
+                auto path = resolve(name);
+                entries.emplace(std::move(name), Entry {.path = std::move(path), .hits = 0});
+            }
+        }
+
+        std::size_t count = 0;
+        for_each([&count](const auto&, const auto&) { ++count; });
+        return count;
+    }
+
+    // ===== Private functions =====
+
+    /**
+     * @brief Throws away stale entries
+     *
+     * Everything goes when PATH itself changed, or when any directory in it was modified
+     * since the entries were resolved (a new executable may now shadow a cached one). An
+     * unset PATH searches the system default path, like execvp().
+     */
+    void CommandCache::validate()
+    {
+        const char* path = std::getenv("PATH");
+        if (path == nullptr)
+        {
+            path = default_path().c_str();
+        }
+
+        if (!loaded || path_env != path)
+        {
+            load_path(path);
+            entries.clear();
+            return;
+        }
+
+        bool stale = false;
+        for (auto& dir : dirs)
+        {
+            timespec mtime = dir_mtime(dir.path);
+            if (!same_time(mtime, dir.mtime))
+            {
+                dir.mtime = mtime;
+                stale = true;
+            }
+        }
+
+        if (stale)
+        {
+            entries.clear();
+        }
+    }
+
+    void CommandCache::load_path(const char* path)
+    {
+        path_env = path;
+        dirs.clear();
+        cacheable = true;
+        loaded = true;
+
+        std::string_view rest = path_env;
+        while (true)
+        {
+            auto sep = rest.find(':');
+            std::string_view dir = rest.substr(0, sep);
+
+            // an empty entry means the current directory
+            std::string dir_path = dir.empty() ? std::string(".") : std::string(dir);
+            cacheable = cacheable && dir_path.front() == '/';
+            timespec mtime = dir_mtime(dir_path);
+            dirs.push_back({.path = std::move(dir_path), .mtime = mtime});
+
+            if (sep == std::string_view::npos)
+            {
+                break;
+            }
+            rest.remove_prefix(sep + 1);
+        }
+    }
+
+    auto CommandCache::resolve(std::string_view name) -> std::string
+    {
+        if (name.empty())
+        {
+            return {};
+        }
+
+        for (const auto& dir : dirs)
+        {
+            scratch.assign(dir.path);
+            scratch.push_back('/');
+            scratch.append(name);
+
+            struct stat st {};
+            if (stat(scratch.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+                access(scratch.c_str(), X_OK) == 0)
+            {
+                return scratch;
+            }
+        }
+
+        return {};
+    }
+
+    /**
+     * @brief Process-wide command cache
+     */
+    CommandCache& command_cache()
+    {
+        static CommandCache cache;
+        return cache;
+    }
+} // namespace nullsh::cache
\ No newline at end of file
@@ -0,0 +1,543 @@
+/**
+ * @file completion.cpp
+ * @brief Tab completion: a trie of command names built off the prompt's thread, and cached
+ * directory listings
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/completion.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <ranges>
+#include <utility>
+
+#include "nullsh/builtins.h"
+#include "nullsh/variables.h"
+
+namespace nullsh::complete
+{
+    namespace
+    {
+        // characters the tokenizer would split on, expand or unquote
+        constexpr std::string_view SPECIAL = " \t'\"\\$|&";
+
+        bool same_time(const timespec& lhs, const timespec& rhs)
+        {
+            return lhs.tv_sec == rhs.tv_sec && lhs.tv_nsec == rhs.tv_nsec;
+        }
+
+        timespec dir_mtime(const std::string& path)
+        {
+            struct stat info {};
+            if (stat(path.c_str(), &info) < 0)
+            {
+                return {};
+            }
+            return info.st_mtim;
+        }
+
+        auto escape(std::string_view text) -> std::string
+        {
+            std::string out;
+            out.reserve(text.size());
+            for (char chr : text)
+            {
+                if (SPECIAL.find(chr) != std::string_view::npos)
+                {
+                    out.push_back('\\');
+                }
+                out.push_back(chr);
+            }
+            return out;
+        }
+
+        auto unescape(std::string_view text) -> std::string
+        {
+            std::string out;
+            out.reserve(text.size());
+            for (std::size_t pos = 0; pos < text.size(); ++pos)
+            {
+                if (text[pos] == '\\' && pos + 1 < text.size())
+                {
+                    ++pos;
+                }
+                out.push_back(text[pos]);
+            }
+            return out;
+        }
+
+        std::size_t common_length(std::string_view lhs, std::string_view rhs)
+        {
+            auto [left, right] = std::ranges::mismatch(lhs, rhs);
+            return static_cast<std::size_t>(left - lhs.begin());
+        }
+
+        // the first word of a line or of a pipeline stage names a command
+        bool names_command(std::string_view word)
+        {
+            if (word == "|")
+            {
+                return true;
+            }
+            auto eq = word.find('=');
+            return eq != std::string_view::npos && vars::valid_name(word.substr(0, eq));
+        }
+
+        bool is_executable(int dir_fd, const dirent& entry)
+        {
+            if (entry.d_type == DT_DIR)
+            {
+                return false;
+            }
+            if (entry.d_type != DT_REG)
+            {
+                struct stat info {};
+                if (fstatat(dir_fd, entry.d_name, &info, 0) < 0 || !S_ISREG(info.st_mode))
+                {
+                    return false;
+                }
+            }
+            return faccessat(dir_fd, entry.d_name, X_OK, 0) == 0;
+        }
+    } // namespace
+
+    // ===== Trie =====
+
+    Trie::Trie() : nodes_(1) {}
+
+    /**
+     * @brief Adds a word, once
+     */
+    void Trie::insert(std::string_view word)
+    {
+        if (auto node = find(word); node != NONE && nodes_[node].terminal)
+        {
+            return;
+        }
+
+        std::uint32_t node = 0;
+        ++nodes_[node].count;
+        for (char chr : word)
+        {
+            // siblings are kept in byte order
+            auto byte = static_cast<unsigned char>(chr);
+            std::uint32_t prev = NONE;
+            std::uint32_t cur = nodes_[node].child;
+            while (cur != NONE && static_cast<unsigned char>(nodes_[cur].chr) < byte)
+            {
+                prev = cur;
+                cur = nodes_[cur].sibling;
+            }
+
+            if (cur == NONE || nodes_[cur].chr != chr)
+            {
+                auto fresh = static_cast<std::uint32_t>(nodes_.size());
+                nodes_.push_back({.child = NONE, .sibling = cur, .count = 0, .chr = chr});
+                (prev == NONE ? nodes_[node].child : nodes_[prev].sibling) = fresh;
+                cur = fresh;
+            }
+
+            node = cur;
+            ++nodes_[node].count;
+        }
+        nodes_[node].terminal = true;
+    }
+
+    /**
+     * @brief Counts the words starting with a prefix
+     */
+    std::size_t Trie::count(std::string_view prefix) const
+    {
+        auto node = find(prefix);
+        return node == NONE ? 0 : nodes_[node].count;
+    }
+
+    /**
+     * @brief Returns what every word starting with a prefix continues it with
+     *
+     * @param prefix Start of the words
+     * @return std::string The longest common continuation, empty if none or no match
+     */
+    auto Trie::extension(std::string_view prefix) const -> std::string
+    {
+        std::string ext;
+        auto node = find(prefix);
+        if (node == NONE)
+        {
+            return ext;
+        }
+
+        while (!nodes_[node].terminal && nodes_[node].child != NONE &&
+               nodes_[nodes_[node].child].sibling == NONE)
+        {
+            node = nodes_[node].child;
+            ext.push_back(nodes_[node].chr);
+        }
+        return ext;
+    }
+
+    /**
+     * @brief Appends the first words starting with a prefix, in byte order
+     *
+     * @param prefix Start of the words
+     * @param limit Words to stop at, counting those already in out
+     * @param out Receives the words
+     */
+    void Trie::collect(std::string_view prefix,
+                       std::size_t limit,
+                       std::vector<std::string>& out) const
+    {
+        auto node = find(prefix);
+        if (node != NONE)
+        {
+            std::string word {prefix};
+            walk(node, word, limit, out);
+        }
+    }
+
+    auto Trie::find(std::string_view prefix) const -> std::uint32_t
+    {
+        std::uint32_t node = 0;
+        for (char chr : prefix)
+        {
+            node = nodes_[node].child;
+            while (node != NONE && nodes_[node].chr != chr)
+            {
+                node = nodes_[node].sibling;
+            }
+            if (node == NONE)
+            {
+                return NONE;
+            }
+        }
+        return node;
+    }
+
+    void Trie::walk(std::uint32_t node,
+                    std::string& word,
+                    std::size_t limit,
+                    std::vector<std::string>& out) const
+    {
+        if (nodes_[node].terminal && out.size() < limit)
+        {
+            out.push_back(word);
+        }
+        for (auto child = nodes_[node].child; child != NONE && out.size() < limit;
+             child = nodes_[child].sibling)
+        {
+            word.push_back(nodes_[child].chr);
+            walk(child, word, limit, out);
+            word.pop_back();
+        }
+    }
+
+    // ===== DirCache =====
+
+    /**
+     * @brief Returns the entries of a directory, "." and ".." left out
+     *
+     * The listing is read again only when the directory's mtime changed, or when the path now
+     * names another directory (after a cd). Past MAX_DIRS listings the cache starts over.
+     *
+     * @param dir Directory path
+     * @return const std::vector<Entry>& Entries sorted by name, valid until the next call;
+     *         empty if the directory can't be read
+     */
+    auto DirCache::list(const std::string& dir) -> const std::vector<Entry>&
+    {
+        struct stat info {};
+        if (stat(dir.c_str(), &info) < 0 || !S_ISDIR(info.st_mode))
+        {
+            return none_;
+        }
+
+        auto it = listings_.find(dir);
+        if (it != listings_.end() && it->second.dev == info.st_dev &&
+            it->second.ino == info.st_ino && same_time(it->second.mtime, info.st_mtim))
+        {
+            return it->second.entries;
+        }
+        if (it == listings_.end() && listings_.size() >= MAX_DIRS)
+        {
+            listings_.clear();
+        }
+
+        Listing& listing = listings_[dir];
+        listing = {.dev = info.st_dev, .ino = info.st_ino, .mtime = info.st_mtim, .entries = {}};
+
+        DIR* handle = opendir(dir.c_str());
+        if (handle == nullptr)
+        {
+            return listing.entries;
+        }
+        while (const dirent* entry = readdir(handle))
+        {
+            std::string_view name = entry->d_name;
+            if (name == "." || name == "..")
+            {
+                continue;
+            }
+
+            bool is_dir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+            {
+                struct stat target {};
+                is_dir = fstatat(dirfd(handle), entry->d_name, &target, 0) == 0 &&
+                         S_ISDIR(target.st_mode);
+            }
+            listing.entries.push_back({.name = std::string(name), .is_dir = is_dir});
+        }
+        closedir(handle);
+
+        std::ranges::sort(listing.entries, {}, &Entry::name);
+        return listing.entries;
+    }
+
+    // ===== Completer =====
+
+    /**
+     * @brief Starts building the command trie from PATH on a helper thread
+     */
+    Completer::Completer()
+    {
+        auto builtins = std::make_shared<Trie>();
+        for (std::string_view name : builtins::names())
+        {
+            builtins->insert(name);
+        }
+        commands_ = std::move(builtins);
+        rebuild();
+    }
+
+    Completer::~Completer()
+    {
+        if (builder_.joinable())
+        {
+            builder_.join();
+        }
+    }
+
+    /**
+     * @brief Rebuilds the command trie if PATH or one of its directories changed
+     *
+     * Meant to run once per prompt, not per keystroke: it costs one stat per PATH entry.
+     */
+    void Completer::refresh()
+    {
+        const char* path = std::getenv("PATH");
+        if (path_env_ != (path == nullptr ? "" : path))
+        {
+            rebuild();
+            return;
+        }
+
+        if (std::ranges::any_of(dirs_, [](const Dir& dir)
+                                { return !same_time(dir_mtime(dir.path), dir.mtime); }))
+        {
+            rebuild();
+        }
+    }
+
+    /**
+     * @brief Completes the word before the cursor
+     *
+     * @param line Line being edited
+     * @param cursor Byte offset of the cursor in line
+     * @return Completion Text to insert at the cursor, and the candidates if ambiguous
+     */
+    auto Completer::complete(std::string_view line, std::size_t cursor) -> Completion
+    {
+        cursor = std::min(cursor, line.size());
+
+        // the word ends at the cursor and starts after the last unescaped blank
+        std::size_t start = 0;
+        bool command = true;
+        for (std::size_t pos = 0; pos < cursor; ++pos)
+        {
+            char chr = line[pos];
+            if (chr == '\\')
+            {
+                ++pos;
+            }
+            else if (chr == ' ' || chr == '\t')
+            {
+                if (pos > start)
+                {
+                    command = names_command(line.substr(start, pos - start));
+                }
+                start = pos + 1;
+            }
+        }
+        start = std::min(start, cursor);
+
+        auto word = unescape(line.substr(start, cursor - start));
+        auto res = command && word.find('/') == std::string::npos ? complete_command(word)
+                                                                  : complete_path(word);
+        res.start = start;
+        return res;
+    }
+
+    /**
+     * @brief The trie commands complete from: builtins, and PATH once it has been read
+     */
+    auto Completer::commands() const -> std::shared_ptr<const Trie>
+    {
+        std::lock_guard lock {mutex_};
+        return commands_;
+    }
+
+    bool Completer::ready() const
+    {
+        std::lock_guard lock {mutex_};
+        return ready_;
+    }
+
+    // ===== Private functions =====
+
+    void Completer::rebuild()
+    {
+        if (builder_.joinable())
+        {
+            builder_.join(); // PATH changed again while it was being read
+        }
+
+        const char* path = std::getenv("PATH");
+        path_env_ = path == nullptr ? "" : path;
+        dirs_.clear();
+
+        std::vector<std::string> paths;
+        for (auto part : std::views::split(std::string_view {path_env_}, ':'))
+        {
+            // an empty entry means the current directory, which changes under the trie
+            std::string dir {std::string_view(part.begin(), part.end())};
+            if (!dir.starts_with('/'))
+            {
+                continue;
+            }
+            dirs_.push_back({.path = dir, .mtime = dir_mtime(dir)});
+            paths.push_back(std::move(dir));
+        }
+
+        {
+            std::lock_guard lock {mutex_};
+            ready_ = false;
+        }
+        builder_ = std::thread(&Completer::build, this, std::move(paths));
+    }
+
+    // helper thread body; reads only its own copy of PATH, never the environment
+    void Completer::build(std::vector<std::string> dirs)
+    {
+        auto trie = std::make_shared<Trie>();
+        for (std::string_view name : builtins::names())
+        {
+            trie->insert(name);
+        }
+
+        for (const auto& dir : dirs)
+        {
+            DIR* handle = opendir(dir.c_str());
+            if (handle == nullptr)
+            {
+                continue;
+            }
+            while (const dirent* entry = readdir(handle))
+            {
+                if (entry->d_name[0] != '.' && is_executable(dirfd(handle), *entry))
+                {
+                    trie->insert(entry->d_name);
+                }
+            }
+            closedir(handle);
+        }
+
+        std::lock_guard lock {mutex_};
+        commands_ = std::move(trie);
+        ready_ = true;
+    }
+
+    auto Completer::complete_command(std::string_view word) -> Completion
+    {
+        auto trie = commands();
+
+        Completion res;
+        res.total = trie->count(word);
+        if (res.total == 0)
+        {
+            return res;
+        }
+
+        auto ext = trie->extension(word);
+        res.insert = escape(ext);
+        if (res.total == 1)
+        {
+            res.insert.push_back(' ');
+        }
+        else if (ext.empty())
+        {
+            trie->collect(word, MAX_CANDIDATES, res.candidates);
+        }
+        return res;
+    }
+
+    auto Completer::complete_path(std::string_view word) -> Completion
+    {
+        auto slash = word.rfind('/');
+        std::string_view base = slash == std::string_view::npos ? word : word.substr(slash + 1);
+        std::string dir = slash == std::string_view::npos ? std::string(".")
+                                                          : std::string(word.substr(0, slash + 1));
+        if (dir.starts_with("~/") && !home_.empty())
+        {
+            dir.replace(0, 1, home_);
+        }
+
+        // the names starting with base are one run of the sorted listing
+        const auto& entries = dir_cache_.list(dir);
+        auto starts_with = [&entries](std::string_view prefix)
+        {
+            auto first = std::ranges::lower_bound(entries, prefix, {}, &DirCache::Entry::name);
+            auto last = std::ranges::find_if_not(
+                first, entries.end(), [prefix](const DirCache::Entry& entry)
+                { return std::string_view(entry.name).starts_with(prefix); });
+            return std::ranges::subrange(first, last);
+        };
+        auto run = starts_with(base);
+
+        // hidden names only when asked for; they sort as a run of their own
+        auto hidden = base.empty() ? starts_with(".") : std::ranges::subrange(run.end(), run.end());
+        std::array parts {std::ranges::subrange(run.begin(), hidden.begin()),
+                          std::ranges::subrange(hidden.end(), run.end())};
+
+        Completion res;
+        res.total = run.size() - hidden.size();
+        if (res.total == 0)
+        {
+            return res;
+        }
+        const auto& first = parts[0].empty() ? parts[1].front() : parts[0].front();
+        const auto& last = parts[1].empty() ? parts[0].back() : parts[1].back();
+
+        // the longest prefix shared by a sorted run is the one its ends share
+        auto shared = common_length(first.name, last.name);
+        res.insert = escape(std::string_view(first.name).substr(base.size(), shared - base.size()));
+        if (res.total == 1)
+        {
+            res.insert.push_back(first.is_dir ? '/' : ' ');
+        }
+        else if (res.insert.empty())
+        {
+            for (const auto& entry : parts | std::views::join | std::views::take(MAX_CANDIDATES))
+            {
+                res.candidates.push_back(entry.is_dir ? entry.name + '/' : entry.name);
+            }
+        }
+        return res;
+    }
+} // namespace nullsh::complete
\ No newline at end of file
@@ -0,0 +1,217 @@
+/**
+ * @file event_loop.cpp
+ * @brief epoll loop the interactive shell waits on, with signals read from a signalfd
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/event_loop.h"
+
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include "nullsh/launcher.h"
+
+namespace nullsh::io
+{
+    /**
+     * @brief Creates the epoll set, and takes SIGINT, SIGCHLD and SIGWINCH over if asked to
+     *
+     * @param signals Whether to block the signals and read them from a signalfd
+     */
+    EventLoop::EventLoop(bool signals)
+    {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0 || !signals)
+        {
+            return;
+        }
+
+        sigset_t mask {};
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGCHLD);
+        sigaddset(&mask, SIGWINCH);
+        pthread_sigmask(SIG_BLOCK, &mask, &saved_mask_);
+
+        signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (signal_fd_ < 0 || !add(signal_fd_))
+        {
+            pthread_sigmask(SIG_SETMASK, &saved_mask_, nullptr);
+            if (signal_fd_ >= 0)
+            {
+                close(signal_fd_);
+                signal_fd_ = -1;
+            }
+        }
+    }
+
+    EventLoop::~EventLoop()
+    {
+        if (signal_fd_ >= 0)
+        {
+            // a pending ^C would kill the shell once unblocked
+            read_signals();
+            pthread_sigmask(SIG_SETMASK, &saved_mask_, nullptr);
+            close(signal_fd_);
+        }
+        if (epoll_fd_ >= 0)
+        {
+            close(epoll_fd_);
+        }
+    }
+
+    /**
+     * @brief Watches an fd, level-triggered
+     *
+     * @return true if it was added
+     */
+    bool EventLoop::add(int fd, std::uint32_t events)
+    {
+        epoll_event event {.events = events, .data = {.fd = fd}};
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    // to be called before the fd is closed, a dup'd fd would keep it in the set
+    void EventLoop::remove(int fd)
+    {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    /**
+     * @brief Waits for the watched fds, reading the signals that arrive meanwhile
+     *
+     * @param timeout_ms Longest wait, -1 for none
+     * @return std::optional<std::span<const epoll_event>> The ready fds, valid until the next
+     *         call; empty after a timeout or a signal. nullopt if epoll failed (errno is set)
+     */
+    auto EventLoop::wait(int timeout_ms) -> std::optional<std::span<const epoll_event>>
+    {
+        int count = epoll_wait(epoll_fd_, events_.data(), MAX_EVENTS, timeout_ms);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                return std::span<const epoll_event> {};
+            }
+            return std::nullopt;
+        }
+
+        // the signalfd is handled here, the rest is moved up over it
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < static_cast<std::size_t>(count); ++i)
+        {
+            if (events_[i].data.fd == signal_fd_)
+            {
+                read_signals();
+                continue;
+            }
+            events_[kept++] = events_[i];
+        }
+        return std::span<const epoll_event> {events_.data(), kept};
+    }
+
+    /**
+     * @brief Blocks until a child has exited, passing on the SIGINTs the shell gets meanwhile
+     *
+     * A child in the shell's process group gets a ^C from the terminal itself, so only other
+     * SIGINTs are forwarded to it. A child in a group of its own gets them all.
+     *
+     * @param pidfd pidfd of the child, left open
+     * @param own_group Whether the child leads a process group of its own
+     */
+    void EventLoop::wait_exit(int pidfd, bool own_group)
+    {
+        if (pidfd < 0 || !add(pidfd))
+        {
+            return;
+        }
+
+        bool exited = false;
+        while (!exited)
+        {
+            auto events = wait(-1);
+            if (!events)
+            {
+                break;
+            }
+
+            if (auto from = take_interrupt();
+                from == Interrupt::Other || (from == Interrupt::Terminal && own_group))
+            {
+                launcher::signal_pidfd(pidfd, SIGINT);
+            }
+            for (const auto& event : *events)
+            {
+                exited = exited || event.data.fd == pidfd;
+            }
+        }
+        remove(pidfd);
+    }
+
+    /**
+     * @brief Returns where the SIGINTs since the last call came from, Other if from both
+     */
+    auto EventLoop::take_interrupt() -> Interrupt
+    {
+        auto from = interrupt_;
+        interrupt_ = Interrupt::None;
+        return from;
+    }
+
+    // whether a child exited or stopped since the last call
+    bool EventLoop::take_child()
+    {
+        bool changed = child_;
+        child_ = false;
+        return changed;
+    }
+
+    // whether the terminal was resized since the last call
+    bool EventLoop::take_resize()
+    {
+        bool resized = resize_;
+        resize_ = false;
+        return resized;
+    }
+
+    // ===== Private functions =====
+
+    void EventLoop::read_signals()
+    {
+        std::array<signalfd_siginfo, 8> infos {};
+        ssize_t len = 0;
+        while ((len = read(signal_fd_, infos.data(), sizeof(infos))) > 0)
+        {
+            auto count = static_cast<std::size_t>(len) / sizeof(signalfd_siginfo);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto& info = infos[i];
+                switch (info.ssi_signo)
+                {
+                    case SIGINT:
+                        if (info.ssi_code != SI_KERNEL)
+                        {
+                            interrupt_ = Interrupt::Other;
+                        }
+                        else if (interrupt_ == Interrupt::None)
+                        {
+                            interrupt_ = Interrupt::Terminal;
+                        }
+                        break;
+                    case SIGCHLD:
+                        child_ = true;
+                        break;
+                    case SIGWINCH:
+                        resize_ = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+} // namespace nullsh::io
\ No newline at end of file
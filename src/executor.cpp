@@ -7,102 +7,728 @@
 
 #include "nullsh/executor.h"
 
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "nullsh/command_cache.h"
+#include "nullsh/output_sink.h"
 #include "nullsh/result_capturer.h"
 #include "nullsh/shell.h"
 
 namespace nullsh::executor
 {
-    command::CommandResult exec_external(const command::Command& cmd)
+    namespace
     {
-        command::CommandResult res {};
-        io::CommandResultCapturer cmd_capturer {res};
+        // output already queued in sink goes out before the spill is copied behind it; spilled
+        // output is copied to the fd in-kernel instead of being read back
+        void print_stream(io::OutputSink& sink,
+                          const std::string& data,
+                          const std::shared_ptr<io::SpillFile>& spill)
+        {
+            sink.write(data);
+            if (spill)
+            {
+                sink.flush();
+                spill->send_to(sink.fd());
+            }
+        }
+
+        // one line, like `time`, plus faults and context switches (minor/major, vol/invol)
+        void print_usage(io::OutputSink& out,
+                         int return_code,
+                         const std::optional<command::Usage>& usage)
+        {
+            if (!usage)
+            {
+                out.print("{}  (no usage)\n", return_code);
+                return;
+            }
+
+            using Seconds = std::chrono::duration<double>;
+            out.print("{}  wall {:.3f}s  user {:.3f}s  sys {:.3f}s  maxrss {} KiB  "
+                      "faults {}/{}  ctxsw {}/{}\n",
+                      return_code,
+                      Seconds(usage->wall).count(),
+                      Seconds(usage->user).count(),
+                      Seconds(usage->system).count(),
+                      usage->max_rss_kib,
+                      usage->minor_faults,
+                      usage->major_faults,
+                      usage->voluntary_switches,
+                      usage->involuntary_switches);
+        }
+    } // namespace
+
+    /**
+     * @brief Decides where each output stream of a child should go, based on its operators
+     *
+     * Replays the operator chain the same way apply_operator() would and counts who still
+     * looks at each stream. Streams nobody reads go to /dev/null. A stream printed by exactly
+     * one operator, with nothing printed ahead of it, is passed straight through to the
+     * shell's own fd (or tee'd there live when the output must also be retained). Anything
+     * else is captured. Without operators there is no known consumer, so everything is
+     * captured for the caller.
+     *
+     * @param ops Operators of the command, in application order
+     * @param retain Whether the caller needs the output in the result regardless
+     * @return io::StreamRoute Wiring for the child's stdout and stderr
+     */
+    auto route_streams(const std::vector<command::Op>& ops, bool retain) -> io::StreamRoute
+    {
+        if (ops.empty())
+        {
+            return {};
+        }
+
+        struct Stream
+        {
+            bool alive {true};      // data still held by the result
+            int readers {0};        // ops that print it while alive
+            bool reordered {false}; // something else was printed before it
+        };
+        Stream out {};
+        Stream err {};
+        bool printed = false;
+
+        auto read = [&printed](Stream& stream)
+        {
+            if (stream.alive)
+            {
+                ++stream.readers;
+                stream.reordered = stream.reordered || printed;
+            }
+        };
+
+        for (auto op : ops)
+        {
+            switch (op)
+            {
+                case command::Op::ForceOutput:
+                    read(out);
+                    read(err);
+                    break;
+                case command::Op::DiscardOutput:
+                    out.alive = false;
+                    err.alive = false;
+                    break;
+                case command::Op::None:
+                    out.alive = false;
+                    read(err);
+                    break;
+                case command::Op::PrintRC:
+                case command::Op::PrintRCHuman:
+                case command::Op::PrintUsage:
+                    printed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        auto mode = [retain](const Stream& stream)
+        {
+            if (stream.readers == 0)
+            {
+                return retain ? io::StreamMode::Capture : io::StreamMode::Discard;
+            }
+            if (stream.readers == 1 && !stream.reordered)
+            {
+                return retain ? io::StreamMode::Tee : io::StreamMode::Inherit;
+            }
+            return io::StreamMode::Capture;
+        };
+
+        return {.out = mode(out), .err = mode(err)};
+    }
+
+    namespace
+    {
+        /**
+         * @brief Resolves the file to execute for a command in the parent
+         *
+         * Names without a '/' go through the command cache, so a missing command fails here,
+         * without a fork.
+         *
+         * @param cmd Command to resolve
+         * @return std::optional<std::string> File to exec, or nullopt when not on PATH
+         */
+        auto resolve(const command::Command& cmd) -> std::optional<std::string>
+        {
+            if (cmd.name.find('/') != std::string::npos)
+            {
+                return cmd.name;
+            }
+
+            auto path = cache::command_cache().lookup(cmd.name);
+            if (!path)
+            {
+                return std::nullopt;
+            }
+            return std::string(*path);
+        }
+
+        // the environment a command starts with, read when it starts: the table's array moves
+        char* const* environment(const ExecOptions& opts)
+        {
+            if (opts.envp != nullptr)
+            {
+                return opts.envp;
+            }
+            return opts.vars != nullptr ? opts.vars->envp() : environ;
+        }
 
-        if (cmd.name.empty())
+        // the signal mask the shell had before its loop took SIGINT and friends over
+        const sigset_t* child_mask(const ExecOptions& opts)
         {
+            return opts.loop != nullptr ? opts.loop->child_mask() : nullptr;
+        }
+
+        // maps a failed launch to the shell's exit code, dropping stale cache entries
+        int launch_failure(const command::Command& cmd, int error)
+        {
+            if (error == ENOENT && cmd.name.find('/') == std::string::npos)
+            {
+                cache::command_cache().forget(cmd.name);
+            }
+            return error == ENOENT ? shell::EXIT_CMD_NOT_FOUND : shell::EXIT_CMD_NOT_EXECUTABLE;
+        }
+
+        /**
+         * @brief Runs an external command whose output feeds the capturer and operators
+         *
+         * @param cmd Command to run
+         * @param ops Operators applied to its output, used to route the streams
+         * @param opts Execution options
+         * @param input fd installed as the child's stdin, -1 to inherit the shell's
+         * @return command::CommandResult Result of the command
+         */
+        command::CommandResult run_captured(const command::Command& cmd,
+                                            const std::vector<command::Op>& ops,
+                                            const ExecOptions& opts,
+                                            int input)
+        {
+            command::CommandResult res {};
+            io::CommandResultCapturer cmd_capturer {res,
+                                                    route_streams(ops, opts.retain_output),
+                                                    opts.spill_threshold,
+                                                    opts.limits,
+                                                    opts.loop};
+
+            if (cmd.name.empty())
+            {
+                return res;
+            }
+
+            auto file = resolve(cmd);
+            if (!file)
+            {
+                res.return_code = shell::EXIT_CMD_NOT_FOUND;
+                return res;
+            }
+
+            cmd_capturer.init_pipes();
+
+            char* const* argv = cmd.args.argv(cmd.name.c_str());
+            auto child = opts.launch({.file = file->c_str(),
+                                      .argv = argv,
+                                      .envp = environment(opts),
+                                      .stdio = {input, -1, -1},
+                                      .io = &cmd_capturer,
+                                      .sigmask = child_mask(opts)});
+            if (child.error != 0)
+            {
+                res.return_code = launch_failure(cmd, child.error);
+                return res;
+            }
+
+            cmd_capturer.capture_parent(child.pid);
+
             return res;
         }
 
-        cmd_capturer.init_pipes();
+        /**
+         * @brief Starts a pipeline stage that is not the last one
+         *
+         * @param stage Command to start
+         * @param opts Execution options
+         * @param stdio fds for the child's stdin, stdout and stderr (-1 inherits)
+         * @return pid_t Child pid, or -1 when the stage could not be started
+         */
+        pid_t spawn_stage(const command::Command& stage,
+                          const ExecOptions& opts,
+                          const std::array<int, 3>& stdio)
+        {
+            auto file = resolve(stage);
+            if (!file)
+            {
+                return -1;
+            }
+
+            char* const* argv = stage.args.argv(stage.name.c_str());
+            auto child = opts.launch({.file = file->c_str(),
+                                      .argv = argv,
+                                      .envp = environment(opts),
+                                      .stdio = stdio,
+                                      .sigmask = child_mask(opts)});
+            if (child.error != 0)
+            {
+                launch_failure(stage, child.error);
+                return -1;
+            }
+            return child.pid;
+        }
 
-        pid_t pid = fork();
-        if (pid < 0)
+        // runs the builtin last stage of a pipeline with its output kept for the operators
+        command::CommandResult capture_builtin(command::Command& stage, const StageFn& run_builtin)
         {
-            std::perror("fork");
-            res.return_code = shell::EXIT_CMD_NOT_FOUND;
+            std::string out_data;
+            std::string err_data;
+            io::OutputSink out {out_data};
+            io::OutputSink err {err_data};
+
+            auto res = run_builtin(stage, out, err);
+            out.flush();
+            err.flush();
+            if (!out_data.empty())
+            {
+                res.stdout_data = std::move(out_data);
+            }
+            if (!err_data.empty())
+            {
+                res.stderr_data = std::move(err_data);
+            }
             return res;
         }
-        if (pid == 0)
+    } // namespace
+
+    command::CommandResult exec_external(const command::Command& cmd, const ExecOptions& opts)
+    {
+        return run_captured(cmd, cmd.ops, opts, opts.stdin_fd);
+    }
+
+    /**
+     * @brief Replaces the shell with cmd when nothing is left to do once it exits
+     *
+     * The fast path for `nullsh -c`: no fork, no pipes, no wait. Only taken when both streams
+     * are routed Inherit or Discard and no operator prints after the command. The shell never
+     * sees those bytes on the forked path either, so nothing is sanitized there (no newline
+     * appended, as command::sanitize_result() does for captured output) and the output is the
+     * same as through exec_external(). Anything captured, and $?, $$? or $%, takes the regular
+     * path. A command killed by a signal is then reported by the caller of nullsh instead of
+     * by the shell.
+     *
+     * @param cmd Command to run
+     * @param opts Execution options
+     * @return bool false when the fast path does not apply or exec failed, the shell's fds are
+     *         left untouched then; does not return otherwise
+     */
+    bool exec_in_place(const command::Command& cmd, const ExecOptions& opts)
+    {
+        const auto& limits = opts.limits;
+        bool limited = limits.timeout.count() != 0 || limits.cpu_seconds != 0 ||
+                       limits.address_space != 0 || limits.open_files != 0 ||
+                       limits.max_output != 0;
+        bool quiet_ops = std::ranges::all_of(cmd.ops,
+                                             [](command::Op op)
+                                             {
+                                                 return op == command::Op::None ||
+                                                        op == command::Op::ForceOutput ||
+                                                        op == command::Op::DiscardOutput;
+                                             });
+        if (cmd.type != command::CommandType::External || cmd.background || limited ||
+            !quiet_ops || opts.retain_output)
+        {
+            return false;
+        }
+
+        auto route = route_streams(cmd.ops);
+        auto direct = [](io::StreamMode mode)
+        { return mode == io::StreamMode::Inherit || mode == io::StreamMode::Discard; };
+        if (!direct(route.out) || !direct(route.err))
+        {
+            return false;
+        }
+
+        auto file = resolve(cmd);
+        if (!file)
+        {
+            return false; // reported by the regular path
+        }
+
+        std::array<int, 3> wanted {opts.stdin_fd, -1, -1};
+        int devnull = -1;
+        if (route.out == io::StreamMode::Discard || route.err == io::StreamMode::Discard)
         {
-            std::vector<char*> argv;
-            argv.reserve(cmd.args.size() + 2);
-            // NOLINTBEGIN(cppcoreguidelines-pro-type-const-cast)
-            argv.push_back(const_cast<char*>(cmd.name.c_str()));
-            for (const auto& arg : cmd.args)
+            devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+            if (devnull < 0)
             {
-                argv.push_back(const_cast<char*>(arg.c_str()));
+                return false;
             }
-            // NOLINTEND(cppcoreguidelines-pro-type-const-cast)
-            argv.push_back(nullptr);
+            wanted[1] = route.out == io::StreamMode::Discard ? devnull : -1;
+            wanted[2] = route.err == io::StreamMode::Discard ? devnull : -1;
+        }
 
-            cmd_capturer.prepare_child();
+        // kept to restore the shell's fds if exec fails
+        std::array<int, 3> saved {-1, -1, -1};
+        for (int fd = 0; fd < 3; ++fd)
+        {
+            auto idx = static_cast<std::size_t>(fd);
+            if (wanted[idx] >= 0)
+            {
+                saved[idx] = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+                dup2(wanted[idx], fd);
+            }
+        }
+
+        char* const* argv = cmd.args.argv(cmd.name.c_str());
+        execve(file->c_str(), argv, environment(opts));
+
+        int error = errno;
+        for (int fd = 0; fd < 3; ++fd)
+        {
+            auto idx = static_cast<std::size_t>(fd);
+            if (saved[idx] >= 0)
+            {
+                dup2(saved[idx], fd);
+                close(saved[idx]);
+            }
+        }
+        if (devnull >= 0)
+        {
+            close(devnull);
+        }
+        errno = error;
+        return false;
+    }
+
+    /**
+     * @brief Starts an external command in the background
+     *
+     * The child reads /dev/null and writes every stream its operators consume straight to a
+     * memfd, which the kernel fills while the shell moves on; nothing has to drain it.
+     * Completion is tracked through a pidfd, see jobs::JobTable. In the interactive shell the
+     * job leads a process group of its own, so a ^C meant for the foreground misses it.
+     *
+     * @param cmd Command to start
+     * @param opts Execution options
+     * @return jobs::Job The running job, or a finished one without a pid if it did not start
+     */
+    auto exec_background(const command::Command& cmd, const ExecOptions& opts) -> jobs::Job
+    {
+        jobs::Job job {};
+        job.text = cmd.name;
+        for (const auto& arg : cmd.args)
+        {
+            job.text += ' ';
+            job.text += arg;
+        }
+        job.ops = cmd.ops;
+        job.spill_threshold = opts.spill_threshold;
+        job.done = true;
+
+        auto file = resolve(cmd);
+        if (!file)
+        {
+            job.result.return_code = shell::EXIT_CMD_NOT_FOUND;
+            return job;
+        }
+
+        auto route = route_streams(cmd.ops);
+        if (route.out != io::StreamMode::Discard)
+        {
+            job.out = io::SpillFile::create("nullsh-job-out");
+        }
+        if (route.err != io::StreamMode::Discard)
+        {
+            job.err = io::SpillFile::create("nullsh-job-err");
+        }
 
-            execvp(cmd.name.c_str(), argv.data());
+        int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+        char* const* argv = cmd.args.argv(cmd.name.c_str());
+        auto child = opts.launch({.file = file->c_str(),
+                                  .argv = argv,
+                                  .envp = environment(opts),
+                                  .stdio = {devnull,
+                                            job.out ? job.out->fd() : devnull,
+                                            job.err ? job.err->fd() : devnull},
+                                  .sigmask = child_mask(opts),
+                                  .new_group = opts.loop != nullptr});
+        if (devnull >= 0)
+        {
+            close(devnull);
+        }
+
+        if (child.error != 0)
+        {
+            job.result.return_code = launch_failure(cmd, child.error);
+            job.out.reset();
+            job.err.reset();
+            return job;
+        }
+
+        job.pid = child.pid;
+        job.pidfd = launcher::open_pidfd(child.pid);
+        job.started = std::chrono::steady_clock::now();
+        job.done = false;
+        return job;
+    }
+
+    /**
+     * @brief Runs a pipeline, with its stages as siblings connected by pipes
+     *
+     * External stages write straight into the pipe read by the next stage, nullsh never
+     * relays their data. A builtin stage runs in-process and writes into a memfd through an
+     * OutputSink on it, so its output never sits in the shell's heap; the next stage reads
+     * the memfd directly. Only the last stage feeds the
+     * capturer and the operators; the others share the shell's stderr, unless the
+     * operators discard it. The return code is the last stage's.
+     *
+     * @param cmd Pipeline command
+     * @param opts Execution options
+     * @param run_builtin Runs a builtin stage in the shell
+     * @return command::CommandResult Result of the last stage
+     */
+    command::CommandResult exec_pipeline(command::Command& cmd,
+                                         const ExecOptions& opts,
+                                         const StageFn& run_builtin)
+    {
+        if (cmd.stages.empty() ||
+            std::ranges::any_of(cmd.stages, [](const auto& stage) { return stage.name.empty(); }))
+        {
+            return {.return_code = shell::EXIT_USAGE,
+                    .stdout_data = "",
+                    .stderr_data = "syntax error near unexpected token `|'"};
+        }
+
+        bool discard_err = route_streams(cmd.ops).err == io::StreamMode::Discard;
+        int devnull = discard_err ? open("/dev/null", O_WRONLY | O_CLOEXEC) : -1;
 
-            // if execvp returns it failed
-            if (errno == ENOENT)
+        std::vector<pid_t> children;
+        int input = opts.stdin_fd;            // stdin of the next stage
+        bool input_owned = false;             // input is a pipe end we must close
+        std::shared_ptr<io::SpillFile> feed;  // builtin output backing input
+        command::CommandResult res {};
+        bool broken = false;
+
+        auto release_input = [&]()
+        {
+            if (input_owned)
             {
-                _exit(shell::EXIT_CMD_NOT_FOUND);
+                close(input);
             }
-            else
+            input = -1;
+            input_owned = false;
+            feed.reset();
+        };
+
+        for (std::size_t i = 0; i + 1 < cmd.stages.size(); ++i)
+        {
+            auto& stage = cmd.stages[i];
+
+            if (stage.type == command::CommandType::Builtin)
             {
-                _exit(shell::EXIT_CMD_NOT_EXECUTABLE);
+                release_input();
+                feed = io::SpillFile::create("nullsh-pipe");
+                if (!feed)
+                {
+                    res = {.return_code = 1,
+                           .stdout_data = "",
+                           .stderr_data = std::string("pipe: ") + std::strerror(errno)};
+                    broken = true;
+                    break;
+                }
+
+                {
+                    // the builtin writes into the memfd itself, cat can sendfile() into it
+                    io::OutputSink out {feed->fd()};
+                    io::OutputSink err {discard_err ? -1 : STDERR_FILENO};
+                    auto stage_res = run_builtin(stage, out, err);
+                    // output handed back in the result rather than written
+                    print_stream(out, stage_res.stdout_data, stage_res.stdout_spill);
+                    print_stream(err, stage_res.stderr_data, stage_res.stderr_spill);
+                    // shown live like an external stage's, neither stream is sanitized
+                    out.flush();
+                    err.flush();
+                }
+
+                // written through the fd's offset, the next stage reads from the start
+                lseek(feed->fd(), 0, SEEK_SET);
+                feed->sync_size();
+                input = feed->fd();
+                continue;
             }
+
+            std::array<int, 2> pipe_fds {-1, -1};
+            if (pipe2(pipe_fds.data(), O_CLOEXEC) == -1)
+            {
+                res = {.return_code = 1,
+                       .stdout_data = "",
+                       .stderr_data = std::string("pipe: ") + std::strerror(errno)};
+                broken = true;
+                break;
+            }
+
+            pid_t pid = spawn_stage(stage, opts, {input, pipe_fds[1], devnull});
+            if (pid > 0)
+            {
+                children.push_back(pid);
+            }
+
+            // the child holds its own copies, the next stage sees EOF once it exits
+            close(pipe_fds[1]);
+            release_input();
+            input = pipe_fds[0];
+            input_owned = true;
+        }
+
+        if (!broken)
+        {
+            auto& last = cmd.stages.back();
+            res = last.type == command::CommandType::Builtin
+                      ? capture_builtin(last, run_builtin)
+                      : run_captured(last, cmd.ops, opts, input);
+        }
+        release_input();
+
+        if (devnull >= 0)
+        {
+            close(devnull);
         }
 
-        cmd_capturer.capture_parent(pid);
+        command::Usage usage = res.usage.value_or(command::Usage {});
+        for (pid_t pid : children)
+        {
+            if (opts.loop != nullptr)
+            {
+                // a stage that outlives the last one still gets the shell's ^C
+                int pidfd = launcher::open_pidfd(pid);
+                opts.loop->wait_exit(pidfd, false);
+                if (pidfd >= 0)
+                {
+                    close(pidfd);
+                }
+            }
+
+            rusage stage_usage {};
+            int rc = 0;
+            while ((rc = wait4(pid, nullptr, 0, &stage_usage)) == -1 && errno == EINTR)
+            {
+            }
+            if (rc > 0)
+            {
+                usage += command::to_usage(stage_usage);
+            }
+        }
+        if (!children.empty())
+        {
+            res.usage = usage;
+        }
 
         return res;
     }
 
+    /**
+     * @brief Applies a command's operators to its result, in order
+     *
+     * Everything the operators print is gathered per stream and written once at the end.
+     *
+     * @param ops Operators of the command
+     * @param res Result of the command, sanitized first
+     */
+    void apply_operators(const std::vector<command::Op>& ops, command::CommandResult& res)
+    {
+        command::sanitize_result(res);
+
+        io::OutputSink out {STDOUT_FILENO};
+        io::OutputSink err {STDERR_FILENO};
+        for (auto op : ops)
+        {
+            apply_operator(op, res, out, err);
+        }
+    }
+
     void apply_operator(command::Op op, command::CommandResult& res)
+    {
+        io::OutputSink out {STDOUT_FILENO};
+        io::OutputSink err {STDERR_FILENO};
+        apply_operator(op, res, out, err);
+    }
+
+    /**
+     * @brief Applies one operator, printing through the given sinks
+     *
+     * A sink is flushed before the other stream is written to, so stdout and stderr keep their
+     * relative order, and before the result drops data the sinks may still reference.
+     *
+     * @param op Operator to apply
+     * @param res Result of the command
+     * @param out Sink for the shell's stdout
+     * @param err Sink for the shell's stderr
+     */
+    void apply_operator(command::Op op,
+                        command::CommandResult& res,
+                        io::OutputSink& out,
+                        io::OutputSink& err)
     {
         switch (op)
         {
             case command::Op::ForceOutput:
-                // print stdout/stderr explicitly
-                std::cout << res.stdout_data;
-                std::cerr << res.stderr_data;
+                // print stdout/stderr explicitly, unless already shown live
+                if (!res.stdout_relayed)
+                {
+                    err.flush();
+                    print_stream(out, res.stdout_data, res.stdout_spill);
+                }
+                if (!res.stderr_relayed)
+                {
+                    out.flush();
+                    print_stream(err, res.stderr_data, res.stderr_spill);
+                }
                 break;
             case command::Op::DiscardOutput:
                 // drop output
+                out.flush();
+                err.flush();
                 res.stdout_data.clear();
                 res.stderr_data.clear();
+                res.stdout_spill.reset();
+                res.stderr_spill.reset();
                 break;
             case command::Op::PrintRC:
-                std::cout << res.return_code << '\n';
+                err.flush();
+                out.print("{}\n", res.return_code);
                 break;
             case command::Op::PrintRCHuman:
-                std::cout << res.return_code;
-                if (res.return_code == 0)
-                {
-                    std::cout << " (success)";
-                }
-                else
-                {
-                    std::cout << " (failure)";
-                }
-                std::cout << "\n";
+                err.flush();
+                out.print(
+                    "{} ({})\n", res.return_code, res.return_code == 0 ? "success" : "failure");
+                break;
+            case command::Op::PrintUsage:
+                err.flush();
+                print_usage(out, res.return_code, res.usage);
                 break;
             case command::Op::None:
             default:
                 // default: silent execution (stdout > /dev/null, stderr visible)
+                out.flush();
                 res.stdout_data.clear();
-                std::cerr << res.stderr_data;
+                res.stdout_spill.reset();
+                if (!res.stderr_relayed)
+                {
+                    print_stream(err, res.stderr_data, res.stderr_spill);
+                }
                 break;
         }
     }
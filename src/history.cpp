@@ -0,0 +1,410 @@
+/**
+ * @file history.cpp
+ * @brief Opt-in persistent history: an append-only log with a memory mapped prefix index
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/history.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <ranges>
+#include <utility>
+
+#include "nullsh/util.h"
+
+namespace nullsh::history
+{
+    namespace
+    {
+        constexpr std::array<char, 8> MAGIC {'N', 'S', 'H', 'I', 'D', 'X', '0', '1'};
+
+        struct Header
+        {
+            std::array<char, 8> magic;
+            std::uint64_t log_size; // the index covers the log up to here
+            std::uint64_t log_ino;  // a rotated log gets a new inode and a new index
+            std::uint64_t count;
+        };
+    } // namespace
+
+    History::~History()
+    {
+        if (fd_ >= 0)
+        {
+            sync();
+            close(fd_);
+        }
+    }
+
+    History::History(History&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)),
+          opts_(other.opts_),
+          log_(std::move(other.log_)),
+          index_(std::move(other.index_)),
+          indexed_size_(std::exchange(other.indexed_size_, 0)),
+          count_(std::exchange(other.count_, 0)),
+          tail_(std::move(other.tail_)),
+          appended_(std::move(other.appended_)),
+          unsynced_(std::exchange(other.unsynced_, 0)),
+          last_sync_(other.last_sync_)
+    {
+    }
+
+    History& History::operator=(History&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (fd_ >= 0)
+            {
+                sync();
+                close(fd_);
+            }
+            fd_ = std::exchange(other.fd_, -1);
+            opts_ = other.opts_;
+            log_ = std::move(other.log_);
+            index_ = std::move(other.index_);
+            indexed_size_ = std::exchange(other.indexed_size_, 0);
+            count_ = std::exchange(other.count_, 0);
+            tail_ = std::move(other.tail_);
+            appended_ = std::move(other.appended_);
+            unsynced_ = std::exchange(other.unsynced_, 0);
+            last_sync_ = other.last_sync_;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Opens (or creates) a history log and its index
+     *
+     * The log is mapped as it is now; lines other sessions append later are not seen. A missing,
+     * torn or stale index is ignored and its lines are searched linearly, and when at least
+     * `merge_after` lines are not indexed the index is rewritten. Failing to write it is not an
+     * error, the next session tries again.
+     *
+     * @param path Log file, the index is `path.idx`
+     * @param opts Sync and merge thresholds
+     * @return std::expected<History, std::string> The history, or the reason it failed
+     */
+    auto History::open(const std::string& path, Options opts) -> std::expected<History, std::string>
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            return std::unexpected(std::strerror(errno));
+        }
+        History hist {fd, opts};
+        hist.last_sync_ = std::chrono::steady_clock::now();
+
+        struct stat info {};
+        if (fstat(fd, &info) < 0)
+        {
+            return std::unexpected(std::strerror(errno));
+        }
+
+        auto log = io::MappedFile::open(path, io::MappedFile::Access::Random);
+        if (!log)
+        {
+            return std::unexpected(log.error());
+        }
+        hist.log_ = std::move(*log);
+
+        auto index_path = path + ".idx";
+        hist.index_ = hist.load_index(index_path, info.st_ino);
+
+        // complete lines past the index; a line being written by another session is left out
+        std::string_view rest = hist.log_.view().substr(hist.indexed_size_);
+        rest = rest.substr(0, rest.rfind('\n') + 1);
+        io::LineReader reader {rest};
+        while (auto line = reader.next())
+        {
+            if (!line->empty())
+            {
+                hist.tail_.push_back(*line);
+            }
+        }
+
+        if (hist.tail_.size() >= opts.merge_after &&
+            hist.write_index(index_path, info.st_ino, hist.indexed_size_ + rest.size()))
+        {
+            hist.index_ = hist.load_index(index_path, info.st_ino);
+            hist.tail_.clear();
+        }
+        return hist;
+    }
+
+    /**
+     * @brief Maps the index if it matches the log, else leaves the whole log unindexed
+     */
+    auto History::load_index(const std::string& path, std::uint64_t log_ino) -> io::MappedFile
+    {
+        indexed_size_ = 0;
+        count_ = 0;
+
+        auto index = io::MappedFile::open(path, io::MappedFile::Access::Random);
+        if (!index || index->view().size() < sizeof(Header))
+        {
+            return {};
+        }
+
+        Header hdr {};
+        std::memcpy(&hdr, index->view().data(), sizeof(hdr));
+        auto log = log_.view();
+        bool valid = hdr.magic == MAGIC && hdr.log_ino == log_ino && hdr.log_size <= log.size() &&
+                     (hdr.log_size == 0 || log[hdr.log_size - 1] == '\n') &&
+                     index->view().size() == sizeof(Header) + hdr.count * sizeof(Entry);
+        if (!valid)
+        {
+            return {};
+        }
+
+        indexed_size_ = hdr.log_size;
+        count_ = hdr.count;
+        return std::move(*index);
+    }
+
+    /**
+     * @brief Folds the unindexed lines into the index and replaces the index file
+     *
+     * Both sides are sorted, so this is a merge; equal lines keep the offset of the latest. The
+     * new index is written next to the old one and renamed over it, so concurrent sessions only
+     * ever map a whole index.
+     */
+    bool History::write_index(const std::string& path, std::uint64_t log_ino,
+                              std::uint64_t log_size)
+    {
+        // lines past the old index are covered now, text() must see them
+        std::uint64_t old_size = std::exchange(indexed_size_, log_size);
+
+        const char* base = log_.view().data();
+        std::vector<Entry> fresh;
+        fresh.reserve(tail_.size());
+        for (std::string_view line : tail_)
+        {
+            fresh.push_back({.offset = static_cast<std::uint64_t>(line.data() - base),
+                             .length = line.size()});
+        }
+
+        // stable, so equal lines stay oldest first and the last one wins below
+        auto by_text = [this](const Entry& lhs, const Entry& rhs)
+        { return text(lhs) < text(rhs); };
+        std::ranges::stable_sort(fresh, by_text);
+
+        std::vector<Entry> merged;
+        merged.reserve(count_ + fresh.size());
+        auto keep = [this, &merged](const Entry& ent)
+        {
+            if (!merged.empty() && text(merged.back()) == text(ent))
+            {
+                merged.back() = ent;
+            }
+            else
+            {
+                merged.push_back(ent);
+            }
+        };
+
+        std::size_t old = 0;
+        for (const Entry& ent : fresh)
+        {
+            for (; old < count_ && !by_text(ent, entry(old)); ++old)
+            {
+                keep(entry(old));
+            }
+            keep(ent);
+        }
+        for (; old < count_; ++old)
+        {
+            keep(entry(old));
+        }
+
+        Header hdr {
+            .magic = MAGIC, .log_size = log_size, .log_ino = log_ino, .count = merged.size()};
+        auto tmp = std::format("{}.{}", path, getpid());
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            indexed_size_ = old_size;
+            return false;
+        }
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        bool written =
+            util::write_all(fd, {reinterpret_cast<const char*>(&hdr), sizeof(hdr)}) &&
+            util::write_all(fd,
+                            {reinterpret_cast<const char*>(merged.data()),
+                             merged.size() * sizeof(Entry)});
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+        close(fd);
+
+        if (!written || rename(tmp.c_str(), path.c_str()) < 0)
+        {
+            unlink(tmp.c_str());
+            indexed_size_ = old_size;
+            return false;
+        }
+        return true;
+    }
+
+    History::Entry History::entry(std::size_t idx) const
+    {
+        Entry ent {};
+        std::memcpy(&ent, index_.view().data() + sizeof(Header) + idx * sizeof(Entry), sizeof(ent));
+        return ent;
+    }
+
+    // the line an index entry points at, empty if the entry lies past what the index covers
+    std::string_view History::text(const Entry& ent) const
+    {
+        if (ent.offset > indexed_size_ || ent.length > indexed_size_ - ent.offset)
+        {
+            return {};
+        }
+        return log_.view().substr(ent.offset, ent.length);
+    }
+
+    /**
+     * @brief Appends a line to the log
+     *
+     * The line is written with one `write` on an `O_APPEND` descriptor, so lines of concurrent
+     * sessions do not interleave. `fdatasync` runs every `sync_every` lines, or on the first
+     * line after `sync_interval`, and when the history is closed.
+     *
+     * @param line Line as typed, without its newline
+     * @return true if it was written (empty lines are skipped), false otherwise
+     */
+    bool History::append(std::string_view line)
+    {
+        if (line.empty())
+        {
+            return true;
+        }
+        if (line.find('\n') != std::string_view::npos)
+        {
+            return false;
+        }
+
+        std::string& stored = appended_.emplace_back(line);
+        stored.push_back('\n');
+        bool written = util::write_all(fd_, stored);
+        stored.pop_back();
+        if (!written)
+        {
+            appended_.pop_back();
+            return false;
+        }
+        tail_.emplace_back(stored);
+
+        ++unsynced_;
+        if (unsynced_ >= opts_.sync_every ||
+            std::chrono::steady_clock::now() - last_sync_ >= opts_.sync_interval)
+        {
+            return sync();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Flushes the lines written since the last sync to disk
+     */
+    bool History::sync()
+    {
+        if (unsynced_ == 0)
+        {
+            return true;
+        }
+        unsynced_ = 0;
+        last_sync_ = std::chrono::steady_clock::now();
+        return fdatasync(fd_) == 0;
+    }
+
+    /**
+     * @brief Finds the latest distinct lines starting with a prefix
+     *
+     * Unindexed lines are newer than indexed ones and are scanned newest first. In the index the
+     * matches are one run of the sorted entries, found with two binary searches, and only the
+     * `limit` newest of the run are sorted. An empty prefix reads the log backwards instead.
+     *
+     * @param prefix Text the lines start with
+     * @param limit Maximum number of lines returned
+     * @return std::vector<std::string_view> Matches, newest first, valid while the history lives
+     */
+    auto History::search(std::string_view prefix, std::size_t limit) const
+        -> std::vector<std::string_view>
+    {
+        std::vector<std::string_view> found;
+        auto add = [&found](std::string_view line)
+        {
+            if (std::ranges::find(found, line) == found.end())
+            {
+                found.push_back(line);
+            }
+        };
+
+        for (auto it = tail_.rbegin(); it != tail_.rend() && found.size() < limit; ++it)
+        {
+            if (it->starts_with(prefix))
+            {
+                add(*it);
+            }
+        }
+
+        if (prefix.empty())
+        {
+            std::string_view log = log_.view().substr(0, indexed_size_);
+            while (!log.empty() && found.size() < limit)
+            {
+                log.remove_suffix(1); // its newline
+                auto start = log.rfind('\n') + 1; // npos + 1 is the start of the log
+                std::string_view line = log.substr(start);
+                log = log.substr(0, start);
+                if (line.ends_with('\r'))
+                {
+                    line.remove_suffix(1);
+                }
+                if (!line.empty())
+                {
+                    add(line);
+                }
+            }
+            return found;
+        }
+
+        if (found.size() >= limit)
+        {
+            return found;
+        }
+
+        auto head = [this, &prefix](std::size_t idx)
+        { return text(entry(idx)).substr(0, prefix.size()); };
+        auto all = std::views::iota(std::size_t {0}, count_);
+        auto first = std::ranges::partition_point(
+            all, [&](std::size_t idx) { return head(idx) < prefix; });
+        auto last = std::ranges::partition_point(
+            std::ranges::subrange(first, all.end()),
+            [&](std::size_t idx) { return head(idx) == prefix; });
+
+        // the index holds each line once, so of its `limit` newest matches only lines already
+        // found in the tail are skipped; that leaves at least `limit - found.size()` new ones
+        auto matches = static_cast<std::size_t>(last - first);
+        std::vector<Entry> newest(std::min(matches, limit));
+        auto run = std::ranges::subrange(first, last) |
+                   std::views::transform([this](std::size_t idx) { return entry(idx); });
+        auto end = std::ranges::partial_sort_copy(
+                       run, newest, std::ranges::greater {}, &Entry::offset, &Entry::offset)
+                       .out;
+        for (auto it = newest.begin(); it != end && found.size() < limit; ++it)
+        {
+            add(text(*it));
+        }
+        return found;
+    }
+} // namespace nullsh::history
\ No newline at end of file
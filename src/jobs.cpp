@@ -0,0 +1,229 @@
+/**
+ * @file jobs.cpp
+ * @brief Background jobs started with '&'
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/jobs.h"
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <format>
+#include <utility>
+
+#include "nullsh/shell.h"
+
+namespace nullsh::jobs
+{
+    namespace
+    {
+        // moves small outputs back to the heap, larger ones stay in their memfd
+        void take_output(const std::shared_ptr<io::SpillFile>& file,
+                         std::size_t threshold,
+                         std::string& data,
+                         std::shared_ptr<io::SpillFile>& spill)
+        {
+            if (!file || file->sync_size() == 0)
+            {
+                return;
+            }
+            if (file->size() <= threshold)
+            {
+                data = file->read_all();
+            }
+            else
+            {
+                spill = file;
+            }
+        }
+    } // namespace
+
+    /**
+     * @brief Describes the state of a job, as listed by `jobs`
+     *
+     * @param job Job to describe
+     * @return std::string "Running", "Done" or "Exit <code>"
+     */
+    auto state(const Job& job) -> std::string
+    {
+        if (!job.done)
+        {
+            return "Running";
+        }
+        if (job.result.return_code == 0)
+        {
+            return "Done";
+        }
+        return std::format("Exit {}", job.result.return_code);
+    }
+
+    JobTable::~JobTable()
+    {
+        // jobs still running are left alone, only their pidfds are released
+        for (auto& [id, job] : jobs)
+        {
+            if (job.pidfd >= 0)
+            {
+                close(job.pidfd);
+            }
+        }
+    }
+
+    /**
+     * @brief Adds a started job to the table
+     *
+     * @param job Job with its pid, pidfd and outputs set
+     * @return int Id assigned to the job, one past the highest id in use
+     */
+    int JobTable::add(Job job)
+    {
+        int id = jobs.empty() ? 1 : jobs.rbegin()->first + 1;
+        job.id = id;
+        jobs.emplace(id, std::move(job));
+        return id;
+    }
+
+    /**
+     * @brief Finishes every job whose process has exited, without blocking
+     *
+     * One poll() over the pidfds of the running jobs; only the exited ones are reaped.
+     */
+    void JobTable::refresh()
+    {
+        std::vector<pollfd> fds;
+        std::vector<Job*> running;
+        for (auto& [id, job] : jobs)
+        {
+            if (!job.done)
+            {
+                fds.push_back({.fd = job.pidfd, .events = POLLIN, .revents = 0});
+                running.push_back(&job);
+            }
+        }
+
+        if (fds.empty() || poll(fds.data(), fds.size(), 0) <= 0)
+        {
+            return;
+        }
+
+        for (std::size_t i = 0; i < fds.size(); ++i)
+        {
+            if ((fds[i].revents & (POLLIN | POLLHUP)) != 0)
+            {
+                finish(*running[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief Blocks until a job has finished
+     *
+     * On the shell's loop the job is waited on as a foreground command would be: a ^C reaches
+     * it, though it runs in a process group of its own.
+     *
+     * @param id Job id
+     * @param loop The interactive shell's loop, nullptr to block in waitid()
+     * @return true if the job exists (and is now done), false otherwise
+     */
+    bool JobTable::wait(int id, io::EventLoop* loop)
+    {
+        auto* job = find(id);
+        if (job == nullptr)
+        {
+            return false;
+        }
+
+        if (!job->done)
+        {
+            if (loop != nullptr)
+            {
+                loop->wait_exit(job->pidfd, true);
+            }
+            finish(*job);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Removes a finished job from the table
+     *
+     * @param id Job id
+     * @return std::optional<Job> The job, or nullopt if it does not exist or still runs
+     */
+    auto JobTable::collect(int id) -> std::optional<Job>
+    {
+        auto it = jobs.find(id);
+        if (it == jobs.end() || !it->second.done)
+        {
+            return std::nullopt;
+        }
+
+        Job job = std::move(it->second);
+        jobs.erase(it);
+        return job;
+    }
+
+    auto JobTable::find(int id) -> Job*
+    {
+        auto it = jobs.find(id);
+        return it == jobs.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * @brief Id of the most recently started job, 0 if there are none
+     */
+    int JobTable::current() const
+    {
+        return jobs.empty() ? 0 : jobs.rbegin()->first;
+    }
+
+    /**
+     * @brief Reaps an exited job through its pidfd and fills its result
+     *
+     * @param job Job whose pidfd is readable
+     */
+    void JobTable::finish(Job& job)
+    {
+        // without a pidfd the job is only finished by a blocking wait
+        idtype_t idtype = job.pidfd >= 0 ? P_PIDFD : P_PID;
+        auto ident = static_cast<id_t>(job.pidfd >= 0 ? job.pidfd : job.pid);
+
+        // the raw syscall also reports rusage, which the glibc wrapper drops
+        siginfo_t info {};
+        rusage usage {};
+        long rc = 0;
+        while ((rc = syscall(SYS_waitid, idtype, ident, &info, WEXITED, &usage)) == -1 &&
+               errno == EINTR)
+        {
+        }
+
+        if (rc == 0)
+        {
+            job.result.return_code = info.si_code == CLD_EXITED
+                                         ? info.si_status
+                                         : shell::EXIT_SIGNAL_BASE + info.si_status;
+            job.result.usage = command::to_usage(usage);
+            // up to when the shell noticed the exit
+            job.result.usage->wall = std::chrono::steady_clock::now() - job.started;
+        }
+
+        if (job.pidfd >= 0)
+        {
+            close(job.pidfd);
+            job.pidfd = -1;
+        }
+
+        take_output(job.out, job.spill_threshold, job.result.stdout_data, job.result.stdout_spill);
+        take_output(job.err, job.spill_threshold, job.result.stderr_data, job.result.stderr_spill);
+        job.out.reset();
+        job.err.reset();
+        job.done = true;
+    }
+} // namespace nullsh::jobs
\ No newline at end of file
@@ -0,0 +1,241 @@
+/**
+ * @file launcher.cpp
+ * @brief Process launchers for external commands
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/launcher.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+
+#include "nullsh/shell.h"
+
+namespace nullsh::launcher
+{
+    namespace
+    {
+        // the child only runs prepare_child() and execve() on it
+        constexpr std::size_t CHILD_STACK_SIZE = 64UL * 1024;
+
+        struct ChildArgs
+        {
+            const LaunchSpec* spec;
+            const sigset_t* sigmask;
+            int err_fd;
+        };
+
+        /**
+         * @brief Child side of every launcher, must stay async-signal-safe
+         *
+         * Wires stdio, trims every other inherited fd and execs. If exec fails the errno is
+         * reported through the CLOEXEC error pipe, which exec closes on success.
+         */
+        [[noreturn]] void exec_child(const ChildArgs& args)
+        {
+            const LaunchSpec& spec = *args.spec;
+
+            if (spec.new_group)
+            {
+                setpgid(0, 0);
+            }
+
+            const sigset_t* mask = spec.sigmask != nullptr ? spec.sigmask : args.sigmask;
+            if (mask != nullptr)
+            {
+                sigprocmask(SIG_SETMASK, mask, nullptr);
+            }
+
+            int target = 0;
+            for (int fd : spec.stdio)
+            {
+                if (fd >= 0 && fd != target)
+                {
+                    dup2(fd, target);
+                }
+                ++target;
+            }
+
+            if (spec.io != nullptr)
+            {
+                spec.io->prepare_child();
+            }
+
+            // everything above stdio is closed on exec, the error pipe included
+            close_range(3, ~0U, CLOSE_RANGE_CLOEXEC);
+
+            execvpe(spec.file, spec.argv, spec.envp);
+
+            int err = errno;
+            while (write(args.err_fd, &err, sizeof(err)) < 0 && errno == EINTR)
+            {
+            }
+            _exit(err == ENOENT ? shell::EXIT_CMD_NOT_FOUND : shell::EXIT_CMD_NOT_EXECUTABLE);
+        }
+
+        int clone_entry(void* arg)
+        {
+            exec_child(*static_cast<ChildArgs*>(arg));
+        }
+
+        /**
+         * @brief Waits for the error pipe to close and returns the exec errno, if any
+         */
+        int read_exec_error(int err_fd)
+        {
+            int err = 0;
+            ssize_t count = 0;
+            do
+            {
+                count = read(err_fd, &err, sizeof(err));
+            } while (count < 0 && errno == EINTR);
+            close(err_fd);
+
+            return count == sizeof(err) ? err : 0;
+        }
+
+        // reaps a child whose exec failed so callers only ever see running processes
+        void reap(pid_t pid)
+        {
+            while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+            {
+            }
+        }
+    } // namespace
+
+    /**
+     * @brief Launches with a plain fork(), copying the parent's page tables
+     *
+     * @param spec Prepared argv/envp and stdio wiring
+     * @return Launch pid of the running child, or the errno of fork/exec
+     */
+    Launch launch_fork(const LaunchSpec& spec)
+    {
+        std::array<int, 2> err_pipe {-1, -1};
+        if (pipe2(err_pipe.data(), O_CLOEXEC) < 0)
+        {
+            return {.pid = -1, .error = errno};
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(err_pipe[0]);
+            exec_child({.spec = &spec, .sigmask = nullptr, .err_fd = err_pipe[1]});
+        }
+
+        int fork_err = errno;
+        close(err_pipe[1]);
+        if (pid < 0)
+        {
+            close(err_pipe[0]);
+            return {.pid = -1, .error = fork_err};
+        }
+
+        if (int err = read_exec_error(err_pipe[0]); err != 0)
+        {
+            reap(pid);
+            return {.pid = -1, .error = err};
+        }
+
+        return {.pid = pid, .error = 0};
+    }
+
+    /**
+     * @brief Launches with clone(CLONE_VM | CLONE_VFORK), sharing the parent's memory
+     *
+     * The parent is suspended until the child execs or exits, so the cost does not depend on
+     * the parent's RSS. All signals are blocked around the clone so no handler can run on the
+     * shared memory before exec; the child restores the original mask itself, or installs
+     * spec.sigmask.
+     *
+     * @param spec Prepared argv/envp and stdio wiring
+     * @return Launch pid of the running child, or the errno of clone/exec
+     */
+    Launch launch_vfork(const LaunchSpec& spec)
+    {
+        // not thread safe: one launch at a time
+        alignas(16) static std::array<std::byte, CHILD_STACK_SIZE> child_stack {};
+
+        std::array<int, 2> err_pipe {-1, -1};
+        if (pipe2(err_pipe.data(), O_CLOEXEC) < 0)
+        {
+            return {.pid = -1, .error = errno};
+        }
+
+        sigset_t all {};
+        sigset_t old {};
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+
+        ChildArgs args {.spec = &spec, .sigmask = &old, .err_fd = err_pipe[1]};
+        pid_t pid = clone(&clone_entry,
+                          child_stack.data() + child_stack.size(),
+                          CLONE_VM | CLONE_VFORK | SIGCHLD,
+                          &args);
+        int clone_err = errno;
+
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+        close(err_pipe[1]);
+
+        if (pid < 0)
+        {
+            close(err_pipe[0]);
+            return {.pid = -1, .error = clone_err};
+        }
+
+        // the child has exec'd or exited by now, the read never blocks
+        if (int err = read_exec_error(err_pipe[0]); err != 0)
+        {
+            reap(pid);
+            return {.pid = -1, .error = err};
+        }
+
+        return {.pid = pid, .error = 0};
+    }
+
+    /**
+     * @brief Opens a pidfd for a child, readable once it has exited
+     *
+     * Goes through syscall() because the glibc 2.36 pidfd_open() wrapper lacks C linkage.
+     *
+     * @param pid Child process
+     * @return int The pidfd, or -1 on failure
+     */
+    int open_pidfd(pid_t pid)
+    {
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    }
+
+    /**
+     * @brief Sends a signal through a pidfd, which cannot hit a recycled pid
+     *
+     * @return true if the signal was sent
+     */
+    bool signal_pidfd(int pidfd, int sig)
+    {
+        return syscall(SYS_pidfd_send_signal, pidfd, sig, nullptr, 0) == 0;
+    }
+
+    /**
+     * @brief Tells without blocking whether the child behind a pidfd has exited
+     *
+     * @return true once the child is a zombie or reaped
+     */
+    bool pidfd_exited(int pidfd)
+    {
+        pollfd pfd {.fd = pidfd, .events = POLLIN, .revents = 0};
+        return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN) != 0;
+    }
+} // namespace nullsh::launcher
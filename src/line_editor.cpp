@@ -0,0 +1,726 @@
+/**
+ * @file line_editor.cpp
+ * @brief Raw-mode line editor for the interactive prompt, with incremental redraws
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/line_editor.h"
+
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <format>
+
+#include "nullsh/util.h"
+
+namespace nullsh::edit
+{
+    namespace
+    {
+        constexpr int ESC = 0x1b;
+        constexpr int BACKSPACE = 0x7f;
+
+        constexpr int ctrl(char chr)
+        {
+            return chr & 0x1f;
+        }
+
+        bool is_continuation(char chr)
+        {
+            return (static_cast<unsigned char>(chr) & 0xc0U) == 0x80U;
+        }
+
+        // Puts a terminal in raw mode for as long as it lives; does nothing on anything else
+        class RawMode
+        {
+          public:
+            explicit RawMode(int fd) : fd_(fd)
+            {
+                if (tcgetattr(fd_, &saved_) < 0)
+                {
+                    return;
+                }
+                termios raw = saved_;
+                raw.c_iflag &= ~static_cast<tcflag_t>(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+                raw.c_lflag &= ~static_cast<tcflag_t>(ECHO | ICANON | IEXTEN | ISIG);
+                raw.c_cc[VMIN] = 1;
+                raw.c_cc[VTIME] = 0;
+                active_ = tcsetattr(fd_, TCSADRAIN, &raw) == 0;
+            }
+            ~RawMode()
+            {
+                if (active_)
+                {
+                    tcsetattr(fd_, TCSADRAIN, &saved_);
+                }
+            }
+            RawMode(const RawMode&) = delete;
+            RawMode& operator=(const RawMode&) = delete;
+            RawMode(RawMode&&) = delete;
+            RawMode& operator=(RawMode&&) = delete;
+
+          private:
+            int fd_;
+            termios saved_ {};
+            bool active_ {false};
+        };
+
+        std::size_t terminal_width(int fd)
+        {
+            winsize size {};
+            if (ioctl(fd, TIOCGWINSZ, &size) < 0)
+            {
+                return 0;
+            }
+            return size.ws_col;
+        }
+
+        bool is_blank(char chr)
+        {
+            return chr == ' ' || chr == '\t';
+        }
+    } // namespace
+
+    std::size_t columns(std::string_view text)
+    {
+        return static_cast<std::size_t>(std::ranges::count_if(
+            text, [](char chr) { return !is_continuation(chr); }));
+    }
+
+    // ===== LineBuffer =====
+
+    void LineBuffer::insert(std::string_view text)
+    {
+        text_.insert(cursor_, text);
+        cursor_ += text.size();
+    }
+
+    void LineBuffer::assign(std::string_view text)
+    {
+        text_ = text;
+        cursor_ = text_.size();
+    }
+
+    bool LineBuffer::erase_before()
+    {
+        std::size_t old = cursor_;
+        if (!move_left())
+        {
+            return false;
+        }
+        text_.erase(cursor_, old - cursor_);
+        return true;
+    }
+
+    bool LineBuffer::erase_at()
+    {
+        std::size_t old = cursor_;
+        if (!move_right())
+        {
+            return false;
+        }
+        text_.erase(old, cursor_ - old);
+        cursor_ = old;
+        return true;
+    }
+
+    bool LineBuffer::move_left()
+    {
+        if (cursor_ == 0)
+        {
+            return false;
+        }
+        do
+        {
+            --cursor_;
+        } while (cursor_ > 0 && is_continuation(text_[cursor_]));
+        return true;
+    }
+
+    bool LineBuffer::move_right()
+    {
+        if (cursor_ == text_.size())
+        {
+            return false;
+        }
+        do
+        {
+            ++cursor_;
+        } while (cursor_ < text_.size() && is_continuation(text_[cursor_]));
+        return true;
+    }
+
+    void LineBuffer::home()
+    {
+        cursor_ = 0;
+    }
+
+    void LineBuffer::end()
+    {
+        cursor_ = text_.size();
+    }
+
+    void LineBuffer::kill_to_end()
+    {
+        text_.erase(cursor_);
+    }
+
+    void LineBuffer::kill_to_start()
+    {
+        text_.erase(0, cursor_);
+        cursor_ = 0;
+    }
+
+    // the word before the cursor and the blanks after it, like ^W in a terminal
+    void LineBuffer::erase_word()
+    {
+        std::size_t start = cursor_;
+        while (start > 0 && is_blank(text_[start - 1]))
+        {
+            --start;
+        }
+        while (start > 0 && !is_blank(text_[start - 1]))
+        {
+            --start;
+        }
+        text_.erase(start, cursor_ - start);
+        cursor_ = start;
+    }
+
+    // ===== Renderer =====
+
+    /**
+     * @brief Starts a new line, the prompt having just been written
+     *
+     * @param prompt Prompt text, for its width
+     * @param width Terminal columns, 0 if lines never wrap
+     */
+    void Renderer::reset(std::string_view prompt, std::size_t width)
+    {
+        width_ = width;
+        prompt_cols_ = columns(prompt);
+        shown_.clear();
+        cursor_col_ = prompt_cols_;
+    }
+
+    /**
+     * @brief Appends to out what brings the terminal to the buffer's state
+     *
+     * @param buf Line and cursor to show
+     * @param out Receives the text and escape sequences to write
+     */
+    void Renderer::render(const LineBuffer& buf, std::string& out)
+    {
+        const std::string& text = buf.text();
+        if (text != shown_)
+        {
+            auto same = static_cast<std::size_t>(
+                std::ranges::mismatch(text, shown_).in1 - text.begin());
+            while (same > 0 && same < text.size() && is_continuation(text[same]))
+            {
+                --same;
+            }
+
+            move(cursor_col_, prompt_cols_ + columns(std::string_view(text).substr(0, same)), out);
+            out.append(text, same);
+
+            std::size_t end = prompt_cols_ + columns(text);
+            if (width_ > 0 && end % width_ == 0 && same < text.size())
+            {
+                out += "\r\n"; // leave the pending wrap, so the cursor is where it is counted
+            }
+            if (columns(text) < columns(shown_))
+            {
+                out += "\x1b[J";
+            }
+            cursor_col_ = end;
+            shown_ = text;
+        }
+
+        auto target = prompt_cols_ + columns(std::string_view(text).substr(0, buf.cursor()));
+        move(cursor_col_, target, out);
+        cursor_col_ = target;
+    }
+
+    /**
+     * @brief Appends to out what takes the cursor back to the start of the prompt and erases
+     * the prompt and the line, for them to be written again
+     *
+     * After a resize the rows are counted with the old width, which is where the terminal
+     * leaves them unless it rewraps.
+     *
+     * @param out Receives the escape sequences to write
+     */
+    void Renderer::clear(std::string& out)
+    {
+        std::size_t row = width_ == 0 ? 0 : cursor_col_ / width_;
+        if (row > 0)
+        {
+            out += std::format("\x1b[{}A", row);
+        }
+        out += "\r\x1b[J";
+        shown_.clear();
+        cursor_col_ = 0;
+    }
+
+    // relative moves only: the renderer never knows where on the screen the prompt is
+    void Renderer::move(std::size_t from, std::size_t to, std::string& out) const
+    {
+        if (from == to)
+        {
+            return;
+        }
+
+        std::size_t from_row = width_ == 0 ? 0 : from / width_;
+        std::size_t to_row = width_ == 0 ? 0 : to / width_;
+        std::size_t from_col = width_ == 0 ? from : from % width_;
+        std::size_t to_col = width_ == 0 ? to : to % width_;
+
+        if (to_row < from_row)
+        {
+            out += std::format("\x1b[{}A", from_row - to_row);
+        }
+        else if (to_row > from_row)
+        {
+            out += std::format("\x1b[{}B", to_row - from_row);
+        }
+
+        if (to_col < from_col)
+        {
+            out += std::format("\x1b[{}D", from_col - to_col);
+        }
+        else if (to_col > from_col)
+        {
+            out += std::format("\x1b[{}C", to_col - from_col);
+        }
+    }
+
+    // ===== LineEditor =====
+
+    /**
+     * @brief Reads one line, with editing, completion and history
+     *
+     * The terminal is in raw mode only while the line is read, so commands run on a terminal
+     * as the shell found it. Keys: arrows, Home/End, ^A ^E ^B ^F, Backspace/^H, Delete, ^D
+     * (end of input on an empty line), ^K ^U ^W, ^L, ^C (drops the line), Tab, and Up/Down
+     * through the history lines starting with what was typed. Input that is not a terminal
+     * is edited the same way, without echo from the kernel.
+     *
+     * On the shell's loop a SIGINT drops the line like ^C, a resize draws the line again at
+     * the new width and a child exit shows the notices above it. The input is in the loop's
+     * set only while the line is read: what is typed during a command is not the shell's.
+     *
+     * @param prompt Prompt to show
+     * @return std::optional<std::string> The line, or nullopt at the end of input
+     */
+    auto LineEditor::read_line(std::string_view prompt) -> std::optional<std::string>
+    {
+        watched_ = loop_ != nullptr && loop_->add(in_fd_);
+        auto line = edit(prompt);
+        if (watched_)
+        {
+            loop_->remove(in_fd_);
+            watched_ = false;
+        }
+        return line;
+    }
+
+    // ===== Private functions =====
+
+    auto LineEditor::edit(std::string_view prompt) -> std::optional<std::string>
+    {
+        RawMode raw {in_fd_};
+        std::size_t width = terminal_width(out_fd_);
+
+        LineBuffer buf;
+        renderer_.reset(prompt, width);
+        step_ = 0;
+        util::write_all(out_fd_, prompt);
+
+        while (true)
+        {
+            auto key = next_key();
+            if (!key)
+            {
+                if (buf.text().empty())
+                {
+                    return std::nullopt;
+                }
+                util::write_all(out_fd_, "\n");
+                return buf.text();
+            }
+
+            out_.clear();
+            bool recalling = *key == KEY_UP || *key == KEY_DOWN;
+            if (!recalling)
+            {
+                step_ = 0;
+            }
+
+            switch (*key)
+            {
+                case '\r':
+                case '\n':
+                    buf.end();
+                    renderer_.render(buf, out_);
+                    out_ += '\n';
+                    util::write_all(out_fd_, out_);
+                    return buf.text();
+                case ctrl('C'):
+                case KEY_INTERRUPT:
+                    buf.end();
+                    renderer_.render(buf, out_);
+                    out_ += "^C\n";
+                    util::write_all(out_fd_, out_);
+                    return std::string {};
+                case ctrl('D'):
+                    if (buf.text().empty())
+                    {
+                        util::write_all(out_fd_, "\n");
+                        return std::nullopt;
+                    }
+                    buf.erase_at();
+                    break;
+                case '\t':
+                    complete(buf, prompt, width);
+                    break;
+                case BACKSPACE:
+                case ctrl('H'):
+                    buf.erase_before();
+                    break;
+                case KEY_DELETE:
+                    buf.erase_at();
+                    break;
+                case KEY_LEFT:
+                case ctrl('B'):
+                    buf.move_left();
+                    break;
+                case KEY_RIGHT:
+                case ctrl('F'):
+                    buf.move_right();
+                    break;
+                case KEY_HOME:
+                case ctrl('A'):
+                    buf.home();
+                    break;
+                case KEY_END:
+                case ctrl('E'):
+                    buf.end();
+                    break;
+                case ctrl('K'):
+                    buf.kill_to_end();
+                    break;
+                case ctrl('U'):
+                    buf.kill_to_start();
+                    break;
+                case ctrl('W'):
+                    buf.erase_word();
+                    break;
+                case ctrl('L'):
+                    out_ += "\x1b[H\x1b[2J";
+                    out_ += prompt;
+                    renderer_.reset(prompt, width);
+                    break;
+                case KEY_UP:
+                case KEY_DOWN:
+                    recall(buf, *key == KEY_UP);
+                    break;
+                case KEY_RESIZE:
+                    width = terminal_width(out_fd_);
+                    redraw(prompt, width, {});
+                    break;
+                case KEY_CHILD:
+                    if (notices_)
+                    {
+                        if (auto text = notices_(); !text.empty())
+                        {
+                            redraw(prompt, width, text);
+                        }
+                    }
+                    break;
+                default:
+                    // printable, UTF-8 sequences byte by byte
+                    if (*key >= ' ' && *key != BACKSPACE && *key < KEY_NONE)
+                    {
+                        auto chr = static_cast<char>(*key);
+                        buf.insert({&chr, 1});
+                    }
+                    break;
+            }
+
+            renderer_.render(buf, out_);
+            if (!out_.empty())
+            {
+                util::write_all(out_fd_, out_);
+            }
+        }
+    }
+
+    /**
+     * @brief Decodes the next key from the input
+     *
+     * @return std::optional<int> A byte, or a Key for an escape sequence (KEY_NONE for those
+     *         not bound) or a signal; nullopt at the end of input
+     */
+    auto LineEditor::next_key() -> std::optional<int>
+    {
+        if (pending_.empty())
+        {
+            if (auto key = signal_key())
+            {
+                return key;
+            }
+            if (!fill(-1))
+            {
+                return signal_key(); // woken by a signal, or the input ended
+            }
+        }
+
+        auto take = [this]
+        {
+            auto byte = static_cast<unsigned char>(pending_.front());
+            pending_.erase(0, 1);
+            return static_cast<int>(byte);
+        };
+
+        int byte = take();
+        if (byte != ESC)
+        {
+            return byte;
+        }
+
+        // ESC [ params final, or ESC O final; the rest of a sequence may come a bit later
+        if (pending_.empty() && !fill(ESC_TIMEOUT_MS))
+        {
+            return KEY_NONE;
+        }
+        int kind = take();
+        if (kind != '[' && kind != 'O')
+        {
+            return KEY_NONE;
+        }
+
+        std::string params;
+        while (true)
+        {
+            if (pending_.empty() && !fill(ESC_TIMEOUT_MS))
+            {
+                return KEY_NONE;
+            }
+            int chr = take();
+            if (chr >= 0x40 && chr <= 0x7e)
+            {
+                switch (chr)
+                {
+                    case 'A':
+                        return KEY_UP;
+                    case 'B':
+                        return KEY_DOWN;
+                    case 'C':
+                        return KEY_RIGHT;
+                    case 'D':
+                        return KEY_LEFT;
+                    case 'H':
+                        return KEY_HOME;
+                    case 'F':
+                        return KEY_END;
+                    case '~':
+                        if (params == "1" || params == "7")
+                        {
+                            return KEY_HOME;
+                        }
+                        if (params == "4" || params == "8")
+                        {
+                            return KEY_END;
+                        }
+                        return params == "3" ? KEY_DELETE : KEY_NONE;
+                    default:
+                        return KEY_NONE;
+                }
+            }
+            params.push_back(static_cast<char>(chr));
+        }
+    }
+
+    // the signals the loop caught, as keys; nullopt if none
+    auto LineEditor::signal_key() -> std::optional<int>
+    {
+        if (loop_ == nullptr)
+        {
+            return std::nullopt;
+        }
+        if (loop_->take_interrupt() != io::Interrupt::None)
+        {
+            return KEY_INTERRUPT;
+        }
+        if (loop_->take_resize())
+        {
+            return KEY_RESIZE;
+        }
+        if (loop_->take_child())
+        {
+            return KEY_CHILD;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Reads what the input has, waiting at most timeout_ms (-1: until it has something)
+     *
+     * @return true if bytes were added to pending_, false on timeout, end of input, error or,
+     *         on the loop, a signal
+     */
+    bool LineEditor::fill(int timeout_ms)
+    {
+        if (watched_)
+        {
+            // the input is all the loop watches while a line is read
+            auto ready = loop_->wait(timeout_ms);
+            if (!ready || ready->empty())
+            {
+                return false;
+            }
+        }
+        else if (timeout_ms >= 0)
+        {
+            pollfd pfd {.fd = in_fd_, .events = POLLIN, .revents = 0};
+            int ready = 0;
+            do
+            {
+                ready = poll(&pfd, 1, timeout_ms);
+            } while (ready < 0 && errno == EINTR);
+            if (ready <= 0)
+            {
+                return false;
+            }
+        }
+
+        std::array<char, 256> chunk {};
+        ssize_t len = 0;
+        do
+        {
+            len = read(in_fd_, chunk.data(), chunk.size());
+        } while (len < 0 && errno == EINTR);
+        if (len <= 0)
+        {
+            return false;
+        }
+        pending_.append(chunk.data(), static_cast<std::size_t>(len));
+        return true;
+    }
+
+    /**
+     * @brief Completes the word before the cursor, or lists the candidates if it can't
+     */
+    void LineEditor::complete(LineBuffer& buf, std::string_view prompt, std::size_t width)
+    {
+        if (completer_ == nullptr)
+        {
+            out_ += '\a';
+            return;
+        }
+
+        auto res = completer_->complete(buf.text(), buf.cursor());
+        if (!res.insert.empty())
+        {
+            buf.insert(res.insert);
+            return;
+        }
+        if (res.candidates.size() < 2)
+        {
+            out_ += '\a';
+            return;
+        }
+
+        // below the line, in columns, then the prompt and the line again
+        std::size_t widest = 0;
+        for (const auto& name : res.candidates)
+        {
+            widest = std::max(widest, columns(name));
+        }
+        std::size_t cell = widest + 2;
+        std::size_t per_row =
+            width == 0 ? res.candidates.size() : std::max<std::size_t>(1, width / cell);
+
+        LineBuffer end = buf;
+        end.end();
+        renderer_.render(end, out_);
+        out_ += '\n';
+        for (std::size_t idx = 0; idx < res.candidates.size(); ++idx)
+        {
+            const auto& name = res.candidates[idx];
+            bool last_in_row = (idx + 1) % per_row == 0 || idx + 1 == res.candidates.size();
+            out_ += name;
+            if (!last_in_row)
+            {
+                out_.append(cell - columns(name), ' ');
+            }
+            else
+            {
+                out_ += '\n';
+            }
+        }
+        if (res.total > res.candidates.size())
+        {
+            out_ += std::format("({} more)\n", res.total - res.candidates.size());
+        }
+
+        out_ += prompt;
+        renderer_.reset(prompt, width);
+    }
+
+    // erases the prompt and the line, shows above above them, and writes the prompt again
+    void LineEditor::redraw(std::string_view prompt, std::size_t width, std::string_view above)
+    {
+        renderer_.clear(out_);
+        out_ += above;
+        out_ += prompt;
+        renderer_.reset(prompt, width);
+    }
+
+    /**
+     * @brief Steps through the history lines starting with what was typed before the first Up
+     *
+     * @param older true for Up, false for Down
+     */
+    void LineEditor::recall(LineBuffer& buf, bool older)
+    {
+        if (history_ == nullptr)
+        {
+            out_ += '\a';
+            return;
+        }
+
+        if (step_ == 0)
+        {
+            if (!older)
+            {
+                return;
+            }
+            saved_ = buf.text();
+            matches_ = history_->search(saved_, HISTORY_STEPS);
+            std::erase(matches_, std::string_view(saved_)); // would look like nothing happened
+        }
+
+        if (older)
+        {
+            if (step_ == matches_.size())
+            {
+                out_ += '\a';
+                return;
+            }
+            ++step_;
+        }
+        else
+        {
+            --step_;
+        }
+        buf.assign(step_ == 0 ? std::string_view(saved_) : matches_[step_ - 1]);
+    }
+} // namespace nullsh::edit
\ No newline at end of file
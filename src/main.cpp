@@ -5,12 +5,16 @@
  * @license GPLv3 (see LICENSE file)
  */
 
-#include <iostream>
+#include <unistd.h>
+
+#include <format>
 #include <span>
 #include <string>
 
 #include "nullsh/cli.h"
+#include "nullsh/server.h"
 #include "nullsh/shell.h"
+#include "nullsh/tokenizer.h"
 #include "nullsh/util.h"
 
 int main(int argc, const char* argv[])
@@ -21,23 +25,66 @@ int main(int argc, const char* argv[])
 
     if (!cli)
     {
-        std::cerr << "nullsh: " << cli.error() << "\n";
+        nullsh::util::write_all(STDERR_FILENO, std::format("nullsh: {}\n", cli.error()));
         return 2;
     }
 
     nullsh::shell::NullShell shell {};
+    if (cli->spill_threshold)
+    {
+        shell.exec_options().spill_threshold = *cli->spill_threshold;
+    }
+    if (cli->memo_size)
+    {
+        shell.memo().set_capacity(*cli->memo_size);
+    }
+    if (cli->memo_dir)
+    {
+        const auto& dir = *cli->memo_dir; // NOLINT(bugprone-unchecked-optional-access)
+        auto opened = shell.memo().open_store(dir);
+        if (!opened)
+        {
+            nullsh::util::write_all(STDERR_FILENO,
+                                    std::format("nullsh: {}: {}\n", dir, opened.error()));
+        }
+    }
+
+    if (cli->client)
+    {
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        return nullsh::server::run_client(*cli->client, *cli->one_shot);
+    }
+
+    if (cli->server)
+    {
+        return nullsh::server::run_server(*cli->server, shell);
+    }
 
     if (cli->one_shot)
     {
-        auto tokens =
-            nullsh::util::tokenize(*cli->one_shot); // NOLINT(bugprone-unchecked-optional-access)
+        const auto& line = *cli->one_shot; // NOLINT(bugprone-unchecked-optional-access)
+        auto tokens = nullsh::util::tokenize_views(line, shell.variables());
         if (!tokens)
         {
-            std::cerr << "parse error: " << tokens.error() << "\n";
+            nullsh::util::write_all(STDERR_FILENO,
+                                    std::format("parse error: {}\n", tokens.error()));
             return 2;
         }
 
-        return shell.execute(tokens.value());
+        return shell.execute_last(*tokens);
+    }
+
+    if (cli->script)
+    {
+        const auto& path = *cli->script; // NOLINT(bugprone-unchecked-optional-access)
+        auto rc = shell.source(path);
+        if (!rc)
+        {
+            nullsh::util::write_all(STDERR_FILENO,
+                                    std::format("nullsh: {}: {}\n", path, rc.error()));
+            return nullsh::shell::EXIT_CMD_NOT_FOUND;
+        }
+        return *rc;
     }
 
     if (getenv("NULLSH_IN_TERMINAL") == nullptr && cli->spawn_term)
@@ -57,7 +104,19 @@ int main(int argc, const char* argv[])
         return system(cmd.c_str());
     }
 
-    shell.run();
+    if (cli->history)
+    {
+        const auto& path = *cli->history; // NOLINT(bugprone-unchecked-optional-access)
+        auto enabled = shell.enable_history(path);
+        if (!enabled)
+        {
+            nullsh::util::write_all(STDERR_FILENO,
+                                    std::format("nullsh: {}: {}\n", path, enabled.error()));
+        }
+    }
+
+    int rc = shell.run();
 
-    return 0;
+    // the interactive loop ends on EOF, reading commands from a pipe ends with their status
+    return rc < 0 ? 0 : rc;
 }
\ No newline at end of file
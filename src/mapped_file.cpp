@@ -0,0 +1,142 @@
+/**
+ * @file mapped_file.cpp
+ * @brief Read-only memory mapped file and a line reader over it
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace nullsh::io
+{
+    MappedFile::~MappedFile()
+    {
+        if (addr_ != nullptr)
+        {
+            munmap(addr_, size_);
+        }
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : addr_(std::exchange(other.addr_, nullptr)), size_(std::exchange(other.size_, 0))
+    {
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (addr_ != nullptr)
+            {
+                munmap(addr_, size_);
+            }
+            addr_ = std::exchange(other.addr_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Maps a whole file read-only
+     *
+     * For sequential access the pages are populated up front, so the scan does not fault on
+     * every page. Random access maps lazily and turns off read-ahead, so a lookup only pages in
+     * what it touches. An empty file maps to an empty view.
+     *
+     * @param path File to map
+     * @param access How the mapping will be read
+     * @return std::expected<MappedFile, std::string> The mapping, or the reason it failed
+     */
+    auto MappedFile::open(const std::string& path, Access access)
+        -> std::expected<MappedFile, std::string>
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return std::unexpected(std::strerror(errno));
+        }
+
+        struct stat info {};
+        int err = 0;
+        if (fstat(fd, &info) < 0)
+        {
+            err = errno;
+        }
+        else if (S_ISDIR(info.st_mode))
+        {
+            err = EISDIR;
+        }
+        else if (!S_ISREG(info.st_mode))
+        {
+            err = EINVAL; // pipes and devices have no size to map
+        }
+        if (err != 0)
+        {
+            close(fd);
+            return std::unexpected(std::strerror(err));
+        }
+
+        auto size = static_cast<std::size_t>(info.st_size);
+        if (size == 0)
+        {
+            close(fd);
+            return MappedFile {};
+        }
+
+        bool sequential = access == Access::Sequential;
+        int flags = sequential ? MAP_PRIVATE | MAP_POPULATE : MAP_PRIVATE;
+        void* addr = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+        err = errno;
+        close(fd); // the mapping keeps the file alive
+        if (addr == MAP_FAILED)
+        {
+            return std::unexpected(std::strerror(err));
+        }
+
+        madvise(addr, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        return MappedFile {addr, size};
+    }
+
+    /**
+     * @brief Returns the next line, without its terminating newline (nor a CR before it)
+     *
+     * @return std::optional<std::string_view> The line, or nullopt at the end of the buffer
+     */
+    auto LineReader::next() -> std::optional<std::string_view>
+    {
+        if (rest_.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::string_view line = rest_;
+        const void* newline = std::memchr(rest_.data(), '\n', rest_.size());
+        if (newline != nullptr)
+        {
+            auto len = static_cast<std::size_t>(static_cast<const char*>(newline) - rest_.data());
+            line = rest_.substr(0, len);
+            rest_.remove_prefix(len + 1);
+        }
+        else
+        {
+            rest_ = {};
+        }
+
+        if (line.ends_with('\r'))
+        {
+            line.remove_suffix(1);
+        }
+
+        ++line_;
+        return line;
+    }
+} // namespace nullsh::io
\ No newline at end of file
@@ -0,0 +1,352 @@
+/**
+ * @file memo_cache.cpp
+ * @brief Results of deterministic commands kept by the memo builtin, in memory and on disk
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/memo_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <utility>
+
+#include "nullsh/mapped_file.h"
+#include "nullsh/util.h"
+
+namespace nullsh::memo
+{
+    namespace
+    {
+        constexpr std::array<char, 8> MAGIC {'N', 'S', 'H', 'M', 'E', 'M', 'O', '1'};
+        constexpr std::string_view SUFFIX = ".memo";
+
+        // followed by the key, stdout and stderr, back to back
+        struct Header
+        {
+            std::array<char, 8> magic;
+            std::int64_t return_code;
+            std::uint64_t key_size;
+            std::uint64_t out_size;
+            std::uint64_t err_size;
+        };
+    } // namespace
+
+    /**
+     * @brief 64-bit FNV-1a of a buffer, to name disk entries and fingerprint dependencies
+     */
+    auto digest(std::string_view data) -> std::uint64_t
+    {
+        constexpr std::uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+        constexpr std::uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+        std::uint64_t hash = FNV_OFFSET;
+        for (char c : data)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    void KeyBuilder::add(std::string_view field)
+    {
+        key_ += std::format("{}:", field.size());
+        key_ += field;
+    }
+
+    // an unset variable and an empty one are different keys
+    void KeyBuilder::add_var(std::string_view name, std::optional<std::string_view> value)
+    {
+        add(name);
+        add(value ? std::format("={}", *value) : std::string {});
+    }
+
+    /**
+     * @brief Adds a file by its metadata: modification and change times, size and inode
+     *
+     * Cheap, and enough for files rewritten in place or replaced. A missing file is a key too,
+     * so the entry goes stale once it appears.
+     *
+     * @param path File or directory the command depends on
+     */
+    void KeyBuilder::add_stamp(const std::string& path)
+    {
+        add(path);
+
+        struct stat info {};
+        if (stat(path.c_str(), &info) < 0)
+        {
+            add({});
+            return;
+        }
+        add(std::format("{}.{}:{}.{}:{}:{}:{}",
+                        info.st_mtim.tv_sec,
+                        info.st_mtim.tv_nsec,
+                        info.st_ctim.tv_sec,
+                        info.st_ctim.tv_nsec,
+                        info.st_size,
+                        info.st_dev,
+                        info.st_ino));
+    }
+
+    /**
+     * @brief Adds a file by a hash of its content, for files whose times change more often
+     *
+     * @param path Regular file the command depends on; a missing one is a key as well
+     * @return std::expected<void, std::string> The reason the file could not be read
+     */
+    auto KeyBuilder::add_digest(const std::string& path) -> std::expected<void, std::string>
+    {
+        add(path);
+
+        struct stat info {};
+        if (stat(path.c_str(), &info) < 0)
+        {
+            add({});
+            return {};
+        }
+
+        auto file = io::MappedFile::open(path);
+        if (!file)
+        {
+            return std::unexpected(file.error());
+        }
+        add(std::format("#{:016x}", digest(file->view())));
+        return {};
+    }
+
+    /**
+     * @brief Returns a copy of the result stored under key, from memory or from the store
+     *
+     * @param key Key from a KeyBuilder
+     * @return std::optional<command::CommandResult> Exit code and output, nullopt on a miss
+     */
+    auto MemoCache::lookup(std::string_view key) -> std::optional<command::CommandResult>
+    {
+        auto it = index_.find(key);
+        if (it == index_.end() && !dir_.empty())
+        {
+            if (auto entry = load(key))
+            {
+                insert(std::move(*entry));
+                it = index_.find(key);
+            }
+        }
+        if (it == index_.end())
+        {
+            ++misses_;
+            return std::nullopt;
+        }
+
+        // a hit moves to the front
+        lru_.splice(lru_.begin(), lru_, it->second);
+        ++hits_;
+
+        const Entry& entry = *it->second;
+        return command::CommandResult {
+            .return_code = entry.return_code, .stdout_data = entry.out, .stderr_data = entry.err};
+    }
+
+    /**
+     * @brief Keeps a result under key, replacing what was there
+     *
+     * Output spilled past the heap threshold is not kept, and an entry larger than the whole
+     * capacity only goes to the store.
+     *
+     * @param key Key from a KeyBuilder
+     * @param res Result of the command, its output not printed yet or already
+     * @return true if the result was kept in memory or in the store
+     */
+    bool MemoCache::store(std::string key, const command::CommandResult& res)
+    {
+        if (res.stdout_spill || res.stderr_spill)
+        {
+            return false;
+        }
+
+        Entry entry {.key = std::move(key),
+                     .return_code = res.return_code,
+                     .out = res.stdout_data,
+                     .err = res.stderr_data};
+        bool saved = !dir_.empty() && save(entry);
+        bool kept = entry.size() <= capacity_;
+        insert(std::move(entry));
+        return kept || saved;
+    }
+
+    /**
+     * @brief Forgets every entry, in memory and in the store
+     */
+    void MemoCache::clear()
+    {
+        index_.clear();
+        lru_.clear();
+        bytes_ = 0;
+
+        if (dir_.empty())
+        {
+            return;
+        }
+
+        DIR* dir = opendir(dir_.c_str());
+        if (dir == nullptr)
+        {
+            return;
+        }
+        while (const dirent* ent = readdir(dir))
+        {
+            std::string_view name = ent->d_name;
+            if (name.ends_with(SUFFIX))
+            {
+                unlinkat(dirfd(dir), ent->d_name, 0);
+            }
+        }
+        closedir(dir);
+    }
+
+    void MemoCache::set_capacity(std::size_t capacity)
+    {
+        capacity_ = capacity;
+        evict();
+    }
+
+    /**
+     * @brief Keeps entries in dir as well, creating it if needed
+     *
+     * @param dir Directory of the store, shared by every session using it
+     * @return std::expected<void, std::string> The reason the directory can't be used
+     */
+    auto MemoCache::open_store(const std::string& dir) -> std::expected<void, std::string>
+    {
+        if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)
+        {
+            return std::unexpected(std::strerror(errno));
+        }
+
+        struct stat info {};
+        if (stat(dir.c_str(), &info) < 0)
+        {
+            return std::unexpected(std::strerror(errno));
+        }
+        if (!S_ISDIR(info.st_mode))
+        {
+            return std::unexpected(std::strerror(ENOTDIR));
+        }
+
+        dir_ = dir;
+        return {};
+    }
+
+    // ===== Private functions =====
+
+    void MemoCache::insert(Entry entry)
+    {
+        if (auto it = index_.find(entry.key); it != index_.end())
+        {
+            auto old = it->second;
+            bytes_ -= old->size();
+            index_.erase(it);
+            lru_.erase(old);
+        }
+        if (entry.size() > capacity_)
+        {
+            return;
+        }
+
+        bytes_ += entry.size();
+        lru_.push_front(std::move(entry));
+        index_.emplace(lru_.front().key, lru_.begin());
+        evict();
+    }
+
+    void MemoCache::evict()
+    {
+        while (bytes_ > capacity_ && !lru_.empty())
+        {
+            const Entry& last = lru_.back();
+            bytes_ -= last.size();
+            index_.erase(last.key);
+            lru_.pop_back();
+        }
+    }
+
+    auto MemoCache::file_of(std::string_view key) const -> std::string
+    {
+        return std::format("{}/{:016x}{}", dir_, digest(key), SUFFIX);
+    }
+
+    /**
+     * @brief Reads an entry of the store, if it is whole and stored under this very key
+     */
+    auto MemoCache::load(std::string_view key) const -> std::optional<Entry>
+    {
+        auto file = io::MappedFile::open(file_of(key));
+        if (!file || file->view().size() < sizeof(Header))
+        {
+            return std::nullopt;
+        }
+
+        auto data = file->view();
+        Header hdr {};
+        std::memcpy(&hdr, data.data(), sizeof(hdr));
+        data.remove_prefix(sizeof(hdr));
+
+        bool valid = hdr.magic == MAGIC && hdr.key_size == key.size() &&
+                     data.size() == hdr.key_size + hdr.out_size + hdr.err_size &&
+                     data.starts_with(key);
+        if (!valid)
+        {
+            return std::nullopt;
+        }
+
+        data.remove_prefix(hdr.key_size);
+        return Entry {.key = std::string(key),
+                      .return_code = static_cast<int>(hdr.return_code),
+                      .out = std::string(data.substr(0, hdr.out_size)),
+                      .err = std::string(data.substr(hdr.out_size))};
+    }
+
+    /**
+     * @brief Writes an entry to the store
+     *
+     * The file is written next to its final name and renamed over it, so concurrent sessions
+     * only ever map a whole entry.
+     */
+    bool MemoCache::save(const Entry& entry) const
+    {
+        Header hdr {.magic = MAGIC,
+                    .return_code = entry.return_code,
+                    .key_size = entry.key.size(),
+                    .out_size = entry.out.size(),
+                    .err_size = entry.err.size()};
+
+        auto path = file_of(entry.key);
+        auto tmp = std::format("{}.{}", path, getpid());
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        bool written = util::write_all(fd, {reinterpret_cast<const char*>(&hdr), sizeof(hdr)}) &&
+                       util::write_all(fd, entry.key) && util::write_all(fd, entry.out) &&
+                       util::write_all(fd, entry.err);
+        close(fd);
+
+        if (!written || rename(tmp.c_str(), path.c_str()) < 0)
+        {
+            unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+} // namespace nullsh::memo
\ No newline at end of file
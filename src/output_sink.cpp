@@ -0,0 +1,268 @@
+/**
+ * @file output_sink.cpp
+ * @brief Gathering writer for output produced inside the shell process
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/output_sink.h"
+
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <span>
+
+#include "nullsh/util.h"
+
+namespace nullsh::io
+{
+    OutputSink::~OutputSink()
+    {
+        flush();
+    }
+
+    // makes room for data that missed the fast path, or queues it in place when it is long
+    void OutputSink::write_slow(std::string_view data)
+    {
+        if (data.empty() || discards())
+        {
+            return;
+        }
+
+        if (data.size() <= COPY_LIMIT)
+        {
+            copy(data);
+            return;
+        }
+
+        make_room(0);
+        queue_run();
+        written_ += data.size();
+        last_ = data.back();
+        // writev() does not write through iov_base, the cast only satisfies its signature
+        iov_[count_++] = {.iov_base = const_cast<char*>(data.data()), .iov_len = data.size()};
+    }
+
+    /**
+     * @brief Adds data that does not outlive the call, it is always copied
+     *
+     * @param data Bytes to write
+     */
+    void OutputSink::copy(std::string_view data)
+    {
+        if (discards())
+        {
+            return;
+        }
+
+        while (!data.empty())
+        {
+            auto size = std::min(data.size(), SCRATCH_SIZE);
+            make_room(size);
+            std::memcpy(scratch_.data() + used_, data.data(), size);
+            commit(size);
+            data.remove_prefix(size);
+        }
+    }
+
+    /**
+     * @brief Copies everything left to read from in_fd to the output
+     *
+     * Output bound only for the fd is moved in the kernel, with copy_file_range() between
+     * files or sendfile() from a file to anything else. Pipes, ttys and captures go through
+     * read(). The last byte of an in-kernel copy is not looked at, see finish().
+     *
+     * @param in_fd Descriptor to read from
+     * @return bool false if reading in_fd failed, with errno set
+     */
+    bool OutputSink::copy_from(int in_fd)
+    {
+        flush();
+        if (discards())
+        {
+            // nothing is read, but a directory still fails like it would for read()
+            struct stat st {};
+            if (fstat(in_fd, &st) == 0 && S_ISDIR(st.st_mode))
+            {
+                errno = EISDIR;
+                return false;
+            }
+            return true;
+        }
+
+        constexpr std::size_t KERNEL_CHUNK = std::size_t {1} << 30;
+        bool try_range = capture_ == nullptr;
+        bool try_sendfile = capture_ == nullptr;
+        bool copied = false;
+        while (try_range || try_sendfile)
+        {
+            ssize_t count = try_range
+                                ? copy_file_range(in_fd, nullptr, fd_, nullptr, KERNEL_CHUNK, 0)
+                                : sendfile(fd_, in_fd, nullptr, KERNEL_CHUNK);
+            if (count > 0)
+            {
+                written_ += static_cast<std::size_t>(count);
+                copied = true;
+                continue;
+            }
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (copied)
+            {
+                return count == 0;
+            }
+            // nothing moved yet: an error, an empty file or one the kernel cannot copy (procfs
+            // reports 0), the next way decides
+            if (try_range)
+            {
+                try_range = false;
+            }
+            else
+            {
+                try_sendfile = false;
+            }
+        }
+
+        std::array<char, READ_SIZE> buffer; // NOLINT(*-member-init)
+        while (true)
+        {
+            ssize_t count = read(in_fd, buffer.data(), buffer.size());
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return count == 0;
+            }
+
+            std::string_view chunk(buffer.data(), static_cast<std::size_t>(count));
+            written_ += chunk.size();
+            last_ = chunk.back();
+            if (capture_ != nullptr)
+            {
+                capture_->append(chunk);
+            }
+            if (fd_ >= 0 && !failed_ && !util::write_all(fd_, chunk))
+            {
+                failed_ = true;
+            }
+        }
+    }
+
+    /**
+     * @brief Hands on everything queued, one writev() for the fd, retrying short writes
+     *
+     * @return bool false once a write failed, later output is dropped
+     */
+    bool OutputSink::flush()
+    {
+        queue_run();
+        std::span<iovec> pending(iov_.data(), count_);
+        if (capture_ != nullptr)
+        {
+            for (const auto& frag : pending)
+            {
+                capture_->append(static_cast<const char*>(frag.iov_base), frag.iov_len);
+            }
+        }
+
+        while (fd_ >= 0 && !pending.empty() && !failed_)
+        {
+            // a lone fragment, the usual case, takes the cheaper plain write()
+            ssize_t done = pending.size() == 1
+                               ? ::write(fd_, pending.front().iov_base, pending.front().iov_len)
+                               : writev(fd_, pending.data(), static_cast<int>(pending.size()));
+            if (done < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (done <= 0)
+            {
+                failed_ = true;
+                break;
+            }
+
+            auto left = static_cast<std::size_t>(done);
+            while (!pending.empty() && left >= pending.front().iov_len)
+            {
+                left -= pending.front().iov_len;
+                pending = pending.subspan(1);
+            }
+            if (left > 0)
+            {
+                pending.front().iov_base = static_cast<char*>(pending.front().iov_base) + left;
+                pending.front().iov_len -= left;
+            }
+        }
+
+        count_ = 0;
+        run_ = 0;
+        used_ = 0;
+        return !failed_;
+    }
+
+    /**
+     * @brief Ends the output with a newline if it lacks one, then flushes
+     *
+     * Same rule as command::sanitize_result() applies to captured output.
+     *
+     * @return bool false if a write failed
+     */
+    bool OutputSink::finish()
+    {
+        if (written_ > 0 && last_ != '\n')
+        {
+            put('\n');
+        }
+        return flush();
+    }
+
+    // makes sure size bytes of scratch are free, and slots for the pending run, one fragment
+    // and the run that may follow it
+    void OutputSink::make_room(std::size_t size)
+    {
+        if (count_ + 3 > MAX_FRAGMENTS || size > SCRATCH_SIZE - used_)
+        {
+            flush();
+        }
+    }
+
+    // takes size bytes just placed at the end of the used scratch
+    void OutputSink::commit(std::size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        used_ += size;
+        written_ += size;
+        last_ = scratch_[used_ - 1];
+    }
+
+    // queues the scratch bytes written since the last fragment
+    void OutputSink::queue_run()
+    {
+        if (used_ > run_)
+        {
+            iov_[count_++] = {.iov_base = scratch_.data() + run_, .iov_len = used_ - run_};
+            run_ = used_;
+        }
+    }
+
+    // writes data that does not fit the scratch buffer right away
+    void OutputSink::write_now(std::string_view data)
+    {
+        write(data);
+        flush();
+    }
+} // namespace nullsh::io
\ No newline at end of file
@@ -7,75 +7,210 @@
 
 #include "nullsh/parser.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <optional>
 
 #include "nullsh/builtins.h"
 #include "nullsh/command.h"
+#include "nullsh/variables.h"
 
 namespace nullsh::parser
 {
-    auto parse_operator(std::string_view token) -> command::Op
+    namespace
     {
-        using namespace std::literals;
+        // arena room beyond the arguments themselves: argv ends and per-stage rounding
+        constexpr std::size_t ARENA_SLACK = 256;
 
-        command::Op op = command::Op::None;
-
-        if (token == "!"sv)
-        {
-            op = command::Op::ForceOutput;
-        }
-        else if (token == "?"sv)
+        // moves trailing operators from args to ops, keeping their order
+        void strip_operators(command::ArgBlock& args, std::vector<command::Op>& ops)
         {
-            op = command::Op::DiscardOutput;
-        }
-        else if (token == "$?"sv)
-        {
-            op = command::Op::PrintRC;
+            const std::size_t first = ops.size();
+            command::Op op = command::Op::None;
+            while (!args.empty() && (op = parse_operator(args.back())) != command::Op::None)
+            {
+                ops.push_back(op);
+                args.pop_back();
+            }
+            // collected last to first
+            std::reverse(ops.begin() + static_cast<std::ptrdiff_t>(first), ops.end());
         }
-        else if (token == "$$?"sv)
+
+        template <typename Iter>
+        command::Command make_stage(Iter first, Iter last, const command::ArgBlock::Arena& arena)
         {
-            op = command::Op::PrintRCHuman;
-        }
+            command::Command cmd {.type = command::CommandType::External,
+                                  .name = {},
+                                  .args = command::ArgBlock(arena),
+                                  .ops = {}};
+            if (first == last)
+            {
+                // empty stage, reported as a syntax error when the pipeline runs
+                return cmd;
+            }
 
-        return op;
-    }
+            cmd.name = std::string(*first);
+            cmd.args.assign(first + 1, last);
 
-    std::optional<command::Command> make_command(const std::vector<std::string>& args)
-    {
-        if (args.empty())
-        {
-            return std::nullopt;
-        }
+            if (builtins::is_builtin(cmd.name))
+            {
+                cmd.type = command::CommandType::Builtin;
+            }
 
-        command::Command cmd {};
-        cmd.name = args[0];
-        cmd.args.assign(args.begin() + 1, args.end());
+            return cmd;
+        }
 
-        if (builtins::is_builtin(cmd.name))
+        // runs a builtin that stands in for a program as that program instead
+        void demote_utility(command::Command& cmd)
         {
-            cmd.type = command::CommandType::Builtin;
+            if (cmd.type == command::CommandType::Builtin && builtins::is_utility(cmd.name))
+            {
+                cmd.type = command::CommandType::External;
+            }
         }
-        else
+
+        // first unquoted '|' in [first, last), last if none
+        template <typename Iter, typename IsSeparator>
+        Iter find_pipe(Iter first, Iter last, IsSeparator is_separator)
         {
-            cmd.type = command::CommandType::External;
+            return std::find_if(first,
+                                last,
+                                [&](const auto& arg)
+                                { return is_separator(&arg) && std::string_view(arg) == "|"; });
         }
 
-        if (!cmd.args.empty())
+        /**
+         * @brief Builds a command, shared by owned and viewed tokens
+         *
+         * @param args Any contiguous range of strings
+         * @param is_separator Tells if the token at a pointer into args is an unquoted '|' or '&'
+         * @return std::optional<command::Command> Command, nullopt for an empty line
+         */
+        template <typename Args, typename IsSeparator>
+        std::optional<command::Command> build_command(const Args& args, IsSeparator is_separator)
         {
-            command::Op op = command::Op::None;
-            while (!cmd.args.empty() && (op = parse_operator(cmd.args.back())) != command::Op::None)
+            if (args.empty())
+            {
+                return std::nullopt;
+            }
+
+            // one arena for every argument of the line, sized so it rarely has to grow
+            std::size_t bytes = 0;
+            for (const auto& arg : args)
             {
-                cmd.ops.insert(cmd.ops.begin(), op);
-                cmd.args.pop_back();
+                bytes += std::string_view(arg).size() + 1 + sizeof(std::uint32_t) + sizeof(char*);
+            }
+            auto arena = command::make_arena(bytes + ARENA_SLACK);
+
+            command::Command cmd {};
+
+            // a trailing & sends the whole line to the background
+            auto end = args.end();
+            if (is_separator(&args.back()) && std::string_view(args.back()) == "&")
+            {
+                --end;
+                if (end == args.begin())
+                {
+                    return std::nullopt;
+                }
+            }
+
+            // NAME=VALUE words in front apply to the whole line
+            auto begin = args.begin();
+            while (begin != end && vars::split_assignment(*begin))
+            {
+                ++begin;
+            }
+            if (begin == end)
+            {
+                cmd.type = command::CommandType::Builtin;
+                cmd.assignments = command::ArgBlock(arena);
+                cmd.assignments.assign(args.begin(), end);
+                cmd.ops.push_back(command::Op::None);
+                return cmd;
+            }
+
+            auto pipe = find_pipe(begin, end, is_separator);
+            if (pipe == end)
+            {
+                cmd = make_stage(begin, end, arena);
+                strip_operators(cmd.args, cmd.ops);
+            }
+            else
+            {
+                auto first = begin;
+                while (true)
+                {
+                    cmd.stages.push_back(make_stage(first, pipe, arena));
+                    if (cmd.stages.size() > 1)
+                    {
+                        // builtins don't read the previous stage, the program does
+                        demote_utility(cmd.stages.back());
+                    }
+                    if (pipe == end)
+                    {
+                        break;
+                    }
+                    first = pipe + 1;
+                    pipe = find_pipe(first, end, is_separator);
+                }
+
+                // operators apply to the output of the pipeline, which is the last stage's
+                strip_operators(cmd.stages.back().args, cmd.ops);
+
+                cmd.type = command::CommandType::Pipeline;
+                cmd.name = cmd.stages.front().name;
             }
 
             if (cmd.ops.empty())
             {
                 cmd.ops.push_back(command::Op::None);
             }
+
+            cmd.background = end != args.end();
+            if (cmd.background)
+            {
+                demote_utility(cmd);
+            }
+            if (begin != args.begin())
+            {
+                cmd.assignments = command::ArgBlock(arena);
+                cmd.assignments.assign(args.begin(), begin);
+            }
+            return cmd;
         }
+    } // namespace
+
+    /**
+     * @brief Builds a command from words that carry no quoting, every "|" and "&" separates
+     *
+     * @param args Words of the command line
+     * @return std::optional<command::Command> Command, nullopt for an empty line
+     */
+    std::optional<command::Command> make_command(const std::vector<std::string>& args)
+    {
+        return build_command(args, [](const std::string*) { return true; });
+    }
 
-        return cmd;
+    /**
+     * @brief Builds a command from tokens that view into the line, see util::tokenize_views
+     *
+     * Only tokens the tokenizer marked as separators split the line into stages or send it to
+     * the background, a quoted '|' or '&' is an argument.
+     *
+     * @param tokens Tokens, only read during the call
+     * @return std::optional<command::Command> Command, nullopt for an empty line
+     */
+    std::optional<command::Command> make_command(const util::TokenList& tokens)
+    {
+        auto views = tokens.views();
+        auto kinds = tokens.kinds();
+        return build_command(views,
+                             [&](const std::string_view* token)
+                             {
+                                 return kinds[static_cast<std::size_t>(token - views.data())] ==
+                                        util::TokenKind::Separator;
+                             });
     }
 
 } // namespace nullsh::parser
\ No newline at end of file
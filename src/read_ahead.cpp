@@ -0,0 +1,218 @@
+/**
+ * @file read_ahead.cpp
+ * @brief Block reader that tokenizes and parses non-interactive input ahead of execution
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/read_ahead.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "nullsh/mapped_file.h"
+#include "nullsh/parser.h"
+#include "nullsh/tokenizer.h"
+
+namespace nullsh::io
+{
+    /**
+     * @brief Starts the helper thread reading fd
+     *
+     * @param fd Input to read, not owned
+     * @param depth Most lines parsed ahead of the consumer
+     */
+    ReadAhead::ReadAhead(int fd, std::size_t depth)
+        : fd_(fd), wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), depth_(depth == 0 ? 1 : depth)
+    {
+        helper_ = std::thread(&ReadAhead::produce, this);
+    }
+
+    ReadAhead::~ReadAhead()
+    {
+        {
+            std::lock_guard lock {mutex_};
+            stop_ = true;
+        }
+        room_.notify_all();
+        if (wake_fd_ >= 0)
+        {
+            uint64_t one = 1;
+            (void) write(wake_fd_, &one, sizeof(one));
+        }
+
+        helper_.join();
+
+        if (wake_fd_ >= 0)
+        {
+            close(wake_fd_);
+        }
+    }
+
+    /**
+     * @brief Takes the next parsed line, waiting for the helper if it is not ready yet
+     *
+     * @return std::optional<ParsedLine> The line, or nullopt once the input is exhausted
+     */
+    auto ReadAhead::next() -> std::optional<ParsedLine>
+    {
+        std::unique_lock lock {mutex_};
+        ready_.wait(lock, [this] { return !queue_.empty() || eof_; });
+        if (queue_.empty())
+        {
+            return std::nullopt;
+        }
+
+        ParsedLine line = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        room_.notify_one();
+        return line;
+    }
+
+    /**
+     * @brief Tells a read error from the end of the input, once next() returned nullopt
+     *
+     * @return std::expected<void, std::string> Nothing at EOF, else why reading failed
+     */
+    auto ReadAhead::status() const -> std::expected<void, std::string>
+    {
+        if (error_ != 0)
+        {
+            return std::unexpected(std::strerror(error_));
+        }
+        return {};
+    }
+
+    /**
+     * @brief Waits until the input can be read or the consumer is leaving
+     *
+     * @return bool true when the input is readable (or at EOF), false on stop
+     */
+    bool ReadAhead::wait_readable()
+    {
+        // poll skips a negative fd, without an eventfd this only waits for the input
+        std::array<pollfd, 2> fds {{{.fd = fd_, .events = POLLIN, .revents = 0},
+                                    {.fd = wake_fd_, .events = POLLIN, .revents = 0}}};
+        while (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno != EINTR)
+            {
+                return true; // let read() report it
+            }
+        }
+        return fds[1].revents == 0;
+    }
+
+    /**
+     * @brief Parses a line and queues it, waiting for room first
+     *
+     * @param line Line without its newline
+     * @param number Line number
+     * @return bool false when the consumer is leaving
+     */
+    bool ReadAhead::push(std::string_view line, std::size_t number)
+    {
+        auto first = line.find_first_not_of(" \t");
+        if (first == std::string_view::npos || line[first] == '#')
+        {
+            return true;
+        }
+
+        ParsedLine parsed {.number = number, .cmd = std::nullopt, .error = {}};
+        if (util::has_expansions(line))
+        {
+            // earlier lines may still change the variables
+            parsed.deferred = line;
+        }
+        else if (auto tokens = util::tokenize_views(line))
+        {
+            parsed.cmd = parser::make_command(*tokens);
+        }
+        else
+        {
+            parsed.error = tokens.error();
+        }
+
+        std::unique_lock lock {mutex_};
+        room_.wait(lock, [this] { return queue_.size() < depth_ || stop_; });
+        if (stop_)
+        {
+            return false;
+        }
+        queue_.push_back(std::move(parsed));
+        lock.unlock();
+
+        ready_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Helper thread body: reads blocks, splits complete lines and queues them
+     */
+    void ReadAhead::produce()
+    {
+        std::string buffer;
+        std::size_t number = 0;
+        bool running = true;
+
+        while (running && wait_readable())
+        {
+            std::size_t old_size = buffer.size();
+            buffer.resize(old_size + BLOCK_SIZE);
+            ssize_t got = read(fd_, buffer.data() + old_size, BLOCK_SIZE);
+            if (got < 0 && (errno == EINTR || errno == EAGAIN))
+            {
+                buffer.resize(old_size); // a non-blocking fd waits in poll() again
+                continue;
+            }
+            int error = got < 0 ? errno : 0;
+            buffer.resize(old_size + static_cast<std::size_t>(got > 0 ? got : 0));
+            bool at_end = got <= 0;
+
+            // only complete lines, unless the input ended cleanly; a line cut short by an error
+            // is not run
+            std::string_view text = buffer;
+            std::size_t complete = text.size();
+            if (!at_end || error != 0)
+            {
+                auto last_newline = text.rfind('\n');
+                if (last_newline == std::string_view::npos && !at_end)
+                {
+                    continue;
+                }
+                complete = last_newline == std::string_view::npos ? 0 : last_newline + 1;
+            }
+
+            LineReader lines {text.substr(0, complete)};
+            while (auto line = lines.next())
+            {
+                if (!push(*line, ++number))
+                {
+                    running = false;
+                    break;
+                }
+            }
+            buffer.erase(0, complete);
+
+            if (at_end)
+            {
+                error_ = error;
+                break;
+            }
+        }
+
+        {
+            std::lock_guard lock {mutex_};
+            eof_ = true;
+        }
+        ready_.notify_all();
+    }
+} // namespace nullsh::io
\ No newline at end of file
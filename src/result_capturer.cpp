@@ -7,73 +7,470 @@
 
 #include "nullsh/result_capturer.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
-#include <iostream>
+#include <chrono>
+#include <csignal>
+#include <format>
+#include <limits>
+#include <optional>
 #include <stdexcept>
 
+#include "nullsh/launcher.h"
 #include "nullsh/shell.h"
+#include "nullsh/util.h"
 
 namespace nullsh::io
 {
+    namespace
+    {
+        void close_fd(int& fd)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        bool needs_pipe(StreamMode mode)
+        {
+            return mode == StreamMode::Capture || mode == StreamMode::Tee;
+        }
+
+        // writes the whole buffer, waiting out a non-blocking destination
+        bool write_all(int fd, const char* data, size_t len)
+        {
+            while (len > 0)
+            {
+                ssize_t count = write(fd, data, len);
+                if (count < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        pollfd pfd {.fd = fd, .events = POLLOUT, .revents = 0};
+                        poll(&pfd, 1, -1);
+                        continue;
+                    }
+                    return false;
+                }
+                data += count;
+                len -= static_cast<size_t>(count);
+            }
+            return true;
+        }
+
+        // child side: caps a resource, soft and hard limit alike
+        void set_limit(int resource, rlim_t value)
+        {
+            if (value > 0)
+            {
+                rlimit lim {.rlim_cur = value, .rlim_max = value};
+                setrlimit(resource, &lim);
+            }
+        }
+
+        // child side: point target_fd at wherever the route says
+        void wire_child(StreamMode mode,
+                        const std::array<int, 2>& pipe_fds,
+                        int devnull,
+                        int target_fd)
+        {
+            switch (mode)
+            {
+                case StreamMode::Capture:
+                case StreamMode::Tee:
+                    dup2(pipe_fds[1], target_fd);
+                    break;
+                case StreamMode::Discard:
+                    dup2(devnull, target_fd);
+                    break;
+                case StreamMode::Inherit:
+                default:
+                    break;
+            }
+        }
+    } // namespace
+
+    CommandResultCapturer::~CommandResultCapturer()
+    {
+        for (int* fd :
+             {&stdout_pipe[0], &stdout_pipe[1], &stderr_pipe[0], &stderr_pipe[1], &devnull})
+        {
+            close_fd(*fd);
+        }
+    }
+
     void CommandResultCapturer::init_pipes()
     {
-        if (pipe(stdout_pipe.data()) < 0 || pipe(stderr_pipe.data()) < 0)
+        // CLOEXEC everywhere: the child keeps only what prepare_child() dups onto stdio
+        if ((needs_pipe(route.out) && pipe2(stdout_pipe.data(), O_CLOEXEC) < 0) ||
+            (needs_pipe(route.err) && pipe2(stderr_pipe.data(), O_CLOEXEC) < 0))
         {
             throw std::runtime_error("Failed to create pipes");
         }
+
+        if (route.out == StreamMode::Discard || route.err == StreamMode::Discard)
+        {
+            devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+            if (devnull < 0)
+            {
+                throw std::runtime_error("Failed to open /dev/null");
+            }
+        }
     }
 
+    /**
+     * @brief Redirects the child's stdio according to the route
+     *
+     * May run in a child sharing the parent's memory (vfork), so it only issues dup2() and
+     * leaves the capturer untouched; the original fds are CLOEXEC and vanish on exec.
+     */
     void CommandResultCapturer::prepare_child()
     {
-        // redirect child stdio to pipes
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
+        wire_child(route.out, stdout_pipe, devnull, STDOUT_FILENO);
+        wire_child(route.err, stderr_pipe, devnull, STDERR_FILENO);
+
+        set_limit(RLIMIT_CPU, limits.cpu_seconds);
+        set_limit(RLIMIT_AS, limits.address_space);
+        set_limit(RLIMIT_NOFILE, limits.open_files);
     }
 
     void CommandResultCapturer::capture_parent(pid_t pid)
     {
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
+        close_fd(stdout_pipe[1]);
+        close_fd(stderr_pipe[1]);
+        close_fd(devnull);
 
-        read_pipe(stdout_pipe[0], cmd_result->stdout_data);
-        read_pipe(stderr_pipe[0], cmd_result->stderr_data);
+        cmd_result->stdout_relayed = route.out == StreamMode::Tee;
+        cmd_result->stderr_relayed = route.err == StreamMode::Tee;
 
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
+        // the pidfd is only needed to enforce a timeout, or to see the exit of an interrupted
+        // child whose pipes a descendant still holds
+        bool watch = limits.timeout.count() > 0 || loop != nullptr;
+        int pidfd = watch ? launcher::open_pidfd(pid) : -1;
+        bool timed_out = drain_pipes(pidfd);
+        close_fd(pidfd);
 
         int status = 0;
-        if (waitpid(pid, &status, 0) < 0)
+        rusage usage {};
+        if (wait4(pid, &status, 0, &usage) < 0)
         {
-            std::perror("waitpid");
+            std::perror("wait4");
             cmd_result->return_code = nullsh::shell::EXIT_CMD_NOT_FOUND;
             return;
         }
+        cmd_result->usage = command::to_usage(usage);
 
-        if (WIFEXITED(status))
+        if (timed_out)
+        {
+            util::write_all(STDERR_FILENO,
+                            std::format("Process timed out after {}s\n",
+                                        std::chrono::duration<double>(limits.timeout).count()));
+            cmd_result->return_code = nullsh::shell::EXIT_TIMEOUT;
+        }
+        else if (WIFEXITED(status))
         {
             cmd_result->return_code = WEXITSTATUS(status);
         }
         else if (WIFSIGNALED(status))
         {
-            std::cerr << "Process terminated by signal " << WTERMSIG(status) << "\n";
+            util::write_all(STDERR_FILENO,
+                            std::format("Process terminated by signal {}\n", WTERMSIG(status)));
             cmd_result->return_code = nullsh::shell::EXIT_SIGNAL_BASE + WTERMSIG(status);
         }
     }
 
     // ===== Private functions =====
-    void CommandResultCapturer::read_pipe(int fd, std::string& out)
+
+    /**
+     * @brief Drains stdout and stderr concurrently until both reach EOF
+     *
+     * Both read ends are switched to non-blocking mode and multiplexed on an epoll set, so a
+     * child filling one pipe never stalls behind the other one. Tee'd streams are forwarded to
+     * the shell's own stdout/stderr chunk by chunk as they are captured.
+     *
+     * The child's pidfd joins the set too, given a timeout or the shell's loop. Past the
+     * deadline the child gets SIGTERM, then SIGKILL after KILL_GRACE. On the shell's loop a
+     * SIGINT also stops the wait: the child got a ^C typed at the terminal with the shell,
+     * any other SIGINT is passed on to it. A child stopped either way is not waited on past
+     * its exit, even if a descendant still holds its pipes.
+     *
+     * @param pidfd pidfd of the child, -1 without a timeout or loop
+     * @return true if the child had to be signalled for running past the timeout
+     */
+    bool CommandResultCapturer::drain_pipes(int pidfd)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        std::optional<EventLoop> own;
+        if (loop == nullptr)
+        {
+            own.emplace();
+        }
+        EventLoop& events = loop != nullptr ? *loop : *own;
+
+        std::array<Stream, 2> streams {{
+            {.data = &cmd_result->stdout_data, .spill = &cmd_result->stdout_spill, .relay = {}},
+            {.data = &cmd_result->stderr_data, .spill = &cmd_result->stderr_spill, .relay = {}},
+        }};
+        std::array<int, 2> fds {stdout_pipe[0], stderr_pipe[0]};
+        std::array<StreamMode, 2> modes {route.out, route.err};
+        std::array<int, 2> targets {STDOUT_FILENO, STDERR_FILENO};
+
+        int open_fds = 0;
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            if (modes.at(i) == StreamMode::Tee)
+            {
+                struct stat st {};
+                streams.at(i).relay.fd = targets.at(i);
+                streams.at(i).relay.is_pipe =
+                    fstat(targets.at(i), &st) == 0 && S_ISFIFO(st.st_mode);
+            }
+
+            int fd = fds.at(i);
+            if (fd >= 0)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                events.add(fd);
+                ++open_fds;
+            }
+        }
+
+        bool exited = pidfd < 0 || !events.add(pidfd);
+        bool timed = limits.timeout.count() > 0;
+        auto deadline = Clock::now() + limits.timeout;
+        int signals_sent = 0; // SIGTERM first, SIGKILL if that was not enough
+        bool interrupted = false;
+
+        while (open_fds > 0 || !exited)
+        {
+            int wait_ms = -1;
+            if (!exited && timed && signals_sent < 2)
+            {
+                auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+                wait_ms = static_cast<int>(std::max<long>(left.count(), 0));
+            }
+
+            auto ready = events.wait(wait_ms);
+            if (!ready)
+            {
+                std::perror("epoll_wait");
+                break;
+            }
+
+            if (auto from = events.take_interrupt(); from != Interrupt::None)
+            {
+                if (from == Interrupt::Other && !exited)
+                {
+                    launcher::signal_pidfd(pidfd, SIGINT);
+                }
+                interrupted = true;
+            }
+
+            // a child that exited by the deadline keeps its own status, even when its pidfd
+            // event is still to be handled
+            if (!exited && timed && signals_sent < 2 && Clock::now() >= deadline &&
+                !launcher::pidfd_exited(pidfd))
+            {
+                launcher::signal_pidfd(pidfd, signals_sent == 0 ? SIGTERM : SIGKILL);
+                ++signals_sent;
+                deadline = Clock::now() + KILL_GRACE;
+            }
+
+            for (const auto& event : *ready)
+            {
+                int fd = event.data.fd;
+                if (fd == pidfd)
+                {
+                    exited = true;
+                    events.remove(pidfd); // closed by the caller
+                    continue;
+                }
+
+                auto idx = fd == fds[0] ? 0U : 1U;
+                if (!read_pipe(fd, streams.at(idx)))
+                {
+                    events.remove(fd);
+                    close_fd(fds.at(idx));
+                    --open_fds;
+                }
+            }
+
+            if ((signals_sent > 0 || interrupted) && exited)
+            {
+                break;
+            }
+        }
+
+        // close whatever is left after an epoll failure, a timeout or an interrupt
+        if (!exited)
+        {
+            events.remove(pidfd);
+        }
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            if (fds.at(i) >= 0)
+            {
+                events.remove(fds.at(i));
+                close_fd(fds.at(i));
+            }
+            if (streams.at(i).truncated)
+            {
+                util::write_all(STDERR_FILENO,
+                                std::format("Output truncated to {} bytes\n", limits.max_output));
+            }
+        }
+        stdout_pipe[0] = -1;
+        stderr_pipe[0] = -1;
+
+        return signals_sent > 0;
+    }
+
+    /**
+     * @brief Reads one chunk from a non-blocking pipe
+     *
+     * A single read per poll wakeup keeps a chatty stream from starving the other one. When the
+     * chunk has to be relayed and the destination is a pipe too, tee() duplicates it into the
+     * destination in-kernel before it is pulled into the result. Once a stream has spilled to
+     * its memfd, chunks are spliced there without passing through user space.
+     *
+     * @param fd Read end of the pipe
+     * @param stream Where the chunk goes
+     * @return true if the pipe is still open, false on EOF or error
+     */
+    bool CommandResultCapturer::read_pipe(int fd, Stream& stream)
     {
+        size_t want = buffer.size();
+        bool relayed = false;
+        const Relay& relay = stream.relay;
+
+        if (relay.is_pipe)
+        {
+            ssize_t teed = tee(fd, relay.fd, buffer.size(), SPLICE_F_NONBLOCK);
+            if (teed == 0)
+            {
+                return false;
+            }
+            if (teed > 0)
+            {
+                want = static_cast<size_t>(teed);
+                relayed = true;
+            }
+        }
+
+        // nothing to copy by hand: pipe -> memfd in-kernel
+        if (*stream.spill && (relay.fd < 0 || relayed) && want <= room(stream))
+        {
+            // exactly the tee'd bytes, otherwise one chunk per wakeup
+            size_t moved = 0;
+            do
+            {
+                long count = (*stream.spill)->splice_from(fd, want - moved);
+                if (count > 0)
+                {
+                    moved += static_cast<size_t>(count);
+                    continue;
+                }
+                if (count == 0)
+                {
+                    return moved > 0; // EOF
+                }
+                return errno == EAGAIN;
+            } while (relayed && moved < want);
+            return true;
+        }
+
         ssize_t count = 0;
-        while ((count = read(fd, buffer.data(), sizeof(buffer))) > 0)
+        do
+        {
+            count = read(fd, buffer.data(), want);
+        } while (count < 0 && errno == EINTR);
+
+        // the tee'd bytes are all queued already, take exactly those so none is relayed twice
+        while (relayed && count > 0 && static_cast<size_t>(count) < want)
+        {
+            ssize_t more = read(fd, buffer.data() + count, want - static_cast<size_t>(count));
+            if (more > 0)
+            {
+                count += more;
+            }
+            else if (more == 0 || errno != EINTR)
+            {
+                break;
+            }
+        }
+
+        if (count > 0)
+        {
+            store(stream, buffer.data(), static_cast<size_t>(count));
+            if (relay.fd >= 0 && !relayed)
+            {
+                write_all(relay.fd, buffer.data(), static_cast<size_t>(count));
+            }
+            return true;
+        }
+
+        return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    /**
+     * @brief Appends captured bytes, moving the stream to a memfd once it outgrows the threshold
+     *
+     * After the switch the in-memory copy is released, so the heap never holds more than
+     * spill_threshold bytes per stream. If no memfd can be created the data stays in memory.
+     */
+    void CommandResultCapturer::store(Stream& stream, const char* data, size_t len)
+    {
+        auto& spill = *stream.spill;
+        auto& out = *stream.data;
+
+        if (len > room(stream))
+        {
+            len = room(stream);
+            stream.truncated = true;
+        }
+
+        if (!spill && out.size() + len > spill_threshold)
         {
-            out.append(buffer.data(), count);
+            spill = SpillFile::create("nullsh-capture");
+            if (spill)
+            {
+                spill->append(out.data(), out.size());
+                std::string {}.swap(out);
+            }
         }
+
+        if (spill)
+        {
+            spill->append(data, len);
+        }
+        else
+        {
+            out.append(data, len);
+        }
+    }
+
+    // bytes a stream may still capture under limits.max_output
+    auto CommandResultCapturer::room(const Stream& stream) const -> std::size_t
+    {
+        if (limits.max_output == 0)
+        {
+            return std::numeric_limits<std::size_t>::max();
+        }
+
+        std::size_t stored = *stream.spill ? (*stream.spill)->size() : stream.data->size();
+        return stored < limits.max_output ? limits.max_output - stored : 0;
     }
 } // namespace nullsh::io
\ No newline at end of file
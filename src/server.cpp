@@ -0,0 +1,564 @@
+/**
+ * @file server.cpp
+ * @brief Persistent nullsh server over a Unix socket, and the client talking to it
+ *
+ * Every connection is a session served by a child forked from the warm server: the session
+ * owns its cwd, environment and jobs, while the builtin tables and the PATH cache come
+ * ready-made from the parent. Messages are length-prefixed frames (host byte order, the
+ * socket is local) made of u32 fields and u32-length strings.
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/server.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "nullsh/command_cache.h"
+#include "nullsh/spill_file.h"
+#include "nullsh/tokenizer.h"
+#include "nullsh/util.h"
+#include "nullsh/variables.h"
+
+namespace nullsh::server
+{
+    namespace
+    {
+        volatile std::sig_atomic_t stop_requested = 0;
+
+        void request_stop(int /*sig*/)
+        {
+            stop_requested = 1;
+        }
+
+        void put_u32(std::string& out, std::uint32_t value)
+        {
+            std::array<char, sizeof(value)> raw {};
+            std::memcpy(raw.data(), &value, sizeof(value));
+            out.append(raw.data(), raw.size());
+        }
+
+        void put_string(std::string& out, std::string_view str)
+        {
+            put_u32(out, static_cast<std::uint32_t>(str.size()));
+            out.append(str);
+        }
+
+        // reads fields back in the order put_u32/put_string wrote them
+        class Decoder
+        {
+          public:
+            explicit Decoder(std::string_view data) : rest(data) {}
+
+            bool take(std::uint32_t& value)
+            {
+                if (rest.size() < sizeof(value))
+                {
+                    return false;
+                }
+                std::memcpy(&value, rest.data(), sizeof(value));
+                rest.remove_prefix(sizeof(value));
+                return true;
+            }
+
+            bool take(std::string& str)
+            {
+                std::uint32_t len = 0;
+                if (!take(len) || rest.size() < len)
+                {
+                    return false;
+                }
+                str.assign(rest.substr(0, len));
+                rest.remove_prefix(len);
+                return true;
+            }
+
+            bool done() const
+            {
+                return rest.empty();
+            }
+
+          private:
+            std::string_view rest;
+        };
+
+        bool read_exact(int fd, char* data, std::size_t len)
+        {
+            while (len > 0)
+            {
+                ssize_t got = read(fd, data, len);
+                if (got < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (got <= 0)
+                {
+                    return false;
+                }
+                data += got;
+                len -= static_cast<std::size_t>(got);
+            }
+            return true;
+        }
+
+        auto make_address(const std::string& path) -> std::optional<sockaddr_un>
+        {
+            sockaddr_un addr {};
+            if (path.empty() || path.size() >= sizeof(addr.sun_path))
+            {
+                return std::nullopt;
+            }
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            return addr;
+        }
+
+        auto connect_to(const sockaddr_un& addr) -> int
+        {
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0)
+            {
+                int err = errno;
+                close(fd);
+                errno = err;
+                return -1;
+            }
+            return fd;
+        }
+
+        /**
+         * @brief Binds and listens on path, replacing a stale socket left by a dead server
+         *
+         * The socket is created owner-only: whoever can connect can run commands as us.
+         *
+         * @param path Socket path
+         * @return std::expected<int, std::string> Listening fd, or why it failed
+         */
+        auto open_listener(const std::string& path) -> std::expected<int, std::string>
+        {
+            auto addr = make_address(path);
+            if (!addr)
+            {
+                return std::unexpected("invalid socket path");
+            }
+
+            struct stat info {};
+            if (lstat(path.c_str(), &info) == 0)
+            {
+                if (!S_ISSOCK(info.st_mode))
+                {
+                    return std::unexpected(std::strerror(EEXIST));
+                }
+                int live = connect_to(*addr);
+                if (live >= 0)
+                {
+                    close(live);
+                    return std::unexpected(std::strerror(EADDRINUSE));
+                }
+                unlink(path.c_str());
+            }
+
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                return std::unexpected(std::strerror(errno));
+            }
+
+            mode_t old_mask = umask(0077);
+            int rc = bind(fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr));
+            int err = errno;
+            umask(old_mask);
+
+            if (rc < 0 || listen(fd, SOMAXCONN) < 0)
+            {
+                err = rc < 0 ? err : errno;
+                close(fd);
+                return std::unexpected(std::strerror(err));
+            }
+            return fd;
+        }
+
+        // only our own user may drive the shell, whatever the socket permissions say
+        bool same_user(int conn)
+        {
+            ucred peer {};
+            socklen_t len = sizeof(peer);
+            return getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &peer, &len) == 0 &&
+                   peer.uid == getuid();
+        }
+
+        // the request holds the client's whole environment, exported names it lacks are unset
+        void apply_env(vars::VarTable& vars, const std::vector<std::string>& env)
+        {
+            std::unordered_set<std::string_view> names;
+            for (std::string_view entry : env)
+            {
+                names.insert(entry.substr(0, entry.find('=')));
+            }
+            std::vector<std::string> stale;
+            vars.for_each(
+                [&](std::string_view name, std::string_view, bool exported)
+                {
+                    if (exported && !names.contains(name))
+                    {
+                        stale.emplace_back(name);
+                    }
+                });
+            for (const auto& name : stale)
+            {
+                vars.unset(name);
+            }
+
+            for (std::string_view entry : env)
+            {
+                auto eq = entry.find('=');
+                if (eq == std::string_view::npos)
+                {
+                    vars.unset(entry);
+                }
+                else
+                {
+                    vars.export_var(entry.substr(0, eq), entry.substr(eq + 1));
+                }
+            }
+        }
+
+        /**
+         * @brief Serves the requests of one connection, in a forked child
+         *
+         * @param conn Connected socket
+         * @param sh Shell copied from the server, private to this session
+         */
+        [[noreturn]] void run_session(int conn, shell::NullShell& sh)
+        {
+            struct sigaction dfl {};
+            dfl.sa_handler = SIG_DFL;
+            sigaction(SIGCHLD, &dfl, nullptr); // the session reaps its own commands
+            sigaction(SIGINT, &dfl, nullptr);
+            sigaction(SIGTERM, &dfl, nullptr);
+
+            // commands must not read the server's stdin
+            int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            sh.exec_options().stdin_fd = devnull;
+
+            while (auto frame = read_frame(conn))
+            {
+                auto req = decode_request(*frame);
+                if (!req)
+                {
+                    break;
+                }
+                if (!write_frame(conn, encode(handle(sh, *req))))
+                {
+                    break;
+                }
+            }
+
+            _exit(0);
+        }
+    } // namespace
+
+    auto encode(const Request& req) -> std::string
+    {
+        std::string out;
+        put_string(out, req.line);
+        put_string(out, req.cwd);
+        put_u32(out, static_cast<std::uint32_t>(req.env.size()));
+        for (const auto& entry : req.env)
+        {
+            put_string(out, entry);
+        }
+        return out;
+    }
+
+    auto encode(const Reply& reply) -> std::string
+    {
+        std::string out;
+        put_u32(out, static_cast<std::uint32_t>(reply.return_code));
+        put_string(out, reply.stdout_data);
+        put_string(out, reply.stderr_data);
+        return out;
+    }
+
+    auto decode_request(std::string_view data) -> std::optional<Request>
+    {
+        Decoder dec {data};
+        Request req {};
+        std::uint32_t count = 0;
+        if (!dec.take(req.line) || !dec.take(req.cwd) || !dec.take(count))
+        {
+            return std::nullopt;
+        }
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            if (!dec.take(req.env.emplace_back()))
+            {
+                return std::nullopt;
+            }
+        }
+        return dec.done() ? std::optional<Request> {std::move(req)} : std::nullopt;
+    }
+
+    auto decode_reply(std::string_view data) -> std::optional<Reply>
+    {
+        Decoder dec {data};
+        Reply reply {};
+        std::uint32_t code = 0;
+        if (!dec.take(code) || !dec.take(reply.stdout_data) || !dec.take(reply.stderr_data) ||
+            !dec.done())
+        {
+            return std::nullopt;
+        }
+        reply.return_code = static_cast<int>(code);
+        return reply;
+    }
+
+    /**
+     * @brief Writes a length-prefixed frame
+     *
+     * @param fd Socket to write to
+     * @param payload Encoded message
+     * @return bool false if the peer went away
+     */
+    bool write_frame(int fd, std::string_view payload)
+    {
+        if (payload.size() > MAX_FRAME)
+        {
+            return false;
+        }
+        std::string frame;
+        frame.reserve(sizeof(std::uint32_t) + payload.size());
+        put_string(frame, payload);
+        return util::write_all(fd, frame);
+    }
+
+    /**
+     * @brief Reads a length-prefixed frame
+     *
+     * @param fd Socket to read from
+     * @return std::optional<std::string> The payload, or nullopt on EOF or a broken frame
+     */
+    auto read_frame(int fd) -> std::optional<std::string>
+    {
+        std::uint32_t len = 0;
+        if (!read_exact(fd, reinterpret_cast<char*>(&len), sizeof(len)) || len > MAX_FRAME)
+        {
+            return std::nullopt;
+        }
+        std::string payload(len, '\0');
+        if (!read_exact(fd, payload.data(), len))
+        {
+            return std::nullopt;
+        }
+        return payload;
+    }
+
+    /**
+     * @brief Runs one request in the session's shell, as `nullsh -c` would
+     *
+     * The shell's stdout and stderr are pointed at memfds for the duration of the command, so
+     * the reply holds exactly what `-c` would have printed: builtins, operators and the
+     * streams external commands write directly.
+     *
+     * @param sh Session shell
+     * @param req Request to run
+     * @return Reply Return code and printed output
+     */
+    Reply handle(shell::NullShell& sh, const Request& req)
+    {
+        Reply reply {};
+        apply_env(sh.variables(), req.env);
+
+        if (!req.cwd.empty() && chdir(req.cwd.c_str()) < 0)
+        {
+            reply.return_code = 1;
+            reply.stderr_data = std::format("nullsh: cd: {}: {}\n", req.cwd, std::strerror(errno));
+            return reply;
+        }
+
+        auto out = io::SpillFile::create("nullsh-reply-out");
+        auto err = io::SpillFile::create("nullsh-reply-err");
+        if (!out || !err)
+        {
+            reply.return_code = 1;
+            reply.stderr_data = std::format("nullsh: memfd: {}\n", std::strerror(errno));
+            return reply;
+        }
+
+        int saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+        int saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+        dup2(out->fd(), STDOUT_FILENO);
+        dup2(err->fd(), STDERR_FILENO);
+
+        auto tokens = util::tokenize_views(req.line, sh.variables());
+        if (tokens)
+        {
+            reply.return_code = sh.execute(*tokens);
+        }
+        else
+        {
+            util::write_all(STDERR_FILENO, std::format("parse error: {}\n", tokens.error()));
+            reply.return_code = shell::EXIT_USAGE;
+        }
+
+        dup2(saved_out, STDOUT_FILENO);
+        dup2(saved_err, STDERR_FILENO);
+        close(saved_out);
+        close(saved_err);
+
+        out->sync_size();
+        err->sync_size();
+        reply.stdout_data = out->read_all();
+        reply.stderr_data = err->read_all();
+        return reply;
+    }
+
+    /**
+     * @brief Sends one request to a server and waits for its reply
+     *
+     * @param path Server socket
+     * @param req Request to send
+     * @return std::expected<Reply, std::string> The reply, or why there is none
+     */
+    auto send_request(const std::string& path, const Request& req)
+        -> std::expected<Reply, std::string>
+    {
+        auto addr = make_address(path);
+        if (!addr)
+        {
+            return std::unexpected("invalid socket path");
+        }
+
+        int fd = connect_to(*addr);
+        if (fd < 0)
+        {
+            return std::unexpected(std::strerror(errno));
+        }
+
+        std::optional<Reply> reply;
+        if (write_frame(fd, encode(req)))
+        {
+            if (auto frame = read_frame(fd))
+            {
+                reply = decode_reply(*frame);
+            }
+        }
+        close(fd);
+
+        if (!reply)
+        {
+            return std::unexpected("connection closed by server");
+        }
+        return std::move(*reply);
+    }
+
+    /**
+     * @brief Serves sessions on a Unix socket until SIGINT or SIGTERM
+     *
+     * @param path Socket to listen on, removed on exit
+     * @param sh Warm shell every session starts from
+     * @return int Exit code
+     */
+    int run_server(const std::string& path, shell::NullShell& sh)
+    {
+        auto listener = open_listener(path);
+        if (!listener)
+        {
+            util::write_all(STDERR_FILENO, std::format("nullsh: {}: {}\n", path, listener.error()));
+            return 1;
+        }
+
+        // sessions start with every PATH command resolved
+        cache::command_cache().warm();
+
+        struct sigaction stop {};
+        stop.sa_handler = request_stop; // no SA_RESTART: accept() must return
+        sigaction(SIGINT, &stop, nullptr);
+        sigaction(SIGTERM, &stop, nullptr);
+
+        struct sigaction reap {};
+        reap.sa_handler = SIG_DFL;
+        reap.sa_flags = SA_NOCLDWAIT; // finished sessions leave no zombies
+        sigaction(SIGCHLD, &reap, nullptr);
+
+        while (stop_requested == 0)
+        {
+            int conn = accept4(*listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (conn < 0)
+            {
+                continue;
+            }
+
+            if (!same_user(conn))
+            {
+                close(conn);
+                continue;
+            }
+
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                close(*listener);
+                run_session(conn, sh);
+            }
+            close(conn);
+        }
+
+        close(*listener);
+        unlink(path.c_str());
+        return 0;
+    }
+
+    /**
+     * @brief Runs a command line on a server and prints its output, replacing `nullsh -c`
+     *
+     * The request carries the client's cwd and its whole environment, which replaces the
+     * session's exported variables.
+     *
+     * @param path Server socket
+     * @param line Command line
+     * @return int Exit code of the command
+     */
+    int run_client(const std::string& path, const std::string& line)
+    {
+        Request req {.line = line, .cwd = {}, .env = {}};
+        if (char* cwd = getcwd(nullptr, 0))
+        {
+            req.cwd = cwd;
+            free(cwd); // NOLINT(cppcoreguidelines-no-malloc)
+        }
+        for (char** var = environ; *var != nullptr; ++var)
+        {
+            req.env.emplace_back(*var);
+        }
+
+        auto reply = send_request(path, req);
+        if (!reply)
+        {
+            util::write_all(STDERR_FILENO, std::format("nullsh: {}: {}\n", path, reply.error()));
+            return 1;
+        }
+
+        util::write_all(STDOUT_FILENO, reply->stdout_data);
+        util::write_all(STDERR_FILENO, reply->stderr_data);
+        return reply->return_code;
+    }
+} // namespace nullsh::server
\ No newline at end of file
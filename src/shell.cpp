@@ -7,63 +7,240 @@
 
 #include "nullsh/shell.h"
 
+#include <fcntl.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
-#include <iostream>
-#include <unordered_map>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <string>
+#include <utility>
 
 #include "nullsh/builtins.h"
 #include "nullsh/command.h"
+#include "nullsh/completion.h"
+#include "nullsh/event_loop.h"
 #include "nullsh/executor.h"
+#include "nullsh/line_editor.h"
+#include "nullsh/mapped_file.h"
+#include "nullsh/output_sink.h"
 #include "nullsh/parser.h"
+#include "nullsh/read_ahead.h"
+#include "nullsh/tokenizer.h"
 #include "nullsh/util.h"
+#include "nullsh/variables.h"
 
 namespace nullsh::shell
 {
     using ExecutorFn = command::CommandResult (*)(command::Command&, NullShell&);
 
-    static const std::unordered_map<command::CommandType, ExecutorFn> DISPATCH_TABLE = {
-        {command::CommandType::Builtin,
-         [](auto& cmd, auto& sh) { return builtins::execute(cmd, sh); }},
-        {command::CommandType::External,
-         [](auto& cmd, auto&) { return executor::exec_external(cmd); }},
-    };
+    namespace
+    {
+        // where a builtin's stream goes, the same wiring a child would get
+        auto make_sink(io::StreamMode mode, int fd, std::string& capture) -> io::OutputSink
+        {
+            switch (mode)
+            {
+                case io::StreamMode::Inherit:
+                    return io::OutputSink {fd};
+                case io::StreamMode::Discard:
+                    return io::OutputSink {};
+                case io::StreamMode::Tee:
+                    return io::OutputSink {fd, capture};
+                case io::StreamMode::Capture:
+                default:
+                    return io::OutputSink {capture};
+            }
+        }
+
+        // output that went out live is left as written, like a child's; only captured
+        // output gets the trailing newline the operators would add anyway
+        void end_sink(io::OutputSink& sink)
+        {
+            if (sink.relays())
+            {
+                sink.flush();
+            }
+            else
+            {
+                sink.finish();
+            }
+        }
+
+        /**
+         * @brief Runs a builtin with its output routed by the command's operators
+         *
+         * Output nobody reads again goes straight to the shell's fds (or nowhere), so only
+         * output an operator still needs is copied into the result.
+         *
+         * @param cmd Builtin command
+         * @param sh Shell context
+         * @return command::CommandResult Result, with live-printed streams marked relayed
+         */
+        auto run_builtin(command::Command& cmd, NullShell& sh) -> command::CommandResult
+        {
+            auto route = executor::route_streams(cmd.ops, sh.exec_options().retain_output);
+
+            std::string out_data;
+            std::string err_data;
+            auto out = make_sink(route.out, STDOUT_FILENO, out_data);
+            auto err = make_sink(route.err, STDERR_FILENO, err_data);
+
+            auto res = builtins::run(cmd, sh, out, err);
+            end_sink(out);
+            end_sink(err);
+
+            res.stdout_relayed = res.stdout_relayed || out.relays();
+            res.stderr_relayed = res.stderr_relayed || err.relays();
+            if (!out_data.empty())
+            {
+                res.stdout_data = std::move(out_data);
+            }
+            if (!err_data.empty())
+            {
+                res.stderr_data = std::move(err_data);
+            }
+            return res;
+        }
+
+        // one handler per command type, indexed by the enum
+        constexpr std::array<ExecutorFn, 3> DISPATCH = {
+            &run_builtin,
+            [](command::Command& cmd, NullShell& sh)
+            { return executor::exec_external(cmd, sh.exec_options()); },
+            [](command::Command& cmd, NullShell& sh)
+            {
+                return executor::exec_pipeline(cmd,
+                                               sh.exec_options(),
+                                               [&sh](command::Command& stage,
+                                                     io::OutputSink& out,
+                                                     io::OutputSink& err)
+                                               { return builtins::run(stage, sh, out, err); });
+            },
+        };
+        static_assert(static_cast<std::size_t>(command::CommandType::Builtin) == 0 &&
+                      static_cast<std::size_t>(command::CommandType::External) == 1 &&
+                      static_cast<std::size_t>(command::CommandType::Pipeline) == 2);
+
+        // resources the shell used itself since before, peak RSS is the shell's
+        auto self_usage_since(const rusage& before) -> command::Usage
+        {
+            rusage after {};
+            getrusage(RUSAGE_SELF, &after);
+
+            auto start = command::to_usage(before);
+            auto usage = command::to_usage(after);
+            usage.user -= start.user;
+            usage.system -= start.system;
+            usage.minor_faults -= start.minor_faults;
+            usage.major_faults -= start.major_faults;
+            usage.voluntary_switches -= start.voluntary_switches;
+            usage.involuntary_switches -= start.involuntary_switches;
+            return usage;
+        }
+    } // namespace
+
+    /**
+     * @brief Creates a shell whose variables start as the process environment
+     *
+     * Exported changes are applied to the process environment as well, for the PATH cache
+     * and libc. Children get the table's envp, not environ.
+     */
+    NullShell::NullShell() : var_table(environ, true)
+    {
+        exec_opts.vars = &var_table;
+    }
 
     /**
-     * @brief Runs the interactive shell
+     * @brief Records the interactive lines in a persistent history from now on
+     *
+     * @param path History log, created if missing
+     * @return std::expected<void, std::string> Nothing, or the reason the log can't be opened
+     */
+    auto NullShell::enable_history(const std::string& path) -> std::expected<void, std::string>
+    {
+        auto hist = history::History::open(path);
+        if (!hist)
+        {
+            return std::unexpected(hist.error());
+        }
+        history_ = std::move(*hist);
+        return {};
+    }
+
+    /**
+     * @brief Runs the interactive shell, or reads commands from stdin when it is not a terminal
+     *
+     * Everything the shell waits on goes through one event loop: the terminal while a line is
+     * edited, then the command's pidfd and capture pipes. SIGINT, SIGCHLD and SIGWINCH are
+     * read from its signalfd, so a ^C stops the foreground command (or drops the line) and
+     * leaves the shell running, and a finished background job is reported at once.
      *
      * @return int Exit code
      */
     int NullShell::run()
     {
+        if (isatty(STDIN_FILENO) == 0)
+        {
+            return run_stream(STDIN_FILENO, "stdin");
+        }
+
+        // first, so the helper threads started below inherit the blocked signals
+        io::EventLoop loop {true};
+        exec_opts.loop = loop.valid() ? &loop : nullptr;
+
+        // the PATH trie is read on a helper thread while the first prompt is up
+        complete::Completer completer {};
+        edit::LineEditor editor {STDIN_FILENO, STDOUT_FILENO, &completer};
+        editor.set_history(history());
+        editor.set_loop(exec_opts.loop);
+        editor.set_notices([this] { return job_notices(); });
+
         running = true;
         while (running)
         {
             if (has_exit)
             {
+                if (history_)
+                {
+                    history_->sync(); // exit() skips the destructors
+                }
                 std::exit(last_status_);
             }
 
-            std::cout << prompt << std::flush;
+            notify_jobs();
+            completer.refresh();
+            completer.set_home(var_table.get("HOME"));
+            loop.take_interrupt(); // a ^C between commands has nothing left to stop
 
-            std::string line;
-            if (!std::getline(std::cin, line))
+            auto input = editor.read_line(prompt);
+            if (!input)
             {
                 break;
             }
+            std::string_view line = *input;
 
-            auto tokens = util::tokenize(line);
+            auto tokens = util::tokenize_views(line, var_table);
             if (!tokens)
             {
-                std::cerr << "parse error: " << tokens.error() << "\n";
+                util::write_all(STDERR_FILENO, std::format("parse error: {}\n", tokens.error()));
                 continue;
             }
 
+            if (history_ && line.find_first_not_of(" \t") != std::string_view::npos)
+            {
+                history_->append(line);
+            }
+
             int rc = execute(*tokens);
             (void) rc; // reserved for later
         }
 
+        exec_opts.loop = nullptr;
         return -1;
     }
 
@@ -81,12 +258,296 @@ namespace nullsh::shell
             return 0;
         }
 
-        auto res = execute_command(*cmd);
+        return execute(*cmd);
+    }
+
+    /**
+     * @brief Dispatches a command line tokenized in place, see util::tokenize_views
+     *
+     * @param tokens Tokens viewing into the line
+     * @return int Exit code
+     */
+    int NullShell::execute(const util::TokenList& tokens)
+    {
+        auto cmd = parser::make_command(tokens);
+        if (!cmd)
+        {
+            return 0;
+        }
+
+        return execute(*cmd);
+    }
+
+    /**
+     * @brief Runs the last command line of this shell, as `nullsh -c` does
+     *
+     * When nothing has to happen after the command, the shell execs it in place rather than
+     * forking, see executor::exec_in_place(). Otherwise it runs like execute().
+     *
+     * @param tokens Tokens viewing into the command line
+     * @return int Exit code, when the shell was not replaced
+     */
+    int NullShell::execute_last(const util::TokenList& tokens)
+    {
+        auto cmd = parser::make_command(tokens);
+        if (!cmd)
+        {
+            return 0;
+        }
+
+        if (cmd->assignments.empty())
+        {
+            executor::exec_in_place(*cmd, exec_opts);
+        }
+        else if (!cmd->name.empty())
+        {
+            vars::VarTable::Scope scope {var_table, cmd->assignments};
+            executor::exec_in_place(*cmd, exec_opts);
+        }
+        return execute(*cmd);
+    }
+
+    /**
+     * @brief Runs a parsed command in the foreground, or starts it as a job
+     *
+     * @param cmd Command to run
+     * @return int Exit code
+     */
+    int NullShell::execute(command::Command& cmd)
+    {
+        if (cmd.name.empty() && !cmd.assignments.empty())
+        {
+            // a line of assignments only sets shell variables
+            for (std::string_view word : cmd.assignments)
+            {
+                auto [name, value] = *vars::split_assignment(word);
+                var_table.set(name, value);
+            }
+            last_status_ = 0;
+            return last_status_;
+        }
+
+        // the assignments in front of a command are exported to it alone
+        std::optional<vars::VarTable::Scope> scope;
+        if (!cmd.assignments.empty())
+        {
+            scope.emplace(var_table, cmd.assignments);
+        }
+
+        if (cmd.background)
+        {
+            last_status_ = start_job(cmd);
+            return last_status_;
+        }
+
+        auto res = execute_command(cmd);
         last_status_ = res.return_code;
 
         return res.return_code;
     }
 
+    /**
+     * @brief Starts a command as a background job
+     *
+     * @param cmd Command to start
+     * @return int 0 once started, otherwise the exit code of the failed start
+     */
+    int NullShell::start_job(command::Command& cmd)
+    {
+        if (cmd.type != command::CommandType::External)
+        {
+            util::write_all(STDERR_FILENO,
+                            "nullsh: only external commands can run in the background\n");
+            return EXIT_USAGE;
+        }
+
+        auto job = executor::exec_background(cmd, exec_opts);
+        if (job.pid < 0)
+        {
+            // did not start, reported like a foreground command
+            executor::apply_operators(job.ops, job.result);
+            return job.result.return_code;
+        }
+
+        pid_t pid = job.pid;
+        int id = job_table.add(std::move(job));
+        util::write_all(STDERR_FILENO, std::format("[{}] {}\n", id, pid));
+        return 0;
+    }
+
+    /**
+     * @brief Reports background jobs that finished since the last prompt
+     */
+    void NullShell::notify_jobs()
+    {
+        util::write_all(STDERR_FILENO, job_notices());
+    }
+
+    /**
+     * @brief Lists the background jobs that finished and were not reported yet
+     *
+     * @return std::string One line per job, empty if none; they count as reported
+     */
+    auto NullShell::job_notices() -> std::string
+    {
+        std::string notices;
+        job_table.refresh();
+        job_table.for_each(
+            [&notices](jobs::Job& job)
+            {
+                if (job.done && !job.notified)
+                {
+                    notices += std::format("[{}]  {}\t{}\n", job.id, jobs::state(job), job.text);
+                    job.notified = true;
+                }
+            });
+        return notices;
+    }
+
+    /**
+     * @brief Runs every line of a script, without a prompt
+     *
+     * Lines are tokenized straight from the buffer, nothing is copied line by line. Blank
+     * lines and lines starting with '#', a shebang included, are skipped. A command calling
+     * exit ends the script.
+     *
+     * @param text Script contents
+     * @param name Script name for error messages
+     * @return int Exit code of the last command
+     */
+    int NullShell::run_script(std::string_view text, std::string_view name)
+    {
+        last_status_ = 0;
+
+        io::LineReader lines {text};
+        while (auto line = lines.next())
+        {
+            auto first = line->find_first_not_of(" \t");
+            if (first == std::string_view::npos || (*line)[first] == '#')
+            {
+                continue;
+            }
+
+            auto tokens = util::tokenize_views(*line, var_table);
+            if (!tokens)
+            {
+                util::write_all(STDERR_FILENO,
+                                std::format("{}: line {}: parse error: {}\n",
+                                            name,
+                                            lines.line_number(),
+                                            tokens.error()));
+                last_status_ = EXIT_USAGE;
+                continue;
+            }
+
+            execute(*tokens);
+            if (has_exit)
+            {
+                break;
+            }
+        }
+
+        return last_status_;
+    }
+
+    /**
+     * @brief Runs commands read from a non-interactive stream, such as a pipe, without a prompt
+     *
+     * The stream is read in large blocks and the next lines are tokenized and parsed on a helper
+     * thread while the current command runs. Commands get /dev/null as stdin: the rest of the
+     * stream belongs to the shell, a child must not swallow the lines queued after it.
+     *
+     * @param fd Stream to read, not owned
+     * @param name Stream name for error messages
+     * @return int Exit code of the last command
+     */
+    int NullShell::run_stream(int fd, std::string_view name)
+    {
+        last_status_ = 0;
+
+        int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        int saved_stdin = std::exchange(exec_opts.stdin_fd, devnull);
+
+        {
+            io::ReadAhead input {fd};
+            while (auto line = input.next())
+            {
+                if (!line->deferred.empty())
+                {
+                    auto tokens = util::tokenize_views(line->deferred, var_table);
+                    if (tokens)
+                    {
+                        line->cmd = parser::make_command(*tokens);
+                    }
+                    else
+                    {
+                        line->error = tokens.error();
+                    }
+                }
+
+                if (!line->error.empty())
+                {
+                    util::write_all(STDERR_FILENO,
+                                    std::format("{}: line {}: parse error: {}\n",
+                                                name,
+                                                line->number,
+                                                line->error));
+                    last_status_ = EXIT_USAGE;
+                    continue;
+                }
+
+                if (line->cmd)
+                {
+                    execute(*line->cmd);
+                }
+                if (has_exit)
+                {
+                    break;
+                }
+            }
+
+            if (auto status = input.status(); !status && !has_exit)
+            {
+                util::write_all(STDERR_FILENO,
+                                std::format("{}: read error: {}\n", name, status.error()));
+                last_status_ = EXIT_FAILURE;
+            }
+        }
+
+        exec_opts.stdin_fd = saved_stdin;
+        if (devnull >= 0)
+        {
+            close(devnull);
+        }
+
+        return last_status_;
+    }
+
+    /**
+     * @brief Runs a script file in this shell, as `nullsh file` and the source builtin do
+     *
+     * @param path Script to run, memory mapped while it runs
+     * @return std::expected<int, std::string> Exit code of the script, or why it could not run
+     */
+    auto NullShell::source(const std::string& path) -> std::expected<int, std::string>
+    {
+        if (source_depth >= MAX_SOURCE_DEPTH)
+        {
+            return std::unexpected("maximum nesting depth exceeded");
+        }
+
+        auto file = io::MappedFile::open(path);
+        if (!file)
+        {
+            return std::unexpected(file.error());
+        }
+
+        ++source_depth;
+        int rc = run_script(file->view(), path);
+        --source_depth;
+        return rc;
+    }
+
     void NullShell::exit()
     {
         has_exit = true;
@@ -100,17 +561,22 @@ namespace nullsh::shell
      */
     command::CommandResult NullShell::execute_command(command::Command& cmd)
     {
-        if (auto it = DISPATCH_TABLE.find(cmd.type); it != DISPATCH_TABLE.end())
+        if (auto idx = static_cast<std::size_t>(cmd.type); idx < DISPATCH.size())
         {
-            auto res = it->second(cmd, *this);
+            rusage before {};
+            getrusage(RUSAGE_SELF, &before);
+            auto start = std::chrono::steady_clock::now();
 
-            command::sanitize_result(res);
+            auto res = DISPATCH[idx](cmd, *this);
 
-            for (auto op : cmd.ops)
+            // no child was reaped: the work happened in the shell itself
+            if (!res.usage)
             {
-                executor::apply_operator(op, res);
+                res.usage = self_usage_since(before);
             }
+            res.usage->wall = std::chrono::steady_clock::now() - start;
 
+            executor::apply_operators(cmd.ops, res);
             return res;
         }
 
@@ -0,0 +1,195 @@
+/**
+ * @file spill_file.cpp
+ * @brief Anonymous in-memory file holding captured output past the heap threshold
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/spill_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+
+namespace nullsh::io
+{
+    SpillFile::~SpillFile()
+    {
+        close(fd_);
+    }
+
+    /**
+     * @brief Creates an empty memfd-backed spill file
+     *
+     * @param name Debug name of the memfd (shows up in /proc/<pid>/fd)
+     * @return std::shared_ptr<SpillFile> The file, or nullptr if memfd_create() failed
+     */
+    auto SpillFile::create(const char* name) -> std::shared_ptr<SpillFile>
+    {
+        int fd = memfd_create(name, MFD_CLOEXEC);
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        return std::make_shared<SpillFile>(fd);
+    }
+
+    /**
+     * @brief Appends a buffer at the end of the file
+     *
+     * @return true if everything was written
+     */
+    bool SpillFile::append(const char* data, std::size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t count = pwrite(fd_, data, len, static_cast<off_t>(size_));
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += count;
+            len -= static_cast<std::size_t>(count);
+            size_ += static_cast<std::size_t>(count);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Moves up to len bytes from a pipe to the end of the file without a user copy
+     *
+     * @return long Bytes moved, 0 on EOF, -1 with errno set on error (EAGAIN if empty)
+     */
+    auto SpillFile::splice_from(int pipe_fd, std::size_t len) -> long
+    {
+        auto offset = static_cast<loff_t>(size_);
+        ssize_t count = 0;
+        do
+        {
+            count = splice(pipe_fd, nullptr, fd_, &offset, len, SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+        } while (count < 0 && errno == EINTR);
+
+        if (count > 0)
+        {
+            size_ += static_cast<std::size_t>(count);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Copies the whole file to out_fd in-kernel
+     *
+     * Uses sendfile(), falling back to read()/write() for targets it does not support.
+     *
+     * @return true if everything was written
+     */
+    bool SpillFile::send_to(int out_fd) const
+    {
+        off_t offset = 0;
+        while (static_cast<std::size_t>(offset) < size_)
+        {
+            auto left = size_ - static_cast<std::size_t>(offset);
+            ssize_t count = sendfile(out_fd, fd_, &offset, left);
+            if (count > 0)
+            {
+                continue;
+            }
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count < 0 && (errno == EINVAL || errno == ENOSYS))
+            {
+                break;
+            }
+            return false;
+        }
+
+        std::array<char, 65536> buf {};
+        while (static_cast<std::size_t>(offset) < size_)
+        {
+            ssize_t count = pread(fd_, buf.data(), buf.size(), offset);
+            if (count <= 0)
+            {
+                return false;
+            }
+            for (ssize_t done = 0; done < count;)
+            {
+                auto left = static_cast<std::size_t>(count - done);
+                ssize_t wrote = write(out_fd, buf.data() + done, left);
+                if (wrote < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                done += wrote;
+            }
+            offset += count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Materialises the file in memory, for callers that really need a string
+     */
+    auto SpillFile::read_all() const -> std::string
+    {
+        std::string out(size_, '\0');
+        std::size_t done = 0;
+        while (done < size_)
+        {
+            ssize_t count = pread(fd_, out.data() + done, size_ - done, static_cast<off_t>(done));
+            if (count <= 0)
+            {
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            done += static_cast<std::size_t>(count);
+        }
+        out.resize(done);
+        return out;
+    }
+
+    /**
+     * @brief Last byte of the file, '\0' if empty
+     */
+    char SpillFile::back() const
+    {
+        char last = '\0';
+        if (size_ == 0 || pread(fd_, &last, 1, static_cast<off_t>(size_ - 1)) != 1)
+        {
+            return '\0';
+        }
+        return last;
+    }
+
+    /**
+     * @brief Picks up data written through another descriptor, e.g. by a child writing to it
+     *
+     * @return std::size_t The new size
+     */
+    std::size_t SpillFile::sync_size()
+    {
+        struct stat info {};
+        if (fstat(fd_, &info) == 0)
+        {
+            size_ = static_cast<std::size_t>(info.st_size);
+        }
+        return size_;
+    }
+} // namespace nullsh::io
\ No newline at end of file
@@ -0,0 +1,552 @@
+/**
+ * @file tokenizer.cpp
+ * @brief Vectorized command line tokenizer returning views into the line
+ *
+ * The line is classified 64 bytes at a time into bitmasks of separators, quotes and
+ * backslashes, so finding the end of a word is a count-trailing-zeros instead of a
+ * per-character branch. Blocks are classified with AVX2 or SSE2 when the CPU has them and
+ * with a plain loop otherwise; all three produce the same masks.
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/tokenizer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NULLSH_X86 1
+#endif
+
+namespace nullsh::util
+{
+    namespace
+    {
+        constexpr std::size_t BLOCK = 64;
+
+        // one bit per byte of a block
+        struct Masks
+        {
+            std::uint64_t special = 0; // anything that ends a plain word
+            std::uint64_t squote = 0;
+            std::uint64_t dquote = 0;
+            std::uint64_t bslash = 0;
+            std::uint64_t dollar = 0; // not in special, only words that expand stop there
+        };
+
+        using ClassifyFn = Masks (*)(const char* block);
+
+        bool is_space(char chr)
+        {
+            // same set as std::isspace in the C locale
+            return chr == ' ' || (chr >= '\t' && chr <= '\r');
+        }
+
+        bool is_separator(char chr)
+        {
+            return chr == '|' || chr == '&';
+        }
+
+        Masks classify_scalar(const char* block)
+        {
+            Masks masks;
+            for (std::size_t i = 0; i < BLOCK; ++i)
+            {
+                const char chr = block[i];
+                const std::uint64_t bit = std::uint64_t {1} << i;
+                if (chr == '\'')
+                {
+                    masks.squote |= bit;
+                }
+                else if (chr == '"')
+                {
+                    masks.dquote |= bit;
+                }
+                else if (chr == '\\')
+                {
+                    masks.bslash |= bit;
+                }
+                else if (chr == '$')
+                {
+                    masks.dollar |= bit;
+                    continue;
+                }
+                else if (!is_space(chr) && !is_separator(chr))
+                {
+                    continue;
+                }
+                masks.special |= bit;
+            }
+            return masks;
+        }
+
+#ifdef NULLSH_X86
+        std::uint64_t bits(__m128i mask)
+        {
+            return static_cast<std::uint16_t>(_mm_movemask_epi8(mask));
+        }
+
+        __attribute__((target("avx2"))) std::uint64_t bits(__m256i mask)
+        {
+            return static_cast<std::uint32_t>(_mm256_movemask_epi8(mask));
+        }
+
+        Masks classify_sse2(const char* block)
+        {
+            const __m128i squote = _mm_set1_epi8('\'');
+            const __m128i dquote = _mm_set1_epi8('"');
+            const __m128i bslash = _mm_set1_epi8('\\');
+            const __m128i dollar = _mm_set1_epi8('$');
+            const __m128i pipe = _mm_set1_epi8('|');
+            const __m128i amp = _mm_set1_epi8('&');
+            const __m128i space = _mm_set1_epi8(' ');
+            // shift \t..\r down to the bottom of the signed range, then one compare
+            const __m128i ws_shift = _mm_set1_epi8(static_cast<char>(0x80 - '\t'));
+            const __m128i ws_limit = _mm_set1_epi8(static_cast<char>(0x80 + ('\r' - '\t' + 1)));
+
+            Masks masks;
+            for (std::size_t i = 0; i < BLOCK; i += 16)
+            {
+                const __m128i chunk =
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i)); // NOLINT
+                const __m128i is_sq = _mm_cmpeq_epi8(chunk, squote);
+                const __m128i is_dq = _mm_cmpeq_epi8(chunk, dquote);
+                const __m128i is_bs = _mm_cmpeq_epi8(chunk, bslash);
+                const __m128i is_ws = _mm_or_si128(
+                    _mm_cmpeq_epi8(chunk, space),
+                    _mm_cmplt_epi8(_mm_add_epi8(chunk, ws_shift), ws_limit));
+                const __m128i is_sep =
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, pipe), _mm_cmpeq_epi8(chunk, amp));
+                const __m128i any = _mm_or_si128(_mm_or_si128(is_sq, is_dq),
+                                                 _mm_or_si128(is_bs, _mm_or_si128(is_ws, is_sep)));
+
+                masks.special |= bits(any) << i;
+                masks.squote |= bits(is_sq) << i;
+                masks.dquote |= bits(is_dq) << i;
+                masks.bslash |= bits(is_bs) << i;
+                masks.dollar |= bits(_mm_cmpeq_epi8(chunk, dollar)) << i;
+            }
+            return masks;
+        }
+
+        __attribute__((target("avx2"))) Masks classify_avx2(const char* block)
+        {
+            const __m256i squote = _mm256_set1_epi8('\'');
+            const __m256i dquote = _mm256_set1_epi8('"');
+            const __m256i bslash = _mm256_set1_epi8('\\');
+            const __m256i dollar = _mm256_set1_epi8('$');
+            const __m256i pipe = _mm256_set1_epi8('|');
+            const __m256i amp = _mm256_set1_epi8('&');
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i ws_shift = _mm256_set1_epi8(static_cast<char>(0x80 - '\t'));
+            const __m256i ws_limit =
+                _mm256_set1_epi8(static_cast<char>(0x80 + ('\r' - '\t' + 1)));
+
+            Masks masks;
+            for (std::size_t i = 0; i < BLOCK; i += 32)
+            {
+                const __m256i chunk =
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i)); // NOLINT
+                const __m256i is_sq = _mm256_cmpeq_epi8(chunk, squote);
+                const __m256i is_dq = _mm256_cmpeq_epi8(chunk, dquote);
+                const __m256i is_bs = _mm256_cmpeq_epi8(chunk, bslash);
+                // no signed less-than in AVX2, greater-than with the operands swapped
+                const __m256i is_ws = _mm256_or_si256(
+                    _mm256_cmpeq_epi8(chunk, space),
+                    _mm256_cmpgt_epi8(ws_limit, _mm256_add_epi8(chunk, ws_shift)));
+                const __m256i is_sep =
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, pipe), _mm256_cmpeq_epi8(chunk, amp));
+                const __m256i any =
+                    _mm256_or_si256(_mm256_or_si256(is_sq, is_dq),
+                                    _mm256_or_si256(is_bs, _mm256_or_si256(is_ws, is_sep)));
+
+                masks.special |= bits(any) << i;
+                masks.squote |= bits(is_sq) << i;
+                masks.dquote |= bits(is_dq) << i;
+                masks.bslash |= bits(is_bs) << i;
+                masks.dollar |= bits(_mm256_cmpeq_epi8(chunk, dollar)) << i;
+            }
+            return masks;
+        }
+#endif
+
+        ClassifyFn classifier(ScanLevel level)
+        {
+#ifdef NULLSH_X86
+            switch (std::min(level, best_scan_level()))
+            {
+                case ScanLevel::AVX2:
+                    return classify_avx2;
+                case ScanLevel::SSE2:
+                    return classify_sse2;
+                case ScanLevel::Scalar:
+                    break;
+            }
+#else
+            (void) level;
+#endif
+            return classify_scalar;
+        }
+
+        /**
+         * Walks the line block by block, keeping the masks of the block last looked at. The
+         * final partial block is copied into a zero-padded buffer, NUL is not special so the
+         * padding never produces a hit.
+         */
+        class Scanner
+        {
+          public:
+            Scanner(std::string_view line, ClassifyFn classify, bool expand)
+                : line_(line), classify_(classify), dollars_(expand ? ~std::uint64_t {0} : 0)
+            {
+            }
+
+            // first separator, quote or backslash at or after pos, size() if none; also '$'
+            // when expanding
+            std::size_t find_special(std::size_t pos)
+            {
+                return find(pos,
+                            [this](const Masks& masks)
+                            { return masks.special | (masks.dollar & dollars_); });
+            }
+
+            // first quote of the given kind or backslash at or after pos, size() if none; also
+            // '$' inside double quotes when expanding
+            std::size_t find_quote(std::size_t pos, char quote)
+            {
+                if (quote == '\'')
+                {
+                    return find(pos,
+                                [](const Masks& masks) { return masks.squote | masks.bslash; });
+                }
+                return find(pos,
+                            [this](const Masks& masks)
+                            { return masks.dquote | masks.bslash | (masks.dollar & dollars_); });
+            }
+
+          private:
+            template <typename Select>
+            std::size_t find(std::size_t pos, Select select)
+            {
+                while (pos < line_.size())
+                {
+                    const std::size_t base = pos & ~(BLOCK - 1);
+                    load(base);
+                    const std::uint64_t hits = select(masks_) >> (pos - base);
+                    if (hits != 0)
+                    {
+                        return pos + static_cast<std::size_t>(std::countr_zero(hits));
+                    }
+                    pos = base + BLOCK;
+                }
+                return line_.size();
+            }
+
+            void load(std::size_t base)
+            {
+                if (base == base_)
+                {
+                    return;
+                }
+                base_ = base;
+                if (base + BLOCK <= line_.size())
+                {
+                    masks_ = classify_(line_.data() + base);
+                    return;
+                }
+                std::array<char, BLOCK> tail {};
+                std::memcpy(tail.data(), line_.data() + base, line_.size() - base);
+                masks_ = classify_(tail.data());
+            }
+
+            std::string_view line_;
+            ClassifyFn classify_;
+            std::uint64_t dollars_; // all ones when '$' starts expansions
+            std::size_t base_ = std::string_view::npos;
+            Masks masks_;
+        };
+
+        constexpr const char* MISMATCHED_QUOTES = "Mismatched quotes in command line";
+
+        bool is_name_char(char chr, bool first)
+        {
+            return (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || chr == '_' ||
+                   (!first && chr >= '0' && chr <= '9');
+        }
+
+        /**
+         * @brief Appends the value of the $NAME or ${NAME} at pos, unset variables are empty
+         *
+         * A '$' that does not start a name is kept as is, so the $?, $$? and $% operators
+         * pass through untouched.
+         *
+         * @return std::size_t First byte after the expansion
+         */
+        std::size_t expand(std::string_view line,
+                           std::size_t pos,
+                           std::string& cur,
+                           const vars::VarTable& vars)
+        {
+            const bool braced = pos + 1 < line.size() && line[pos + 1] == '{';
+            const std::size_t name = pos + (braced ? 2 : 1);
+            std::size_t end = name;
+            while (end < line.size() && is_name_char(line[end], end == name))
+            {
+                ++end;
+            }
+            if (end == name || (braced && (end >= line.size() || line[end] != '}')))
+            {
+                cur.push_back('$');
+                return pos + 1;
+            }
+
+            if (auto value = vars.get(line.substr(name, end - name)))
+            {
+                cur.append(*value);
+            }
+            return braced ? end + 1 : end;
+        }
+
+        /**
+         * @brief Builds a word that needs rewriting, starting at the first quote or escape
+         *
+         * @param scan Scanner over the line
+         * @param line Command line
+         * @param pos In: first quote or backslash of the word, out: first byte after the word
+         * @param cur Plain bytes of the word seen before pos, the rest is appended
+         * @param vars Variables to expand, nullptr keeps '$' literal
+         * @return bool False on an unterminated quote
+         */
+        bool build_word(Scanner& scan,
+                        std::string_view line,
+                        std::size_t& pos,
+                        std::string& cur,
+                        const vars::VarTable* vars)
+        {
+            while (pos < line.size())
+            {
+                const char chr = line[pos];
+                if (is_space(chr) || is_separator(chr))
+                {
+                    return true;
+                }
+
+                if (chr == '\\')
+                {
+                    // escape next char, trailing backslash is kept literally
+                    cur.push_back(pos + 1 < line.size() ? line[pos + 1] : '\\');
+                    pos += 2;
+                }
+                else if (chr == '$' && vars != nullptr)
+                {
+                    pos = expand(line, pos, cur, *vars);
+                }
+                else if (chr == '\'' || chr == '"')
+                {
+                    ++pos;
+                    for (;;)
+                    {
+                        const std::size_t hit = scan.find_quote(pos, chr);
+                        if (hit >= line.size())
+                        {
+                            return false;
+                        }
+                        cur.append(line.substr(pos, hit - pos));
+                        pos = hit + 1;
+                        if (line[hit] == chr)
+                        {
+                            break;
+                        }
+                        if (line[hit] == '$')
+                        {
+                            pos = expand(line, hit, cur, *vars);
+                            continue;
+                        }
+                        // backslash escapes inside quotes too
+                        if (pos >= line.size())
+                        {
+                            return false;
+                        }
+                        cur.push_back(line[pos++]);
+                    }
+                }
+                else
+                {
+                    const std::size_t end = scan.find_special(pos);
+                    cur.append(line.substr(pos, end - pos));
+                    pos = end;
+                }
+            }
+            pos = std::min(pos, line.size());
+            return true;
+        }
+
+        bool ends_word(std::string_view line, std::size_t pos)
+        {
+            return pos >= line.size() || is_space(line[pos]) || is_separator(line[pos]);
+        }
+
+        // the tokenizer proper, vars is nullptr when '$' is not special
+        auto tokenize_line(std::string_view line, ScanLevel level, const vars::VarTable* vars)
+            -> std::expected<TokenList, std::string>
+        {
+            TokenList tokens;
+            Scanner scan(line, classifier(level), vars != nullptr);
+            std::size_t pos = 0;
+
+            while (true)
+            {
+                while (pos < line.size() && is_space(line[pos]))
+                {
+                    ++pos;
+                }
+                if (pos >= line.size())
+                {
+                    break;
+                }
+
+                const std::size_t start = pos;
+                const char first = line[start];
+                if (is_separator(first))
+                {
+                    // pipe and background separators, tokens of their own even without spaces
+                    tokens.push_view(line.substr(start, 1), TokenKind::Separator);
+                    ++pos;
+                    continue;
+                }
+
+                pos = scan.find_special(start);
+                if (ends_word(line, pos))
+                {
+                    tokens.push_view(line.substr(start, pos - start));
+                    continue;
+                }
+
+                if (pos == start && (first == '\'' || first == '"'))
+                {
+                    // a word that is one quoted span is still a view, of the inside
+                    const std::size_t close = scan.find_quote(start + 1, first);
+                    if (close < line.size() && line[close] == first && ends_word(line, close + 1))
+                    {
+                        if (close > start + 1)
+                        {
+                            tokens.push_view(line.substr(start + 1, close - start - 1));
+                        }
+                        pos = close + 1;
+                        continue;
+                    }
+                }
+
+                std::string cur(line.substr(start, pos - start));
+                if (!build_word(scan, line, pos, cur, vars))
+                {
+                    return std::unexpected(MISMATCHED_QUOTES);
+                }
+                if (!cur.empty())
+                {
+                    tokens.push_owned(std::move(cur));
+                }
+            }
+
+            return tokens;
+        }
+    } // namespace
+
+    /**
+     * @brief Copies the tokens out, for callers that keep them past the line
+     *
+     * @return std::vector<std::string>
+     */
+    auto TokenList::to_strings() const -> std::vector<std::string>
+    {
+        return {tokens_.begin(), tokens_.end()};
+    }
+
+    /**
+     * @brief Widest block scanner this CPU supports, probed once
+     *
+     * @return ScanLevel
+     */
+    auto best_scan_level() -> ScanLevel
+    {
+#ifdef NULLSH_X86
+        static const ScanLevel LEVEL =
+            __builtin_cpu_supports("avx2") != 0 ? ScanLevel::AVX2 : ScanLevel::SSE2;
+        return LEVEL;
+#else
+        return ScanLevel::Scalar;
+#endif
+    }
+
+    /**
+     * @brief Tokenizes a command line without copying plain words
+     *
+     * Splits on unquoted whitespace, makes unquoted '|' and '&' tokens of their own, strips
+     * quotes and applies backslash escapes, exactly like the copying tokenizer always has.
+     * Only the unquoted '|' and '&' are TokenKind::Separator, a quoted one is a plain word.
+     *
+     * @param line Command line to tokenize, must outlive the result
+     * @return std::expected<TokenList, std::string> Tokens or the mismatched quotes error
+     */
+    auto tokenize_views(std::string_view line) -> std::expected<TokenList, std::string>
+    {
+        return tokenize_views(line, best_scan_level());
+    }
+
+    /**
+     * @brief Tokenizes a command line with a given block scanner
+     *
+     * Levels the CPU lacks fall back to the best one it has, results never differ between
+     * levels.
+     *
+     * @param line Command line to tokenize, must outlive the result
+     * @param level Block scanner to use
+     * @return std::expected<TokenList, std::string> Tokens or the mismatched quotes error
+     */
+    auto tokenize_views(std::string_view line, ScanLevel level)
+        -> std::expected<TokenList, std::string>
+    {
+        return tokenize_line(line, level, nullptr);
+    }
+
+    /**
+     * @brief Tokenizes a command line, expanding $NAME and ${NAME} outside single quotes
+     *
+     * Expansions become part of their word as they are, they are not split again. Words
+     * without a '$' are still views into the line.
+     *
+     * @param line Command line to tokenize, must outlive the result
+     * @param vars Variables to expand, unset ones expand to nothing
+     * @return std::expected<TokenList, std::string> Tokens or the mismatched quotes error
+     */
+    auto tokenize_views(std::string_view line, const vars::VarTable& vars)
+        -> std::expected<TokenList, std::string>
+    {
+        return tokenize_line(line, best_scan_level(), &vars);
+    }
+
+    /**
+     * @brief Checks if a line has a $NAME or ${NAME} that tokenizing with variables expands
+     *
+     * Quotes are not looked at, a '$' inside single quotes counts too.
+     *
+     * @param line Command line
+     * @return true if the tokens may depend on variables
+     */
+    bool has_expansions(std::string_view line)
+    {
+        for (auto pos = line.find('$'); pos != std::string_view::npos; pos = line.find('$', pos))
+        {
+            ++pos;
+            if (pos < line.size() && (line[pos] == '{' || is_name_char(line[pos], true)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+} // namespace nullsh::util
\ No newline at end of file
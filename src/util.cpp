@@ -10,12 +10,17 @@
 #include <unistd.h>
 
 #include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
 #include <filesystem>
-#include <format>
+#include <limits>
 #include <optional>
-#include <sstream>
 #include <system_error>
 
+#include "nullsh/command_cache.h"
+#include "nullsh/tokenizer.h"
+
 namespace nullsh::util
 {
     /**
@@ -82,63 +87,56 @@ namespace nullsh::util
      */
     auto tokenize(std::string_view line) -> std::expected<std::vector<std::string>, std::string>
     {
-        std::vector<std::string> tokens;
-        std::string cur;
-        bool in_single_quote = false;
-        bool in_double_quote = false;
-
-        auto push_token = [&]()
+        auto tokens = tokenize_views(line);
+        if (!tokens)
         {
-            if (!cur.empty())
-            {
-                tokens.emplace_back(std::move(cur));
-                cur.clear();
-            }
-        };
+            return std::unexpected(std::move(tokens.error()));
+        }
+        return tokens->to_strings();
+    }
 
-        for (size_t i = 0; i < line.size(); ++i)
-        {
-            char cur_c = line[i];
+    /**
+     * @brief Parses a byte count with an optional binary suffix
+     *
+     * @param str Size such as "4096", "512K", "16M" or "1G"
+     * @return std::optional<std::size_t> Number of bytes, nullopt if malformed or too large
+     */
+    auto parse_size(std::string_view str) -> std::optional<std::size_t>
+    {
+        using namespace std::literals;
 
-            // escape next char
-            if (cur_c == '\\')
-            {
-                if (i + 1 < line.size())
-                {
-                    cur.push_back(line[++i]);
-                }
-                else
-                {
-                    // trailing backslash, treat as literal
-                    cur.push_back('\\');
-                }
-            }
-            else if (cur_c == '\'' && !in_double_quote)
-            {
-                in_single_quote = !in_single_quote;
-            }
-            else if (cur_c == '\"' && !in_single_quote)
-            {
-                in_double_quote = !in_double_quote;
-            }
-            else if (std::isspace(static_cast<unsigned char>(cur_c)) != 0 && !in_single_quote &&
-                     !in_double_quote)
-            {
-                push_token();
-            }
-            else
-            {
-                cur.push_back(cur_c);
-            }
+        std::size_t value = 0;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc {} || ptr == str.data())
+        {
+            return std::nullopt;
         }
 
-        if (in_single_quote || in_double_quote)
+        std::string_view suffix(ptr, str.data() + str.size() - ptr);
+        std::size_t shift = 0;
+        if (suffix == "K"sv || suffix == "k"sv)
+        {
+            shift = 10;
+        }
+        else if (suffix == "M"sv || suffix == "m"sv)
         {
-            return std::unexpected("Mismatched quotes in command line");
+            shift = 20;
+        }
+        else if (suffix == "G"sv || suffix == "g"sv)
+        {
+            shift = 30;
+        }
+        else if (!suffix.empty())
+        {
+            return std::nullopt;
         }
 
-        push_token();
-        return tokens;
+        // a suffix must not push the size past what size_t holds
+        if (value > std::numeric_limits<std::size_t>::max() >> shift)
+        {
+            return std::nullopt;
+        }
+        return value << shift;
     }
 
     /**
@@ -149,44 +147,28 @@ namespace nullsh::util
      */
     bool command_exists(const std::string& cmd)
     {
-        if (cmd.empty())
-        {
-            return false;
-        }
-
-        const char* path_env = std::getenv("PATH");
-        if (path_env == nullptr)
+        if (cmd.empty() || cmd.find('/') != std::string::npos)
         {
             return false;
         }
 
-        std::string path(path_env);
-        std::stringstream sstr(path);
-        std::string dir;
-
-        while (std::getline(sstr, dir, ':'))
-        {
-            std::string full_path = std::format("{}/{}", dir, cmd);
-            if (access(full_path.c_str(), X_OK) == 0)
-            {
-                return true;
-            }
-        }
-
-        return false;
+        return cache::command_cache().lookup(cmd).has_value();
     }
 
     /**
-     * @brief Gets the value of an environment variable
+     * @brief Gets the value of a variable of the process environment
+     *
+     * The shell's own variables live in its vars::VarTable, this is for code running before
+     * or outside a shell.
      *
      * @param name
-     * @return std::optional<std::string>
+     * @return std::optional<std::string_view> View into the environment, valid until it changes
      */
-    auto get_env_var(const std::string& name) -> std::optional<std::string>
+    auto get_env_var(const char* name) -> std::optional<std::string_view>
     {
-        if (const char* value = std::getenv(name.c_str()); value != nullptr)
+        if (const char* value = std::getenv(name); value != nullptr)
         {
-            return std::string(value);
+            return value;
         }
         return std::nullopt;
     }
@@ -195,16 +177,17 @@ namespace nullsh::util
      * @brief Expands a user path, replacing ~ with the user's home directory
      *
      * @param path
+     * @param home Home directory, the path is left as is without one
      * @return std::filesystem::path
      */
-    auto expand_user_path(const std::string& path) -> std::filesystem::path
+    auto expand_user_path(std::string_view path, std::optional<std::string_view> home)
+        -> std::filesystem::path
     {
         if (path.empty() || path[0] != '~')
         {
             return {path};
         }
 
-        auto home = get_env_var("HOME");
         if (!home.has_value())
         {
             return {path};
@@ -253,4 +236,29 @@ namespace nullsh::util
         return {};
     }
 
+    /**
+     * @brief Writes all of data to fd, retrying short and interrupted writes
+     *
+     * @param fd Descriptor to write to
+     * @param data Bytes to write
+     * @return bool false if the write failed, e.g. the reader went away
+     */
+    bool write_all(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            ssize_t done = write(fd, data.data(), data.size());
+            if (done < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (done <= 0)
+            {
+                return false;
+            }
+            data.remove_prefix(static_cast<std::size_t>(done));
+        }
+        return true;
+    }
+
 } // namespace nullsh::util
\ No newline at end of file
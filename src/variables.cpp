@@ -0,0 +1,285 @@
+/**
+ * @file variables.cpp
+ * @brief Shell variables, with the environment of child processes kept ready to pass on
+ *
+ * The envp array holds one slot per exported variable, in no particular order. Adding a
+ * variable appends a slot, removing one moves the last slot into its place, and changing a
+ * value repoints its slot, so every change is O(1) and envp() is always ready for execve().
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include "nullsh/variables.h"
+
+#include <cstdlib>
+
+namespace nullsh::vars
+{
+    namespace
+    {
+        bool name_start(char chr)
+        {
+            return (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || chr == '_';
+        }
+    } // namespace
+
+    /**
+     * @brief Checks if a word is a valid variable name: a letter or '_', then also digits
+     *
+     * @param name Word to check
+     * @return true if it can name a variable
+     */
+    bool valid_name(std::string_view name)
+    {
+        if (name.empty() || !name_start(name[0]))
+        {
+            return false;
+        }
+        for (char chr : name.substr(1))
+        {
+            if (!name_start(chr) && (chr < '0' || chr > '9'))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Splits a NAME=VALUE word
+     *
+     * @param word Word to split
+     * @return Name and value, nullopt when the word is not an assignment
+     */
+    auto split_assignment(std::string_view word)
+        -> std::optional<std::pair<std::string_view, std::string_view>>
+    {
+        auto eq = word.find('=');
+        if (eq == std::string_view::npos || !valid_name(word.substr(0, eq)))
+        {
+            return std::nullopt;
+        }
+        return std::pair {word.substr(0, eq), word.substr(eq + 1)};
+    }
+
+    /**
+     * @brief Imports an environment, every entry becomes an exported variable
+     *
+     * @param env NULL-terminated "NAME=VALUE" strings, such as environ
+     * @param sync_process Also apply later changes of exported variables to the process
+     *        environment, for what still reads it (PATH lookups, libc)
+     */
+    VarTable::VarTable(char* const* env, bool sync_process)
+    {
+        for (; env != nullptr && *env != nullptr; ++env)
+        {
+            std::string_view entry = *env;
+            auto eq = entry.find('=');
+            // the first of duplicate entries wins, as with getenv()
+            if (eq != std::string_view::npos && eq > 0 && !vars_.contains(entry.substr(0, eq)))
+            {
+                put(entry.substr(0, eq), entry.substr(eq + 1), true, false);
+            }
+        }
+        sync_process_ = sync_process;
+    }
+
+    /**
+     * @brief Gets the value of a variable, without copying it
+     *
+     * @param name Variable name
+     * @return View of the value, valid until the variable changes, or nullopt when unset
+     */
+    auto VarTable::get(std::string_view name) const -> std::optional<std::string_view>
+    {
+        auto it = vars_.find(name);
+        if (it == vars_.end())
+        {
+            return std::nullopt;
+        }
+        return value_of(it->second);
+    }
+
+    /**
+     * @brief Checks if a variable is set and exported to child processes
+     *
+     * @param name Variable name
+     */
+    bool VarTable::exported(std::string_view name) const
+    {
+        auto it = vars_.find(name);
+        return it != vars_.end() && it->second.slot != NO_SLOT;
+    }
+
+    /**
+     * @brief Sets a variable, keeping it exported if it was; new variables are not exported
+     *
+     * @param name Valid variable name
+     * @param value New value
+     */
+    void VarTable::set(std::string_view name, std::string_view value)
+    {
+        put(name, value, false, true);
+    }
+
+    /**
+     * @brief Sets a variable and exports it
+     *
+     * @param name Valid variable name
+     * @param value New value
+     */
+    void VarTable::export_var(std::string_view name, std::string_view value)
+    {
+        put(name, value, true, true);
+    }
+
+    /**
+     * @brief Exports a variable that is already set, unset names are left alone
+     *
+     * @param name Variable name
+     */
+    void VarTable::export_var(std::string_view name)
+    {
+        if (auto it = vars_.find(name); it != vars_.end() && it->second.slot == NO_SLOT)
+        {
+            put(name, value_of(it->second), true, true);
+        }
+    }
+
+    /**
+     * @brief Removes a variable
+     *
+     * @param name Variable name
+     * @return bool false if it was not set
+     */
+    bool VarTable::unset(std::string_view name)
+    {
+        if (!vars_.contains(name))
+        {
+            return false;
+        }
+        remove(name, true);
+        return true;
+    }
+
+    // ===== Private functions =====
+
+    void VarTable::put(std::string_view name, std::string_view value, bool exported, bool sync)
+    {
+        auto it = vars_.find(name);
+        if (it == vars_.end())
+        {
+            std::string entry;
+            entry.reserve(name.size() + 1 + value.size());
+            entry.append(name).append(1, '=').append(value);
+            it = vars_
+                     .emplace(std::string(name),
+                              Var {.entry = std::move(entry),
+                                   .value_pos = name.size() + 1,
+                                   .slot = NO_SLOT})
+                     .first;
+        }
+        else
+        {
+            Var& var = it->second;
+            if (value_of(var) != value)
+            {
+                var.entry.replace(var.value_pos, std::string::npos, value);
+            }
+            if (var.slot != NO_SLOT)
+            {
+                envp_[var.slot] = var.entry.data(); // the string may have moved
+            }
+        }
+
+        Var& var = it->second;
+        if (exported && var.slot == NO_SLOT)
+        {
+            add_slot(var);
+        }
+        if (sync && sync_process_ && var.slot != NO_SLOT)
+        {
+            setenv(it->first.c_str(), var.entry.c_str() + var.value_pos, 1);
+        }
+    }
+
+    void VarTable::remove(std::string_view name, bool sync)
+    {
+        auto it = vars_.find(name);
+        if (it->second.slot != NO_SLOT)
+        {
+            drop_slot(it->second);
+            if (sync && sync_process_)
+            {
+                unsetenv(it->first.c_str());
+            }
+        }
+        vars_.erase(it);
+    }
+
+    void VarTable::add_slot(Var& var)
+    {
+        var.slot = envp_.size() - 1;
+        envp_.back() = var.entry.data();
+        envp_.push_back(nullptr);
+        owners_.push_back(&var);
+    }
+
+    void VarTable::drop_slot(Var& var)
+    {
+        // the last slot fills the hole, envp order means nothing
+        std::size_t last = envp_.size() - 2;
+        envp_[var.slot] = envp_[last];
+        owners_[var.slot] = owners_[last];
+        owners_[var.slot]->slot = var.slot;
+
+        envp_.pop_back();
+        envp_.back() = nullptr;
+        owners_.pop_back();
+        var.slot = NO_SLOT;
+    }
+
+    /**
+     * @brief Puts back every variable the scope changed, last change first
+     */
+    VarTable::Scope::~Scope()
+    {
+        for (auto it = saved_.rbegin(); it != saved_.rend(); ++it)
+        {
+            if (!it->value)
+            {
+                if (table_->vars_.contains(it->name))
+                {
+                    table_->remove(it->name, false);
+                }
+                continue;
+            }
+
+            table_->put(it->name, *it->value, false, false);
+            Var& var = table_->vars_.find(it->name)->second;
+            if (!it->exported && var.slot != NO_SLOT)
+            {
+                table_->drop_slot(var);
+            }
+        }
+    }
+
+    void VarTable::Scope::apply(std::string_view word)
+    {
+        auto assignment = split_assignment(word);
+        if (!assignment)
+        {
+            return;
+        }
+
+        auto [name, value] = *assignment;
+        Saved saved {.name = std::string(name), .value = std::nullopt, .exported = false};
+        if (auto it = table_->vars_.find(name); it != table_->vars_.end())
+        {
+            saved.value = std::string(value_of(it->second));
+            saved.exported = it->second.slot != NO_SLOT;
+        }
+        saved_.push_back(std::move(saved));
+        table_->put(name, value, true, false);
+    }
+} // namespace nullsh::vars
\ No newline at end of file
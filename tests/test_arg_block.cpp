@@ -0,0 +1,137 @@
+/**
+ * @file test_arg_block.cpp
+ * @brief Unit tests for the flat argument block
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/arg_block.h"
+#include "nullsh/parser.h"
+#include "nullsh/tokenizer.h"
+
+using nullsh::command::ArgBlock;
+
+namespace
+{
+    // counts what reaches the heap, installed as the default resource for a scope
+    class CountingResource : public std::pmr::memory_resource
+    {
+      public:
+        int allocations {0};
+
+      private:
+        void* do_allocate(std::size_t bytes, std::size_t align) override
+        {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, align);
+        }
+        void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override
+        {
+            std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+} // namespace
+
+TEST(ArgBlock, StoresArgumentsBackToBack)
+{
+    ArgBlock args {"-l", "", "/tmp"};
+    ASSERT_EQ(args.size(), 3);
+    EXPECT_EQ(args[0], "-l");
+    EXPECT_EQ(args[1], "");
+    EXPECT_EQ(args.back(), "/tmp");
+    EXPECT_EQ(args.bytes(), std::string_view("-l\0\0/tmp\0", 9));
+    EXPECT_EQ(args, std::vector<std::string>({"-l", "", "/tmp"}));
+}
+
+TEST(ArgBlock, ArgvPointsIntoTheBlock)
+{
+    ArgBlock args {"a", "bc"};
+    char* const* argv = args.argv("prog");
+    EXPECT_STREQ(argv[0], "prog");
+    EXPECT_STREQ(argv[1], "a");
+    EXPECT_STREQ(argv[2], "bc");
+    EXPECT_EQ(argv[3], nullptr);
+    EXPECT_EQ(argv[2], argv[1] + 2);
+    EXPECT_EQ(argv[1], args.bytes().data());
+}
+
+TEST(ArgBlock, PopBackDropsTheLastArgument)
+{
+    ArgBlock args {"x", "!", "?"};
+    args.pop_back();
+    args.pop_back();
+    EXPECT_EQ(args, std::vector<std::string>({"x"}));
+    args.push_back("y");
+    EXPECT_EQ(args.bytes(), std::string_view("x\0y\0", 4));
+}
+
+TEST(ArgBlock, CopiesAndMovesKeepTheirContents)
+{
+    const std::vector<std::string> expected {"one", "two"};
+    auto arena = nullsh::command::make_arena(64);
+    ArgBlock parsed(arena);
+    parsed.assign(expected.begin(), expected.end());
+
+    ArgBlock copy = parsed;
+    ArgBlock other(nullsh::command::make_arena(64));
+    other.push_back("three");
+    other = std::move(parsed);
+    arena.reset();
+
+    EXPECT_EQ(copy, other);
+    EXPECT_EQ(other, expected);
+    other.push_back("four");
+    EXPECT_EQ(other.back(), "four");
+}
+
+TEST(ArgBlock, LongLineParsesWithoutPerArgumentAllocations)
+{
+    std::string line = "echo";
+    for (int i = 0; i < 4096; ++i)
+    {
+        line += " file" + std::to_string(i) + ".txt";
+    }
+    auto tokens = nullsh::util::tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+
+    CountingResource counting;
+    auto* previous = std::pmr::set_default_resource(&counting);
+    auto cmd = nullsh::parser::make_command(*tokens);
+    std::pmr::set_default_resource(previous);
+
+    ASSERT_TRUE(cmd.has_value());
+    ASSERT_EQ(cmd->args.size(), 4096);
+    EXPECT_EQ(cmd->args[4095], "file4095.txt");
+    // the arena's first chunk holds the whole line, argv included
+    char* const* argv = cmd->args.argv(cmd->name.c_str());
+    EXPECT_STREQ(argv[4096], "file4095.txt");
+    EXPECT_LE(counting.allocations, 1);
+}
+
+TEST(ArgBlock, PipelineStagesShareOneArena)
+{
+    std::vector<std::string> tokens {"ls", "-l", "|", "grep", "x", "|", "wc", "-l"};
+
+    CountingResource counting;
+    auto* previous = std::pmr::set_default_resource(&counting);
+    auto cmd = nullsh::parser::make_command(tokens);
+    std::pmr::set_default_resource(previous);
+
+    ASSERT_TRUE(cmd.has_value());
+    ASSERT_EQ(cmd->stages.size(), 3);
+    EXPECT_EQ(cmd->stages[2].args, std::vector<std::string>({"-l"}));
+    // every stage fits in the buffer allocated together with the arena
+    EXPECT_EQ(counting.allocations, 0);
+}
\ No newline at end of file
@@ -9,6 +9,14 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
 #include "nullsh/builtins.h"
 #include "nullsh/shell.h"
 
@@ -21,7 +29,24 @@ TEST(BuiltinsTest, IsBuiltin)
     EXPECT_TRUE(is_builtin("pwd"));
     EXPECT_TRUE(is_builtin("echo"));
     EXPECT_TRUE(is_builtin("exit"));
+    EXPECT_TRUE(is_builtin("hash"));
+    EXPECT_TRUE(is_builtin("jobs"));
+    EXPECT_TRUE(is_builtin("wait"));
+    EXPECT_TRUE(is_builtin("fg"));
+    EXPECT_TRUE(is_builtin("limit"));
+    EXPECT_TRUE(is_builtin("source"));
+    EXPECT_TRUE(is_builtin("."));
+    EXPECT_TRUE(is_builtin("["));
+    EXPECT_TRUE(is_builtin("printf"));
+    EXPECT_TRUE(is_builtin("export"));
+    EXPECT_TRUE(is_builtin("unset"));
+    EXPECT_TRUE(is_builtin("history"));
     EXPECT_FALSE(is_builtin("nonexistentcommand"));
+
+    EXPECT_TRUE(is_utility("cat"));
+    EXPECT_TRUE(is_utility("sleep"));
+    EXPECT_FALSE(is_utility("cd"));
+    EXPECT_FALSE(is_utility("nonexistentcommand"));
 }
 
 TEST(BuiltinsTest, ExecuteCd)
@@ -88,7 +113,7 @@ TEST(BuiltinsTest, ExecuteNonexistent)
     auto res = execute(cmd, sh);
     EXPECT_EQ(res.return_code, nullsh::shell::EXIT_CMD_NOT_FOUND);
     EXPECT_EQ(res.stdout_data, "");
-    EXPECT_EQ(res.stderr_data, "not a builtin");
+    EXPECT_EQ(res.stderr_data, "not a builtin\n");
 }
 
 TEST(BuiltinsTest, ExecuteCdInvalid)
@@ -334,3 +359,467 @@ TEST(BuiltinsTest, ExecuteEchoWithEscapeSequences)
     EXPECT_EQ(res.stdout_data, "Hello,\\nWorld!\\tTabbed\n"); // escape sequences not interpreted
     EXPECT_EQ(res.stderr_data, "");
 }
+
+TEST(BuiltinsTest, ExecuteHash)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "hash";
+    cmd.args = {"-r"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 0);
+
+    cmd.args = {};
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "hash: hash table empty\n");
+
+    cmd.args = {"ls"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 0);
+
+    cmd.args = {};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_TRUE(res.stdout_data.starts_with("hits\tcommand\n"));
+    EXPECT_NE(res.stdout_data.find("/ls\n"), std::string::npos);
+}
+
+TEST(BuiltinsTest, ExecuteHashMissing)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "hash";
+    cmd.args = {"nonexistentcommand"};
+
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "hash: nonexistentcommand: not found\n");
+}
+
+
+TEST(BuiltinsTest, ExecuteJobsWaitFg)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command job_cmd {.type = nullsh::command::CommandType::External,
+                                      .name = "sh",
+                                      .args = {"-c", "exit 4"},
+                                      .ops = {nullsh::command::Op::DiscardOutput}};
+    sh.jobs().add(nullsh::executor::exec_background(job_cmd));
+    job_cmd.args = {"-c", "exit 5"};
+    sh.jobs().add(nullsh::executor::exec_background(job_cmd));
+
+    nullsh::command::Command cmd;
+    cmd.name = "jobs";
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_NE(res.stdout_data.find("[1]  "), std::string::npos);
+    EXPECT_NE(res.stdout_data.find("sh -c exit 5\n"), std::string::npos);
+
+    cmd.name = "wait";
+    cmd.args = {"%1"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 4);
+
+    cmd.args = {"1"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 127);
+    EXPECT_EQ(res.stderr_data, "wait: 1: no such job\n");
+
+    cmd.name = "fg";
+    cmd.args = {};
+    EXPECT_EQ(execute(cmd, sh).return_code, 5);
+    EXPECT_TRUE(sh.jobs().empty());
+
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "fg: current: no such job\n");
+
+    cmd.name = "wait";
+    EXPECT_EQ(execute(cmd, sh).return_code, 0);
+}
+
+TEST(BuiltinsTest, ExecuteLimit)
+{
+    nullsh::shell::NullShell sh {};
+    sh.exec_options().retain_output = true;
+    nullsh::command::Command cmd;
+    cmd.name = "limit";
+    cmd.ops = {nullsh::command::Op::None};
+
+    cmd.args = {"-t", "0.1", "sleep", "5"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 124);
+
+    cmd.args = {"-n", "17", "-o", "1K", "--", "sh", "-c", "ulimit -n"};
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "17\n");
+
+    // limits are per command, not sticky
+    EXPECT_EQ(sh.exec_options().limits.open_files, 0);
+}
+
+TEST(BuiltinsTest, ExecuteLimitErrors)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "limit";
+
+    cmd.args = {"-t", "soon", "ls"};
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 2);
+    EXPECT_EQ(res.stderr_data, "limit: -t: invalid value 'soon'\n");
+
+    cmd.args = {"-x", "1", "ls"};
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "limit: -x: unknown option\n");
+
+    cmd.args = {"-t"};
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "limit: -t: missing value\n");
+
+    cmd.args = {"-t", "1"};
+    EXPECT_TRUE(execute(cmd, sh).stderr_data.starts_with("limit: usage:"));
+
+    cmd.args = {"cd", "/"};
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "limit: cd: only external commands can be limited\n");
+}
+
+TEST(BuiltinsTest, ExecuteMemo)
+{
+    nullsh::shell::NullShell sh {};
+    std::string dir = testing::TempDir();
+    std::string runs = dir + "/memo_runs";
+    std::string dep = dir + "/memo_dep";
+    std::remove(runs.c_str());
+    std::ofstream(dep) << "one\n";
+
+    nullsh::command::Command cmd;
+    cmd.name = "memo";
+    cmd.ops = {nullsh::command::Op::None};
+    cmd.args = {"-d", dep, "sh", "-c", "echo run >> \"$0\"; cat \"$1\"", runs, dep};
+
+    auto count_runs = [&runs]
+    {
+        std::ifstream in {runs};
+        return std::count(std::istreambuf_iterator<char> {in}, {}, '\n');
+    };
+
+    // the second run is replayed from the cache, without running the command
+    EXPECT_EQ(execute(cmd, sh).stdout_data, "one\n");
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "one\n");
+    EXPECT_EQ(count_runs(), 1);
+    EXPECT_EQ(sh.memo().stats().hits, 1U);
+
+    // a changed dependency or argv is a new key
+    std::ofstream(dep) << "two two\n";
+    EXPECT_EQ(execute(cmd, sh).stdout_data, "two two\n");
+    EXPECT_EQ(count_runs(), 2);
+    cmd.args.push_back("extra");
+    execute(cmd, sh);
+    EXPECT_EQ(count_runs(), 3);
+
+    // so is a changed variable the key names
+    cmd.args = {"-e", "MEMO_TEST", "sh", "-c", "echo run >> \"$0\"", runs};
+    execute(cmd, sh);
+    execute(cmd, sh);
+    EXPECT_EQ(count_runs(), 4);
+    sh.variables().export_var("MEMO_TEST", "1");
+    execute(cmd, sh);
+    EXPECT_EQ(count_runs(), 5);
+
+    cmd.args = {"-r"};
+    execute(cmd, sh);
+    EXPECT_EQ(sh.memo().stats().entries, 0U);
+}
+
+TEST(BuiltinsTest, ExecuteMemoErrors)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "memo";
+
+    cmd.args = {"-x", "1", "ls"};
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "memo: -x: unknown option\n");
+
+    cmd.args = {"-d"};
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "memo: -d: missing value\n");
+
+    cmd.args = {"-e", "HOME"};
+    EXPECT_TRUE(execute(cmd, sh).stderr_data.starts_with("memo: usage:"));
+
+    cmd.args = {"-c", "/", "ls"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 1);
+
+    cmd.args = {"cd", "/"};
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "memo: cd: only external commands can be memoized\n");
+}
+
+TEST(BuiltinsTest, ExecuteSource)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "source";
+
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 2);
+    EXPECT_EQ(res.stderr_data, "source: usage: source file\n");
+
+    cmd.args = {"/nonexistent/script.nsh"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "source: /nonexistent/script.nsh: No such file or directory\n");
+}
+
+TEST(BuiltinsTest, ExecuteTrueFalse)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "true";
+    cmd.args = {"--ignored"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 0);
+
+    cmd.name = "false";
+    EXPECT_EQ(execute(cmd, sh).return_code, 1);
+}
+
+TEST(BuiltinsTest, ExecuteTest)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "test";
+    auto test = [&sh, &cmd](std::initializer_list<std::string_view> args)
+    {
+        cmd.args = args;
+        return execute(cmd, sh).return_code;
+    };
+
+    EXPECT_EQ(test({}), 1);
+    EXPECT_EQ(test({""}), 1);
+    EXPECT_EQ(test({"word"}), 0);
+    EXPECT_EQ(test({"!", "word"}), 1);
+    EXPECT_EQ(test({"-n", ""}), 1);
+    EXPECT_EQ(test({"-z", ""}), 0);
+    EXPECT_EQ(test({"-d", "/tmp"}), 0);
+    EXPECT_EQ(test({"-f", "/tmp"}), 1);
+    EXPECT_EQ(test({"-e", "/nonexistent"}), 1);
+    EXPECT_EQ(test({"-r", "/"}), 0);
+    EXPECT_EQ(test({"a", "=", "a"}), 0);
+    EXPECT_EQ(test({"a", "!=", "a"}), 1);
+    EXPECT_EQ(test({" 10", "-gt", "+9 "}), 0);
+    EXPECT_EQ(test({"-1", "-ge", "0"}), 1);
+    EXPECT_EQ(test({"/", "-ef", "/."}), 0);
+    EXPECT_EQ(test({"/nonexistent", "-ot", "/"}), 0);
+    EXPECT_EQ(test({"a", "-a", "", "-o", "b"}), 0);
+    EXPECT_EQ(test({"(", "a", "=", "b", ")", "-o", "!", "-z", "x"}), 0);
+    EXPECT_EQ(test({"!", "(", "-d", "/", "-a", "-d", "/tmp", ")"}), 1);
+
+    EXPECT_EQ(test({"1", "-eq", "one"}), 2);
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "test: invalid integer 'one'\n");
+    EXPECT_EQ(test({"a", "b"}), 2);
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "test: missing argument after 'b'\n");
+    EXPECT_EQ(test({"a", "b", "c"}), 2);
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "test: 'b': binary operator expected\n");
+    EXPECT_EQ(test({"(", "a", "-a", "b"}), 2);
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "test: ')' expected\n");
+    EXPECT_EQ(test({"a", "-nt", "b", "-nt", "c"}), 2);
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "test: extra argument '-nt'\n");
+
+    cmd.name = "[";
+    EXPECT_EQ(test({"-d", "/", "]"}), 0);
+    EXPECT_EQ(test({"]"}), 1);
+    EXPECT_EQ(test({"-d", "/"}), 2);
+    EXPECT_EQ(execute(cmd, sh).stderr_data, "[: missing ']'\n");
+}
+
+TEST(BuiltinsTest, ExecutePrintf)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "printf";
+    auto printf = [&sh, &cmd](std::initializer_list<std::string_view> args)
+    {
+        cmd.args = args;
+        return execute(cmd, sh).stdout_data;
+    };
+
+    EXPECT_EQ(printf({"plain\\t\\x41\\101\\n"}), "plain\tAA\n");
+    EXPECT_EQ(printf({"[%s]", "a", "b"}), "[a][b]");
+    EXPECT_EQ(printf({"%s=%d\\n", "one", "1", "two"}), "one=1\ntwo=0\n");
+    EXPECT_EQ(printf({"[%5s|%-5s|%.2s]", "ab", "cd", "efg"}), "[   ab|cd   |ef]");
+    EXPECT_EQ(printf({"[%*s]", "-4", "x"}), "[x   ]");
+    EXPECT_EQ(printf({"%05d %x %o %u %+i", "42", "255", "8", "7", "0x10"}), "00042 ff 10 7 +16");
+    EXPECT_EQ(printf({"%.3f %e %g", "3.14159", "1000", "0.5"}), "3.142 1.000000e+03 0.5");
+    EXPECT_EQ(printf({"%d %d", "'A", "\"B"}), "65 66");
+    EXPECT_EQ(printf({"%c%c", "xyz", ""}), std::string("x\0", 2));
+    EXPECT_EQ(printf({"%b|%s", "a\\tb\\0101", "\\t"}), "a\tbA|\\t");
+    EXPECT_EQ(printf({"%b after", "stop\\chere"}), "stop");
+    EXPECT_EQ(printf({"100%%"}), "100%");
+    EXPECT_EQ(printf({"%s", std::string(5000, 'p')}), std::string(5000, 'p'));
+
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+
+    cmd.args = {"%d|%d|%d", "12abc", "x", ""};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stdout_data, "12|0|0");
+    EXPECT_EQ(res.stderr_data,
+              "printf: '12abc': value not completely converted\n"
+              "printf: 'x': expected a numeric value\n");
+
+    // widths and precisions that do not fit an int are errors, not wrapped
+    cmd.args = {"[%*s|%.*s|%99999999999s]", "4294967297", "a", "-9999999999", "b", "c"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stdout_data, "[a|b|c]");
+    EXPECT_EQ(res.stderr_data,
+              "printf: '4294967297': invalid field width\n"
+              "printf: '-9999999999': invalid precision\n"
+              "printf: '99999999999': invalid field width\n");
+
+    cmd.args = {};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "printf: missing operand\n");
+}
+
+TEST(BuiltinsTest, ExecuteSleep)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "sleep";
+
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "sleep: missing operand\n");
+
+    cmd.args = {"1x", "-1"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data,
+              "sleep: invalid time interval '1x'\nsleep: invalid time interval '-1'\n");
+
+    cmd.args = {"0.02", "0.0005m"};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(execute(cmd, sh).return_code, 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST(BuiltinsTest, ExecuteHistory)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "history";
+
+    // off unless asked for
+    EXPECT_EQ(sh.history(), nullptr);
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "history: not enabled, start nullsh with --history <file>\n");
+
+    std::string path = testing::TempDir() + "nullsh_history_builtin";
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+    ASSERT_TRUE(sh.enable_history(path).has_value());
+    for (const char* line : {"make", "git pull", "make test", "git push"})
+    {
+        sh.history()->append(line);
+    }
+
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "make\ngit pull\nmake test\ngit push\n");
+
+    cmd.args = {"-n", "1", "make"};
+    EXPECT_EQ(execute(cmd, sh).stdout_data, "make test\n");
+
+    cmd.args = {"-n", "x"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "history: x: invalid count\n");
+}
+
+TEST(BuiltinsTest, ExecuteCat)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "cat";
+
+    std::string path = testing::TempDir() + "nullsh_cat_test.txt";
+    std::string content(100000, 'c');
+    content += "end";
+    {
+        std::ofstream file(path);
+        file << content;
+    }
+
+    cmd.args = {path, "--", path};
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, content + content);
+
+    cmd.args = {"/nonexistent", path, "/"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stdout_data, content);
+    EXPECT_EQ(res.stderr_data,
+              "cat: /nonexistent: No such file or directory\n"
+              "cat: /: Is a directory\n");
+
+    std::remove(path.c_str());
+}
+
+TEST(BuiltinsTest, ExecuteEnv)
+{
+    nullsh::shell::NullShell sh {};
+    sh.exec_options().retain_output = true;
+    nullsh::command::Command cmd;
+    cmd.name = "env";
+    cmd.ops = {nullsh::command::Op::None};
+    sh.variables().export_var("NULLSH_ENV_TEST", "before");
+    sh.variables().set("NULLSH_LOCAL", "not exported");
+
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_NE(res.stdout_data.find("NULLSH_ENV_TEST=before\n"), std::string::npos);
+    EXPECT_EQ(res.stdout_data.find("NULLSH_LOCAL"), std::string::npos);
+
+    cmd.args = {"-i", "A=1", "NULLSH_ENV_TEST=after"};
+    EXPECT_EQ(execute(cmd, sh).stdout_data, "A=1\nNULLSH_ENV_TEST=after\n");
+
+    cmd.args = {"NULLSH_ENV_TEST=after", "sh", "-c", "echo $NULLSH_ENV_TEST"};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "after\n");
+
+    // the shell's own environment is left alone
+    EXPECT_EQ(sh.variables().get("NULLSH_ENV_TEST"), "before");
+    EXPECT_STREQ(getenv("NULLSH_ENV_TEST"), "before");
+    sh.variables().unset("NULLSH_ENV_TEST");
+    EXPECT_EQ(getenv("NULLSH_ENV_TEST"), nullptr);
+}
+
+TEST(BuiltinsTest, ExecuteExportUnset)
+{
+    nullsh::shell::NullShell sh {};
+    nullsh::command::Command cmd;
+    cmd.name = "export";
+    cmd.args = {"NULLSH_EXPORTED=it's", "NULLSH_LATER", "1bad"};
+    sh.variables().set("NULLSH_LATER", "now");
+
+    auto res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 1);
+    EXPECT_EQ(res.stderr_data, "export: '1bad': not a valid identifier\n");
+    EXPECT_TRUE(sh.variables().exported("NULLSH_EXPORTED"));
+    EXPECT_TRUE(sh.variables().exported("NULLSH_LATER"));
+    EXPECT_STREQ(getenv("NULLSH_LATER"), "now");
+
+    cmd.args = {};
+    res = execute(cmd, sh);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_NE(res.stdout_data.find("export NULLSH_EXPORTED='it'\\''s'\n"), std::string::npos);
+
+    cmd.name = "unset";
+    cmd.args = {"NULLSH_EXPORTED", "NULLSH_LATER", "NULLSH_NEVER_SET"};
+    EXPECT_EQ(execute(cmd, sh).return_code, 0);
+    EXPECT_FALSE(sh.variables().get("NULLSH_EXPORTED").has_value());
+    EXPECT_EQ(getenv("NULLSH_LATER"), nullptr);
+}
\ No newline at end of file
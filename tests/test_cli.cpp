@@ -51,4 +51,75 @@ TEST(ParseCLI, UnknownOption)
     auto cli = parse_cli(args);
     ASSERT_FALSE(cli.has_value());
     EXPECT_EQ(cli.error(), "Unknown option: -x");
+}
+TEST(ParseCLI, SpillThreshold)
+{
+    std::array args {"nullsh", "--spill-threshold", "64M"};
+    auto cli = parse_cli(args);
+    ASSERT_TRUE(cli.has_value());
+    EXPECT_EQ(cli->spill_threshold, 64UL * 1024 * 1024);
+}
+
+TEST(ParseCLI, SpillThresholdInvalid)
+{
+    std::array args {"nullsh", "--spill-threshold", "lots"};
+    auto cli = parse_cli(args);
+    ASSERT_FALSE(cli.has_value());
+    EXPECT_EQ(cli.error(), "Invalid size for --spill-threshold: lots");
+}
+
+
+TEST(ParseCLI, Script)
+{
+    std::array args {"nullsh", "--spill-threshold", "1M", "build.nsh"};
+    auto cli = parse_cli(args);
+    ASSERT_TRUE(cli.has_value());
+    EXPECT_EQ(cli->script, "build.nsh");
+
+    std::array extra {"nullsh", "build.nsh", "other.nsh"};
+    cli = parse_cli(extra);
+    ASSERT_FALSE(cli.has_value());
+    EXPECT_EQ(cli.error(), "Unexpected argument: other.nsh");
+}
+
+TEST(ParseCLI, ServerAndClient)
+{
+    std::array server {"nullsh", "--server", "/tmp/nullsh.sock"};
+    auto cli = parse_cli(server);
+    ASSERT_TRUE(cli.has_value());
+    EXPECT_EQ(cli->server, "/tmp/nullsh.sock");
+
+    std::array client {"nullsh", "--client", "/tmp/nullsh.sock", "-c", "ls !"};
+    cli = parse_cli(client);
+    ASSERT_TRUE(cli.has_value());
+    EXPECT_EQ(cli->client, "/tmp/nullsh.sock");
+    EXPECT_EQ(cli->one_shot, "ls !");
+
+    std::array no_command {"nullsh", "--client", "/tmp/nullsh.sock"};
+    cli = parse_cli(no_command);
+    ASSERT_FALSE(cli.has_value());
+    EXPECT_EQ(cli.error(), "--client requires -c");
+
+    std::array missing {"nullsh", "--server"};
+    cli = parse_cli(missing);
+    ASSERT_FALSE(cli.has_value());
+    EXPECT_EQ(cli.error(), "Missing argument to --server");
+}
+
+TEST(ParseCLI, History)
+{
+    std::array history {"nullsh", "--history", "/tmp/nullsh_history"};
+    auto cli = parse_cli(history);
+    ASSERT_TRUE(cli.has_value());
+    EXPECT_EQ(cli->history, "/tmp/nullsh_history");
+
+    std::array none {"nullsh"};
+    cli = parse_cli(none);
+    ASSERT_TRUE(cli.has_value());
+    EXPECT_FALSE(cli->history.has_value());
+
+    std::array missing {"nullsh", "--history"};
+    cli = parse_cli(missing);
+    ASSERT_FALSE(cli.has_value());
+    EXPECT_EQ(cli.error(), "Missing argument to --history");
 }
\ No newline at end of file
@@ -6,3 +6,43 @@
  */
 
 #include <gtest/gtest.h>
+#include <sys/resource.h>
+
+#include <chrono>
+
+#include "nullsh/command.h"
+
+using namespace nullsh::command;
+
+TEST(CommandTest, ToUsage)
+{
+    rusage ru {};
+    ru.ru_utime = {.tv_sec = 1, .tv_usec = 500};
+    ru.ru_stime = {.tv_sec = 0, .tv_usec = 250};
+    ru.ru_maxrss = 2048;
+    ru.ru_minflt = 10;
+    ru.ru_majflt = 1;
+    ru.ru_nvcsw = 3;
+    ru.ru_nivcsw = 4;
+
+    auto usage = to_usage(ru);
+    EXPECT_EQ(usage.wall.count(), 0);
+    EXPECT_EQ(usage.user, std::chrono::microseconds(1000500));
+    EXPECT_EQ(usage.system, std::chrono::microseconds(250));
+    EXPECT_EQ(usage.max_rss_kib, 2048);
+    EXPECT_EQ(usage.minor_faults, 10);
+    EXPECT_EQ(usage.major_faults, 1);
+    EXPECT_EQ(usage.voluntary_switches, 3);
+    EXPECT_EQ(usage.involuntary_switches, 4);
+}
+
+TEST(CommandTest, UsageSum)
+{
+    Usage total {.user = std::chrono::microseconds(10), .max_rss_kib = 100, .minor_faults = 5};
+    total += {.user = std::chrono::microseconds(5), .max_rss_kib = 300, .minor_faults = 1};
+    total += {.user = std::chrono::microseconds(1), .max_rss_kib = 200, .minor_faults = 1};
+
+    EXPECT_EQ(total.user, std::chrono::microseconds(16));
+    EXPECT_EQ(total.max_rss_kib, 300); // peak of the processes, not a sum
+    EXPECT_EQ(total.minor_faults, 7);
+}
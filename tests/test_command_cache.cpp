@@ -0,0 +1,146 @@
+/**
+ * @file test_command_cache.cpp
+ * @brief Unit tests for the command lookup cache
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include "nullsh/command_cache.h"
+
+using namespace nullsh::cache;
+
+class CommandCacheTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        const char* path = std::getenv("PATH");
+        saved_path = path != nullptr ? path : "";
+        dir = std::filesystem::path(testing::TempDir()) / "nullsh_cache_test";
+        std::filesystem::create_directories(dir);
+    }
+
+    void TearDown() override
+    {
+        setenv("PATH", saved_path.c_str(), 1);
+        std::filesystem::remove_all(dir);
+    }
+
+    void make_executable(const std::string& name)
+    {
+        auto file = dir / name;
+        int fd = open(file.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0755);
+        ASSERT_GE(fd, 0);
+        close(fd);
+    }
+
+    std::string saved_path;
+    std::filesystem::path dir;
+};
+
+TEST_F(CommandCacheTest, ResolvesThroughPath)
+{
+    CommandCache cache;
+    auto path = cache.lookup("ls");
+    ASSERT_TRUE(path.has_value());
+    EXPECT_EQ(path->front(), '/'); // NOLINT(bugprone-unchecked-optional-access)
+    EXPECT_FALSE(cache.lookup("some_nonexistent_command_12345").has_value());
+}
+
+TEST_F(CommandCacheTest, UnsetPathSearchesDefaultPath)
+{
+    unsetenv("PATH");
+    CommandCache cache;
+    auto path = cache.lookup("ls");
+    ASSERT_TRUE(path.has_value());
+    EXPECT_EQ(path->front(), '/'); // NOLINT(bugprone-unchecked-optional-access)
+
+    // and again after PATH had been set to something else
+    setenv("PATH", dir.c_str(), 1);
+    EXPECT_FALSE(cache.lookup("ls").has_value());
+    unsetenv("PATH");
+    EXPECT_TRUE(cache.lookup("ls").has_value());
+}
+
+TEST_F(CommandCacheTest, CountsHits)
+{
+    CommandCache cache;
+    cache.lookup("ls");
+    cache.lookup("ls");
+
+    std::size_t hits = 0;
+    cache.for_each([&hits](std::string_view name, const CommandCache::Entry& entry)
+                   { hits = name == "ls" ? entry.hits : hits; });
+    EXPECT_EQ(hits, 2);
+
+    cache.clear();
+    hits = 0;
+    cache.for_each([&hits](std::string_view, const CommandCache::Entry&) { ++hits; });
+    EXPECT_EQ(hits, 0);
+}
+
+TEST_F(CommandCacheTest, NewExecutableInvalidatesMiss)
+{
+    setenv("PATH", dir.c_str(), 1);
+
+    CommandCache cache;
+    EXPECT_FALSE(cache.lookup("nullsh_cached_tool").has_value());
+
+    // directory mtime moves, the cached miss must not stick
+    make_executable("nullsh_cached_tool");
+    auto path = cache.lookup("nullsh_cached_tool");
+    ASSERT_TRUE(path.has_value());
+    EXPECT_EQ(*path, (dir / "nullsh_cached_tool").string()); // NOLINT
+}
+
+TEST_F(CommandCacheTest, PathChangeInvalidates)
+{
+    make_executable("nullsh_cached_tool");
+
+    CommandCache cache;
+    setenv("PATH", "/nonexistentdirectory", 1);
+    EXPECT_FALSE(cache.lookup("nullsh_cached_tool").has_value());
+
+    setenv("PATH", dir.c_str(), 1);
+    EXPECT_TRUE(cache.lookup("nullsh_cached_tool").has_value());
+}
+
+TEST_F(CommandCacheTest, SkipsDirectoriesAndNonExecutables)
+{
+    setenv("PATH", dir.c_str(), 1);
+    std::filesystem::create_directories(dir / "subdir");
+    int fd = open((dir / "plain").c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    CommandCache cache;
+    EXPECT_FALSE(cache.lookup("subdir").has_value());
+    EXPECT_FALSE(cache.lookup("plain").has_value());
+}
+
+
+TEST_F(CommandCacheTest, WarmResolvesPathUpFront)
+{
+    setenv("PATH", dir.c_str(), 1);
+    make_executable("nullsh_warm_a");
+    make_executable("nullsh_warm_b");
+    std::filesystem::create_directories(dir / "subdir");
+
+    CommandCache cache;
+    EXPECT_EQ(cache.warm(), 2U);
+
+    std::size_t hits = 0;
+    cache.for_each([&hits](std::string_view, const CommandCache::Entry& entry)
+                   { hits += entry.hits; });
+    EXPECT_EQ(hits, 0U); // warming is not a hit
+    EXPECT_TRUE(cache.lookup("nullsh_warm_a").has_value());
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+/**
+ * @file test_completion.cpp
+ * @brief Unit tests for the completion trie, directory cache and completer
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nullsh/completion.h"
+
+using namespace nullsh::complete;
+
+namespace
+{
+    std::filesystem::path fresh_dir(const std::string& name)
+    {
+        auto path = std::filesystem::path(testing::TempDir()) / name;
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+        return path;
+    }
+
+    void wait_ready(const Completer& completer)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!completer.ready() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_TRUE(completer.ready());
+    }
+} // namespace
+
+TEST(TrieTest, CountsExtendsAndCollects)
+{
+    Trie trie;
+    for (const char* word : {"git", "gitk", "git-lfs", "gcc", "g++", "make", "git"})
+    {
+        trie.insert(word);
+    }
+
+    EXPECT_EQ(trie.size(), 6U);
+    EXPECT_EQ(trie.count("g"), 5U);
+    EXPECT_EQ(trie.count("git"), 3U);
+    EXPECT_EQ(trie.count("x"), 0U);
+
+    EXPECT_EQ(trie.extension("gi"), "t"); // "git" is a word itself, so it stops there
+    EXPECT_EQ(trie.extension("m"), "ake");
+    EXPECT_EQ(trie.extension("g"), "");
+    EXPECT_EQ(trie.extension("x"), "");
+
+    std::vector<std::string> out;
+    trie.collect("g", 10, out);
+    EXPECT_EQ(out, (std::vector<std::string> {"g++", "gcc", "git", "git-lfs", "gitk"}));
+
+    out.clear();
+    trie.collect("", 2, out);
+    EXPECT_EQ(out, (std::vector<std::string> {"g++", "gcc"}));
+}
+
+TEST(DirCacheTest, ListsSortedAndNoticesChanges)
+{
+    auto dir = fresh_dir("nullsh_dircache");
+    std::ofstream(dir / "beta") << "";
+    std::ofstream(dir / "alpha") << "";
+    std::filesystem::create_directory(dir / "sub");
+
+    DirCache cache;
+    const auto& first = cache.list(dir.string());
+    ASSERT_EQ(first.size(), 3U);
+    EXPECT_EQ(first[0].name, "alpha");
+    EXPECT_EQ(first[2].name, "sub");
+    EXPECT_TRUE(first[2].is_dir);
+    EXPECT_FALSE(first[0].is_dir);
+
+    // a new entry changes the directory's mtime
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::ofstream(dir / "gamma") << "";
+    EXPECT_EQ(cache.list(dir.string()).size(), 4U);
+
+    EXPECT_TRUE(cache.list((dir / "missing").string()).empty());
+}
+
+TEST(CompleterTest, CompletesBuiltinsAndPath)
+{
+    Completer completer;
+    wait_ready(completer);
+    EXPECT_GT(completer.commands()->size(), 20U);
+
+    // "export" is a builtin
+    auto res = completer.complete("expo", 4);
+    EXPECT_EQ(res.start, 0U);
+    EXPECT_EQ(res.insert, "rt ");
+    EXPECT_EQ(res.total, 1U);
+
+    // several builtins and programs start with "ec", or one does and it is done
+    res = completer.complete("ls | ech", 8);
+    EXPECT_EQ(res.start, 5U);
+    EXPECT_EQ(res.insert, "o ");
+
+    res = completer.complete("FOO=1 expo", 10);
+    EXPECT_EQ(res.insert, "rt ");
+
+    res = completer.complete("no_such_command_prefix_", 23);
+    EXPECT_EQ(res.total, 0U);
+    EXPECT_TRUE(res.insert.empty());
+}
+
+TEST(CompleterTest, CompletesPaths)
+{
+    auto dir = fresh_dir("nullsh_complete_paths");
+    std::ofstream(dir / "notes one.txt") << "";
+    std::ofstream(dir / "notes two.txt") << "";
+    std::ofstream(dir / ".hidden") << "";
+    std::filesystem::create_directory(dir / "build");
+
+    Completer completer;
+    auto base = dir.string() + "/";
+    std::string line = "cat " + base + "bu";
+    auto res = completer.complete(line, line.size());
+    EXPECT_EQ(res.start, 4U);
+    EXPECT_EQ(res.insert, "ild/");
+
+    // the common part is escaped, and the candidates are listed once it is inserted
+    line = "cat " + base + "n";
+    res = completer.complete(line, line.size());
+    EXPECT_EQ(res.insert, "otes\\ ");
+    EXPECT_EQ(res.total, 2U);
+
+    line = "cat " + base + "notes\\ ";
+    res = completer.complete(line, line.size());
+    EXPECT_TRUE(res.insert.empty());
+    EXPECT_EQ(res.candidates, (std::vector<std::string> {"notes one.txt", "notes two.txt"}));
+
+    // hidden names only when the word starts with a dot
+    line = "cat " + base;
+    res = completer.complete(line, line.size());
+    EXPECT_EQ(res.total, 3U);
+    line = "cat " + base + ".";
+    res = completer.complete(line, line.size());
+    EXPECT_EQ(res.insert, "hidden ");
+}
\ No newline at end of file
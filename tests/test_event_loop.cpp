@@ -0,0 +1,124 @@
+/**
+ * @file test_event_loop.cpp
+ * @brief Unit tests for the epoll event loop and its signalfd
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <csignal>
+
+#include "nullsh/event_loop.h"
+#include "nullsh/launcher.h"
+
+using namespace nullsh;
+
+namespace
+{
+    bool blocked(int sig)
+    {
+        sigset_t mask {};
+        pthread_sigmask(SIG_SETMASK, nullptr, &mask);
+        return sigismember(&mask, sig) == 1;
+    }
+} // namespace
+
+TEST(EventLoopTest, ReportsReadyFds)
+{
+    io::EventLoop loop;
+    ASSERT_TRUE(loop.valid());
+    EXPECT_EQ(loop.child_mask(), nullptr);
+
+    std::array<int, 2> fds {-1, -1};
+    ASSERT_EQ(pipe(fds.data()), 0);
+    ASSERT_TRUE(loop.add(fds[0]));
+
+    auto idle = loop.wait(0);
+    ASSERT_TRUE(idle.has_value());
+    EXPECT_TRUE(idle->empty());
+
+    ASSERT_EQ(write(fds[1], "x", 1), 1);
+    auto ready = loop.wait(1000);
+    ASSERT_TRUE(ready.has_value());
+    ASSERT_EQ(ready->size(), 1U);
+    EXPECT_EQ((*ready)[0].data.fd, fds[0]);
+
+    loop.remove(fds[0]);
+    auto removed = loop.wait(0);
+    ASSERT_TRUE(removed.has_value());
+    EXPECT_TRUE(removed->empty());
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(EventLoopTest, TakesSignalsOverWhileItLives)
+{
+    {
+        io::EventLoop loop {true};
+        ASSERT_NE(loop.child_mask(), nullptr);
+        EXPECT_FALSE(sigismember(loop.child_mask(), SIGINT));
+        EXPECT_TRUE(blocked(SIGINT));
+        EXPECT_TRUE(blocked(SIGCHLD));
+        EXPECT_TRUE(blocked(SIGWINCH));
+
+        // a SIGINT wakes the loop instead of ending the process
+        raise(SIGINT);
+        raise(SIGWINCH);
+        auto ready = loop.wait(1000);
+        ASSERT_TRUE(ready.has_value());
+        EXPECT_TRUE(ready->empty());
+        EXPECT_EQ(loop.take_interrupt(), io::Interrupt::Other);
+        EXPECT_EQ(loop.take_interrupt(), io::Interrupt::None);
+        EXPECT_TRUE(loop.take_resize());
+        EXPECT_FALSE(loop.take_child());
+
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0)
+        {
+            _exit(0);
+        }
+        while (!loop.take_child())
+        {
+            ASSERT_TRUE(loop.wait(1000).has_value());
+        }
+        waitpid(pid, nullptr, 0);
+
+        // still pending when the loop goes, and dropped with it
+        raise(SIGINT);
+    }
+
+    EXPECT_FALSE(blocked(SIGINT));
+    EXPECT_FALSE(blocked(SIGCHLD));
+}
+
+TEST(EventLoopTest, WaitExitPassesInterruptsOn)
+{
+    io::EventLoop loop {true};
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        sigprocmask(SIG_SETMASK, loop.child_mask(), nullptr);
+        pause();
+        _exit(0);
+    }
+
+    int pidfd = launcher::open_pidfd(pid);
+    ASSERT_GE(pidfd, 0);
+    raise(SIGINT);
+    loop.wait_exit(pidfd, false);
+    close(pidfd);
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    EXPECT_EQ(WTERMSIG(status), SIGINT);
+}
\ No newline at end of file
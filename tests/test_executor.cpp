@@ -6,6 +6,11 @@
  */
 
 #include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
 
 #include "nullsh/executor.h"
 
@@ -114,6 +119,25 @@ TEST(ExecutorTest, ApplyOperator)
         EXPECT_EQ(output, "0 (success)\n");
     }
 
+    // Test PrintUsage
+    {
+        CommandResult temp_res = res;
+        temp_res.usage = Usage {.wall = std::chrono::milliseconds(1500),
+                                .user = std::chrono::milliseconds(250),
+                                .system = std::chrono::milliseconds(5),
+                                .max_rss_kib = 4096,
+                                .minor_faults = 120,
+                                .major_faults = 2,
+                                .voluntary_switches = 7,
+                                .involuntary_switches = 1};
+        testing::internal::CaptureStdout();
+        apply_operator(Op::PrintUsage, temp_res);
+        std::string output = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(output,
+                  "0  wall 1.500s  user 0.250s  sys 0.005s  maxrss 4096 KiB  faults 120/2  "
+                  "ctxsw 7/1\n");
+    }
+
     // Test None (default)
     {
         // should discard stdout, keep stderr
@@ -124,4 +148,377 @@ TEST(ExecutorTest, ApplyOperator)
         EXPECT_EQ(temp_res.stdout_data, "");
         EXPECT_EQ(err_output, "Error message\n");
     }
+}
+TEST(ExecutorTest, RouteStreams)
+{
+    using nullsh::command::Op;
+    using nullsh::io::StreamMode;
+
+    // no operators: caller wants everything
+    auto route = route_streams({});
+    EXPECT_EQ(route.out, StreamMode::Capture);
+    EXPECT_EQ(route.err, StreamMode::Capture);
+
+    // default: stdout dropped, stderr shown as-is
+    route = route_streams({Op::None});
+    EXPECT_EQ(route.out, StreamMode::Discard);
+    EXPECT_EQ(route.err, StreamMode::Inherit);
+
+    route = route_streams({Op::DiscardOutput});
+    EXPECT_EQ(route.out, StreamMode::Discard);
+    EXPECT_EQ(route.err, StreamMode::Discard);
+
+    route = route_streams({Op::PrintRC});
+    EXPECT_EQ(route.out, StreamMode::Discard);
+    EXPECT_EQ(route.err, StreamMode::Discard);
+
+    route = route_streams({Op::DiscardOutput, Op::ForceOutput});
+    EXPECT_EQ(route.out, StreamMode::Discard);
+    EXPECT_EQ(route.err, StreamMode::Discard);
+
+    // '!' as the only consumer: straight to the terminal
+    route = route_streams({Op::ForceOutput, Op::PrintRC});
+    EXPECT_EQ(route.out, StreamMode::Inherit);
+    EXPECT_EQ(route.err, StreamMode::Inherit);
+
+    // return code must stay ahead of the output
+    route = route_streams({Op::PrintRC, Op::ForceOutput});
+    EXPECT_EQ(route.out, StreamMode::Capture);
+    EXPECT_EQ(route.err, StreamMode::Capture);
+
+    // printed twice
+    route = route_streams({Op::ForceOutput, Op::ForceOutput});
+    EXPECT_EQ(route.out, StreamMode::Capture);
+    EXPECT_EQ(route.err, StreamMode::Capture);
+}
+
+TEST(ExecutorTest, RouteStreamsRetained)
+{
+    using nullsh::command::Op;
+    using nullsh::io::StreamMode;
+
+    auto route = route_streams({Op::ForceOutput}, true);
+    EXPECT_EQ(route.out, StreamMode::Tee);
+    EXPECT_EQ(route.err, StreamMode::Tee);
+
+    route = route_streams({Op::None}, true);
+    EXPECT_EQ(route.out, StreamMode::Capture);
+    EXPECT_EQ(route.err, StreamMode::Tee);
+
+    route = route_streams({Op::DiscardOutput}, true);
+    EXPECT_EQ(route.out, StreamMode::Capture);
+    EXPECT_EQ(route.err, StreamMode::Capture);
+}
+
+TEST(ExecutorTest, ExecExternalDiscardedOutputIsNotCaptured)
+{
+    nullsh::command::Command cmd;
+    cmd.name = "ls";
+    cmd.args = {"/", "/nonexistentpath"};
+    cmd.ops = {nullsh::command::Op::DiscardOutput};
+
+    auto res = exec_external(cmd);
+    EXPECT_NE(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "");
+    EXPECT_EQ(res.stderr_data, "");
+}
+
+TEST(ExecutorTest, ExecExternalDefaultInheritsStderr)
+{
+    nullsh::command::Command cmd;
+    cmd.name = "ls";
+    cmd.args = {"/nonexistentpath"};
+    cmd.ops = {nullsh::command::Op::None};
+
+    testing::internal::CaptureStderr();
+    auto res = exec_external(cmd);
+    std::string err_output = testing::internal::GetCapturedStderr();
+
+    EXPECT_NE(res.return_code, 0);
+    EXPECT_EQ(res.stderr_data, ""); // written by the child directly
+    EXPECT_NE(err_output, "");
+}
+
+TEST(ExecutorTest, ExecInPlaceMatchesForkedOutput)
+{
+    // a message without a trailing newline, which captured output would get
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::External;
+    cmd.name = "sh";
+    cmd.args = {"-c", "printf err >&2"};
+    cmd.ops = {nullsh::command::Op::None};
+
+    testing::internal::CaptureStderr();
+    exec_external(cmd);
+    std::string forked = testing::internal::GetCapturedStderr();
+
+    std::array<int, 2> fds {};
+    ASSERT_EQ(pipe(fds.data()), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        exec_in_place(cmd);
+        _exit(99);
+    }
+    close(fds[1]);
+    std::string in_place;
+    std::array<char, 64> buf {};
+    ssize_t count = 0;
+    while ((count = read(fds[0], buf.data(), buf.size())) > 0)
+    {
+        in_place.append(buf.data(), static_cast<std::size_t>(count));
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(forked, "err");
+    EXPECT_EQ(in_place, forked);
+}
+
+TEST(ExecutorTest, ExecInPlaceDeclinesCapturedStreams)
+{
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::External;
+    cmd.name = "true";
+    using nullsh::command::Op;
+    for (auto ops : {std::vector {Op::ForceOutput, Op::ForceOutput}, std::vector {Op::PrintRC}})
+    {
+        cmd.ops = ops;
+        EXPECT_FALSE(exec_in_place(cmd)); // returning at all means it did not exec
+    }
+}
+
+TEST(ExecutorTest, ExecExternalForceOutputPassthrough)
+{
+    nullsh::command::Command cmd;
+    cmd.name = "echo";
+    cmd.args = {"passthrough"};
+    cmd.ops = {nullsh::command::Op::ForceOutput};
+
+    testing::internal::CaptureStdout();
+    auto res = exec_external(cmd);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, ""); // never buffered in the shell
+    EXPECT_EQ(output, "passthrough\n");
+}
+
+TEST(ExecutorTest, ExecExternalForceOutputRetained)
+{
+    using nullsh::command::Op;
+
+    nullsh::command::Command cmd;
+    cmd.name = "echo";
+    cmd.args = {"relayed"};
+    cmd.ops = {Op::ForceOutput};
+
+    testing::internal::CaptureStdout();
+    auto res = exec_external(cmd, {.retain_output = true});
+    apply_operator(Op::ForceOutput, res); // must not print a second time
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "relayed\n");
+    EXPECT_TRUE(res.stdout_relayed);
+    EXPECT_EQ(output, "relayed\n");
+}
+
+TEST(ExecutorTest, ApplyOperatorSpilled)
+{
+    using namespace nullsh::command;
+
+    CommandResult res {};
+    res.stdout_spill = nullsh::io::SpillFile::create("test");
+    ASSERT_NE(res.stdout_spill, nullptr);
+    res.stdout_spill->append("from memfd", 10);
+
+    sanitize_result(res);
+    EXPECT_EQ(res.stdout_spill->read_all(), "from memfd\n");
+
+    testing::internal::CaptureStdout();
+    apply_operator(Op::ForceOutput, res);
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "from memfd\n");
+
+    apply_operator(Op::DiscardOutput, res);
+    EXPECT_EQ(res.stdout_spill, nullptr);
+}
+
+
+namespace
+{
+    nullsh::command::Command stage(std::string name, std::vector<std::string> args)
+    {
+        return {.type = nullsh::command::CommandType::External,
+                .name = std::move(name),
+                .args = std::move(args),
+                .ops = {}};
+    }
+
+    nullsh::command::CommandResult no_builtin(nullsh::command::Command& /*cmd*/,
+                                              nullsh::io::OutputSink& /*out*/,
+                                              nullsh::io::OutputSink& /*err*/)
+    {
+        ADD_FAILURE() << "unexpected builtin stage";
+        return {.return_code = 1, .stdout_data = "", .stderr_data = ""};
+    }
+} // namespace
+
+TEST(ExecutorTest, ExecPipeline)
+{
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::Pipeline;
+    cmd.stages = {stage("echo", {"hello void"}), stage("tr", {"a-z", "A-Z"})};
+
+    auto res = exec_pipeline(cmd, {}, no_builtin);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "HELLO VOID\n");
+}
+
+TEST(ExecutorTest, ExecPipelineThreeStages)
+{
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::Pipeline;
+    cmd.stages = {stage("seq", {"1", "100000"}), stage("grep", {"7"}), stage("wc", {"-l"})};
+
+    auto res = exec_pipeline(cmd, {}, no_builtin);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "40951\n");
+}
+
+TEST(ExecutorTest, ExecPipelineReturnsLastStage)
+{
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::Pipeline;
+    cmd.stages = {stage("false", {}), stage("true", {})};
+    EXPECT_EQ(exec_pipeline(cmd, {}, no_builtin).return_code, 0);
+
+    cmd.stages = {stage("true", {}), stage("nonexistentcommand", {})};
+    EXPECT_EQ(exec_pipeline(cmd, {}, no_builtin).return_code, 127);
+
+    // the writer is not waited for before the reader exits
+    cmd.stages = {stage("yes", {}), stage("head", {"-n", "2"})};
+    auto res = exec_pipeline(cmd, {}, no_builtin);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "y\ny\n");
+}
+
+TEST(ExecutorTest, ExecPipelineBuiltinStages)
+{
+    auto fake_builtin = [](nullsh::command::Command& cmd,
+                           nullsh::io::OutputSink& out,
+                           nullsh::io::OutputSink& /*err*/) -> nullsh::command::CommandResult
+    {
+        if (cmd.name == "first")
+        {
+            out.write("b\na\nc");
+            return {.return_code = 0, .stdout_data = "", .stderr_data = ""};
+        }
+        return {.return_code = 3, .stdout_data = "last", .stderr_data = ""};
+    };
+
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::Pipeline;
+    cmd.stages = {stage("first", {}), stage("sort", {})};
+    cmd.stages[0].type = nullsh::command::CommandType::Builtin;
+
+    auto res = exec_pipeline(cmd, {}, fake_builtin);
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "a\nb\nc\n");
+
+    cmd.stages = {stage("echo", {"ignored"}), stage("last", {})};
+    cmd.stages[1].type = nullsh::command::CommandType::Builtin;
+
+    res = exec_pipeline(cmd, {}, fake_builtin);
+    EXPECT_EQ(res.return_code, 3);
+    EXPECT_EQ(res.stdout_data, "last");
+}
+
+TEST(ExecutorTest, ExecPipelineEmptyStage)
+{
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::Pipeline;
+    cmd.stages = {stage("echo", {}), stage("", {})};
+
+    auto res = exec_pipeline(cmd, {}, no_builtin);
+    EXPECT_EQ(res.return_code, 2);
+    EXPECT_EQ(res.stderr_data, "syntax error near unexpected token `|'");
+}
+
+TEST(ExecutorTest, ExecExternalReportsUsage)
+{
+    nullsh::command::Command cmd;
+    cmd.name = "sh";
+    cmd.args = {"-c", "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done"};
+
+    auto res = exec_external(cmd);
+    EXPECT_EQ(res.return_code, 0);
+    ASSERT_TRUE(res.usage.has_value());
+    EXPECT_GT(res.usage->user + res.usage->system, std::chrono::microseconds(0));
+    EXPECT_GT(res.usage->max_rss_kib, 0);
+    EXPECT_GT(res.usage->minor_faults, 0);
+}
+
+TEST(ExecutorTest, ExecPipelineSumsUsage)
+{
+    nullsh::command::Command cmd;
+    cmd.type = nullsh::command::CommandType::Pipeline;
+    cmd.stages = {stage("true", {}), stage("true", {})};
+
+    auto single = exec_external(stage("true", {}));
+    auto res = exec_pipeline(cmd, {}, no_builtin);
+    ASSERT_TRUE(single.usage.has_value());
+    ASSERT_TRUE(res.usage.has_value());
+    EXPECT_GT(res.usage->minor_faults, single.usage->minor_faults);
+}
+
+TEST(ExecutorTest, ExecInPlaceOnlyWhenNothingFollows)
+{
+    using nullsh::command::Op;
+    nullsh::command::Command cmd;
+    cmd.name = "true";
+    cmd.type = nullsh::command::CommandType::External;
+
+    // these return without replacing the test process
+    cmd.ops = {Op::PrintRC};
+    EXPECT_FALSE(exec_in_place(cmd));
+    cmd.ops = {Op::ForceOutput, Op::ForceOutput};
+    EXPECT_FALSE(exec_in_place(cmd));
+    cmd.ops = {Op::None};
+    cmd.background = true;
+    EXPECT_FALSE(exec_in_place(cmd));
+    cmd.background = false;
+    ExecOptions limited {};
+    limited.limits.timeout = std::chrono::milliseconds {100};
+    EXPECT_FALSE(exec_in_place(cmd, limited));
+    cmd.name = "nonexistentcommand";
+    EXPECT_FALSE(exec_in_place(cmd));
+}
+
+TEST(ExecutorTest, ExecInPlaceReplacesProcess)
+{
+    nullsh::command::Command cmd;
+    cmd.name = "sh";
+    cmd.args = {"-c", "exit 7"};
+    cmd.type = nullsh::command::CommandType::External;
+    cmd.ops = {nullsh::command::Op::None};
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        exec_in_place(cmd);
+        _exit(99);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 7);
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+/**
+ * @file test_history.cpp
+ * @brief Unit tests for the persistent history log and its prefix index
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/history.h"
+
+using namespace nullsh::history;
+
+namespace
+{
+    // a fresh log for each test, without the index a previous run left
+    std::string fresh_log(const std::string& name)
+    {
+        auto path = std::filesystem::path(testing::TempDir()) / name;
+        std::filesystem::remove(path);
+        std::filesystem::remove(path.string() + ".idx");
+        return path.string();
+    }
+
+    std::vector<std::string> strings(const std::vector<std::string_view>& views)
+    {
+        return {views.begin(), views.end()};
+    }
+
+    // what search() must return: distinct lines by their last use, newest first
+    std::vector<std::string> model_search(const std::vector<std::string>& lines,
+                                          std::string_view prefix,
+                                          std::size_t limit)
+    {
+        std::vector<std::string> found;
+        for (auto it = lines.rbegin(); it != lines.rend() && found.size() < limit; ++it)
+        {
+            if (it->starts_with(prefix) && std::ranges::find(found, *it) == found.end())
+            {
+                found.push_back(*it);
+            }
+        }
+        return found;
+    }
+} // namespace
+
+TEST(HistoryTest, SearchesNewestFirst)
+{
+    auto hist = History::open(fresh_log("nullsh_history_newest"));
+    ASSERT_TRUE(hist.has_value()) << hist.error();
+
+    for (const char* line : {"git status", "ls -la", "git commit -m x", "git status", ""})
+    {
+        EXPECT_TRUE(hist->append(line));
+    }
+    EXPECT_FALSE(hist->append("two\nlines"));
+
+    using Lines = std::vector<std::string>;
+    EXPECT_EQ(strings(hist->search("git", 10)), (Lines {"git status", "git commit -m x"}));
+    EXPECT_EQ(strings(hist->search("git", 1)), (Lines {"git status"}));
+    EXPECT_EQ(strings(hist->search("", 10)), (Lines {"git status", "git commit -m x", "ls -la"}));
+    EXPECT_TRUE(hist->search("make", 10).empty());
+    EXPECT_TRUE(hist->search("git", 0).empty());
+}
+
+TEST(HistoryTest, IndexesOnReopen)
+{
+    auto path = fresh_log("nullsh_history_reopen");
+    Options opts {.merge_after = 2};
+    {
+        auto hist = History::open(path, opts);
+        ASSERT_TRUE(hist.has_value());
+        hist->append("make -j8");
+        hist->append("make test");
+        hist->append("cd build");
+    }
+
+    auto hist = History::open(path, opts);
+    ASSERT_TRUE(hist.has_value());
+    EXPECT_EQ(hist->indexed(), 3U);
+    EXPECT_EQ(hist->pending(), 0U);
+    EXPECT_TRUE(std::filesystem::exists(path + ".idx"));
+
+    // the session's own lines come before the indexed ones
+    hist->append("make -j8");
+    hist->append("make install");
+    using Lines = std::vector<std::string>;
+    EXPECT_EQ(strings(hist->search("make", 10)), (Lines {"make install", "make -j8", "make test"}));
+    EXPECT_EQ(strings(hist->search("", 2)), (Lines {"make install", "make -j8"}));
+    EXPECT_EQ(strings(hist->search("cd", 10)), (Lines {"cd build"}));
+}
+
+TEST(HistoryTest, SearchKeepsTheNewestWhenMatchesExceedTheLimit)
+{
+    auto path = fresh_log("nullsh_history_limit");
+    Options opts {.merge_after = 2};
+    {
+        auto hist = History::open(path, opts);
+        ASSERT_TRUE(hist.has_value());
+        for (const char* line : {"make a", "make b", "make c", "make b", "make b", "make d"})
+        {
+            hist->append(line);
+        }
+    }
+
+    auto hist = History::open(path, opts);
+    ASSERT_TRUE(hist.has_value());
+    ASSERT_EQ(hist->indexed(), 4U); // one entry per distinct line
+    using Lines = std::vector<std::string>;
+    EXPECT_EQ(strings(hist->search("make", 2)), (Lines {"make d", "make b"}));
+    EXPECT_EQ(strings(hist->search("make", 3)), (Lines {"make d", "make b", "make c"}));
+
+    // lines the session already returned from its tail do not crowd out older indexed ones
+    hist->append("make c");
+    hist->append("make d");
+    EXPECT_EQ(strings(hist->search("make", 3)), (Lines {"make d", "make c", "make b"}));
+    EXPECT_EQ(strings(hist->search("make", 4)), (Lines {"make d", "make c", "make b", "make a"}));
+}
+
+TEST(HistoryTest, IgnoresAStaleIndex)
+{
+    auto path = fresh_log("nullsh_history_stale");
+    Options opts {.merge_after = 1};
+    {
+        auto hist = History::open(path, opts);
+        ASSERT_TRUE(hist.has_value());
+        hist->append("rm -rf old");
+    }
+    ASSERT_TRUE(History::open(path, opts).has_value()); // writes the index
+
+    // a rotated log is a new file, its old index must not be used for it
+    std::filesystem::remove(path);
+    std::ofstream(path) << "rm new\n";
+    auto hist = History::open(path, Options {});
+    ASSERT_TRUE(hist.has_value());
+    EXPECT_EQ(hist->indexed(), 0U);
+    EXPECT_EQ(strings(hist->search("rm", 10)), std::vector<std::string> {"rm new"});
+
+    // a torn index is ignored too
+    std::filesystem::resize_file(path + ".idx", 7);
+    hist = History::open(path, Options {});
+    ASSERT_TRUE(hist.has_value());
+    EXPECT_EQ(hist->indexed(), 0U);
+    EXPECT_EQ(hist->pending(), 1U);
+}
+
+TEST(HistoryTest, SkipsAPartialLastLine)
+{
+    auto path = fresh_log("nullsh_history_partial");
+    std::ofstream(path) << "echo done\necho half";
+    auto hist = History::open(path);
+    ASSERT_TRUE(hist.has_value());
+    EXPECT_EQ(strings(hist->search("echo", 10)), std::vector<std::string> {"echo done"});
+}
+
+TEST(HistoryTest, MatchesAModelAcrossSessions)
+{
+    auto path = fresh_log("nullsh_history_model");
+    Options opts {.sync_every = 4, .merge_after = 8};
+    std::mt19937 rng {21}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    std::uniform_int_distribution<int> pick {0, 2};
+    const std::string letters = "abc";
+
+    auto random_line = [&]
+    {
+        std::string line;
+        for (int len = 1 + pick(rng); len > 0; --len)
+        {
+            line += letters[static_cast<std::size_t>(pick(rng))];
+        }
+        return line;
+    };
+
+    std::vector<std::string> lines;
+    for (int session = 0; session < 12; ++session)
+    {
+        auto hist = History::open(path, opts);
+        ASSERT_TRUE(hist.has_value());
+        for (int k = 0; k < 6; ++k)
+        {
+            lines.push_back(random_line());
+            ASSERT_TRUE(hist->append(lines.back()));
+        }
+
+        for (std::string_view prefix : {"", "a", "b", "ab", "cc", "abc", "x"})
+        {
+            for (std::size_t limit : {1U, 3U, 100U})
+            {
+                EXPECT_EQ(strings(hist->search(prefix, limit)),
+                          model_search(lines, prefix, limit))
+                    << "session " << session << ", prefix '" << prefix << "', limit " << limit;
+            }
+        }
+    }
+}
\ No newline at end of file
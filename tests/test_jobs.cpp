@@ -0,0 +1,122 @@
+/**
+ * @file test_jobs.cpp
+ * @brief Unit tests for background jobs
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+#include <poll.h>
+
+#include <csignal>
+#include <string>
+#include <vector>
+
+#include "nullsh/command.h"
+#include "nullsh/executor.h"
+#include "nullsh/jobs.h"
+
+using namespace nullsh::jobs;
+using nullsh::command::Command;
+using nullsh::command::CommandType;
+using nullsh::command::Op;
+
+namespace
+{
+    Job start(const std::string& script, std::vector<Op> ops = {Op::ForceOutput})
+    {
+        Command cmd {.type = CommandType::External,
+                     .name = "sh",
+                     .args = {"-c", script},
+                     .ops = std::move(ops)};
+        return nullsh::executor::exec_background(cmd);
+    }
+} // namespace
+
+TEST(JobsTest, CapturesOutputAndStatus)
+{
+    JobTable table;
+    auto job = start("echo out; echo err >&2; exit 3");
+    ASSERT_GT(job.pid, 0);
+    ASSERT_GE(job.pidfd, 0);
+    EXPECT_FALSE(job.done);
+    EXPECT_EQ(job.text, "sh -c echo out; echo err >&2; exit 3");
+
+    int id = table.add(std::move(job));
+    EXPECT_EQ(id, 1);
+    EXPECT_EQ(table.current(), 1);
+    EXPECT_FALSE(table.collect(id).has_value()); // not finished yet
+
+    ASSERT_TRUE(table.wait(id));
+    auto done = table.collect(id);
+    ASSERT_TRUE(done.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_TRUE(done->done);
+    EXPECT_EQ(done->pidfd, -1);
+    EXPECT_EQ(done->result.return_code, 3);
+    EXPECT_EQ(done->result.stdout_data, "out\n");
+    EXPECT_EQ(done->result.stderr_data, "err\n");
+    EXPECT_EQ(done->ops, std::vector<Op>({Op::ForceOutput}));
+    // NOLINTEND(bugprone-unchecked-optional-access)
+    EXPECT_TRUE(table.empty());
+}
+
+TEST(JobsTest, DiscardedStreamsAreNotCaptured)
+{
+    JobTable table;
+    int id = table.add(start("echo out; echo err >&2", {Op::DiscardOutput}));
+
+    ASSERT_TRUE(table.wait(id));
+    auto done = table.collect(id);
+    ASSERT_TRUE(done.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_EQ(done->result.return_code, 0);
+    EXPECT_EQ(done->result.stdout_data, "");
+    EXPECT_EQ(done->result.stderr_data, "");
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(JobsTest, RefreshDoesNotBlock)
+{
+    JobTable table;
+    int slow = table.add(start("sleep 5"));
+    int fast = table.add(start("exit 0"));
+    EXPECT_EQ(slow, 1);
+    EXPECT_EQ(fast, 2);
+
+    // wait for the fast one to exit without reaping it
+    pollfd pfd {.fd = table.find(fast)->pidfd, .events = POLLIN, .revents = 0};
+    ASSERT_EQ(poll(&pfd, 1, 5000), 1);
+
+    table.refresh();
+    EXPECT_TRUE(table.find(fast)->done);
+    EXPECT_FALSE(table.find(slow)->done);
+    EXPECT_EQ(state(*table.find(fast)), "Done");
+    EXPECT_EQ(state(*table.find(slow)), "Running");
+
+    kill(table.find(slow)->pid, SIGTERM);
+    ASSERT_TRUE(table.wait(slow));
+    EXPECT_EQ(table.find(slow)->result.return_code, 128 + SIGTERM);
+    EXPECT_EQ(state(*table.find(slow)), "Exit 143");
+}
+
+TEST(JobsTest, MissingCommandDoesNotStart)
+{
+    Command cmd {.type = CommandType::External,
+                 .name = "nonexistentcommand",
+                 .args = {},
+                 .ops = {Op::None}};
+    auto job = nullsh::executor::exec_background(cmd);
+    EXPECT_EQ(job.pid, -1);
+    EXPECT_TRUE(job.done);
+    EXPECT_EQ(job.result.return_code, 127);
+}
+
+TEST(JobsTest, UnknownJob)
+{
+    JobTable table;
+    EXPECT_FALSE(table.wait(1));
+    EXPECT_FALSE(table.collect(1).has_value());
+    EXPECT_EQ(table.find(1), nullptr);
+    EXPECT_EQ(table.current(), 0);
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+/**
+ * @file test_launcher.cpp
+ * @brief Unit tests for process launchers
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <string>
+
+#include "nullsh/launcher.h"
+
+using namespace nullsh::launcher;
+
+class LauncherTest : public ::testing::TestWithParam<LaunchFn>
+{
+};
+
+TEST_P(LauncherTest, RunsProgram)
+{
+    std::array<const char*, 4> args {"sh", "-c", "exit 7", nullptr};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    auto child = GetParam()({.file = "sh", .argv = const_cast<char* const*>(args.data()),
+                             .envp = environ});
+    ASSERT_EQ(child.error, 0);
+    ASSERT_GT(child.pid, 0);
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child.pid, &status, 0), child.pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 7);
+}
+
+TEST_P(LauncherTest, ReportsMissingProgram)
+{
+    std::array<const char*, 2> args {"nonexistentcommand", nullptr};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    auto child = GetParam()({.file = args[0], .argv = const_cast<char* const*>(args.data()),
+                             .envp = environ});
+    EXPECT_EQ(child.pid, -1);
+    EXPECT_EQ(child.error, ENOENT);
+}
+
+TEST_P(LauncherTest, ReportsNotExecutable)
+{
+    std::string path = testing::TempDir() + "nullsh_not_executable";
+    int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    std::array<const char*, 2> args {path.c_str(), nullptr};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    auto child = GetParam()({.file = args[0], .argv = const_cast<char* const*>(args.data()),
+                             .envp = environ});
+    unlink(path.c_str());
+    EXPECT_EQ(child.pid, -1);
+    EXPECT_EQ(child.error, EACCES);
+}
+
+TEST_P(LauncherTest, TrimsInheritedFds)
+{
+    // a non-CLOEXEC fd of the parent must not leak into the child
+    int leaked = dup(STDIN_FILENO);
+    ASSERT_GE(leaked, 3);
+    std::string check = "test ! -e /proc/self/fd/" + std::to_string(leaked);
+    std::array<const char*, 4> args {"sh", "-c", check.c_str(), nullptr};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    auto child = GetParam()({.file = "sh", .argv = const_cast<char* const*>(args.data()),
+                             .envp = environ});
+    close(leaked);
+    ASSERT_EQ(child.error, 0);
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child.pid, &status, 0), child.pid);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(PidfdTest, TellsAnExitedChild)
+{
+    std::array<int, 2> gate {-1, -1};
+    ASSERT_EQ(pipe2(gate.data(), O_CLOEXEC), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        close(gate[1]);
+        char byte = 0;
+        (void) read(gate[0], &byte, 1);
+        _exit(0);
+    }
+    close(gate[0]);
+
+    int pidfd = open_pidfd(pid);
+    ASSERT_GE(pidfd, 0);
+    EXPECT_FALSE(pidfd_exited(pidfd));
+
+    // exited but not reaped, as a child is when its timeout runs out under it
+    close(gate[1]);
+    siginfo_t info {};
+    ASSERT_EQ(waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT), 0);
+    EXPECT_TRUE(pidfd_exited(pidfd));
+    EXPECT_FALSE(pidfd_exited(-1));
+
+    close(pidfd);
+    ASSERT_EQ(waitpid(pid, nullptr, 0), pid);
+}
+
+INSTANTIATE_TEST_SUITE_P(Launchers,
+                         LauncherTest,
+                         ::testing::Values(&launch_fork, &launch_vfork),
+                         [](const auto& info) { return info.index == 0 ? "Fork" : "Vfork"; });
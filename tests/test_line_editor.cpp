@@ -0,0 +1,257 @@
+/**
+ * @file test_line_editor.cpp
+ * @brief Unit tests for the line buffer, the incremental renderer and the line editor
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <array>
+#include <csignal>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "nullsh/event_loop.h"
+#include "nullsh/history.h"
+#include "nullsh/line_editor.h"
+
+using namespace nullsh::edit;
+
+namespace
+{
+    // feeds keys to an editor through a pipe and reads back what it drew
+    class Keyboard
+    {
+      public:
+        Keyboard()
+        {
+            EXPECT_EQ(pipe(in_.data()), 0);
+            EXPECT_EQ(pipe(out_.data()), 0);
+        }
+        ~Keyboard()
+        {
+            for (int fd : {in_[0], in_[1], out_[0], out_[1]})
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+        }
+        Keyboard(const Keyboard&) = delete;
+        Keyboard& operator=(const Keyboard&) = delete;
+        Keyboard(Keyboard&&) = delete;
+        Keyboard& operator=(Keyboard&&) = delete;
+
+        void type(std::string_view keys)
+        {
+            EXPECT_EQ(write(in_[1], keys.data(), keys.size()),
+                      static_cast<ssize_t>(keys.size()));
+        }
+
+        void hang_up()
+        {
+            close(in_[1]);
+            in_[1] = -1;
+        }
+
+        std::string drawn()
+        {
+            close(out_[1]);
+            out_[1] = -1;
+            std::string all;
+            std::array<char, 4096> chunk {};
+            ssize_t len = 0;
+            while ((len = read(out_[0], chunk.data(), chunk.size())) > 0)
+            {
+                all.append(chunk.data(), static_cast<std::size_t>(len));
+            }
+            return all;
+        }
+
+        int in() const
+        {
+            return in_[0];
+        }
+        int out() const
+        {
+            return out_[1];
+        }
+
+      private:
+        std::array<int, 2> in_ {-1, -1};
+        std::array<int, 2> out_ {-1, -1};
+    };
+} // namespace
+
+TEST(LineBufferTest, EditsOnCharacterBoundaries)
+{
+    LineBuffer buf;
+    buf.insert("héllo");
+    EXPECT_EQ(buf.cursor(), 6U);
+
+    buf.move_left();
+    buf.move_left();
+    buf.move_left();
+    buf.move_left();
+    EXPECT_EQ(buf.cursor(), 1U); // before the two bytes of 'é'
+    buf.erase_at();
+    EXPECT_EQ(buf.text(), "hllo");
+
+    buf.end();
+    buf.insert(" wörld  ");
+    buf.erase_word();
+    EXPECT_EQ(buf.text(), "hllo ");
+    buf.erase_before();
+    buf.home();
+    buf.kill_to_end();
+    EXPECT_EQ(buf.text(), "");
+    EXPECT_FALSE(buf.erase_before());
+    EXPECT_EQ(columns("wörld"), 5U);
+}
+
+TEST(RendererTest, RewritesOnlyWhatChanged)
+{
+    Renderer renderer;
+    renderer.reset("> ", 0);
+    LineBuffer buf;
+    std::string out;
+
+    buf.insert("ls");
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "ls");
+
+    // typing at the end writes that character only
+    out.clear();
+    buf.insert(" -l");
+    renderer.render(buf, out);
+    EXPECT_EQ(out, " -l");
+
+    // an insert in the middle goes back to it, rewrites the tail and puts the cursor back
+    out.clear();
+    buf.move_left();
+    buf.move_left();
+    buf.insert("x");
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "\x1b[2Dx-l\x1b[2D");
+
+    // a shorter line clears what is left of the old one
+    out.clear();
+    buf.end();
+    buf.erase_before();
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "\x1b[1C\x1b[J");
+
+    // cursor moves alone
+    out.clear();
+    buf.home();
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "\x1b[5D");
+}
+
+TEST(RendererTest, WrapsLongLines)
+{
+    Renderer renderer;
+    renderer.reset("> ", 5);
+    LineBuffer buf;
+    std::string out;
+
+    // filling the row leaves the terminal's pending wrap for the next row
+    buf.insert("abc");
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "abc\r\n");
+
+    out.clear();
+    buf.insert("d");
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "d");
+
+    // back to the first row
+    out.clear();
+    buf.home();
+    renderer.render(buf, out);
+    EXPECT_EQ(out, "\x1b[1A\x1b[1C");
+}
+
+TEST(LineEditorTest, EditsAndReturnsLines)
+{
+    Keyboard keys;
+    LineEditor editor {keys.in(), keys.out()};
+
+    keys.type("ls -l\x7f" "a\r");
+    EXPECT_EQ(editor.read_line("$ "), "ls -a");
+
+    // arrows, Home and ^E, and ^K
+    keys.type("abc\x1b[D\x1b[DX\x1b[H>\x05!\x01\x1b[C\x0b\r");
+    EXPECT_EQ(editor.read_line("$ "), ">");
+
+    // ^C drops the line, ^D ends the input on an empty one
+    keys.type("rm -rf /\x03");
+    EXPECT_EQ(editor.read_line("$ "), "");
+    keys.type("\x04");
+    EXPECT_EQ(editor.read_line("$ "), std::nullopt);
+
+    keys.type("echo partial");
+    keys.hang_up();
+    EXPECT_EQ(editor.read_line("$ "), "echo partial");
+    EXPECT_EQ(editor.read_line("$ "), std::nullopt);
+
+    EXPECT_TRUE(keys.drawn().starts_with("$ ls -l\x1b[1D\x1b[Ja\n"));
+}
+
+TEST(LineEditorTest, CompletesAndRecalls)
+{
+    auto path = (std::filesystem::path(testing::TempDir()) / "nullsh_editor_history").string();
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".idx");
+    auto hist = nullsh::history::History::open(path);
+    ASSERT_TRUE(hist.has_value());
+    for (const char* line : {"make all", "git log", "make test"})
+    {
+        hist->append(line);
+    }
+
+    Keyboard keys;
+    nullsh::complete::Completer completer;
+    LineEditor editor {keys.in(), keys.out(), &completer};
+    editor.set_history(&*hist);
+
+    keys.type("expo\t\r");
+    EXPECT_EQ(editor.read_line("$ "), "export ");
+
+    // Up walks back through the lines starting with what was typed, Down comes back
+    keys.type("ma\x1b[A\x1b[A\x1b[A\x1b[B\r");
+    EXPECT_EQ(editor.read_line("$ "), "make test");
+    keys.type("\x1b[A\x1b[B!\r");
+    EXPECT_EQ(editor.read_line("$ "), "!");
+}
+TEST(LineEditorTest, HandlesSignalsFromTheLoop)
+{
+    nullsh::io::EventLoop loop {true};
+    Keyboard keys;
+    LineEditor editor {keys.in(), keys.out()};
+    editor.set_loop(&loop);
+    editor.set_notices([] { return std::string("[1]  Done\tsleep 1\n"); });
+
+    // a child exit shows the notices above the prompt, drawn again below them
+    raise(SIGCHLD);
+    ASSERT_TRUE(loop.wait(0).has_value());
+    keys.type("ls\r");
+    EXPECT_EQ(editor.read_line("$ "), "ls");
+
+    // a SIGINT drops the line like ^C
+    raise(SIGINT);
+    EXPECT_EQ(editor.read_line("$ "), "");
+
+    // between lines the input belongs to the commands, the loop does not watch it
+    keys.type("x");
+    auto ready = loop.wait(0);
+    ASSERT_TRUE(ready.has_value());
+    EXPECT_TRUE(ready->empty());
+
+    EXPECT_EQ(keys.drawn(), "$ \r\x1b[J[1]  Done\tsleep 1\n$ ls\n$ ^C\n");
+}
\ No newline at end of file
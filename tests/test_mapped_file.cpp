@@ -0,0 +1,94 @@
+/**
+ * @file test_mapped_file.cpp
+ * @brief Unit tests for the memory mapped file and line reader
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/mapped_file.h"
+
+using namespace nullsh::io;
+
+namespace
+{
+    std::string write_temp(const std::string& name, std::string_view contents)
+    {
+        auto path = std::filesystem::path(testing::TempDir()) / name;
+        std::ofstream(path, std::ios::binary) << contents;
+        return path.string();
+    }
+
+    std::vector<std::string_view> all_lines(std::string_view text)
+    {
+        std::vector<std::string_view> lines;
+        LineReader reader {text};
+        while (auto line = reader.next())
+        {
+            lines.push_back(*line);
+        }
+        return lines;
+    }
+} // namespace
+
+TEST(MappedFileTest, MapsContents)
+{
+    auto file = MappedFile::open(write_temp("nullsh_mapped.nsh", "echo one\necho two\n"));
+    ASSERT_TRUE(file.has_value());
+    EXPECT_EQ(file->view(), "echo one\necho two\n");
+
+    // moving keeps the mapping alive
+    MappedFile moved = std::move(*file);
+    EXPECT_EQ(moved.view(), "echo one\necho two\n");
+    EXPECT_TRUE(file->view().empty()); // NOLINT(bugprone-use-after-move)
+}
+
+TEST(MappedFileTest, EmptyFile)
+{
+    auto file = MappedFile::open(write_temp("nullsh_empty.nsh", ""));
+    ASSERT_TRUE(file.has_value());
+    EXPECT_TRUE(file->view().empty());
+}
+
+TEST(MappedFileTest, Errors)
+{
+    auto missing = MappedFile::open("/nonexistent/script.nsh");
+    ASSERT_FALSE(missing.has_value());
+    EXPECT_EQ(missing.error(), "No such file or directory");
+
+    auto dir = MappedFile::open(testing::TempDir());
+    ASSERT_FALSE(dir.has_value());
+    EXPECT_EQ(dir.error(), "Is a directory");
+}
+
+TEST(LineReaderTest, SplitsLines)
+{
+    EXPECT_EQ(all_lines("a\nb b\n\nc"), std::vector<std::string_view>({"a", "b b", "", "c"}));
+    EXPECT_EQ(all_lines("a\r\nb\r\n"), std::vector<std::string_view>({"a", "b"}));
+    EXPECT_TRUE(all_lines("").empty());
+}
+
+TEST(LineReaderTest, ViewsPointIntoBuffer)
+{
+    std::string_view text = "first\nsecond\n";
+    LineReader reader {text};
+
+    auto line = reader.next();
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ(line->data(), text.data());
+    EXPECT_EQ(reader.line_number(), 1);
+
+    line = reader.next();
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ(line->data(), text.data() + 6);
+    EXPECT_EQ(reader.line_number(), 2);
+
+    EXPECT_FALSE(reader.next().has_value());
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+/**
+ * @file test_memo_cache.cpp
+ * @brief Unit tests for the memo builtin's result cache and its on-disk store
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "nullsh/memo_cache.h"
+
+using namespace nullsh::memo;
+
+namespace
+{
+    // an empty store directory for each test
+    std::string fresh_dir(const std::string& name)
+    {
+        auto path = std::filesystem::path(testing::TempDir()) / name;
+        std::filesystem::remove_all(path);
+        return path.string();
+    }
+
+    std::string key_of(std::initializer_list<std::string_view> fields)
+    {
+        KeyBuilder key;
+        for (auto field : fields)
+        {
+            key.add(field);
+        }
+        return key.take();
+    }
+
+    nullsh::command::CommandResult result(int rc, std::string out, std::string err = {})
+    {
+        return {.return_code = rc, .stdout_data = std::move(out), .stderr_data = std::move(err)};
+    }
+} // namespace
+
+TEST(MemoCacheTest, KeysKeepFieldsApart)
+{
+    EXPECT_NE(key_of({"ab", "c"}), key_of({"a", "bc"}));
+    EXPECT_NE(key_of({"a", ""}), key_of({"a"}));
+
+    KeyBuilder unset;
+    unset.add_var("X", std::nullopt);
+    KeyBuilder empty;
+    empty.add_var("X", "");
+    EXPECT_NE(unset.take(), empty.take());
+}
+
+TEST(MemoCacheTest, KeysFollowDependencies)
+{
+    auto dir = fresh_dir("memo_deps");
+    std::filesystem::create_directories(dir);
+    auto file = dir + "/dep";
+
+    auto stamp = [&file]
+    {
+        KeyBuilder key;
+        key.add_stamp(file);
+        return key.take();
+    };
+    auto hashed = [&file]
+    {
+        KeyBuilder key;
+        EXPECT_TRUE(key.add_digest(file).has_value());
+        return key.take();
+    };
+
+    // a missing file is a key of its own
+    auto missing_stamp = stamp();
+    auto missing_hash = hashed();
+    std::ofstream(file) << "one";
+    EXPECT_NE(stamp(), missing_stamp);
+    EXPECT_NE(hashed(), missing_hash);
+
+    auto first_stamp = stamp();
+    auto first_hash = hashed();
+    EXPECT_EQ(stamp(), first_stamp);
+    EXPECT_EQ(hashed(), first_hash);
+
+    std::ofstream(file) << "three";
+    EXPECT_NE(stamp(), first_stamp);
+    EXPECT_NE(hashed(), first_hash);
+
+    // same content, new times: only the stamp changes
+    std::ofstream(file) << "one";
+    EXPECT_EQ(hashed(), first_hash);
+
+    KeyBuilder key;
+    EXPECT_FALSE(key.add_digest(dir).has_value());
+}
+
+TEST(MemoCacheTest, EvictsLeastRecentlyUsed)
+{
+    // room for two entries of this size
+    MemoCache cache {2 * (key_of({"a"}).size() + 10)};
+    cache.store(key_of({"a"}), result(0, "aaaaaaaaaa"));
+    cache.store(key_of({"b"}), result(1, "bbbbbbbbbb"));
+
+    auto hit = cache.lookup(key_of({"a"}));
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->return_code, 0);
+    EXPECT_EQ(hit->stdout_data, "aaaaaaaaaa");
+    EXPECT_FALSE(hit->stdout_relayed);
+
+    // b is the oldest now
+    cache.store(key_of({"c"}), result(0, "cccccccccc"));
+    EXPECT_FALSE(cache.lookup(key_of({"b"})).has_value());
+    EXPECT_TRUE(cache.lookup(key_of({"a"})).has_value());
+    EXPECT_TRUE(cache.lookup(key_of({"c"})).has_value());
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.entries, 2U);
+    EXPECT_LE(stats.bytes, cache.capacity());
+    EXPECT_EQ(stats.hits, 3U);
+    EXPECT_EQ(stats.misses, 1U);
+
+    // an entry larger than the cache is not kept, and shrinking evicts
+    EXPECT_FALSE(cache.store(key_of({"d"}), result(0, std::string(100, 'd'))));
+    cache.set_capacity(0);
+    EXPECT_EQ(cache.stats().entries, 0U);
+}
+
+TEST(MemoCacheTest, StoreOutlivesTheSession)
+{
+    auto dir = fresh_dir("memo_store");
+    {
+        MemoCache cache;
+        ASSERT_TRUE(cache.open_store(dir).has_value());
+        EXPECT_TRUE(cache.store(key_of({"git", "status"}), result(1, "out", "err")));
+    }
+
+    MemoCache cache;
+    ASSERT_TRUE(cache.open_store(dir).has_value());
+    auto hit = cache.lookup(key_of({"git", "status"}));
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->return_code, 1);
+    EXPECT_EQ(hit->stdout_data, "out");
+    EXPECT_EQ(hit->stderr_data, "err");
+    EXPECT_EQ(cache.stats().entries, 1U);
+
+    // a damaged entry is a miss
+    for (const auto& ent : std::filesystem::directory_iterator(dir))
+    {
+        std::filesystem::resize_file(ent.path(), std::filesystem::file_size(ent.path()) - 1);
+    }
+    MemoCache damaged;
+    ASSERT_TRUE(damaged.open_store(dir).has_value());
+    EXPECT_FALSE(damaged.lookup(key_of({"git", "status"})).has_value());
+
+    cache.clear();
+    EXPECT_TRUE(std::filesystem::is_empty(dir));
+    EXPECT_FALSE(cache.lookup(key_of({"git", "status"})).has_value());
+
+    std::ofstream(dir + "/file") << "";
+    EXPECT_FALSE(cache.open_store(dir + "/file").has_value());
+}
\ No newline at end of file
@@ -0,0 +1,278 @@
+/**
+ * @file test_output_sink.cpp
+ * @brief Unit tests for the gathering output sink
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "nullsh/builtins.h"
+#include "nullsh/executor.h"
+#include "nullsh/output_sink.h"
+#include "nullsh/shell.h"
+
+using namespace nullsh;
+using nullsh::io::OutputSink;
+
+namespace
+{
+    // heap allocations made while counting is on
+    std::size_t allocations = 0;
+    bool counting = false;
+
+    class MemFile
+    {
+      public:
+        MemFile() : fd_(memfd_create("test_output_sink", MFD_CLOEXEC)) {}
+        ~MemFile()
+        {
+            close(fd_);
+        }
+        MemFile(const MemFile&) = delete;
+        MemFile& operator=(const MemFile&) = delete;
+
+        int fd() const
+        {
+            return fd_;
+        }
+
+        auto contents() const -> std::string
+        {
+            std::string out(static_cast<std::size_t>(lseek(fd_, 0, SEEK_END)), '\0');
+            EXPECT_EQ(pread(fd_, out.data(), out.size(), 0), static_cast<ssize_t>(out.size()));
+            return out;
+        }
+
+      private:
+        int fd_;
+    };
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (counting)
+    {
+        ++allocations;
+    }
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// out of line, so the compiler does not pair the free() with a new expression
+[[gnu::noinline]] void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+TEST(OutputSinkTest, GathersFragmentsForTheFd)
+{
+    MemFile file;
+    OutputSink sink {file.fd()};
+
+    sink.write("hello");
+    sink.put(' ');
+    sink.print("{}-{}", 1, "two");
+    EXPECT_EQ(file.contents(), ""); // nothing written before the flush
+    EXPECT_EQ(sink.written(), 11);
+
+    EXPECT_TRUE(sink.flush());
+    EXPECT_EQ(file.contents(), "hello 1-two");
+    EXPECT_TRUE(sink.relays());
+}
+
+TEST(OutputSinkTest, ManyFragmentsOfMixedSizes)
+{
+    MemFile file;
+    std::vector<std::string> parts;
+    std::string expected;
+    for (int i = 0; i < 200; ++i)
+    {
+        // long ones are referenced, short ones copied, well past the fragment limit
+        auto size = i % 3 == 0 ? OutputSink::COPY_LIMIT * 2 + static_cast<std::size_t>(i) : 7;
+        parts.emplace_back(size, static_cast<char>('a' + i % 26));
+    }
+
+    {
+        OutputSink sink {file.fd()};
+        for (const auto& part : parts)
+        {
+            sink.write(part);
+            expected += part;
+        }
+    }
+    EXPECT_EQ(file.contents(), expected);
+}
+
+TEST(OutputSinkTest, PrintLargerThanScratch)
+{
+    MemFile file;
+    std::string big(OutputSink::SCRATCH_SIZE * 3, 'x');
+    {
+        OutputSink sink {file.fd()};
+        sink.write("head ");
+        sink.print("[{}]", big);
+        sink.write(" tail");
+    }
+    EXPECT_EQ(file.contents(), "head [" + big + "] tail");
+}
+
+TEST(OutputSinkTest, CaptureOnlyCopiesIntoString)
+{
+    std::string captured;
+    OutputSink sink {captured};
+
+    sink.write("rc ");
+    sink.print("{}", 42);
+    EXPECT_EQ(captured, ""); // handed on when flushed
+    sink.flush();
+    EXPECT_EQ(captured, "rc 42");
+    EXPECT_FALSE(sink.relays());
+    EXPECT_FALSE(sink.discards());
+}
+
+TEST(OutputSinkTest, TeeWritesBoth)
+{
+    MemFile file;
+    std::string captured;
+    {
+        OutputSink sink {file.fd(), captured};
+        sink.write("both ");
+        sink.print("{}", "ways");
+    }
+    EXPECT_EQ(captured, "both ways");
+    EXPECT_EQ(file.contents(), "both ways");
+}
+
+TEST(OutputSinkTest, CopyFromKeepsOrder)
+{
+    MemFile source;
+    std::string data(300000, 'd');
+    ASSERT_EQ(write(source.fd(), data.data(), data.size()), static_cast<ssize_t>(data.size()));
+
+    MemFile file;
+    std::string captured;
+    {
+        OutputSink sink {file.fd()};
+        sink.write("head:");
+        lseek(source.fd(), 0, SEEK_SET);
+        EXPECT_TRUE(sink.copy_from(source.fd()));
+        sink.write(":tail");
+    }
+    EXPECT_EQ(file.contents(), "head:" + data + ":tail");
+
+    {
+        OutputSink sink {captured};
+        lseek(source.fd(), 0, SEEK_SET);
+        EXPECT_TRUE(sink.copy_from(source.fd()));
+    }
+    EXPECT_EQ(captured, data);
+}
+
+TEST(OutputSinkTest, CopyFromDirectoryFails)
+{
+    int dir = open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_GE(dir, 0);
+    MemFile file;
+    OutputSink sink {file.fd()};
+    EXPECT_FALSE(sink.copy_from(dir));
+    EXPECT_EQ(errno, EISDIR);
+
+    OutputSink discard {};
+    EXPECT_FALSE(discard.copy_from(dir));
+    close(dir);
+}
+
+TEST(OutputSinkTest, DiscardKeepsNothing)
+{
+    OutputSink sink {};
+    sink.write("dropped");
+    sink.print("{}", 1);
+    EXPECT_TRUE(sink.discards());
+    EXPECT_EQ(sink.written(), 0);
+    EXPECT_TRUE(sink.finish());
+}
+
+TEST(OutputSinkTest, FinishTerminatesTheLine)
+{
+    MemFile file;
+    {
+        OutputSink sink {file.fd()};
+        sink.write("no newline");
+        sink.finish();
+    }
+    {
+        OutputSink sink {file.fd()};
+        sink.write("newline\n");
+        sink.finish();
+    }
+    {
+        OutputSink sink {file.fd()};
+        sink.finish(); // nothing written, nothing added
+    }
+    EXPECT_EQ(file.contents(), "no newline\nnewline\n");
+}
+
+TEST(OutputSinkTest, FailedWriteIsReported)
+{
+    int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    {
+        OutputSink sink {fd};
+        sink.write("lost");
+        EXPECT_FALSE(sink.flush());
+        EXPECT_TRUE(sink.failed());
+    }
+    close(fd);
+}
+
+TEST(OutputSinkTest, BuiltinAndOperatorsMakeNoAllocations)
+{
+    MemFile file;
+    shell::NullShell sh {};
+    command::Command cmd {.type = command::CommandType::Builtin,
+                          .name = "echo",
+                          .args = {"hello", "void"},
+                          .ops = {command::Op::ForceOutput, command::Op::PrintRC}};
+
+    auto run = [&]
+    {
+        OutputSink out {file.fd()};
+        OutputSink err {file.fd()};
+        auto res = builtins::run(cmd, sh, out, err);
+        out.finish();
+        res.stdout_relayed = true;
+        for (auto op : cmd.ops)
+        {
+            executor::apply_operator(op, res, out, err);
+        }
+        return res.return_code;
+    };
+
+    ASSERT_EQ(run(), 0); // warm up
+    allocations = 0;
+    counting = true;
+    int rc = run();
+    counting = false;
+
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(allocations, 0);
+    EXPECT_EQ(file.contents(), "hello void\n0\nhello void\n0\n");
+}
\ No newline at end of file
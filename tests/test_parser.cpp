@@ -9,6 +9,7 @@
 
 #include "nullsh/command.h"
 #include "nullsh/parser.h"
+#include "nullsh/tokenizer.h"
 
 using namespace nullsh::parser;
 using namespace nullsh::command;
@@ -20,6 +21,7 @@ TEST(ParserTest, ParseOperator)
     EXPECT_EQ(parse_operator("?"), Op::DiscardOutput);
     EXPECT_EQ(parse_operator("$?"), Op::PrintRC);
     EXPECT_EQ(parse_operator("$$?"), Op::PrintRCHuman);
+    EXPECT_EQ(parse_operator("$%"), Op::PrintUsage);
     EXPECT_EQ(parse_operator("unknown"), Op::None);
 }
 
@@ -58,3 +60,185 @@ TEST(ParserTest, ParseCommandMultipleOps)
     EXPECT_EQ(cmd->ops, std::vector<Op>({Op::DiscardOutput, Op::PrintRC}));
     // NOLINTEND(bugprone-unchecked-optional-access)
 }
+
+TEST(ParserTest, ParseCommandNoArgs)
+{
+    std::vector<std::string> tokens = {"ls"};
+    auto cmd = make_command(tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_EQ(cmd->name, "ls");
+    EXPECT_TRUE(cmd->args.empty());
+    EXPECT_EQ(cmd->ops, std::vector<Op>({Op::None}));
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+
+TEST(ParserTest, ParsePipeline)
+{
+    std::vector<std::string> tokens = {"ls", "-l", "|", "grep", "x", "|", "wc", "-l", "!", "$?"};
+    auto cmd = make_command(tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_EQ(cmd->type, CommandType::Pipeline);
+    EXPECT_EQ(cmd->name, "ls");
+    EXPECT_EQ(cmd->ops, std::vector<Op>({Op::ForceOutput, Op::PrintRC}));
+    ASSERT_EQ(cmd->stages.size(), 3);
+    EXPECT_EQ(cmd->stages[0].name, "ls");
+    EXPECT_EQ(cmd->stages[0].args, std::vector<std::string>({"-l"}));
+    EXPECT_EQ(cmd->stages[1].name, "grep");
+    EXPECT_EQ(cmd->stages[1].args, std::vector<std::string>({"x"}));
+    EXPECT_EQ(cmd->stages[2].name, "wc");
+    EXPECT_EQ(cmd->stages[2].args, std::vector<std::string>({"-l"}));
+    EXPECT_TRUE(cmd->stages[2].ops.empty());
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParsePipelineBuiltinStage)
+{
+    std::vector<std::string> tokens = {"pwd", "|", "cat"};
+    auto cmd = make_command(tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    ASSERT_EQ(cmd->stages.size(), 2);
+    EXPECT_EQ(cmd->stages[0].type, CommandType::Builtin);
+    EXPECT_EQ(cmd->stages[1].type, CommandType::External);
+    EXPECT_EQ(cmd->ops, std::vector<Op>({Op::None}));
+
+    // builtins reading the previous stage run as their program
+    cmd = make_command({"printf", "a", "|", "cat", "-", "|", "cd"});
+    ASSERT_EQ(cmd->stages.size(), 3);
+    EXPECT_EQ(cmd->stages[0].type, CommandType::Builtin);
+    EXPECT_EQ(cmd->stages[1].type, CommandType::External);
+    EXPECT_EQ(cmd->stages[2].type, CommandType::Builtin);
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParsePipelineEmptyStage)
+{
+    std::vector<std::string> tokens = {"ls", "|"};
+    auto cmd = make_command(tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    ASSERT_EQ(cmd->stages.size(), 2);
+    EXPECT_TRUE(cmd->stages[1].name.empty());
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParseQuotedPipeIsAnArgument)
+{
+    for (const std::string line : {"echo '|' !", "echo \"|\" !", "echo \\| !"})
+    {
+        auto tokens = nullsh::util::tokenize_views(line);
+        ASSERT_TRUE(tokens.has_value()) << line;
+        auto cmd = make_command(*tokens);
+        ASSERT_TRUE(cmd.has_value()) << line;
+        // NOLINTBEGIN(bugprone-unchecked-optional-access)
+        EXPECT_EQ(cmd->type, CommandType::Builtin) << line;
+        EXPECT_TRUE(cmd->stages.empty()) << line;
+        EXPECT_EQ(cmd->args, std::vector<std::string>({"|"})) << line;
+        EXPECT_EQ(cmd->ops, std::vector<Op>({Op::ForceOutput})) << line;
+        // NOLINTEND(bugprone-unchecked-optional-access)
+    }
+
+    // only the unquoted one splits
+    const std::string line = "echo a '|' b | cat";
+    auto tokens = nullsh::util::tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+    auto cmd = make_command(*tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    ASSERT_EQ(cmd->stages.size(), 2);
+    EXPECT_EQ(cmd->stages[0].args, std::vector<std::string>({"a", "|", "b"}));
+    EXPECT_EQ(cmd->stages[1].name, "cat");
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParseBackground)
+{
+    std::vector<std::string> tokens = {"sleep", "1", "!", "&"};
+    auto cmd = make_command(tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_TRUE(cmd->background);
+    EXPECT_EQ(cmd->type, CommandType::External); // the program, not the sleep builtin
+    EXPECT_EQ(cmd->name, "sleep");
+    EXPECT_EQ(cmd->args, std::vector<std::string>({"1"}));
+    EXPECT_EQ(cmd->ops, std::vector<Op>({Op::ForceOutput}));
+    // NOLINTEND(bugprone-unchecked-optional-access)
+
+    cmd = make_command({"ls", "-l"});
+    ASSERT_TRUE(cmd.has_value());
+    EXPECT_FALSE(cmd->background); // NOLINT(bugprone-unchecked-optional-access)
+
+    EXPECT_FALSE(make_command({"&"}).has_value());
+}
+
+TEST(ParserTest, ParseQuotedAmpersandIsAnArgument)
+{
+    for (const std::string line : {"echo x '&'", "echo x \"&\"", "echo x \\&"})
+    {
+        auto tokens = nullsh::util::tokenize_views(line);
+        ASSERT_TRUE(tokens.has_value()) << line;
+        auto cmd = make_command(*tokens);
+        ASSERT_TRUE(cmd.has_value()) << line;
+        // NOLINTBEGIN(bugprone-unchecked-optional-access)
+        EXPECT_FALSE(cmd->background) << line;
+        EXPECT_EQ(cmd->args, std::vector<std::string>({"x", "&"})) << line;
+        // NOLINTEND(bugprone-unchecked-optional-access)
+    }
+
+    auto tokens = nullsh::util::tokenize_views("sleep 1 &");
+    ASSERT_TRUE(tokens.has_value());
+    auto cmd = make_command(*tokens);
+    ASSERT_TRUE(cmd.has_value());
+    EXPECT_TRUE(cmd->background); // NOLINT(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParseAssignments)
+{
+    auto cmd = make_command({"A=1", "B=x=y", "env", "C=2", "!"});
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_EQ(cmd->name, "env");
+    EXPECT_EQ(cmd->assignments, std::vector<std::string>({"A=1", "B=x=y"}));
+    EXPECT_EQ(cmd->args, std::vector<std::string>({"C=2"}));
+    EXPECT_EQ(cmd->ops, std::vector<Op>({Op::ForceOutput}));
+
+    cmd = make_command({"A=1", "B=2"});
+    ASSERT_TRUE(cmd.has_value());
+    EXPECT_TRUE(cmd->name.empty());
+    EXPECT_EQ(cmd->assignments, std::vector<std::string>({"A=1", "B=2"}));
+
+    // not a valid name, so a command
+    cmd = make_command({"1A=x", "ls"});
+    ASSERT_TRUE(cmd.has_value());
+    EXPECT_EQ(cmd->name, "1A=x");
+    EXPECT_TRUE(cmd->assignments.empty());
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParseManyTrailingOperatorsInOrder)
+{
+    std::vector<std::string> tokens = {"make", "?"};
+    std::vector<Op> expected = {Op::DiscardOutput};
+    for (int i = 0; i < 1000; ++i)
+    {
+        tokens.emplace_back(i % 2 == 0 ? "$?" : "$%");
+        expected.push_back(i % 2 == 0 ? Op::PrintRC : Op::PrintUsage);
+    }
+    auto cmd = make_command(tokens);
+    ASSERT_TRUE(cmd.has_value());
+    // NOLINTBEGIN(bugprone-unchecked-optional-access)
+    EXPECT_TRUE(cmd->args.empty());
+    EXPECT_EQ(cmd->ops, expected);
+    // NOLINTEND(bugprone-unchecked-optional-access)
+}
+
+TEST(ParserTest, ParseOperatorRejectsNearMisses)
+{
+    for (const char* token : {"", "!!", "$", "$$", "?!", "$%%", "$$?x", "x"})
+    {
+        EXPECT_EQ(parse_operator(token), Op::None) << token;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+/**
+ * @file test_read_ahead.cpp
+ * @brief Unit tests for the non-interactive input read-ahead
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "nullsh/read_ahead.h"
+
+using namespace nullsh::io;
+
+namespace
+{
+    // feeds text through a pipe and collects every parsed line
+    std::vector<ParsedLine> read_all(std::string_view text, std::size_t depth = 4)
+    {
+        std::array<int, 2> fds {-1, -1};
+        EXPECT_EQ(pipe(fds.data()), 0);
+
+        std::vector<ParsedLine> lines;
+        {
+            ReadAhead input {fds[0], depth};
+            std::thread writer(
+                [&]()
+                {
+                    (void) write(fds[1], text.data(), text.size());
+                    close(fds[1]);
+                });
+            while (auto line = input.next())
+            {
+                lines.push_back(std::move(*line));
+            }
+            EXPECT_TRUE(input.status().has_value());
+            writer.join();
+        }
+        close(fds[0]);
+        return lines;
+    }
+} // namespace
+
+TEST(ReadAhead, ParsesLines)
+{
+    auto lines = read_all("echo one !\n\n# comment\n  ls /tmp ?\r\npwd");
+    ASSERT_EQ(lines.size(), 3U);
+
+    EXPECT_EQ(lines[0].number, 1U);
+    ASSERT_TRUE(lines[0].cmd.has_value());
+    EXPECT_EQ(lines[0].cmd->name, "echo");
+
+    EXPECT_EQ(lines[1].number, 4U);
+    ASSERT_TRUE(lines[1].cmd.has_value());
+    EXPECT_EQ(lines[1].cmd->name, "ls");
+
+    EXPECT_EQ(lines[2].number, 5U);
+    ASSERT_TRUE(lines[2].cmd.has_value());
+    EXPECT_EQ(lines[2].cmd->name, "pwd");
+}
+
+TEST(ReadAhead, ReportsParseErrors)
+{
+    auto lines = read_all("echo ok\necho 'open\n");
+    ASSERT_EQ(lines.size(), 2U);
+    EXPECT_TRUE(lines[0].error.empty());
+    EXPECT_EQ(lines[1].number, 2U);
+    EXPECT_FALSE(lines[1].cmd.has_value());
+    EXPECT_EQ(lines[1].error, "Mismatched quotes in command line");
+}
+
+TEST(ReadAhead, LinesAcrossBlocks)
+{
+    // many more lines than the queue holds, some straddling block boundaries
+    std::string text;
+    const std::string arg(100, 'x');
+    const std::size_t count = 3 * ReadAhead::BLOCK_SIZE / 100;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        text += "echo " + arg + "\n";
+    }
+
+    auto lines = read_all(text);
+    ASSERT_EQ(lines.size(), count);
+    for (const auto& line : lines)
+    {
+        ASSERT_TRUE(line.cmd.has_value());
+        ASSERT_EQ(line.cmd->args.size(), 1U);
+        EXPECT_EQ(line.cmd->args[0], arg);
+    }
+    EXPECT_EQ(lines.back().number, count);
+}
+
+TEST(ReadAhead, StopsWhileInputIsOpen)
+{
+    std::array<int, 2> fds {-1, -1};
+    ASSERT_EQ(pipe(fds.data()), 0);
+    ASSERT_EQ(write(fds[1], "exit\necho later\n", 16), 16);
+
+    {
+        ReadAhead input {fds[0]};
+        auto line = input.next();
+        ASSERT_TRUE(line.has_value());
+        EXPECT_EQ(line->cmd->name, "exit");
+        // leaving with the writer still open must not hang on the helper's read
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ReadAhead, ReportsReadErrors)
+{
+    // reading a directory fails with EISDIR, which must not pass for the end of the input
+    int dir = open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_GE(dir, 0);
+    {
+        ReadAhead input {dir};
+        EXPECT_FALSE(input.next().has_value());
+        auto status = input.status();
+        ASSERT_FALSE(status.has_value());
+        EXPECT_EQ(status.error(), std::strerror(EISDIR));
+    }
+    close(dir);
+}
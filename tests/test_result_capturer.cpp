@@ -6,6 +6,13 @@
  */
 
 #include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <string_view>
 
 #include "nullsh/command.h"
 #include "nullsh/result_capturer.h"
@@ -55,3 +62,263 @@ TEST(ResultCapturerTest, CaptureFlow)
         EXPECT_EQ(res.stderr_data, "Error message\n");
     }
 }
+
+TEST(ResultCapturerTest, LargeStderrBeforeStdout)
+{
+    // several pipe buffers on stderr before stdout is ever written or closed; reading the
+    // streams one after the other deadlocks here
+    constexpr size_t STDERR_BYTES = 8UL * 1024 * 1024;
+
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {res};
+    capturer.init_pipes();
+
+    auto start = std::chrono::steady_clock::now();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        std::string chunk(65536, 'e');
+        for (size_t written = 0; written < STDERR_BYTES; written += chunk.size())
+        {
+            if (write(STDERR_FILENO, chunk.data(), chunk.size()) < 0)
+            {
+                _exit(1);
+            }
+        }
+        const std::string_view done = "done\n";
+        if (write(STDOUT_FILENO, done.data(), done.size()) < 0)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    capturer.capture_parent(pid);
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    RecordProperty("stderr_mib_per_sec",
+                   std::to_string(static_cast<double>(STDERR_BYTES) / (1024 * 1024) /
+                                  elapsed.count()));
+
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "done\n");
+    EXPECT_EQ(res.stderr_data.size(), STDERR_BYTES);
+    EXPECT_EQ(res.stderr_data.find_first_not_of('e'), std::string::npos);
+}
+
+TEST(ResultCapturerTest, SpillsPastThreshold)
+{
+    constexpr size_t THRESHOLD = 4096;
+    constexpr size_t STDOUT_BYTES = 1024UL * 1024;
+
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {res, {}, THRESHOLD};
+    capturer.init_pipes();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        std::string chunk(4096, 'o');
+        for (size_t written = 0; written < STDOUT_BYTES; written += chunk.size())
+        {
+            if (write(STDOUT_FILENO, chunk.data(), chunk.size()) < 0)
+            {
+                _exit(1);
+            }
+        }
+        const std::string_view err = "small\n";
+        if (write(STDERR_FILENO, err.data(), err.size()) < 0)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    capturer.capture_parent(pid);
+
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, ""); // moved out of the heap
+    ASSERT_NE(res.stdout_spill, nullptr);
+    EXPECT_EQ(res.stdout_spill->size(), STDOUT_BYTES);
+    EXPECT_EQ(res.stdout_spill->read_all(), std::string(STDOUT_BYTES, 'o'));
+
+    // below the threshold: stays in memory
+    EXPECT_EQ(res.stderr_data, "small\n");
+    EXPECT_EQ(res.stderr_spill, nullptr);
+}
+
+
+TEST(ResultCapturerTest, TimeoutTerminatesChild)
+{
+    using namespace std::chrono_literals;
+
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {
+        res, {}, io::CommandResultCapturer::DEFAULT_SPILL_THRESHOLD, {.timeout = 200ms}};
+    capturer.init_pipes();
+
+    auto start = std::chrono::steady_clock::now();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        const std::string_view partial = "started\n";
+        if (write(STDOUT_FILENO, partial.data(), partial.size()) < 0)
+        {
+            _exit(1);
+        }
+        pause();
+        _exit(0);
+    }
+
+    capturer.capture_parent(pid);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(res.return_code, 124);
+    EXPECT_EQ(res.stdout_data, "started\n");
+    EXPECT_GE(elapsed, 200ms);
+    EXPECT_LT(elapsed, io::CommandResultCapturer::KILL_GRACE);
+}
+
+TEST(ResultCapturerTest, TimeoutEscalatesToKill)
+{
+    using namespace std::chrono_literals;
+
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {
+        res, {}, io::CommandResultCapturer::DEFAULT_SPILL_THRESHOLD, {.timeout = 100ms}};
+    capturer.init_pipes();
+
+    auto start = std::chrono::steady_clock::now();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        signal(SIGTERM, SIG_IGN);
+        for (;;)
+        {
+            pause();
+        }
+    }
+
+    capturer.capture_parent(pid);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(res.return_code, 124);
+    EXPECT_GE(elapsed, 100ms + io::CommandResultCapturer::KILL_GRACE);
+}
+
+TEST(ResultCapturerTest, MaxOutputTruncates)
+{
+    constexpr size_t MAX_OUTPUT = 10000;
+
+    // the spill threshold is below the cap, so both the heap and the memfd paths are hit
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {res, {}, 4096, {.max_output = MAX_OUTPUT}};
+    capturer.init_pipes();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        std::string chunk(4096, 'o');
+        for (size_t written = 0; written < 1024UL * 1024; written += chunk.size())
+        {
+            if (write(STDOUT_FILENO, chunk.data(), chunk.size()) < 0)
+            {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+
+    capturer.capture_parent(pid);
+
+    // the child is never blocked, the excess is read and dropped
+    EXPECT_EQ(res.return_code, 0);
+    ASSERT_NE(res.stdout_spill, nullptr);
+    EXPECT_EQ(res.stdout_spill->read_all(), std::string(MAX_OUTPUT, 'o'));
+}
+
+TEST(ResultCapturerTest, ResourceLimitsApplyToChild)
+{
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {
+        res,
+        {},
+        io::CommandResultCapturer::DEFAULT_SPILL_THRESHOLD,
+        {.cpu_seconds = 7, .address_space = 1UL << 32, .open_files = 42}};
+    capturer.init_pipes();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        rlimit cpu {};
+        rlimit mem {};
+        rlimit files {};
+        getrlimit(RLIMIT_CPU, &cpu);
+        getrlimit(RLIMIT_AS, &mem);
+        getrlimit(RLIMIT_NOFILE, &files);
+        std::string out = std::to_string(cpu.rlim_cur) + " " + std::to_string(mem.rlim_cur) +
+                          " " + std::to_string(files.rlim_max) + "\n";
+        if (write(STDOUT_FILENO, out.data(), out.size()) < 0)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    capturer.capture_parent(pid);
+
+    EXPECT_EQ(res.return_code, 0);
+    EXPECT_EQ(res.stdout_data, "7 4294967296 42\n");
+}
+TEST(ResultCapturerTest, InterruptStopsCaptureAtExit)
+{
+    using namespace std::chrono_literals;
+
+    io::EventLoop loop {true};
+    command::CommandResult res {};
+    io::CommandResultCapturer capturer {
+        res, {}, io::CommandResultCapturer::DEFAULT_SPILL_THRESHOLD, {}, &loop};
+    capturer.init_pipes();
+
+    auto start = std::chrono::steady_clock::now();
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0) << "Fork failed";
+    if (pid == 0)
+    {
+        capturer.prepare_child();
+        sigprocmask(SIG_SETMASK, loop.child_mask(), nullptr);
+        // a descendant keeps the pipes open past the child's exit
+        if (fork() == 0)
+        {
+            alarm(3);
+            pause();
+            _exit(0);
+        }
+        pause();
+        _exit(0);
+    }
+
+    // not from the terminal, so the capturer passes it on to the child
+    raise(SIGINT);
+    capturer.capture_parent(pid);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(res.return_code, 128 + SIGINT);
+    EXPECT_LT(elapsed, 2s);
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+/**
+ * @file test_server.cpp
+ * @brief Unit tests for the nullsh server protocol, sessions and client
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "nullsh/server.h"
+
+using namespace nullsh::server;
+
+namespace
+{
+    // what run_client() would send from this process, minus one name, plus extra entries
+    std::vector<std::string> client_env(std::string_view without = {},
+                                        std::initializer_list<std::string> extra = {})
+    {
+        std::vector<std::string> env;
+        for (char** var = environ; *var != nullptr; ++var)
+        {
+            std::string_view entry = *var;
+            if (without.empty() || entry.substr(0, entry.find('=')) != without)
+            {
+                env.emplace_back(entry);
+            }
+        }
+        env.insert(env.end(), extra);
+        return env;
+    }
+} // namespace
+
+TEST(ServerTest, RequestRoundTrip)
+{
+    Request req {.line = "ls /tmp !", .cwd = "/tmp", .env = {"FOO=bar=baz", "GONE", ""}};
+    auto back = decode_request(encode(req));
+    ASSERT_TRUE(back.has_value());
+    EXPECT_EQ(back->line, req.line);
+    EXPECT_EQ(back->cwd, req.cwd);
+    EXPECT_EQ(back->env, req.env);
+}
+
+TEST(ServerTest, ReplyRoundTrip)
+{
+    Reply reply {.return_code = 127, .stdout_data = std::string("a\0b", 3), .stderr_data = "err"};
+    auto back = decode_reply(encode(reply));
+    ASSERT_TRUE(back.has_value());
+    EXPECT_EQ(back->return_code, 127);
+    EXPECT_EQ(back->stdout_data, reply.stdout_data);
+    EXPECT_EQ(back->stderr_data, "err");
+}
+
+TEST(ServerTest, DecodeRejectsBrokenMessages)
+{
+    auto data = encode(Request {.line = "echo", .cwd = "/", .env = {"A=1"}});
+    EXPECT_FALSE(decode_request(std::string_view(data).substr(0, data.size() - 1)));
+    EXPECT_FALSE(decode_request(data + "x"));
+    EXPECT_FALSE(decode_reply(""));
+}
+
+TEST(ServerTest, Frames)
+{
+    std::array<int, 2> fds {-1, -1};
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()), 0);
+
+    ASSERT_TRUE(write_frame(fds[0], "hello"));
+    ASSERT_TRUE(write_frame(fds[0], ""));
+    close(fds[0]);
+
+    EXPECT_EQ(read_frame(fds[1]), "hello");
+    EXPECT_EQ(read_frame(fds[1]), "");
+    EXPECT_FALSE(read_frame(fds[1]).has_value());
+    close(fds[1]);
+}
+
+TEST(ServerTest, HandleCapturesWhatOneShotPrints)
+{
+    auto saved_cwd = std::filesystem::current_path();
+    nullsh::shell::NullShell sh;
+
+    auto reply = handle(sh,
+                        {.line = "printenv NULLSH_SERVER_TEST !",
+                         .cwd = "/",
+                         .env = client_env({}, {"NULLSH_SERVER_TEST=warm"})});
+    EXPECT_EQ(reply.return_code, 0);
+    EXPECT_EQ(reply.stdout_data, "warm\n");
+
+    reply = handle(sh, {.line = "pwd !", .cwd = "/tmp", .env = {"NULLSH_SERVER_TEST"}});
+    EXPECT_EQ(reply.stdout_data, "/tmp\n");
+    EXPECT_EQ(std::getenv("NULLSH_SERVER_TEST"), nullptr);
+
+    reply = handle(sh, {.line = "ls /nonexistent_dir_12345", .cwd = {}, .env = client_env()});
+    EXPECT_NE(reply.return_code, 0);
+    EXPECT_TRUE(reply.stdout_data.empty());
+    EXPECT_FALSE(reply.stderr_data.empty());
+
+    reply = handle(sh, {.line = "echo 'open", .cwd = {}, .env = client_env()});
+    EXPECT_EQ(reply.return_code, 2);
+    EXPECT_EQ(reply.stderr_data, "parse error: Mismatched quotes in command line\n");
+
+    reply = handle(sh,
+                   {.line = "pwd", .cwd = "/nonexistent_dir_12345", .env = client_env()});
+    EXPECT_EQ(reply.return_code, 1);
+
+    std::filesystem::current_path(saved_cwd);
+}
+
+TEST(ServerTest, HandleMirrorsClientEnvironment)
+{
+    // a variable only the session has does not reach the client's commands
+    nullsh::shell::NullShell sh;
+    sh.variables().export_var("NULLSH_SERVER_ONLY", "leak");
+
+    auto reply = handle(sh,
+                        {.line = "printenv NULLSH_SERVER_ONLY !",
+                         .cwd = {},
+                         .env = client_env("NULLSH_SERVER_ONLY")});
+    EXPECT_NE(reply.return_code, 0);
+    EXPECT_EQ(reply.stdout_data, "");
+    EXPECT_FALSE(sh.variables().get("NULLSH_SERVER_ONLY").has_value());
+    EXPECT_EQ(std::getenv("NULLSH_SERVER_ONLY"), nullptr);
+}
+
+TEST(ServerTest, ServesClients)
+{
+    auto path = (std::filesystem::path(testing::TempDir()) / "nullsh_test.sock").string();
+    std::filesystem::remove(path);
+
+    pid_t server = fork();
+    ASSERT_GE(server, 0);
+    if (server == 0)
+    {
+        nullsh::shell::NullShell sh;
+        _exit(run_server(path, sh));
+    }
+
+    Request req {.line = "echo served !", .cwd = "/", .env = {}};
+    std::expected<Reply, std::string> reply = std::unexpected("not started");
+    for (int attempt = 0; attempt < 200 && !reply; ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        reply = send_request(path, req);
+    }
+    ASSERT_TRUE(reply.has_value()) << reply.error();
+    EXPECT_EQ(reply->return_code, 0);
+    EXPECT_EQ(reply->stdout_data, "served\n");
+
+    // sessions are independent, a second client is served as well
+    auto again = send_request(path, {.line = "exit 3", .cwd = {}, .env = {}});
+    ASSERT_TRUE(again.has_value());
+    EXPECT_EQ(again->return_code, 3);
+
+    kill(server, SIGTERM);
+    int status = 0;
+    ASSERT_EQ(waitpid(server, &status, 0), server);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
\ No newline at end of file
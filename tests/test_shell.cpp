@@ -5,7 +5,15 @@
  * @license GPLv3 (see LICENSE file)
  */
 
+#include <fcntl.h>
 #include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
 
 #include "nullsh/shell.h"
 
@@ -55,3 +63,187 @@ TEST(ShellTest, MultipleCommandsExecute)
     EXPECT_EQ(rc1, 0); // Assuming execute returns 0 for success
     EXPECT_EQ(rc2, 0); // Assuming execute returns 0 for success
 }
+
+
+TEST(ShellTest, RunScript)
+{
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    int rc = shell.run_script("#!/usr/bin/env nullsh\n"
+                              "# comment\n"
+                              "\n"
+                              "echo one !\r\n"
+                              "  echo two !\n"
+                              "false",
+                              "test.nsh");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "one\ntwo\n");
+    EXPECT_EQ(rc, 1);
+}
+
+TEST(ShellTest, RunScriptParseError)
+{
+    NullShell shell;
+    testing::internal::CaptureStderr();
+    int rc = shell.run_script("echo ok\necho 'open", "test.nsh");
+    EXPECT_EQ(testing::internal::GetCapturedStderr(),
+              "test.nsh: line 2: parse error: Mismatched quotes in command line\n");
+    EXPECT_EQ(rc, 2);
+}
+
+TEST(ShellTest, RunScriptVariables)
+{
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    int rc = shell.run_script("GREETING=hi\n"
+                              "echo $GREETING there !\n"
+                              "export NULLSH_OUT=1\n"
+                              "ONCE=yes sh -c 'echo $ONCE $NULLSH_OUT' !\n"
+                              "echo \"[$ONCE]\" !\n"
+                              "unset NULLSH_OUT\n",
+                              "test.nsh");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "hi there\nyes 1\n[]\n");
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(shell.variables().get("GREETING"), "hi");
+    EXPECT_FALSE(shell.variables().exported("GREETING"));
+    EXPECT_EQ(getenv("ONCE"), nullptr);
+    EXPECT_EQ(getenv("NULLSH_OUT"), nullptr);
+}
+
+TEST(ShellTest, RunScriptStopsAtExit)
+{
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    int rc = shell.run_script("exit 3\necho never !\n", "test.nsh");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+    EXPECT_EQ(rc, 3);
+}
+
+TEST(ShellTest, Source)
+{
+    auto path = std::filesystem::path(testing::TempDir()) / "nullsh_source.nsh";
+    std::ofstream(path) << "echo sourced !\n";
+
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    auto rc = shell.source(path.string());
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "sourced\n");
+    ASSERT_TRUE(rc.has_value());
+    EXPECT_EQ(*rc, 0);
+
+    auto missing = shell.source("/nonexistent/script.nsh");
+    ASSERT_FALSE(missing.has_value());
+    EXPECT_EQ(missing.error(), "No such file or directory");
+}
+
+TEST(ShellTest, SourceNestingLimit)
+{
+    auto path = std::filesystem::path(testing::TempDir()) / "nullsh_loop.nsh";
+    std::ofstream(path) << "source " << path.string() << "\n";
+
+    NullShell shell;
+    testing::internal::CaptureStderr();
+    auto rc = shell.source(path.string());
+    std::string err = testing::internal::GetCapturedStderr();
+    ASSERT_TRUE(rc.has_value());
+    EXPECT_EQ(*rc, 1);
+    EXPECT_NE(err.find("maximum nesting depth exceeded"), std::string::npos);
+}
+
+namespace
+{
+    // runs text through run_stream as if it were piped into the shell
+    int run_piped(NullShell& shell, std::string_view text)
+    {
+        auto path = std::filesystem::path(testing::TempDir()) / "nullsh_stream.txt";
+        std::ofstream(path) << text;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        int rc = shell.run_stream(fd, "stdin");
+        close(fd);
+        return rc;
+    }
+} // namespace
+
+TEST(ShellTest, RunStream)
+{
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    int rc = run_piped(shell, "echo one !\n# comment\necho 'open\necho two !\nfalse\n");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "one\ntwo\n");
+    EXPECT_EQ(testing::internal::GetCapturedStderr(),
+              "stdin: line 3: parse error: Mismatched quotes in command line\n");
+    EXPECT_EQ(rc, 1);
+}
+
+TEST(ShellTest, RunStreamExpandsInOrder)
+{
+    // lines read ahead must see the variables set by the lines before them
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    int rc = run_piped(shell,
+                       "NULLSH_V=one\necho $NULLSH_V !\nNULLSH_V=two\necho ${NULLSH_V} !\n");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "one\ntwo\n");
+    EXPECT_EQ(rc, 0);
+}
+
+TEST(ShellTest, RunStreamDetachesChildStdin)
+{
+    // cat would swallow the lines after it if it shared the shell's input
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    int rc = run_piped(shell, "cat !\necho after !\nexit 4\necho never !\n");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "after\n");
+    EXPECT_EQ(rc, 4);
+    EXPECT_EQ(shell.exec_options().stdin_fd, -1);
+}
+
+TEST(ShellTest, BuiltinPipelineStageStaysOutOfTheHeap)
+{
+    // the cat builtin feeds wc through a memfd, not through a string in the shell
+    constexpr off_t SIZE = off_t {64} << 20;
+    const std::string path = testing::TempDir() + "nullsh_big_stage.bin";
+    int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, SIZE), 0);
+    close(fd);
+
+    NullShell shell;
+    rusage before {};
+    getrusage(RUSAGE_SELF, &before);
+    testing::internal::CaptureStdout();
+    int rc = shell.execute(std::vector<std::string> {"cat", path, "|", "wc", "-c", "!"});
+    std::string output = testing::internal::GetCapturedStdout();
+    rusage after {};
+    getrusage(RUSAGE_SELF, &after);
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(output, std::to_string(SIZE) + "\n");
+    EXPECT_LT(after.ru_maxrss - before.ru_maxrss, 16 * 1024); // KiB
+}
+
+TEST(ShellTest, RelayedBuiltinOutputIsLeftAsWritten)
+{
+    // no newline is added to output shown live, same as for the program
+    NullShell shell;
+    testing::internal::CaptureStdout();
+    shell.execute(std::vector<std::string> {"printf", "%s", "x", "!"});
+    std::string builtin = testing::internal::GetCapturedStdout();
+    testing::internal::CaptureStdout();
+    shell.execute(std::vector<std::string> {"/usr/bin/printf", "%s", "x", "!"});
+    std::string program = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(builtin, "x");
+    EXPECT_EQ(builtin, program);
+
+    // a memo hit replays exactly what the miss printed
+    const std::vector<std::string> memo {"memo", "/usr/bin/printf", "%s", "y", "!"};
+    testing::internal::CaptureStdout();
+    shell.execute(memo);
+    std::string miss = testing::internal::GetCapturedStdout();
+    testing::internal::CaptureStdout();
+    shell.execute(memo);
+    std::string hit = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(shell.memo().stats().hits, 1U);
+    EXPECT_EQ(miss, "y");
+    EXPECT_EQ(hit, miss);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file test_spill_file.cpp
+ * @brief Unit tests for memfd spill files
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <array>
+#include <string>
+
+#include "nullsh/spill_file.h"
+
+using namespace nullsh::io;
+
+TEST(SpillFileTest, AppendAndReadBack)
+{
+    auto spill = SpillFile::create("test");
+    ASSERT_NE(spill, nullptr);
+
+    EXPECT_EQ(spill->size(), 0);
+    EXPECT_EQ(spill->back(), '\0');
+
+    ASSERT_TRUE(spill->append("hello ", 6));
+    ASSERT_TRUE(spill->append("void", 4));
+    EXPECT_EQ(spill->size(), 10);
+    EXPECT_EQ(spill->back(), 'd');
+    EXPECT_EQ(spill->read_all(), "hello void");
+}
+
+TEST(SpillFileTest, SpliceFromPipe)
+{
+    auto spill = SpillFile::create("test");
+    ASSERT_NE(spill, nullptr);
+
+    std::array<int, 2> fds {-1, -1};
+    ASSERT_EQ(pipe(fds.data()), 0);
+    ASSERT_EQ(write(fds[1], "spliced", 7), 7);
+
+    EXPECT_EQ(spill->splice_from(fds[0], 4096), 7);
+    close(fds[1]);
+    EXPECT_EQ(spill->splice_from(fds[0], 4096), 0); // EOF
+    close(fds[0]);
+
+    EXPECT_EQ(spill->read_all(), "spliced");
+}
+
+TEST(SpillFileTest, SendTo)
+{
+    auto spill = SpillFile::create("test");
+    ASSERT_NE(spill, nullptr);
+    std::string data(200000, 'x');
+    ASSERT_TRUE(spill->append(data.data(), data.size()));
+
+    testing::internal::CaptureStdout();
+    EXPECT_TRUE(spill->send_to(STDOUT_FILENO));
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), data);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file test_static_map.cpp
+ * @brief Unit tests for the compile-time perfect hash table
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+#include "nullsh/static_map.h"
+
+using nullsh::util::make_static_map;
+
+namespace
+{
+    constexpr auto COLORS = make_static_map<int>({
+        {"red", 1},   //
+        {"green", 2}, //
+        {"blue", 3},  //
+        {"", 4},      //
+        {"r", 5},     //
+    });
+
+    // looked up during compilation, the table is a constant
+    static_assert(*COLORS.find("green") == 2);
+    static_assert(COLORS.find("purple") == nullptr);
+    static_assert(COLORS.size() == 5);
+
+    // same length, first and last byte, only the middle tells them apart
+    constexpr auto LOOKALIKES = make_static_map<int>({
+        {"true", 1}, //
+        {"type", 2}, //
+        {"time", 3}, //
+        {"tame", 4}, //
+        {"tune", 5}, //
+        {"tree", 6}, //
+    });
+} // namespace
+
+TEST(StaticMap, FindsEveryKey)
+{
+    EXPECT_EQ(*COLORS.find("red"), 1);
+    EXPECT_EQ(*COLORS.find("green"), 2);
+    EXPECT_EQ(*COLORS.find("blue"), 3);
+    EXPECT_EQ(*COLORS.find(""), 4);
+    EXPECT_EQ(*COLORS.find("r"), 5);
+}
+
+TEST(StaticMap, MissesAreRejected)
+{
+    for (const char* key : {"re", "redd", "Red", "gree", "blue ", "b", "yellowish-orange"})
+    {
+        EXPECT_FALSE(COLORS.contains(key)) << key;
+    }
+}
+
+TEST(StaticMap, KeysNeedNotOutliveTheLookup)
+{
+    std::string key = "bl";
+    key += "ue";
+    EXPECT_TRUE(COLORS.contains(key));
+}
+
+TEST(StaticMap, KeysSharingLengthAndEnds)
+{
+    EXPECT_EQ(*LOOKALIKES.find("true"), 1);
+    EXPECT_EQ(*LOOKALIKES.find("type"), 2);
+    EXPECT_EQ(*LOOKALIKES.find("time"), 3);
+    EXPECT_EQ(*LOOKALIKES.find("tame"), 4);
+    EXPECT_EQ(*LOOKALIKES.find("tune"), 5);
+    EXPECT_EQ(*LOOKALIKES.find("tree"), 6);
+    for (const char* key : {"tile", "tone", "t", "te", "trues"})
+    {
+        EXPECT_FALSE(LOOKALIKES.contains(key)) << key;
+    }
+}
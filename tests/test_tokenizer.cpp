@@ -0,0 +1,274 @@
+/**
+ * @file test_tokenizer.cpp
+ * @brief Unit tests for the in-place command line tokenizer
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cctype>
+#include <expected>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nullsh/tokenizer.h"
+
+using namespace nullsh::util;
+
+namespace
+{
+    constexpr std::array<ScanLevel, 3> LEVELS = {ScanLevel::Scalar, ScanLevel::SSE2,
+                                                 ScanLevel::AVX2};
+
+    // character at a time tokenizer the vectorized one replaced, the reference for parity
+    auto reference(std::string_view line) -> std::expected<std::vector<std::string>, std::string>
+    {
+        std::vector<std::string> tokens;
+        std::string cur;
+        bool in_single = false;
+        bool in_double = false;
+        for (size_t i = 0; i < line.size(); ++i)
+        {
+            char chr = line[i];
+            if (chr == '\\')
+            {
+                cur.push_back(i + 1 < line.size() ? line[++i] : '\\');
+            }
+            else if (chr == '\'' && !in_double)
+            {
+                in_single = !in_single;
+            }
+            else if (chr == '"' && !in_single)
+            {
+                in_double = !in_double;
+            }
+            else if (!in_single && !in_double &&
+                     (std::isspace(static_cast<unsigned char>(chr)) != 0 || chr == '|' ||
+                      chr == '&'))
+            {
+                if (!cur.empty())
+                {
+                    tokens.emplace_back(std::move(cur));
+                    cur.clear();
+                }
+                if (chr == '|' || chr == '&')
+                {
+                    tokens.emplace_back(1, chr);
+                }
+            }
+            else
+            {
+                cur.push_back(chr);
+            }
+        }
+        if (in_single || in_double)
+        {
+            return std::unexpected("Mismatched quotes in command line");
+        }
+        if (!cur.empty())
+        {
+            tokens.emplace_back(std::move(cur));
+        }
+        return tokens;
+    }
+
+    bool inside(std::string_view token, std::string_view line)
+    {
+        return token.data() >= line.data() &&
+               token.data() + token.size() <= line.data() + line.size();
+    }
+
+    void expect_parity(const std::string& line)
+    {
+        auto expected = reference(line);
+        for (auto level : LEVELS)
+        {
+            auto tokens = tokenize_views(line, level);
+            ASSERT_EQ(tokens.has_value(), expected.has_value()) << line;
+            if (!expected)
+            {
+                EXPECT_EQ(tokens.error(), expected.error());
+                continue;
+            }
+            EXPECT_EQ(tokens->to_strings(), *expected) << line;
+        }
+    }
+} // namespace
+
+TEST(TokenizeViews, PlainWordsPointIntoTheLine)
+{
+    const std::string line = "ls -l /tmp|wc -l &";
+    auto tokens = tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+    ASSERT_EQ(tokens->size(), 7);
+    EXPECT_EQ((*tokens)[3], "|");
+    EXPECT_EQ((*tokens)[6], "&");
+    EXPECT_EQ(tokens->kinds()[3], TokenKind::Separator);
+    EXPECT_EQ(tokens->kinds()[6], TokenKind::Separator);
+    EXPECT_EQ(tokens->kinds()[0], TokenKind::Word);
+    for (auto token : *tokens)
+    {
+        EXPECT_TRUE(inside(token, line)) << token;
+    }
+    EXPECT_EQ(tokens->owned_count(), 0);
+}
+
+TEST(TokenizeViews, QuotedWordIsAViewOfItsInside)
+{
+    const std::string line = R"(echo 'hello void' "a|b" '')";
+    auto tokens = tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+    ASSERT_EQ(tokens->size(), 3);
+    EXPECT_EQ((*tokens)[1], "hello void");
+    EXPECT_EQ((*tokens)[2], "a|b");
+    EXPECT_EQ(tokens->kinds()[2], TokenKind::Word);
+    EXPECT_TRUE(inside((*tokens)[1], line));
+    EXPECT_EQ(tokens->owned_count(), 0);
+}
+
+TEST(TokenizeViews, OnlyRewrittenWordsAreOwned)
+{
+    const std::string line = R"(echo hello\ world pre'fix' "say \"hi\"" plain)";
+    auto tokens = tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+    ASSERT_EQ(tokens->size(), 5);
+    EXPECT_EQ((*tokens)[1], "hello world");
+    EXPECT_EQ((*tokens)[2], "prefix");
+    EXPECT_EQ((*tokens)[3], "say \"hi\"");
+    EXPECT_EQ(tokens->owned_count(), 3);
+    EXPECT_FALSE(inside((*tokens)[1], line));
+    EXPECT_TRUE(inside((*tokens)[4], line));
+}
+
+TEST(TokenizeViews, ViewsSurviveMovingTheList)
+{
+    const std::string line = "a\\ b c";
+    auto tokens = tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+    TokenList moved = std::move(*tokens);
+    ASSERT_EQ(moved.size(), 2);
+    EXPECT_EQ(moved[0], "a b");
+    EXPECT_EQ(moved[1], "c");
+}
+
+TEST(TokenizeViews, MismatchedQuotesErrorIsUnchanged)
+{
+    for (const std::string line : {"echo 'open", "echo \"open", "a 'b\\'", "x \"y\\"})
+    {
+        auto tokens = tokenize_views(line);
+        ASSERT_FALSE(tokens.has_value()) << line;
+        EXPECT_EQ(tokens.error(), "Mismatched quotes in command line");
+    }
+}
+
+TEST(TokenizeViews, MatchesReferenceOnEdgeCases)
+{
+    for (const std::string line :
+         {"", "   ", "\t\n\v\f\r", "echo hello\\", "a''b", "'' \"\"", "''x", "x''", "'a'\"b\"c",
+          "echo '\\''", "sleep 1& echo '&'", "ls -l|wc -l | cat", R"(echo 'a|b' "c|d" e\|f)",
+          "\"it's\" 'say \"x\"'", "a\\\\b", "&&||", "\\ ", "'a b'c d", "\x01\x7f\xff word"})
+    {
+        expect_parity(line);
+    }
+}
+
+TEST(TokenizeViews, MatchesReferenceAcrossBlockBoundaries)
+{
+    // quotes, escapes and words straddling the 16, 32 and 64 byte scan widths
+    for (size_t pad = 0; pad < 130; ++pad)
+    {
+        std::string line(pad, 'x');
+        line += " 'quoted \\' text' \"dq|&\" esc\\ aped|tail&";
+        expect_parity(line);
+        expect_parity(line + " 'unterminated");
+    }
+}
+
+TEST(TokenizeViews, MatchesReferenceOnRandomLines)
+{
+    constexpr std::string_view ALPHABET = "ab '\"\\|&\t\n-$";
+    std::mt19937 rng(42); // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    std::uniform_int_distribution<size_t> pick(0, ALPHABET.size() - 1);
+    std::uniform_int_distribution<size_t> length(0, 300);
+    for (int round = 0; round < 2000; ++round)
+    {
+        std::string line(length(rng), ' ');
+        for (auto& chr : line)
+        {
+            chr = ALPHABET[pick(rng)];
+        }
+        expect_parity(line);
+    }
+}
+
+TEST(TokenizeViews, LongArgumentListStaysInPlace)
+{
+    std::string line = "cmd";
+    for (int i = 0; i < 4096; ++i)
+    {
+        line += " arg" + std::to_string(i);
+    }
+    auto tokens = tokenize_views(line);
+    ASSERT_TRUE(tokens.has_value());
+    ASSERT_EQ(tokens->size(), 4097);
+    EXPECT_EQ((*tokens)[4096], "arg4095");
+    EXPECT_EQ(tokens->owned_count(), 0);
+}
+
+TEST(TokenizeViews, ExpandsVariables)
+{
+    nullsh::vars::VarTable vars;
+    vars.set("NAME", "void");
+    vars.set("SPACED", "a b");
+
+    const std::string line =
+        R"(echo $NAME ${NAME}x "is $NAME." '$NAME' \$NAME $SPACED $UNSET "$UNSET" end)";
+    auto tokens = tokenize_views(line, vars);
+    ASSERT_TRUE(tokens.has_value());
+    EXPECT_EQ(tokens->to_strings(),
+              (std::vector<std::string> {"echo", "void", "voidx", "is void.", "$NAME", "$NAME",
+                                         "a b", "end"}));
+
+    // operators and a '$' not followed by a name stay as they are
+    tokens = tokenize_views("cmd $? $$? $% $ a$ ${NAME $1 ${}", vars);
+    ASSERT_TRUE(tokens.has_value());
+    EXPECT_EQ(tokens->to_strings(),
+              (std::vector<std::string> {"cmd", "$?", "$$?", "$%", "$", "a$", "${NAME", "$1",
+                                         "${}"}));
+
+    const std::string plain = "ls $NAME /tmp";
+    tokens = tokenize_views(plain, vars);
+    ASSERT_TRUE(tokens.has_value());
+    EXPECT_EQ(tokens->owned_count(), 1);
+    EXPECT_TRUE(inside((*tokens)[2], plain));
+}
+
+TEST(TokenizeViews, ExpansionsAcrossBlockBoundaries)
+{
+    nullsh::vars::VarTable vars;
+    vars.set("V", "value");
+    for (size_t pad = 0; pad < 130; ++pad)
+    {
+        std::string line = "w" + std::string(pad, 'x');
+        line += " a$V \"$V|$V\" '$V'";
+        auto tokens = tokenize_views(line, vars);
+        ASSERT_TRUE(tokens.has_value());
+        ASSERT_EQ(tokens->size(), 4) << line;
+        EXPECT_EQ((*tokens)[1], "avalue");
+        EXPECT_EQ((*tokens)[2], "value|value");
+        EXPECT_EQ((*tokens)[3], "$V");
+    }
+}
+
+TEST(TokenizeViews, HasExpansions)
+{
+    EXPECT_TRUE(has_expansions("echo $HOME"));
+    EXPECT_TRUE(has_expansions("echo ${HOME}"));
+    EXPECT_TRUE(has_expansions("echo '$_quoted'"));
+    EXPECT_FALSE(has_expansions("echo hi $? $$? $%"));
+    EXPECT_FALSE(has_expansions("a$ $1"));
+}
\ No newline at end of file
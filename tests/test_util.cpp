@@ -7,6 +7,9 @@
 
 #include <gtest/gtest.h>
 
+#include <limits>
+#include <string>
+
 #include "nullsh/util.h"
 
 TEST(LTrimTest, RemovesSpaces)
@@ -156,6 +159,48 @@ TEST(TokenizeTest, EscapedSpaces)
     EXPECT_EQ((*result)[1], "hello world");
 }
 
+TEST(TokenizeTest, PipeSeparator)
+{
+    auto result = nullsh::util::tokenize("ls -l|wc -l | cat");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(*result, std::vector<std::string>({"ls", "-l", "|", "wc", "-l", "|", "cat"}));
+}
+
+TEST(TokenizeTest, QuotedPipe)
+{
+    auto result = nullsh::util::tokenize(R"(echo 'a|b' "c|d" e\|f)");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(*result, std::vector<std::string>({"echo", "a|b", "c|d", "e|f"}));
+}
+
+TEST(TokenizeTest, BackgroundSeparator)
+{
+    auto result = nullsh::util::tokenize("sleep 1& echo '&'");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(*result, std::vector<std::string>({"sleep", "1", "&", "echo", "&"}));
+}
+
+TEST(ParseSizeTest, Suffixes)
+{
+    EXPECT_EQ(nullsh::util::parse_size("4096"), 4096U);
+    EXPECT_EQ(nullsh::util::parse_size("512K"), 512U << 10);
+    EXPECT_EQ(nullsh::util::parse_size("16m"), 16U << 20);
+    EXPECT_EQ(nullsh::util::parse_size("1G"), std::size_t {1} << 30);
+    EXPECT_FALSE(nullsh::util::parse_size("").has_value());
+    EXPECT_FALSE(nullsh::util::parse_size("K").has_value());
+    EXPECT_FALSE(nullsh::util::parse_size("12X").has_value());
+}
+
+TEST(ParseSizeTest, RejectsOverflow)
+{
+    constexpr std::size_t MAX = std::numeric_limits<std::size_t>::max();
+    EXPECT_EQ(nullsh::util::parse_size(std::to_string(MAX >> 30) + "G"), (MAX >> 30) << 30);
+    EXPECT_FALSE(nullsh::util::parse_size(std::to_string((MAX >> 30) + 1) + "G").has_value());
+    EXPECT_FALSE(nullsh::util::parse_size(std::to_string((MAX >> 10) + 1) + "K").has_value());
+    EXPECT_FALSE(nullsh::util::parse_size(std::to_string(MAX) + "M").has_value());
+    EXPECT_FALSE(nullsh::util::parse_size("99999999999999999999").has_value());
+}
+
 TEST(CommandExistsTest, ExistingCommand)
 {
     EXPECT_TRUE(nullsh::util::command_exists("ls")); // Assuming 'ls' exists on the system
@@ -0,0 +1,148 @@
+/**
+ * @file test_variables.cpp
+ * @brief Unit tests for the shell variable table and its envp
+ *
+ * @license GPLv3 (see LICENSE file)
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "nullsh/variables.h"
+
+using namespace nullsh::vars;
+
+namespace
+{
+    auto envp_of(const VarTable& vars) -> std::set<std::string>
+    {
+        std::set<std::string> entries;
+        std::size_t count = 0;
+        for (char* const* var = vars.envp(); *var != nullptr; ++var, ++count)
+        {
+            entries.emplace(*var);
+        }
+        EXPECT_EQ(count, vars.exported_count());
+        return entries;
+    }
+} // namespace
+
+TEST(VarTable, ImportsAnEnvironment)
+{
+    std::array<std::string, 4> strings {"A=1", "B=two=2", "A=dup", "bad"};
+    std::array<char*, 5> env {strings[0].data(), strings[1].data(), strings[2].data(),
+                              strings[3].data(), nullptr};
+    VarTable vars {env.data()};
+
+    EXPECT_EQ(vars.get("A"), "1");
+    EXPECT_EQ(vars.get("B"), "two=2");
+    EXPECT_FALSE(vars.get("bad").has_value());
+    EXPECT_TRUE(vars.exported("A"));
+    EXPECT_EQ(envp_of(vars), (std::set<std::string> {"A=1", "B=two=2"}));
+}
+
+TEST(VarTable, OnlyExportedVariablesAreInEnvp)
+{
+    VarTable vars;
+    vars.set("LOCAL", "here");
+    EXPECT_EQ(vars.get("LOCAL"), "here");
+    EXPECT_FALSE(vars.exported("LOCAL"));
+    EXPECT_TRUE(envp_of(vars).empty());
+
+    vars.export_var("LOCAL");
+    vars.export_var("MISSING");
+    EXPECT_EQ(envp_of(vars), (std::set<std::string> {"LOCAL=here"}));
+
+    // a set keeps the export flag, the slot follows the new value
+    vars.set("LOCAL", std::string(1000, 'x'));
+    EXPECT_EQ(envp_of(vars), (std::set<std::string> {"LOCAL=" + std::string(1000, 'x')}));
+
+    EXPECT_TRUE(vars.unset("LOCAL"));
+    EXPECT_FALSE(vars.unset("LOCAL"));
+    EXPECT_TRUE(envp_of(vars).empty());
+}
+
+TEST(VarTable, ScopeIsUndone)
+{
+    VarTable vars;
+    vars.export_var("A", "1");
+    vars.set("B", "2");
+    {
+        std::vector<std::string> words {"A=x", "B=y", "C=z", "not-a-name=1"};
+        VarTable::Scope scope {vars, words};
+        EXPECT_EQ(envp_of(vars), (std::set<std::string> {"A=x", "B=y", "C=z"}));
+    }
+    EXPECT_EQ(envp_of(vars), (std::set<std::string> {"A=1"}));
+    EXPECT_EQ(vars.get("B"), "2");
+    EXPECT_FALSE(vars.exported("B"));
+    EXPECT_FALSE(vars.get("C").has_value());
+}
+
+TEST(VarTable, MatchesAModelUnderRandomChanges)
+{
+    VarTable vars;
+    std::map<std::string, std::pair<std::string, bool>> model;
+    std::mt19937 rng(7); // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    std::uniform_int_distribution<int> pick_name(0, 15);
+    std::uniform_int_distribution<int> pick_op(0, 3);
+
+    for (int round = 0; round < 5000; ++round)
+    {
+        std::string name = "V" + std::to_string(pick_name(rng));
+        std::string value = std::to_string(round);
+        switch (pick_op(rng))
+        {
+            case 0:
+                vars.set(name, value);
+                model[name] = {value, model.contains(name) && model[name].second};
+                break;
+            case 1:
+                vars.export_var(name, value);
+                model[name] = {value, true};
+                break;
+            case 2:
+                vars.export_var(name);
+                if (model.contains(name))
+                {
+                    model[name].second = true;
+                }
+                break;
+            default:
+                vars.unset(name);
+                model.erase(name);
+                break;
+        }
+
+        std::set<std::string> expected;
+        for (const auto& [var, state] : model)
+        {
+            if (state.second)
+            {
+                expected.insert(var + "=" + state.first);
+            }
+        }
+        ASSERT_EQ(envp_of(vars), expected) << "round " << round;
+    }
+}
+
+TEST(VarTable, Names)
+{
+    EXPECT_TRUE(valid_name("_a1"));
+    EXPECT_TRUE(valid_name("PATH"));
+    EXPECT_FALSE(valid_name(""));
+    EXPECT_FALSE(valid_name("1a"));
+    EXPECT_FALSE(valid_name("a-b"));
+
+    auto assignment = split_assignment("NAME=a=b");
+    ASSERT_TRUE(assignment.has_value());
+    EXPECT_EQ(assignment->first, "NAME");  // NOLINT(bugprone-unchecked-optional-access)
+    EXPECT_EQ(assignment->second, "a=b"); // NOLINT(bugprone-unchecked-optional-access)
+    EXPECT_FALSE(split_assignment("=x").has_value());
+    EXPECT_FALSE(split_assignment("plain").has_value());
+}
\ No newline at end of file